@@ -101,6 +101,13 @@ struct shim_gipc_entry {
 #endif
 };
 
+struct shim_postcopy_entry {
+    struct shim_postcopy_entry * prev;
+    void * addr;
+    size_t size;
+    int prot;
+};
+
 struct shim_palhdl_entry {
     struct shim_palhdl_entry * prev;
     PAL_HANDLE handle;
@@ -132,6 +139,15 @@ struct shim_cp_store {
     /* entries of pal handles to send */
     struct shim_palhdl_entry * last_palhdl_entry;
     int palhdl_nentries;
+
+    /* entries of memory transferred lazily after the checkpoint */
+    bool use_postcopy;
+    struct shim_postcopy_entry * last_postcopy_entry;
+    int postcopy_nentries;
+
+    /* shared memory is sent as handles to map, not copied; a snapshot or a
+       checkpoint file outlives the memory, so it copies it instead */
+    bool share_memory;
 };
 
 #define CP_FUNC_ARGS                                    \
@@ -410,6 +426,11 @@ struct newproc_cp_header {
     struct mem_header {
         unsigned long entoffset;
         int nentries;
+        /* memory data follows the entries; encoded page by page on streams */
+        unsigned long dataoffset;
+        bool encoded;
+        /* helper threads to restore the memory with (sys.checkpoint.workers) */
+        int workers;
     } mem;
     struct palhdl_header {
         unsigned long entoffset;
@@ -420,6 +441,11 @@ struct newproc_cp_header {
         unsigned long entoffset;
         int nentries;
     } gipc;
+    struct postcopy_header {
+        char uri[24];
+        unsigned long entoffset;
+        int nentries;
+    } postcopy;
 };
 
 struct newproc_header {
@@ -437,6 +463,8 @@ struct newproc_response {
     int failure;
 };
 
+int init_checkpoint (void);
+
 int do_migration (struct newproc_cp_header * hdr, void ** cpptr);
 
 int restore_checkpoint (struct cp_header * cphdr, struct mem_header * memhdr,
@@ -456,9 +484,39 @@ int init_from_checkpoint_file (const char * filename,
 int restore_from_file (const char * filename, struct newproc_cp_header * hdr,
                        void ** cpptr);
 
+/* warm-start snapshots of a process saved in a file, see sys.snapshot */
+int do_snapshot_process (int (*migrate) (struct shim_cp_store *,
+                                         struct shim_thread *,
+                                         struct shim_process *, va_list),
+                         struct shim_thread * thread, ...);
+
+int restore_from_snapshot (PAL_HANDLE file, struct newproc_cp_header * hdr,
+                           void ** cpptr);
+
 void restore_context (struct shim_context * context);
 
+/* post-copy (lazy) memory transfer for fork, see shim_postcopy.c */
+int init_postcopy (void);
+bool postcopy_eligible (void * addr, size_t size, int prot, bool file_backed);
+int postcopy_prepare_server (struct shim_cp_store * store, char * uri,
+                             size_t size);
+int postcopy_start_server (struct shim_cp_store * store);
+void postcopy_abort_server (void);
+void postcopy_child_restored (void);
+int restore_postcopy (struct postcopy_header * hdr, ptr_t base, long rebase);
+bool postcopy_handle_fault (void * addr);
+void postcopy_flush_range (void * addr, size_t size, bool discard);
+void postcopy_fetch_all (void);
+void postcopy_drain (bool need_data);
+
+/* pool of pre-created processes for fork, see shim_procpool.c */
+int init_procpool (void);
+PAL_HANDLE get_pooled_process (void);
+void refill_procpool (void);
+void destroy_procpool (void);
+
 int create_checkpoint (const char * cpdir, IDTYPE * session);
 int join_checkpoint (struct shim_thread * cur, IDTYPE sid);
+int create_snapshot (void);
 
 #endif /* _SHIM_CHECKPOINT_H_ */
@@ -47,6 +47,9 @@
 
 #define CP_INIT_VMA_SIZE            (64 * 1024 * 1024)  /* 64MB */
 
+/* smallest VMA transferred lazily when sys.fork.postcopy is enabled */
+#define DEFAULT_POSTCOPY_MIN_SIZE   (4 * 1024 * 1024)   /* 4MB */
+
 #define EXECVE_RTLD                 1
 
 #define ENABLE_ASLR                 1
@@ -569,6 +569,7 @@ extern struct shim_mount chroot_builtin_fs;
 extern struct shim_mount pipe_builtin_fs;
 extern struct shim_mount socket_builtin_fs;
 extern struct shim_mount epoll_builtin_fs;
+extern struct shim_mount shm_builtin_fs;
 
 /* proc file system */
 struct proc_nm_ops {
@@ -582,6 +583,8 @@ struct proc_fs_ops {
     int (*mode) (const char * name, mode_t * mode);
     int (*stat) (const char * name, struct stat * buf);
     int (*follow_link) (const char * name, struct shim_qstr * link);
+    /* writes to the file, instead of to its string buffer */
+    ssize_t (*write) (struct shim_handle * hdl, const void * buf, size_t count);
 };
 
 struct proc_dir;
@@ -611,4 +614,7 @@ ssize_t str_write (struct shim_handle * hdl, const void * buf, size_t count);
 off_t str_seek (struct shim_handle * hdl, off_t offset, int whence);
 int str_flush (struct shim_handle * hdl);
 
+/* shared anonymous memory */
+int create_shm_handle (size_t size, struct shim_handle ** hdl);
+
 #endif /* _SHIM_FS_H_ */
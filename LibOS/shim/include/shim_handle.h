@@ -209,7 +209,7 @@ struct shim_sock_handle {
         size_t size;
         size_t start;
         size_t end;
-        char uri[SOCK_URI_SIZE];
+        PAL_SOCKADDR addr;  /* source of a peeked datagram */
         char buf[];
     } * peek_buffer;
 };
@@ -236,8 +236,7 @@ struct shim_dir_handle {
 };
 
 struct shim_shm_handle {
-    /* XXX: need to implement */
-    void* __reserved;
+    size_t size; /* length of the "shm:" stream backing the mapping */
 };
 
 struct msg_type;
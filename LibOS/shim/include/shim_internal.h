@@ -59,6 +59,7 @@ static inline bool is_internal_tid(unsigned int tid)
 struct debug_buf {
     int start;
     int end;
+    bool dropping;      /* the line is dropped by the rate limit */
     char buf[DEBUGBUF_SIZE];
 };
 
@@ -68,22 +69,40 @@ struct debug_buf {
 
 extern PAL_HANDLE debug_handle;
 
+/* severity of debug messages; "sys.debug.level" prints up to this one */
+#define LOG_LEVEL_ERROR     1
+#define LOG_LEVEL_WARNING   2
+#define LOG_LEVEL_DEBUG     3
+#define LOG_LEVEL_TRACE     4   /* messages on hot paths (IPC, VMAs, polling) */
+
+extern int debug_level;
+
 #include <stdarg.h>
 
 void debug_printf (const char * fmt, ...) __attribute__((format (printf, 1, 2)));
 void debug_puts (const char * str);
 void debug_putch (int ch);
 void debug_vprintf (const char * fmt, va_list ap) __attribute__((format (printf, 1, 0)));
+int init_debug_log (void);
+void debug_log_flush (void);
 
 #define VMID_PREFIX     "[P%05u] "
 #define TID_PREFIX      "[%-6u] "
 #define NOID_PREFIX     "[      ] "
-#define debug(fmt, ...)                                                     \
+
+/* checked before the arguments are evaluated or anything is formatted */
+#define debug_enabled(level)    (debug_handle && (level) <= debug_level)
+
+#define debug_at(level, fmt, ...)                                           \
     do {                                                                    \
-        if (debug_handle)                                                   \
+        if (debug_enabled(level))                                           \
             debug_printf(fmt, ##__VA_ARGS__);                               \
     } while (0)
 
+#define debug(fmt, ...)         debug_at(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#define debug_trace(fmt, ...)   debug_at(LOG_LEVEL_TRACE, fmt, ##__VA_ARGS__)
+#define debug_warn(fmt, ...)    debug_at(LOG_LEVEL_WARNING, fmt, ##__VA_ARGS__)
+
 /* print system messages */
 #define SYSPRINT_BUFFER_SIZE    256
 
@@ -260,11 +279,11 @@ static inline int64_t get_cur_preempt (void) {
     }
 
 #define PARSE_SYSCALL1(name, ...)                                   \
-    if (debug_handle)                                               \
+    if (debug_enabled(LOG_LEVEL_DEBUG))                             \
         parse_syscall_before(__NR_##name, #name, ##__VA_ARGS__);
 
 #define PARSE_SYSCALL2(name, ...)                                   \
-    if (debug_handle)                                               \
+    if (debug_enabled(LOG_LEVEL_DEBUG))                             \
         parse_syscall_after(__NR_##name, #name, ##__VA_ARGS__);
 
 void parse_syscall_before (int sysno, const char * name, int nr, ...);
@@ -426,7 +445,7 @@ void parse_syscall_after (int sysno, const char * name, int nr, ...);
     DEFINE_PROFILE_INTERVAL(syscall_##name##_slow, syscall);        \
     DEFINE_PROFILE_INTERVAL(syscall_##name, syscall);               \
     BEGIN_SHIM(name, SHIM_PROTO_ARGS_##n)                           \
-        debug("WARNING: shim_" #name " not implemented\n");         \
+        debug_warn("WARNING: shim_" #name " not implemented\n");    \
         SHIM_UNUSED_ARGS_##n();                                     \
         ret = DO_SYSCALL_##n(__NR_##name);                          \
     END_SHIM(name)                                                  \
@@ -90,9 +90,18 @@ struct shim_ipc_port {
 
     REFTYPE ref_count;
     LIST_TYPE(shim_ipc_port) list;
+    LIST_TYPE(shim_ipc_port) work_list; /* on the IPC work queue */
+    bool busy;                          /* queued or being serviced by an IPC worker */
     LISTP_TYPE(shim_ipc_msg_duplex) msgs;
     struct shim_lock msgs_lock;
 
+    /* messages sent while another thread writes to the port, which that
+       thread writes next, all in one write */
+    struct shim_lock send_lock;
+    bool sending;
+    void* send_buf;
+    size_t send_len, send_size;
+
     port_fini fini[MAX_IPC_PORT_FINI_CB];
 
     IDTYPE type;
@@ -105,6 +114,12 @@ struct shim_ipc_port {
    succeed. */
 #define RESPONSE_CALLBACK 1
 
+/* messages of at least IPC_MSG_KEEP_MIN bytes are received into a buffer of
+   their own. If the callback of such a message returns KEEP_IPC_MSG, it keeps
+   the message (e.g., to queue its payload) and frees it with free() later. */
+#define IPC_MSG_KEEP_MIN 1024
+#define KEEP_IPC_MSG     2
+
 typedef int (*ipc_callback)(struct shim_ipc_msg* msg, struct shim_ipc_port* port);
 
 /* Basic message codes */
@@ -434,6 +449,8 @@ int init_ipc_helper(void);
 struct shim_process* create_process(bool dup_cur_process);
 void free_process(struct shim_process* process);
 
+/* "ring" or "pipe": the stream type of the IPC ports of processes */
+const char* ipc_pipe_type(void);
 struct shim_ipc_info* create_ipc_info_cur_process(bool is_self_ipc_info);
 int get_ipc_info_cur_process(struct shim_ipc_info** pinfo);
 
@@ -492,6 +509,10 @@ struct shim_ipc_msg_duplex* pop_ipc_msg_duplex(struct shim_ipc_port* port, unsig
 
 int broadcast_ipc(struct shim_ipc_msg* msg, int target_type, struct shim_ipc_port* exclude_port);
 int send_ipc_message(struct shim_ipc_msg* msg, struct shim_ipc_port* port);
+/* sends msg, of which only the header is in place: its last payload_size
+   bytes are taken from payload, without copying them behind the header */
+int send_ipc_message_payload(struct shim_ipc_msg* msg, const void* payload, size_t payload_size,
+                             struct shim_ipc_port* port);
 int send_ipc_message_duplex(struct shim_ipc_msg_duplex* msg, struct shim_ipc_port* port,
                             unsigned long* seq, void* private_data);
 int send_response_ipc_message(struct shim_ipc_port* port, IDTYPE dest, int ret, unsigned long seq);
@@ -68,7 +68,8 @@ int CONCAT3(add, NS, subrange)(IDTYPE idx, IDTYPE owner, const char* uri, LEASET
 
 int CONCAT3(del, NS, subrange)(IDTYPE idx);
 
-int CONCAT3(alloc, NS, range)(IDTYPE owner, const char* uri, IDTYPE* base, LEASETYPE* lease);
+int CONCAT3(alloc, NS, range)(IDTYPE owner, const char* uri, IDTYPE* count, IDTYPE* base,
+                              LEASETYPE* lease);
 
 struct CONCAT2(NS, range) {
     IDTYPE base, size;
@@ -112,8 +113,9 @@ int NS_SEND(tellns)(struct shim_ipc_port* port, IDTYPE dest, struct shim_ipc_inf
                     unsigned long seq);
 int NS_CALLBACK(tellns)(IPC_CALLBACK_ARGS);
 
-/* LEASE: lease a range of name */
+/* LEASE: lease count ranges of name in a row */
 NS_MSG_TYPE(lease) {
+    IDTYPE count;
     char uri[1];
 }
 __attribute__((packed));
@@ -3,6 +3,7 @@
 
 #include <shim_types.h>
 #include <shim_defs.h>
+#include <mpsc_queue.h>
 
 struct shim_signal_handle {
     /* sigaction */
@@ -96,13 +97,16 @@ struct shim_signal {
     bool        context_stored;
     ucontext_t  context;
     PAL_CONTEXT * pal_context;
+    struct mpsc_node node;
 };
 
 #define MAX_SIGNAL_LOG      32
 
+/* Pending signals of one type for a thread. Any thread may append to it
+   without a lock, but only the owning thread fetches from it. */
 struct shim_signal_log {
-    struct atomic_int head, tail;
-    struct shim_signal * logs[MAX_SIGNAL_LOG];
+    struct mpsc_queue queue;
+    struct atomic_int count;
 };
 
 extern const char * const siglist[NUM_KNOWN_SIGS + 1];
@@ -132,6 +136,8 @@ struct shim_thread;
 
 int init_signal (void);
 
+struct shim_signal_log * alloc_signal_logs (void);
+
 void __store_context (shim_tcb_t * tcb, PAL_CONTEXT * pal_context,
                       struct shim_signal * signal);
 
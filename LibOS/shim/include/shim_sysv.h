@@ -78,9 +78,17 @@ struct msg_qobj {
 struct msg_item {
     void* next;
     unsigned short size;
+    bool kept; /* data is a msg_kept_text, not the text itself */
     char data[];
 } __attribute__((packed));
 
+/* text of a message left in the buffer it arrived in (e.g., an IPC message),
+   which the queue owns and frees */
+struct msg_kept_text {
+    void* buf;
+    const void* text;
+} __attribute__((packed));
+
 #define MSG_ITEM_DATA_SIZE(size)                               \
     ((size) < MSG_QOBJ_SIZE - sizeof(struct msg_item) ? (size) \
                                                       : MSG_QOBJ_SIZE - sizeof(struct msg_item))
@@ -144,8 +152,10 @@ void put_msg_handle(struct shim_msg_handle* msgq);
 
 int recover_msg_ownership(struct shim_msg_handle* msgq);
 
+/* if bufp is not NULL, *bufp is a malloc'ed buffer holding data, which the
+   queue may take instead of copying data; it then sets *bufp to NULL */
 int add_sysv_msg(struct shim_msg_handle* msgq, long type, size_t size, const void* data,
-                 struct sysv_client* src);
+                 void** bufp, struct sysv_client* src);
 int get_sysv_msg(struct shim_msg_handle* msgq, long type, size_t size, void* data, int flags,
                  struct sysv_client* src);
 
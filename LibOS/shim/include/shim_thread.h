@@ -196,8 +196,7 @@ void set_cur_thread (struct shim_thread * thread)
         tid = thread->tid;
 
         if (!is_internal(thread) && !thread->signal_logs)
-            thread->signal_logs = malloc(sizeof(struct shim_signal_log) *
-                                         NUM_SIGS);
+            thread->signal_logs = alloc_signal_logs();
     } else if (tcb->tp) {
         put_thread(tcb->tp);
         tcb->tp = NULL;
@@ -209,6 +209,8 @@ void clean_link_map_list(void);
 #define PIPE_URI_SIZE 40
 int create_pipe(IDTYPE* pipeid, char* uri, size_t size, PAL_HANDLE* hdl, struct shim_qstr* qstr,
                 bool use_vmid_for_name);
+int create_ring(IDTYPE* pipeid, char* uri, size_t size, PAL_HANDLE* hdl, struct shim_qstr* qstr,
+                bool use_vmid_for_name);
 int create_dir(const char* prefix, char* path, size_t size, struct shim_handle** hdl);
 int create_file(const char* prefix, char* path, size_t size, struct shim_handle** hdl);
 int create_handle(const char* prefix, char* path, size_t size, PAL_HANDLE* hdl, unsigned int* id);
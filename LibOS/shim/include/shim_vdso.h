@@ -23,9 +23,74 @@
 #ifndef _SHIM_VDSO_H_
 #define _SHIM_VDSO_H_
 
+#include <atomic.h>
+#include <pal.h>
+
 extern const uint8_t vdso_so[];
 extern const size_t vdso_so_size;
 
 int vdso_map_migrate(void);
 
+/* How long a TSC mapping is used before the LibOS asks the PAL for a new one */
+#define VDSO_TIME_PERIOD_NS 1000000000ULL
+
+/*
+ * The vDSO data page ("[vvar]"). The LibOS writes the mapping of the TSC to
+ * the time given by DkSystemTimeCalibrate(), and the vDSO and the time system
+ * calls read it. The writer makes seq odd while it updates the mapping.
+ */
+struct vdso_time_data {
+    int64_t seq;
+    uint64_t tsc_base;
+    uint64_t ns_base;
+    uint64_t mult;
+    uint64_t tsc_period; /* ticks the mapping is used for, 0 if there is none */
+};
+
+static inline uint64_t vdso_rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* Returns the time in nanoseconds, or 0 if there is no mapping or it is older
+ * than VDSO_TIME_PERIOD_NS */
+static inline uint64_t vdso_time_read_ns(struct vdso_time_data* data) {
+    int64_t seq;
+    uint64_t tsc_base, ns_base, mult, tsc_period;
+
+    do {
+        seq = data->seq;
+        COMPILER_BARRIER();
+        if (seq & 1)
+            return 0;
+
+        tsc_base   = data->tsc_base;
+        ns_base    = data->ns_base;
+        mult       = data->mult;
+        tsc_period = data->tsc_period;
+        COMPILER_BARRIER();
+    } while (data->seq != seq);
+
+    /* RDTSC is emulated (slowly) where the PAL cannot calibrate it */
+    if (!tsc_period)
+        return 0;
+
+    uint64_t ticks = vdso_rdtsc() - tsc_base;
+    if (ticks >= tsc_period)
+        return 0;
+
+    return ns_base + (uint64_t)(((unsigned __int128)ticks * mult) >> PAL_TSC_MULT_SHIFT);
+}
+
+/* Returns the time at which the mapping expires; the caller keeps it stable */
+static inline uint64_t vdso_time_end_ns(struct vdso_time_data* data) {
+    return data->ns_base +
+           (uint64_t)(((unsigned __int128)data->tsc_period * data->mult) >> PAL_TSC_MULT_SHIFT);
+}
+
+/* Returns the time in nanoseconds, and renews the mapping in the vDSO data
+ * page if it is too old */
+uint64_t vdso_time_query_ns(void);
+
 #endif /* _SHIM_VDSO_H_ */
@@ -42,64 +42,60 @@ typedef void (*__rt_sighandler_t)(int, siginfo_t*, void*);
 
 static __rt_sighandler_t default_sighandler[NUM_SIGS];
 
-static struct shim_signal **
-allocate_signal_log (struct shim_thread * thread, int sig)
+struct shim_signal_log * alloc_signal_logs (void)
 {
-    if (!thread->signal_logs)
+    struct shim_signal_log * logs = malloc(sizeof(struct shim_signal_log) *
+                                           NUM_SIGS);
+    if (!logs)
         return NULL;
 
-    struct shim_signal_log * log = &thread->signal_logs[sig - 1];
-    int head, tail, old_tail;
+    for (int sig = 1 ; sig <= NUM_SIGS ; sig++) {
+        mpsc_queue_init(&logs[sig - 1].queue);
+        atomic_set(&logs[sig - 1].count, 0);
+    }
 
-    do {
-        head = atomic_read(&log->head);
-        old_tail = tail = atomic_read(&log->tail);
+    return logs;
+}
 
-        if (head == tail + 1 || (!head && tail == (MAX_SIGNAL_LOG - 1)))
-            return NULL;
+static bool
+append_signal_log (struct shim_thread * thread, int sig,
+                   struct shim_signal * signal)
+{
+    if (!thread->signal_logs)
+        return false;
+
+    struct shim_signal_log * log = &thread->signal_logs[sig - 1];
 
-        tail = (tail == MAX_SIGNAL_LOG - 1) ? 0 : tail + 1;
-    } while (atomic_cmpxchg(&log->tail, old_tail, tail) == tail);
+    if (atomic_inc_return(&log->count) > MAX_SIGNAL_LOG) {
+        atomic_dec(&log->count);
+        return false;
+    }
 
-    debug("signal_logs[%d]: head=%d, tail=%d (counter = %ld)\n", sig - 1,
-          head, tail, thread->has_signal.counter + 1);
+    mpsc_queue_push(&log->queue, &signal->node);
 
-    atomic_inc(&thread->has_signal);
+    debug("signal_logs[%d]: appended (counter = %ld)\n", sig - 1,
+          thread->has_signal.counter + 1);
 
-    return &log->logs[old_tail];
+    atomic_inc(&thread->has_signal);
+    return true;
 }
 
 static struct shim_signal *
 fetch_signal_log (struct shim_thread * thread, int sig)
 {
     struct shim_signal_log * log = &thread->signal_logs[sig - 1];
-    struct shim_signal * signal = NULL;
-    int head, tail, old_head;
-
-    while (1) {
-        old_head = head = atomic_read(&log->head);
-        tail = atomic_read(&log->tail);
-
-        if (head == tail)
-            return NULL;
+    struct mpsc_node * node = mpsc_queue_pop(&log->queue);
 
-        if (!(signal = log->logs[head]))
-            return NULL;
-
-        log->logs[head] = NULL;
-        head = (head == MAX_SIGNAL_LOG - 1) ? 0 : head + 1;
-
-        if (atomic_cmpxchg(&log->head, old_head, head) == old_head)
-            break;
+    if (!node)
+        return NULL;
 
-        log->logs[old_head] = signal;
-    }
+    atomic_dec(&log->count);
 
-    debug("signal_logs[%d]: head=%d, tail=%d\n", sig -1, head, tail);
+    debug("signal_logs[%d]: fetched\n", sig - 1);
 
     atomic_dec(&thread->has_signal);
 
-    return signal;
+    return container_of(node, struct shim_signal, node);
 }
 
 static void
@@ -174,12 +170,8 @@ void deliver_signal (siginfo_t * info, PAL_CONTEXT * context)
 
     if (preempt > 1 ||
         __sigismember(&cur_thread->signal_mask, sig)) {
-        struct shim_signal ** signal_log = NULL;
         if ((signal = malloc_copy(signal,sizeof(struct shim_signal))) &&
-            (signal_log = allocate_signal_log(cur_thread, sig))) {
-            *signal_log = signal;
-        }
-        if (signal && !signal_log) {
+            !append_signal_log(cur_thread, sig, signal)) {
             SYS_PRINTF("signal queue is full (TID = %u, SIG = %d)\n",
                        tcb->tid, sig);
             free(signal);
@@ -250,6 +242,11 @@ static void memfault_upcall (PAL_PTR event, PAL_NUM arg, PAL_CONTEXT * context)
     shim_tcb_t * tcb = shim_get_tls();
     assert(tcb);
 
+    /* Memory still being transferred by post-copy fork: resolve the fault
+     * and retry (this also serves faults raised by test_user_memory) */
+    if (arg && postcopy_handle_fault((void *) arg))
+        goto ret_exception;
+
     if (tcb->test_range.cont_addr && arg
         && (void *) arg >= tcb->test_range.start
         && (void *) arg <= tcb->test_range.end) {
@@ -774,10 +771,7 @@ void append_signal(struct shim_thread* thread, int sig, siginfo_t* info, bool ne
         memset(signal, 0, sizeof(struct shim_signal));
     }
 
-    struct shim_signal ** signal_log = allocate_signal_log(thread, sig);
-
-    if (signal_log) {
-        *signal_log = signal;
+    if (append_signal_log(thread, sig, signal)) {
         if (need_interrupt) {
             debug("resuming thread %u\n", thread->tid);
             thread_wakeup(thread);
@@ -509,7 +509,7 @@ int bkeep_mmap (void * addr, size_t length, int prot, int flags,
     if (comment && !comment[0])
         comment = NULL;
 
-    debug("bkeep_mmap: %p-%p\n", addr, addr + length);
+    debug_trace("bkeep_mmap: %p-%p\n", addr, addr + length);
 
     lock(&vma_list_lock);
     struct shim_vma * prev = NULL;
@@ -677,7 +677,7 @@ int bkeep_munmap (void * addr, size_t length, int flags)
     if (!length)
         return -EINVAL;
 
-    debug("bkeep_munmap: %p-%p\n", addr, addr + length);
+    debug_trace("bkeep_munmap: %p-%p\n", addr, addr + length);
 
     lock(&vma_list_lock);
     struct shim_vma * prev = NULL;
@@ -788,7 +788,7 @@ int bkeep_mprotect (void * addr, size_t length, int prot, int flags)
     if (!addr || !length)
         return -EINVAL;
 
-    debug("bkeep_mprotect: %p-%p\n", addr, addr + length);
+    debug_trace("bkeep_mprotect: %p-%p\n", addr, addr + length);
 
     lock(&vma_list_lock);
     struct shim_vma * prev = NULL;
@@ -834,8 +834,8 @@ static void * __bkeep_unmapped (void * top_addr, void * bottom_addr,
                          file, offset, comment);
             assert_vma_list();
 
-            debug("bkeep_unmapped: %p-%p%s%s\n", end - length, end,
-                  comment ? " => " : "", comment ? : "");
+            debug_trace("bkeep_unmapped: %p-%p%s%s\n", end - length, end,
+                        comment ? " => " : "", comment ? : "");
 
             return end - length;
         }
@@ -1057,17 +1057,36 @@ BEGIN_CP_FUNC(vma)
         new_vma = (struct shim_vma_val *) (base + off);
         memcpy(new_vma, vma, sizeof(*vma));
 
-        if (vma->file)
+        /*
+         * Shared memory is not copied: shared anonymous memory is passed as
+         * its "shm:" handle, and a shared mapping of a host file as the file,
+         * which the child maps again (on SGX, files cannot be mapped shared
+         * and writable, so there is nothing to copy anyway). A snapshot or
+         * checkpoint file cannot hold a "shm:" handle, and outlives the
+         * mapping, so there the memory is copied, as private memory for the
+         * "shm:" handle.
+         */
+        bool share = vma->file && (vma->flags & MAP_SHARED) &&
+                     (vma->file->type == TYPE_SHM || vma->file->type == TYPE_FILE);
+        if (share && !store->share_memory) {
+            share = false;
+            if (vma->file->type == TYPE_SHM) {
+                new_vma->file   = NULL;
+                new_vma->flags  = (vma->flags & ~(MAP_SHARED|VMA_TAINTED)) | MAP_PRIVATE;
+                new_vma->offset = 0;
+            }
+        }
+        if (new_vma->file)
             DO_CP(handle, vma->file, &new_vma->file);
 
         void * need_mapped = vma->addr;
 
-        if (
+        if (!share && (
 #if MIGRATE_MORE_GIPC == 1
             store->use_gipc ?
             NEED_MIGRATE_MEMORY_IF_GIPC(vma) :
 #endif
-            NEED_MIGRATE_MEMORY(vma)) {
+            NEED_MIGRATE_MEMORY(vma))) {
             void *   send_addr = vma->addr;
             size_t send_size = vma->length;
             if (vma->file) {
@@ -1105,7 +1124,14 @@ BEGIN_CP_FUNC(vma)
                                            pal_prot|PAL_PROT_READ);
                 }
 
-                if (store->use_gipc) {
+                if (store->use_postcopy &&
+                    postcopy_eligible(send_addr, send_size, pal_prot,
+                                      !!vma->file)) {
+                    /* the child fetches it lazily from the page server */
+                    struct shim_postcopy_entry * postcopy;
+                    DO_CP_SIZE(postcopy, send_addr, send_size, &postcopy);
+                    postcopy->prot = pal_prot;
+                } else if (store->use_gipc) {
                     struct shim_gipc_entry * gipc;
                     DO_CP_SIZE(gipc, send_addr, send_size, &gipc);
                     gipc->mem.prot = pal_prot;
@@ -1392,6 +1392,10 @@ static ElfW(Addr)* __vdso_shim_clock_gettime __attribute_migratable = NULL;
 static ElfW(Addr)* __vdso_shim_gettimeofday __attribute_migratable  = NULL;
 static ElfW(Addr)* __vdso_shim_time __attribute_migratable          = NULL;
 static ElfW(Addr)* __vdso_shim_getcpu __attribute_migratable        = NULL;
+static struct vdso_time_data* vdso_time_data __attribute_migratable = NULL;
+static bool vdso_time_unsupported                                   = false;
+/* no time given out once the current TSC mapping has expired is less */
+static uint64_t vdso_time_floor __attribute_migratable = 0;
 
 static const struct {
     const char* name;
@@ -1438,11 +1442,28 @@ static int vdso_map_init(void) {
         return -PAL_ERRNO;
     assert(addr == ret_addr);
 
+    /* the data page stays writable, for the LibOS to update the time */
+    void* data = bkeep_unmapped_heap(PAGE_SIZE, PROT_READ | PROT_WRITE, 0, NULL, 0, "[vvar]");
+    if (data == NULL)
+        return -ENOMEM;
+
+    if (!DkVirtualMemoryAlloc(data, PAGE_SIZE, 0, PAL_PROT_READ | PAL_PROT_WRITE))
+        return -PAL_ERRNO;
+    memset(data, 0, PAGE_SIZE);
+
     memcpy(addr, &vdso_so, vdso_so_size);
     memset(addr + vdso_so_size, 0, PAGE_ALIGN_UP(vdso_so_size) - vdso_so_size);
     __load_elf_object(NULL, addr, OBJECT_VDSO, NULL);
     vdso_map->l_name = "vDSO";
 
+    ElfW(Sym)* sym = __do_lookup("__vdso_shim_time_data", NULL, vdso_map);
+    if (sym) {
+        *(struct vdso_time_data**)(vdso_map->l_addr + sym->st_value) = data;
+        vdso_time_data = data;
+    } else {
+        debug("vDSO: symbol value for __vdso_shim_time_data not found\n");
+    }
+
     for (size_t i = 0; i < ARRAY_SIZE(vsyms); i++) {
         ElfW(Sym)* sym = __do_lookup(vsyms[i].name, NULL, vdso_map);
         if (sym == NULL) {
@@ -1473,12 +1494,93 @@ int vdso_map_migrate(void) {
         **vsyms[i].func = vsyms[i].value;
     }
 
+    /* the TSC mapping of the parent may not hold on this host, and the
+     * parent may have been updating it; only keep the time it had reached */
+    if (vdso_time_data) {
+        if (vdso_time_data->tsc_period && !(vdso_time_data->seq & 1)) {
+            uint64_t ns = vdso_time_read_ns(vdso_time_data);
+            if (!ns)
+                ns = vdso_time_end_ns(vdso_time_data);
+            if (ns > vdso_time_floor)
+                vdso_time_floor = ns;
+        }
+        vdso_time_data->seq        = 0;
+        vdso_time_data->tsc_period = 0;
+    }
+
     if (!DkVirtualMemoryProtect(vdso_addr, PAGE_ALIGN_UP(vdso_so_size),
                                 PAL_PROT_READ | PAL_PROT_EXEC))
         return -PAL_ERRNO;
     return 0;
 }
 
+/* Asks the PAL for the time, but not for less than the end of the last mapping */
+static uint64_t vdso_time_fallback_ns(void) {
+    uint64_t ns    = DkSystemTimeQueryNs();
+    uint64_t floor = vdso_time_floor;
+    return ns && ns < floor ? floor : ns;
+}
+
+uint64_t vdso_time_query_ns(void) {
+    struct vdso_time_data* data = vdso_time_data;
+    uint64_t ns;
+
+    if (!data)
+        return DkSystemTimeQueryNs();
+
+    int64_t seq = data->seq;
+    COMPILER_BARRIER();
+
+    ns = vdso_time_read_ns(data);
+    if (ns)
+        return ns;
+
+    /* only one thread renews the mapping, the others ask the PAL meanwhile;
+     * since seq is taken before the read, the mapping being renewed has
+     * expired */
+    if (vdso_time_unsupported || (seq & 1) || cmpxchg(&data->seq, seq, seq + 1) != seq)
+        return vdso_time_fallback_ns();
+    COMPILER_BARRIER();
+
+    if (data->tsc_period)
+        vdso_time_floor = vdso_time_end_ns(data);
+
+    PAL_TSC_CALIBRATION calib;
+    if (DkSystemTimeCalibrate(&calib) && calib.mult) {
+        uint64_t floor = vdso_time_floor;
+        uint64_t mult  = calib.mult;
+
+        /*
+         * The host clock may be behind the times the previous mapping gave
+         * out (the rate was off, or the clock was set back). Rather than step
+         * back, start from there and run slower, to meet the host clock at
+         * the end of the period; but at no less than half the speed.
+         */
+        if (calib.ns_base < floor) {
+            uint64_t behind = floor - calib.ns_base;
+            if (behind > VDSO_TIME_PERIOD_NS / 2)
+                behind = VDSO_TIME_PERIOD_NS / 2;
+            mult -= (uint64_t)(((unsigned __int128)mult * behind) / VDSO_TIME_PERIOD_NS);
+            calib.ns_base = floor;
+        }
+
+        data->tsc_base   = calib.tsc_base;
+        data->ns_base    = calib.ns_base;
+        data->mult       = mult;
+        data->tsc_period = (VDSO_TIME_PERIOD_NS << PAL_TSC_MULT_SHIFT) / calib.mult;
+        ns               = calib.ns_base;
+    } else {
+        debug("vDSO: the PAL cannot map the TSC to the time, using the PAL clock\n");
+        data->tsc_period      = 0;
+        vdso_time_unsupported = true;
+        ns                    = vdso_time_fallback_ns();
+    }
+
+    COMPILER_BARRIER();
+    data->seq = seq + 2;
+    return ns;
+}
+
 int init_internal_map(void) {
     __load_elf_object(NULL, &__load_address, OBJECT_INTERNAL, NULL);
     internal_map->l_name = "libsysdb.so";
@@ -46,9 +46,10 @@ extern const struct proc_fs_ops fs_ipc_thread;
 extern const struct proc_dir dir_ipc_thread;
 extern const struct proc_fs_ops fs_meminfo;
 extern const struct proc_fs_ops fs_cpuinfo;
+extern const struct proc_fs_ops fs_snapshot;
 
 const struct proc_dir proc_root = {
-    .size = 5,
+    .size = 6,
     .ent =
         {
             {
@@ -74,6 +75,10 @@ const struct proc_dir proc_root = {
                 .name   = "cpuinfo",
                 .fs_ops = &fs_cpuinfo,
             },
+            {
+                .name   = "snapshot",
+                .fs_ops = &fs_snapshot,
+            },
         },
 };
 
@@ -377,12 +382,25 @@ static int proc_hstat(struct shim_handle* hdl, struct stat* buf) {
     return ent->fs_ops->stat(rel_path, buf);
 }
 
+static ssize_t proc_write(struct shim_handle* hdl, const void* buf, size_t count) {
+    struct shim_dentry* dent = hdl->dentry;
+    assert(dent);
+
+    const struct proc_ent* ent;
+
+    if (proc_match_name(qstrgetstr(&dent->rel_path), &ent) == 0 && ent->fs_ops &&
+        ent->fs_ops->write)
+        return ent->fs_ops->write(hdl, buf, count);
+
+    return str_write(hdl, buf, count);
+}
+
 struct shim_fs_ops proc_fs_ops = {
     .mount   = &proc_mount,
     .unmount = &proc_unmount,
     .close   = &str_close,
     .read    = &str_read,
-    .write   = &str_write,
+    .write   = &proc_write,
     .seek    = &str_seek,
     .flush   = &str_flush,
     .hstat   = &proc_hstat,
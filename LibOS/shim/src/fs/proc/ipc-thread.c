@@ -178,15 +178,26 @@ static const struct proc_fs_ops fs_ipc_thread_link = {
     .follow_link = &proc_ipc_thread_link_follow_link,
 };
 
+/* Listing the processes asks every other process for its status, so a listing
+   reuses the statuses collected by another one in the last
+   PID_STATUS_CACHE_TIME, e.g., when a tool like ps reads /proc repeatedly */
+#define PID_STATUS_CACHE_TIME 100000 /* 100 ms */
+
 static struct pid_status_cache {
     uint32_t ref_count;
-    bool dirty;
+    uint64_t expire;
     size_t nstatus;
     struct pid_status* status;
 } * pid_status_cache;
 
 static struct shim_lock status_lock;
 
+static void free_pid_status_cache(struct pid_status_cache* cache) {
+    if (cache->nstatus)
+        free(cache->status);
+    free(cache);
+}
+
 static int proc_match_ipc_thread(const char* name) {
     IDTYPE pid;
     if (parse_ipc_thread_name(name, &pid, NULL, NULL, NULL) < 0)
@@ -268,7 +279,7 @@ static int proc_list_ipc_thread(const char* name, struct shim_dirent** buf, int
     create_lock_runtime(&status_lock);
 
     lock(&status_lock);
-    if (pid_status_cache && !pid_status_cache->dirty) {
+    if (pid_status_cache && DkSystemTimeQuery() < pid_status_cache->expire) {
         status = pid_status_cache;
         status->ref_count++;
     }
@@ -287,18 +298,16 @@ static int proc_list_ipc_thread(const char* name, struct shim_dirent** buf, int
 
         status->nstatus   = ret;
         status->ref_count = 1;
-        status->dirty     = false;
+        status->expire    = DkSystemTimeQuery() + PID_STATUS_CACHE_TIME;
 
         lock(&status_lock);
         if (pid_status_cache) {
-            if (pid_status_cache->dirty) {
+            if (pid_status_cache->expire < status->expire) {
                 if (!pid_status_cache->ref_count)
-                    free(pid_status_cache);
+                    free_pid_status_cache(pid_status_cache);
                 pid_status_cache = status;
             } else {
-                if (status->nstatus)
-                    free(status->status);
-                free(status);
+                free_pid_status_cache(status);
                 status = pid_status_cache;
                 status->ref_count++;
             }
@@ -341,18 +350,12 @@ static int proc_list_ipc_thread(const char* name, struct shim_dirent** buf, int
 
     *buf = ptr;
 success:
-    lock(&status_lock);
-    status->dirty = true;
-    status->ref_count--;
-    if (!status->ref_count && status != pid_status_cache)
-        free(status);
-    unlock(&status_lock);
-    return 0;
+    ret = 0;
 err:
     lock(&status_lock);
     status->ref_count--;
     if (!status->ref_count && status != pid_status_cache)
-        free(status);
+        free_pid_status_cache(status);
     unlock(&status_lock);
     return ret;
 }
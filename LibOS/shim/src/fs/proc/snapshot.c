@@ -0,0 +1,86 @@
+/* Copyright (C) 2014 Stony Brook University
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * snapshot.c
+ *
+ * /proc/snapshot: any write to it saves the process in the snapshot file
+ * given by sys.snapshot, from which later instances of the application
+ * start. The write returns the number of bytes written in the process that
+ * took the snapshot, and 0 in the processes restored from it.
+ */
+
+#include <errno.h>
+#include <linux/fcntl.h>
+#include <pal.h>
+#include <shim_checkpoint.h>
+#include <shim_fs.h>
+#include <shim_internal.h>
+
+// TODO: For some reason S_IF* macros are missing if this file is included before our headers. We
+// should investigate and fix this behavior.
+#include <linux/stat.h>
+
+static int proc_snapshot_mode(const char* name, mode_t* mode) {
+    // The path is implicitly set by calling this function
+    __UNUSED(name);
+    *mode = 0200;
+    return 0;
+}
+
+static int proc_snapshot_stat(const char* name, struct stat* buf) {
+    // The path is implicitly set by calling this function
+    __UNUSED(name);
+    memset(buf, 0, sizeof(struct stat));
+    buf->st_dev = buf->st_ino = 1;
+    buf->st_mode              = 0200 | S_IFREG;
+    buf->st_uid               = 0;
+    buf->st_gid               = 0;
+    buf->st_size              = 0;
+    return 0;
+}
+
+static int proc_snapshot_open(struct shim_handle* hdl, const char* name, int flags) {
+    // This function only serves one file
+    __UNUSED(name);
+    if (!(flags & (O_WRONLY | O_RDWR)))
+        return -EACCES;
+
+    struct shim_str_data* data = calloc(1, sizeof(struct shim_str_data));
+    if (!data)
+        return -ENOMEM;
+
+    hdl->type          = TYPE_STR;
+    hdl->flags         = flags;
+    hdl->acc_mode      = MAY_WRITE;
+    hdl->info.str.data = data;
+    return 0;
+}
+
+static ssize_t proc_snapshot_write(struct shim_handle* hdl, const void* buf, size_t count) {
+    __UNUSED(hdl);
+    __UNUSED(buf);
+
+    int ret = create_snapshot();
+    return ret < 0 ? ret : (ssize_t)count;
+}
+
+struct proc_fs_ops fs_snapshot = {
+    .mode  = &proc_snapshot_mode,
+    .stat  = &proc_snapshot_stat,
+    .open  = &proc_snapshot_open,
+    .write = &proc_snapshot_write,
+};
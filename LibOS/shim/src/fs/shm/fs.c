@@ -0,0 +1,100 @@
+/* Copyright (C) 2014 Stony Brook University
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * fs.c
+ *
+ * This file contains codes for implementation of 'shm' filesystem. Its handles
+ * are never opened by path; they back shared anonymous mappings
+ * (MAP_SHARED | MAP_ANONYMOUS) with "shm:" PAL streams, so that a child
+ * process maps the same memory instead of receiving a copy of it.
+ */
+
+#include <asm/fcntl.h>
+#include <asm/mman.h>
+#include <errno.h>
+#include <pal.h>
+#include <pal_error.h>
+#include <shim_fs.h>
+#include <shim_handle.h>
+#include <shim_internal.h>
+#include <shim_vma.h>
+
+// TODO: For some reason S_I{R,W}USR macros are missing if this file is included before our headers.
+// We should investigate and fix this behavior.
+#include <linux/stat.h>
+
+int create_shm_handle(size_t size, struct shim_handle** hdl) {
+    PAL_HANDLE palhdl = DkStreamOpen("shm:", PAL_ACCESS_RDWR, 0, 0, 0);
+    if (!palhdl)
+        return -PAL_ERRNO;
+
+    if (DkStreamSetLength(palhdl, size)) {
+        int ret = -PAL_ERRNO;
+        DkObjectClose(palhdl);
+        return ret;
+    }
+
+    struct shim_handle* new = get_new_handle();
+    if (!new) {
+        DkObjectClose(palhdl);
+        return -ENOMEM;
+    }
+
+    new->type = TYPE_SHM;
+    set_handle_fs(new, &shm_builtin_fs);
+    new->flags         = O_RDWR;
+    new->acc_mode      = MAY_READ | MAY_WRITE;
+    new->pal_handle    = palhdl;
+    new->info.shm.size = size;
+    qstrsetstr(&new->uri, "shm:", static_strlen("shm:"));
+
+    *hdl = new;
+    return 0;
+}
+
+static int shm_mmap(struct shim_handle* hdl, void** addr, size_t size, int prot, int flags,
+                    off_t offset) {
+    if (!(flags & MAP_SHARED))
+        return -EINVAL;
+
+    void* alloc_addr = (void*)DkStreamMap(hdl->pal_handle, *addr, PAL_PROT(prot, flags), offset,
+                                          size);
+    if (!alloc_addr)
+        return -PAL_ERRNO;
+
+    *addr = alloc_addr;
+    return 0;
+}
+
+static int shm_hstat(struct shim_handle* hdl, struct stat* stat) {
+    memset(stat, 0, sizeof(struct stat));
+    stat->st_mode    = S_IFREG | S_IRUSR | S_IWUSR;
+    stat->st_size    = hdl->info.shm.size;
+    stat->st_nlink   = 1;
+    stat->st_blksize = 0;
+    return 0;
+}
+
+struct shim_fs_ops shm_fs_ops = {
+    .mmap  = &shm_mmap,
+    .hstat = &shm_hstat,
+};
+
+struct shim_mount shm_builtin_fs = {
+    .type   = "shm",
+    .fs_ops = &shm_fs_ops,
+};
@@ -57,10 +57,43 @@ int init_ipc_ports(void);
 int init_ns_pid(void);
 int init_ns_sysv(void);
 
+/* The IPC ports of processes are "ring:" streams (pipes over shared memory)
+ * if the PAL has them, unless sys.ipc.ring = 0 in the manifest. A parent
+ * names the port of its child after the child's vmid and its own type, so the
+ * choice must not depend on anything but the manifest and the PAL. */
+static bool ipc_use_ring;
+
+static void init_ipc_pipe_type(void) {
+    ipc_use_ring = true;
+    if (root_config) {
+        char cfg[CONFIG_MAX];
+        if (get_config(root_config, "sys.ipc.ring", cfg, CONFIG_MAX) > 0)
+            ipc_use_ring = parse_int(cfg) != 0;
+    }
+
+    if (!ipc_use_ring)
+        return;
+
+    /* PALs without rings fail to open any "ring:" URI as not supported; the
+     * others reject this one as invalid without touching the host */
+    PAL_HANDLE hdl = DkStreamOpen("ring:", 0, 0, 0, 0);
+    if (hdl) {
+        DkObjectClose(hdl);
+    } else if (PAL_NATIVE_ERRNO == PAL_ERROR_NOTSUPPORT) {
+        debug("IPC over rings is not supported, using pipes\n");
+        ipc_use_ring = false;
+    }
+}
+
+const char* ipc_pipe_type(void) {
+    return ipc_use_ring ? "ring" : "pipe";
+}
+
 int init_ipc(void) {
     int ret = 0;
 
     create_lock(&ipc_info_lock);
+    init_ipc_pipe_type();
 
     if (!(ipc_info_mgr = create_mem_mgr(init_align_up(IPC_INFO_MGR_ALLOC))))
         return -ENOMEM;
@@ -301,18 +334,12 @@ void init_ipc_msg_duplex(struct shim_ipc_msg_duplex* msg, int code, size_t size,
     msg->private = NULL;
 }
 
-int send_ipc_message(struct shim_ipc_msg* msg, struct shim_ipc_port* port) {
-    assert(msg->size >= IPC_MSG_MINIMAL_SIZE);
-
-    msg->src = cur_process.vmid;
-    debug("Sending ipc message to port %p (handle %p)\n", port, port->pal_handle);
-
-    size_t total_bytes = msg->size;
-    size_t bytes       = 0;
+static int write_ipc_port(struct shim_ipc_port* port, const void* buf, size_t total_bytes) {
+    size_t bytes = 0;
 
     do {
         size_t ret =
-            DkStreamWrite(port->pal_handle, 0, total_bytes - bytes, (void*)msg + bytes, NULL);
+            DkStreamWrite(port->pal_handle, 0, total_bytes - bytes, (void*)buf + bytes, NULL);
 
         if (!ret) {
             if (PAL_ERRNO == EINTR || PAL_ERRNO == EAGAIN || PAL_ERRNO == EWOULDBLOCK)
@@ -329,6 +356,133 @@ int send_ipc_message(struct shim_ipc_msg* msg, struct shim_ipc_port* port) {
     return 0;
 }
 
+/* bytes of messages queued on a port before more senders wait for the writer */
+#define IPC_SEND_BATCH_MAX (64 * 1024)
+
+/* payloads smaller than this are copied behind the header, to send the
+   message in one write; bigger ones are written from the caller's buffer */
+#define IPC_SEND_COPY_MAX 1024
+
+/* Queues msg, whose last payload_size bytes are at payload, for the thread
+   writing to the port; returns false if there is no room, and the caller has
+   to wait. Must be called with port->send_lock held. */
+static bool queue_ipc_message(struct shim_ipc_msg* msg, const void* payload, size_t payload_size,
+                              struct shim_ipc_port* port) {
+    size_t len = port->send_len + msg->size;
+
+    if (port->send_len && len > IPC_SEND_BATCH_MAX)
+        return false;
+
+    if (len > port->send_size) {
+        size_t new_size = port->send_size ? port->send_size : IPC_MSG_MINIMAL_SIZE * 16;
+        while (new_size < len)
+            new_size *= 2;
+
+        void* new_buf = malloc(new_size);
+        if (!new_buf)
+            return false;
+
+        memcpy(new_buf, port->send_buf, port->send_len);
+        free(port->send_buf);
+        port->send_buf  = new_buf;
+        port->send_size = new_size;
+    }
+
+    size_t header_size = msg->size - payload_size;
+    memcpy(port->send_buf + port->send_len, msg, header_size);
+    memcpy(port->send_buf + port->send_len + header_size, payload, payload_size);
+    port->send_len = len;
+    return true;
+}
+
+/* Writes msg, whose last payload_size bytes are at payload. Only the thread
+   sending on the port may call it, so the two writes of a big payload do not
+   interleave with other messages. */
+static int write_ipc_message(struct shim_ipc_port* port, struct shim_ipc_msg* msg,
+                             const void* payload, size_t payload_size) {
+    size_t header_size = msg->size - payload_size;
+
+    if (!payload_size)
+        return write_ipc_port(port, msg, msg->size);
+
+    if (payload_size < IPC_SEND_COPY_MAX) {
+        void* buf = __alloca(msg->size);
+        memcpy(buf, msg, header_size);
+        memcpy(buf + header_size, payload, payload_size);
+        return write_ipc_port(port, buf, msg->size);
+    }
+
+    int ret = write_ipc_port(port, msg, header_size);
+    if (ret < 0)
+        return ret;
+    return write_ipc_port(port, payload, payload_size);
+}
+
+int send_ipc_message(struct shim_ipc_msg* msg, struct shim_ipc_port* port) {
+    return send_ipc_message_payload(msg, NULL, 0, port);
+}
+
+int send_ipc_message_payload(struct shim_ipc_msg* msg, const void* payload, size_t payload_size,
+                             struct shim_ipc_port* port) {
+    assert(msg->size >= IPC_MSG_MINIMAL_SIZE);
+    assert(msg->size - sizeof(*msg) >= payload_size);
+
+    msg->src = cur_process.vmid;
+    debug_trace("Sending ipc message to port %p (handle %p)\n", port, port->pal_handle);
+
+    /*
+     * Only one thread at a time writes to a port, so that messages do not
+     * interleave. Threads sending meanwhile (e.g., IPC workers answering, or
+     * broadcasts) queue their messages, and the writer sends all of them in
+     * one write once it is done with its own.
+     */
+    lock(&port->send_lock);
+    while (port->sending) {
+        if (queue_ipc_message(msg, payload, payload_size, port)) {
+            unlock(&port->send_lock);
+            return 0;
+        }
+
+        unlock(&port->send_lock);
+        DkThreadYieldExecution();
+        lock(&port->send_lock);
+    }
+    port->sending = true;
+    unlock(&port->send_lock);
+
+    int ret     = write_ipc_message(port, msg, payload, payload_size);
+    bool broken = ret < 0;
+
+    lock(&port->send_lock);
+    while (port->send_len) {
+        void* buf   = port->send_buf;
+        size_t len  = port->send_len;
+        size_t size = port->send_size;
+
+        port->send_buf  = NULL;
+        port->send_len  = 0;
+        port->send_size = 0;
+        unlock(&port->send_lock);
+
+        /* if the port is gone, the queued messages are dropped, and their
+           senders are woken up by the port's fini callbacks */
+        if (!broken && write_ipc_port(port, buf, len) < 0)
+            broken = true;
+
+        lock(&port->send_lock);
+        if (!port->send_buf) {
+            port->send_buf  = buf;
+            port->send_size = size;
+        } else {
+            free(buf);
+        }
+    }
+    port->sending = false;
+    unlock(&port->send_lock);
+
+    return ret;
+}
+
 struct shim_ipc_msg_duplex* pop_ipc_msg_duplex(struct shim_ipc_port* port, unsigned long seq) {
     struct shim_ipc_msg_duplex* found = NULL;
 
@@ -374,7 +528,7 @@ int send_ipc_message_duplex(struct shim_ipc_msg_duplex* msg, struct shim_ipc_por
     if (seq)
         *seq = msg->msg.seq;
 
-    debug("Waiting for response (seq = %lu)\n", msg->msg.seq);
+    debug_trace("Waiting for response (seq = %lu)\n", msg->msg.seq);
 
     /* force thread which will send the message to wait for response;
      * ignore unrelated interrupts but fail on actual errors */
@@ -384,7 +538,7 @@ int send_ipc_message_duplex(struct shim_ipc_msg_duplex* msg, struct shim_ipc_por
             goto out;
     } while (ret != 0);
 
-    debug("Finished waiting for response (seq = %lu, ret = %d)\n", msg->msg.seq, msg->retval);
+    debug_trace("Finished waiting for response (seq = %lu, ret = %d)\n", msg->msg.seq, msg->retval);
     ret = msg->retval;
 out:
     lock(&port->msgs_lock);
@@ -407,10 +561,15 @@ struct shim_ipc_info* create_ipc_info_cur_process(bool is_self_ipc_info) {
     if (!info)
         return NULL;
 
-    /* pipe for cur_process.self is of format "pipe:<cur_process.vmid>", others with random name */
+    /* pipe for cur_process.self is of format "<type>:<cur_process.vmid>", others with random
+     * name; see ipc_pipe_type() */
     char uri[PIPE_URI_SIZE];
-    if (create_pipe(NULL, uri, PIPE_URI_SIZE, &info->pal_handle, &info->uri, is_self_ipc_info) <
-        0) {
+    int ret = ipc_use_ring
+                  ? create_ring(NULL, uri, PIPE_URI_SIZE, &info->pal_handle, &info->uri,
+                                is_self_ipc_info)
+                  : create_pipe(NULL, uri, PIPE_URI_SIZE, &info->pal_handle, &info->uri,
+                                is_self_ipc_info);
+    if (ret < 0) {
         put_ipc_info(info);
         return NULL;
     }
@@ -50,6 +50,31 @@ static struct shim_lock    ipc_helper_lock;
 
 static AEVENTTYPE install_new_event;
 
+/* Messages are received and their callbacks are run by a pool of IPC worker
+ * threads (sys.ipc.workers in the manifest). The IPC helper thread only waits
+ * on the ports: it accepts new clients and puts client ports with input on
+ * work_queue. A port is marked busy while it is queued or serviced, and the
+ * helper does not wait on busy ports, so each port is read by one worker at a
+ * time and its messages are handled in order. Without workers, the helper
+ * thread receives the messages itself. */
+#define IPC_WORKERS_DEFAULT 2
+#define IPC_WORKERS_MAX     16
+
+static int ipc_worker_num;
+static int ipc_workers;
+static LISTP_TYPE(shim_ipc_port) work_queue;
+static AEVENTTYPE work_event;
+
+/* Receive buffer of an IPC thread, reused for all messages it receives. It is
+ * shrunk back after a message bigger than IPC_RECV_BUF_KEEP. */
+#define IPC_RECV_BUF_INIT (IPC_MSG_MINIMAL_SIZE * 3)
+#define IPC_RECV_BUF_KEEP 4096
+
+struct ipc_recv_buf {
+    struct shim_ipc_msg* msg;
+    size_t size;
+};
+
 static int create_ipc_helper(void);
 static int ipc_resp_callback(struct shim_ipc_msg* msg, struct shim_ipc_port* port);
 
@@ -199,6 +224,21 @@ int init_ipc_helper(void) {
     create_lock(&ipc_helper_lock);
     create_event(&install_new_event);
 
+    ipc_worker_num = IPC_WORKERS_DEFAULT;
+    if (root_config) {
+        char cfg[CONFIG_MAX];
+        if (get_config(root_config, "sys.ipc.workers", cfg, CONFIG_MAX) > 0)
+            ipc_worker_num = parse_int(cfg);
+    }
+    if (ipc_worker_num < 0)
+        ipc_worker_num = 0;
+    if (ipc_worker_num > IPC_WORKERS_MAX)
+        ipc_worker_num = IPC_WORKERS_MAX;
+
+    INIT_LISTP(&work_queue);
+    if (ipc_worker_num)
+        create_event(&work_event);
+
     /* some IPC ports were already added before this point, so spawn IPC
      * helper thread (and enable locking mechanisms if not done already
      * since we are going in multi-threaded mode) */
@@ -219,9 +259,11 @@ static struct shim_ipc_port* __create_ipc_port(PAL_HANDLE hdl) {
     memset(port, 0, sizeof(struct shim_ipc_port));
     port->pal_handle = hdl;
     INIT_LIST_HEAD(port, list);
+    INIT_LIST_HEAD(port, work_list);
     INIT_LISTP(&port->msgs);
     REF_SET(port->ref_count, 0);
     create_lock(&port->msgs_lock);
+    create_lock(&port->send_lock);
     return port;
 }
 
@@ -232,6 +274,8 @@ static void __free_ipc_port(struct shim_ipc_port* port) {
     }
 
     destroy_lock(&port->msgs_lock);
+    destroy_lock(&port->send_lock);
+    free(port->send_buf);
     free_mem_obj_to_mgr(port_mgr, port);
 }
 
@@ -414,8 +458,8 @@ struct shim_ipc_port* lookup_ipc_port(IDTYPE vmid, IDTYPE type) {
     struct shim_ipc_port* tmp;
     LISTP_FOR_EACH_ENTRY(tmp, &port_list, list) {
         if (tmp->vmid == vmid && (tmp->type & type)) {
-            debug("Found port %p (handle %p) for process %u (type %04x)\n",
-                  tmp, tmp->pal_handle, tmp->vmid & 0xFFFF, tmp->type);
+            debug_trace("Found port %p (handle %p) for process %u (type %04x)\n",
+                        tmp, tmp->pal_handle, tmp->vmid & 0xFFFF, tmp->type);
             port = tmp;
             __get_ipc_port(port);
             break;
@@ -458,6 +502,10 @@ int broadcast_ipc(struct shim_ipc_msg* msg, int target_type, struct shim_ipc_por
         size_t cnt = 0;
         struct shim_ipc_port** target_ports_heap =
             malloc(sizeof(struct shim_ipc_port *) * target_ports_cnt);
+        if (!target_ports_heap) {
+            unlock(&ipc_helper_lock);
+            return -ENOMEM;
+        }
 
         LISTP_FOR_EACH_ENTRY(port, &port_list, list) {
             if (port == exclude_port)
@@ -474,24 +522,25 @@ int broadcast_ipc(struct shim_ipc_msg* msg, int target_type, struct shim_ipc_por
 
     unlock(&ipc_helper_lock);
 
-    /* send msg to each collected port (note that ports cannot be freed in meantime) */
+    /* send msg to each collected port (note that ports cannot be freed in meantime); a port
+     * that fails does not keep the message from the others, and the first error is returned */
+    ret = 0;
     for (size_t i = 0; i < target_ports_cnt; i++) {
         port = target_ports[i];
 
-        debug("Broadcast to port %p (handle %p) for process %u (type %x, target %x)\n",
-              port, port->pal_handle, port->vmid & 0xFFFF, port->type, target_type);
+        debug_trace("Broadcast to port %p (handle %p) for process %u (type %x, target %x)\n",
+                    port, port->pal_handle, port->vmid & 0xFFFF, port->type, target_type);
 
         msg->dst = port->vmid;
-        ret = send_ipc_message(msg, port);
-        if (ret < 0) {
+        int err = send_ipc_message(msg, port);
+        if (err < 0) {
             debug("Broadcast to port %p (handle %p) for process %u failed (errno = %d)!\n",
-                  port, port->pal_handle, port->vmid & 0xFFFF, ret);
-            goto out;
+                  port, port->pal_handle, port->vmid & 0xFFFF, err);
+            if (!ret)
+                ret = err;
         }
     }
 
-    ret = 0;
-out:
     for (size_t i = 0; i < target_ports_cnt; i++)
         put_ipc_port(target_ports[i]);
     if (target_ports != target_ports_stack)
@@ -501,7 +550,7 @@ out:
 
 static int ipc_resp_callback(struct shim_ipc_msg* msg, struct shim_ipc_port* port) {
     struct shim_ipc_resp* resp = (struct shim_ipc_resp*) &msg->msg;
-    debug("IPC callback from %u: IPC_RESP(%d)\n", msg->src & 0xFFFF, resp->retval);
+    debug_trace("IPC callback from %u: IPC_RESP(%d)\n", msg->src & 0xFFFF, resp->retval);
 
     if (!msg->seq)
         return resp->retval;
@@ -532,41 +581,96 @@ int send_response_ipc_message(struct shim_ipc_port* port, IDTYPE dest, int ret,
     struct shim_ipc_resp* resp = (struct shim_ipc_resp *)resp_msg->msg;
     resp->retval = ret;
 
-    debug("IPC send to %u: IPC_RESP(%d)\n", resp_msg->dst & 0xFFFF, ret);
+    debug_trace("IPC send to %u: IPC_RESP(%d)\n", resp_msg->dst & 0xFFFF, ret);
     return send_ipc_message(resp_msg, port);
 }
 
-static int receive_ipc_message(struct shim_ipc_port* port) {
+/* Reads at most size bytes from the port; returns the number of bytes read */
+static ssize_t read_ipc_port(struct shim_ipc_port* port, void* buf, size_t size) {
+    while (true) {
+        size_t read = DkStreamRead(port->pal_handle, /*offset=*/0, size, buf, NULL, 0);
+        if (read)
+            return read;
+
+        if (PAL_ERRNO == EINTR || PAL_ERRNO == EAGAIN || PAL_ERRNO == EWOULDBLOCK)
+            continue;
+
+        debug("Port %p (handle %p) closed while receiving IPC message\n", port, port->pal_handle);
+        del_ipc_port_fini(port, -ECHILD);
+        return -PAL_ERRNO;
+    }
+}
+
+/* Invokes the callback of msg, and sends the response it asks for. Returns
+   KEEP_IPC_MSG if the callback keeps msg. */
+static int handle_ipc_message(struct shim_ipc_msg* msg, struct shim_ipc_port* port) {
+    debug_trace("Received IPC message from port %p (handle %p): code=%d size=%lu src=%u dst=%u seq=%lx\n",
+                port, port->pal_handle, msg->code, msg->size, msg->src & 0xFFFF, msg->dst & 0xFFFF, msg->seq);
+
+    /* skip messages coming from myself (in case of broadcast) */
+    if (msg->src == cur_process.vmid)
+        return 0;
+
+    if (msg->code >= IPC_CODE_NUM || !ipc_callbacks[msg->code])
+        return 0;
+
+    /* invoke callback to this msg */
+    int ret = (*ipc_callbacks[msg->code])(msg, port);
+    if (ret == KEEP_IPC_MSG && msg->size >= IPC_MSG_KEEP_MIN)
+        return ret;
+
+    if ((ret < 0 || ret == RESPONSE_CALLBACK) && msg->seq) {
+        /* send IPC_RESP message to sender of this msg */
+        ret = send_response_ipc_message(port, msg->src, ret, msg->seq);
+        if (ret < 0) {
+            debug("Sending IPC_RESP msg on port %p (handle %p) to %u failed\n",
+                  port, port->pal_handle, msg->src & 0xFFFF);
+            return -PAL_ERRNO;
+        }
+    }
+
+    return 0;
+}
+
+static int receive_ipc_message(struct shim_ipc_port* port, struct ipc_recv_buf* buf) {
     int ret;
     size_t readahead = IPC_MSG_MINIMAL_SIZE * 2;
-    size_t bufsize = IPC_MSG_MINIMAL_SIZE + readahead;
 
-    struct shim_ipc_msg* msg = malloc(bufsize);
+    if (!buf->msg) {
+        buf->msg = malloc(IPC_RECV_BUF_INIT);
+        if (!buf->msg)
+            return -ENOMEM;
+        buf->size = IPC_RECV_BUF_INIT;
+    }
+
+    struct shim_ipc_msg* msg = buf->msg;
+    size_t bufsize = buf->size;
     size_t expected_size = IPC_MSG_MINIMAL_SIZE;
     size_t bytes = 0;
 
     do {
-        while (bytes < expected_size) {
+        /* big messages are received into a buffer of their own (see below) */
+        while (bytes < expected_size && expected_size < IPC_MSG_KEEP_MIN) {
             /* grow msg buffer to accomodate bigger messages */
             if (expected_size + readahead > bufsize) {
-                while (expected_size + readahead > bufsize)
-                    bufsize *= 2;
-                void* tmp_buf = malloc(bufsize);
+                size_t new_size = bufsize;
+                while (expected_size + readahead > new_size)
+                    new_size *= 2;
+                void* tmp_buf = malloc(new_size);
+                if (!tmp_buf) {
+                    ret = -ENOMEM;
+                    goto out;
+                }
                 memcpy(tmp_buf, msg, bytes);
                 free(msg);
                 msg = tmp_buf;
+                bufsize = new_size;
             }
 
-            size_t read = DkStreamRead(port->pal_handle, /*offset=*/0, expected_size - bytes + readahead,
-                                       (void *) msg + bytes, NULL, 0);
-
-            if (!read) {
-                if (PAL_ERRNO == EINTR || PAL_ERRNO == EAGAIN || PAL_ERRNO == EWOULDBLOCK)
-                    continue;
-
-                debug("Port %p (handle %p) closed while receiving IPC message\n", port, port->pal_handle);
-                del_ipc_port_fini(port, -ECHILD);
-                ret = -PAL_ERRNO;
+            ssize_t read = read_ipc_port(port, (void*)msg + bytes,
+                                         expected_size - bytes + readahead);
+            if (read < 0) {
+                ret = read;
                 goto out;
             }
 
@@ -577,51 +681,156 @@ static int receive_ipc_message(struct shim_ipc_port* port) {
                 expected_size = msg->size;
         }
 
-        debug("Received IPC message from port %p (handle %p): code=%d size=%lu src=%u dst=%u seq=%lx\n",
-              port, port->pal_handle, msg->code, msg->size, msg->src & 0xFFFF, msg->dst & 0xFFFF, msg->seq);
-
-        /* skip messages coming from myself (in case of broadcast) */
-        if (msg->src != cur_process.vmid) {
-            if (msg->code < IPC_CODE_NUM && ipc_callbacks[msg->code]) {
-                /* invoke callback to this msg */
-                ret = (*ipc_callbacks[msg->code])(msg, port);
-                if ((ret < 0 || ret == RESPONSE_CALLBACK) && msg->seq) {
-                    /* send IPC_RESP message to sender of this msg */
-                    ret = send_response_ipc_message(port, msg->src, ret, msg->seq);
-                    if (ret < 0) {
-                        debug("Sending IPC_RESP msg on port %p (handle %p) to %u failed\n",
-                              port, port->pal_handle, msg->src & 0xFFFF);
-                        ret = -PAL_ERRNO;
-                        goto out;
-                    }
+        if (expected_size >= IPC_MSG_KEEP_MIN) {
+            /* move what was read of this message to its own buffer, and read
+               the rest of it there, without reading ahead into the next one;
+               its callback may then keep the message instead of copying it */
+            struct shim_ipc_msg* own = malloc(expected_size);
+            if (!own) {
+                ret = -ENOMEM;
+                goto out;
+            }
+
+            size_t head = MIN(bytes, expected_size);
+            memcpy(own, msg, head);
+            bytes -= head;
+            memmove(msg, (void*)msg + head, bytes);
+
+            while (head < expected_size) {
+                ssize_t read = read_ipc_port(port, (void*)own + head, expected_size - head);
+                if (read < 0) {
+                    free(own);
+                    ret = read;
+                    goto out;
                 }
+                head += read;
             }
-        }
 
-        bytes -= expected_size; /* one message was received and handled */
+            ret = handle_ipc_message(own, port);
+            if (ret != KEEP_IPC_MSG)
+                free(own);
+        } else {
+            ret = handle_ipc_message(msg, port);
 
-        if (bytes > 0) {
-            /* we may have started reading the next message, move this message
-             * to beginning of msg buffer and reset expected size */
-            memmove(msg, (void *)msg + expected_size, bytes);
-            expected_size = IPC_MSG_MINIMAL_SIZE;
-            if (bytes >= IPC_MSG_MINIMAL_SIZE)
-                expected_size = msg->size;
+            /* we may have started reading the next message, move it to the
+               beginning of msg buffer */
+            bytes -= expected_size;
+            memmove(msg, (void*)msg + expected_size, bytes);
         }
+
+        if (ret < 0)
+            goto out;
+
+        expected_size = IPC_MSG_MINIMAL_SIZE;
+        if (bytes >= IPC_MSG_MINIMAL_SIZE)
+            expected_size = msg->size;
     } while (bytes > 0);
 
     ret = 0;
 out:
-    free(msg);
+    if (bufsize > IPC_RECV_BUF_KEEP) {
+        free(msg);
+        buf->msg  = NULL;
+        buf->size = 0;
+    } else {
+        buf->msg  = msg;
+        buf->size = bufsize;
+    }
     return ret;
 }
 
+/* Receive all messages available on a client port and handle its
+ * disconnection. Called by an IPC worker thread, or by the IPC helper thread
+ * if there are no workers. */
+static void service_ipc_port(struct shim_ipc_port* port, struct ipc_recv_buf* buf) {
+    PAL_STREAM_ATTR attr;
+    if (DkStreamAttributesQueryByHandle(port->pal_handle, &attr)) {
+        /* can read on this port, so receive messages */
+        if (attr.readable) {
+            /* NOTE: IPC threads do not handle failures currently */
+            receive_ipc_message(port, buf);
+        }
+
+        if (attr.disconnected) {
+            debug("Port %p (handle %p) disconnected\n", port, port->pal_handle);
+            del_ipc_port_fini(port, -ECONNRESET);
+        }
+    } else {
+        debug("Port %p (handle %p) was removed during attr querying\n",
+              port, port->pal_handle);
+        del_ipc_port_fini(port, -PAL_ERRNO);
+    }
+}
+
+/* Hand a client port with input over to the IPC workers. The queue holds a
+ * reference to the port until a worker is done with it. */
+static void queue_ipc_port(struct shim_ipc_port* port) {
+    lock(&ipc_helper_lock);
+    if (port->busy) {
+        unlock(&ipc_helper_lock);
+        return;
+    }
+
+    port->busy = true;
+    __get_ipc_port(port);
+    LISTP_ADD_TAIL(port, &work_queue, work_list);
+    unlock(&ipc_helper_lock);
+
+    set_event(&work_event, 1);
+}
+
+/* Main routine of an IPC worker thread. Workers are spawned together with the
+ * IPC helper thread and exit when it is terminated. Each wakeup of work_event
+ * corresponds to one port put on work_queue. */
+noreturn static void shim_ipc_worker(void* dummy) {
+    __UNUSED(dummy);
+    struct shim_thread* self = get_cur_thread();
+    struct ipc_recv_buf buf = { .msg = NULL, .size = 0 };
+
+    while (true) {
+        wait_event(&work_event);
+
+        lock(&ipc_helper_lock);
+        if (ipc_helper_state != HELPER_ALIVE) {
+            unlock(&ipc_helper_lock);
+            break;
+        }
+
+        if (LISTP_EMPTY(&work_queue)) {
+            unlock(&ipc_helper_lock);
+            continue;
+        }
+
+        struct shim_ipc_port* port = LISTP_FIRST_ENTRY(&work_queue, struct shim_ipc_port,
+                                                       work_list);
+        LISTP_DEL_INIT(port, &work_queue, work_list);
+        unlock(&ipc_helper_lock);
+
+        service_ipc_port(port, &buf);
+
+        lock(&ipc_helper_lock);
+        port->busy = false;
+        unlock(&ipc_helper_lock);
+
+        /* wake up IPC helper thread so that it waits on this port again */
+        set_event(&install_new_event, 1);
+        put_ipc_port(port);
+    }
+
+    free(buf.msg);
+    put_thread(self);
+    debug("IPC worker thread terminated\n");
+
+    DkThreadExit();
+}
+
 /* Main routine of the IPC helper thread. IPC helper thread is spawned when
  * the first IPC port is added and is terminated only when the whole Graphene
  * application terminates. IPC helper thread runs in an endless loop and waits
  * on port events (either the addition/removal of ports or actual port events:
  * acceptance of new client or receiving/sending messages). In particular,
- * IPC helper thread calls receive_ipc_message() if a message arrives on port.
+ * IPC helper thread queues a port for the IPC workers (or calls
+ * receive_ipc_message() itself) if a message arrives on port.
  *
  * Other threads add and remove IPC ports via add_ipc_xxx() and del_ipc_xxx()
  * functions. These ports are added to port_list which the IPC helper thread
@@ -644,6 +853,7 @@ noreturn static void shim_ipc_helper(void* dummy) {
     struct shim_thread* self = get_cur_thread();
 
     PAL_HANDLE polled = NULL;
+    struct ipc_recv_buf buf = { .msg = NULL, .size = 0 };
 
     /* Initialize two lists:
      * - object_list collects IPC port objects and is the main handled list
@@ -705,25 +915,10 @@ noreturn static void shim_ipc_helper(void* dummy) {
                             polled_port, polled_port->pal_handle);
                     del_ipc_port_fini(polled_port, -ECHILD);
                 }
+            } else if (ipc_workers) {
+                queue_ipc_port(polled_port);
             } else {
-                PAL_STREAM_ATTR attr;
-                if (DkStreamAttributesQueryByHandle(polled_port->pal_handle, &attr)) {
-                    /* can read on this port, so receive messages */
-                    if (attr.readable) {
-                        /* NOTE: IPC helper thread does not handle failures currently */
-                        receive_ipc_message(polled_port);
-                    }
-
-                    if (attr.disconnected) {
-                        debug("Port %p (handle %p) disconnected\n",
-                              polled_port, polled_port->pal_handle);
-                        del_ipc_port_fini(polled_port, -ECONNRESET);
-                    }
-                } else {
-                    debug("Port %p (handle %p) was removed during attr querying\n",
-                          polled_port, polled_port->pal_handle);
-                    del_ipc_port_fini(polled_port, -PAL_ERRNO);
-                }
+                service_ipc_port(polled_port, &buf);
             }
         }
 
@@ -738,6 +933,10 @@ noreturn static void shim_ipc_helper(void* dummy) {
         struct shim_ipc_port* port;
         struct shim_ipc_port* tmp;
         LISTP_FOR_EACH_ENTRY_SAFE(port, tmp, &port_list, list) {
+            /* skip ports with input that a worker has not received yet */
+            if (port->busy)
+                continue;
+
             /* get port reference so it is not freed while we wait on/handle it */
             __get_ipc_port(port);
 
@@ -779,6 +978,7 @@ noreturn static void shim_ipc_helper(void* dummy) {
 
     free(object_list);
     free(palhandle_list);
+    free(buf.msg);
 
     put_thread(self);
     debug("IPC helper thread terminated\n");
@@ -817,6 +1017,51 @@ static void shim_ipc_helper_prepare(void* arg) {
     __SWITCH_STACK(self->stack_top, shim_ipc_helper, NULL);
 }
 
+static void shim_ipc_worker_prepare(void* arg) {
+    struct shim_thread* self = (struct shim_thread*)arg;
+    if (!arg)
+        return;
+
+    __libc_tcb_t tcb;
+    allocate_tls(&tcb, false, self);
+    debug_setbuf(&tcb.shim_tcb, true);
+
+    debug("IPC worker thread started\n");
+
+    /* the stack was allocated by create_ipc_workers() */
+    __SWITCH_STACK(self->stack_top, shim_ipc_worker, NULL);
+}
+
+/* this should be called with the ipc_helper_lock held; failing to spawn a
+ * worker is not fatal, as the IPC helper thread services the ports itself
+ * when there are no workers */
+static void create_ipc_workers(void) {
+    while (ipc_workers < ipc_worker_num) {
+        struct shim_thread* new = get_new_internal_thread();
+        if (!new)
+            return;
+
+        void* stack = allocate_stack(IPC_HELPER_STACK_SIZE, g_pal_alloc_align, false);
+        if (!stack) {
+            put_thread(new);
+            return;
+        }
+
+        new->stack_top = stack + IPC_HELPER_STACK_SIZE;
+        new->stack = stack;
+
+        PAL_HANDLE handle = thread_create(shim_ipc_worker_prepare, new);
+        if (!handle) {
+            debug("Failed to create IPC worker thread (errno = %ld)\n", PAL_ERRNO);
+            put_thread(new);
+            return;
+        }
+
+        new->pal_handle = handle;
+        ipc_workers++;
+    }
+}
+
 /* this should be called with the ipc_helper_lock held */
 static int create_ipc_helper(void) {
     if (ipc_helper_state == HELPER_ALIVE)
@@ -840,6 +1085,7 @@ static int create_ipc_helper(void) {
     }
 
     new->pal_handle = handle;
+    create_ipc_workers();
     return 0;
 }
 
@@ -881,9 +1127,13 @@ struct shim_thread* terminate_ipc_helper(void) {
     if (ret)
         get_thread(ret);
     ipc_helper_state = HELPER_NOTALIVE;
+    int workers = ipc_workers;
+    ipc_workers = 0;
     unlock(&ipc_helper_lock);
 
-    /* force wake up of ipc helper thread so that it exits */
+    /* force wake up of ipc helper thread and workers so that they exit */
     set_event(&install_new_event, 1);
+    if (workers)
+        set_event(&work_event, workers);
     return ret;
 }
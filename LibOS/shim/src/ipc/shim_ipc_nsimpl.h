@@ -406,40 +406,62 @@ failed:
     return err;
 }
 
-int CONCAT3(alloc, NS, range)(IDTYPE owner, const char* uri, IDTYPE* base, LEASETYPE* lease) {
-    struct range* r = malloc(sizeof(struct range));
-    if (!r)
-        return -ENOMEM;
+/* Returns the first of count free ranges in a row; the ranges past the end of
+   range_map are all free */
+static IDTYPE __find_free_ranges(IDTYPE count) {
+    IDTYPE off = 0, run = 0;
+
+    if (range_map)
+        for (; off < range_map->map_size; off++) {
+            if (__check_range_bitmap(off)) {
+                run = 0;
+                continue;
+            }
 
+            if (++run == count)
+                return off + 1 - count;
+        }
+
+    return off - run;
+}
+
+/* Allocates up to *count ranges in a row for owner; *count returns the number
+   actually allocated, and *base the first name of them */
+int CONCAT3(alloc, NS, range)(IDTYPE owner, const char* uri, IDTYPE* count, IDTYPE* base,
+                              LEASETYPE* lease) {
+    assert(*count);
     int ret = 0;
     lock(&range_map_lock);
-    r->owner = NULL;
-    IDTYPE i = 0, j = 0;
 
-    if (range_map)
-        for (i = 0; i < range_map->map_size; i++) {
-            unsigned char map = range_map->map[i];
+    IDTYPE off  = __find_free_ranges(*count);
+    LEASETYPE l = get_lease();
+    IDTYPE i;
 
-            if (map < 255U) {
-                for (j = 0; j < BITS; map >>= 1, j++)
-                    if (!(map & 1U))
-                        break;
-                assert(j < BITS);
-                break;
-            }
+    for (i = 0; i < *count; i++) {
+        struct range* r = malloc(sizeof(struct range));
+        if (!r) {
+            ret = -ENOMEM;
+            break;
         }
 
-    LEASETYPE l = get_lease();
-    ret         = __add_range(r, i * BITS + j, owner, uri, l);
-    if (ret < 0) {
-        if (r->owner)
-            put_ipc_info(r->owner);
-        free(r);
-        goto out;
+        r->owner = NULL;
+        ret      = __add_range(r, off + i, owner, uri, l);
+        if (ret < 0) {
+            if (r->owner)
+                put_ipc_info(r->owner);
+            free(r);
+            break;
+        }
     }
 
+    if (!i)
+        goto out;
+
+    ret    = 0;
+    *count = i;
+
     if (base)
-        *base = (i * BITS + j) * RANGE_SIZE + 1;
+        *base = off * RANGE_SIZE + 1;
 
     if (lease)
         *lease = l;
@@ -612,9 +634,42 @@ int CONCAT3(renew, NS, subrange)(IDTYPE idx, LEASETYPE* lease) {
     return 0;
 }
 
+/*
+ * A lease asks the leader for lease_ranges ranges at once. The number doubles,
+ * up to MAX_LEASE_RANGES, while the owned ranges run out within
+ * LEASE_RATE_WINDOW of the previous lease, and halves when they last longer,
+ * so a process creating names quickly goes back to the leader less often.
+ * When a name is allocated in the last quarter of the last owned range, the
+ * next lease is sent ahead without waiting for the offer.
+ */
+#define MAX_LEASE_RANGES   32
+#define LEASE_RATE_WINDOW  1000000 /* 1 second */
+#define PREFETCH_THRESHOLD (RANGE_SIZE - RANGE_SIZE / 4)
+
+static IDTYPE lease_ranges = 1;
+static LEASETYPE last_lease_time;
+static bool lease_prefetching;
+
+static IDTYPE __next_lease_ranges(void) {
+    LEASETYPE now = DkSystemTimeQuery();
+
+    if (last_lease_time && now - last_lease_time < LEASE_RATE_WINDOW) {
+        if (lease_ranges < MAX_LEASE_RANGES)
+            lease_ranges *= 2;
+    } else if (lease_ranges > 1) {
+        lease_ranges /= 2;
+    }
+
+    last_lease_time = now;
+    return lease_ranges;
+}
+
+static int __lease_send(bool block, LEASETYPE* lease);
+
 IDTYPE CONCAT2(allocate, NS)(IDTYPE min, IDTYPE max) {
     IDTYPE idx = min;
     struct range* r;
+    bool prefetch = false;
     lock(&range_map_lock);
 
     LISTP_FOR_EACH_ENTRY(r, &owned_ranges, list) {
@@ -646,6 +701,10 @@ IDTYPE CONCAT2(allocate, NS)(IDTYPE min, IDTYPE max) {
                         (*m) |= f;
                         idx = base + i * BITS + j;
                         debug("allocated " NS_STR ": %u\n", idx);
+
+                        if (!lease_prefetching && idx - base >= PREFETCH_THRESHOLD &&
+                            r == LISTP_LAST_ENTRY(&owned_ranges, range, list))
+                            prefetch = lease_prefetching = true;
                         goto out;
                     }
             }
@@ -655,6 +714,10 @@ IDTYPE CONCAT2(allocate, NS)(IDTYPE min, IDTYPE max) {
 
 out:
     unlock(&range_map_lock);
+
+    if (prefetch)
+        __lease_send(false, NULL);
+
     return idx;
 }
 
@@ -1081,13 +1144,17 @@ out:
 DEFINE_PROFILE_INTERVAL(NS_SEND(lease), ipc);
 DEFINE_PROFILE_INTERVAL(NS_CALLBACK(lease), ipc);
 
-int NS_SEND(lease)(LEASETYPE* lease) {
+static int __lease_send(bool block, LEASETYPE* lease) {
     BEGIN_PROFILE_INTERVAL();
-    IDTYPE leader;
+    IDTYPE leader              = 0;
     struct shim_ipc_port* port = NULL;
     struct shim_ipc_info* self = NULL;
     int ret                    = 0;
 
+    lock(&range_map_lock);
+    IDTYPE count = __next_lease_ranges();
+    unlock(&range_map_lock);
+
     if ((ret = connect_ns(&leader, &port)) < 0)
         goto out;
 
@@ -1095,7 +1162,8 @@ int NS_SEND(lease)(LEASETYPE* lease) {
         goto out;
 
     if (leader == cur_process.vmid) {
-        ret = CONCAT3(alloc, NS, range)(cur_process.vmid, qstrgetstr(&self->uri), NULL, NULL);
+        ret = CONCAT3(alloc, NS, range)(cur_process.vmid, qstrgetstr(&self->uri), &count, NULL,
+                                        NULL);
         put_ipc_info(self);
         goto out;
     }
@@ -1106,34 +1174,56 @@ int NS_SEND(lease)(LEASETYPE* lease) {
     init_ipc_msg_duplex(msg, NS_CODE(LEASE), total_msg_size, leader);
 
     NS_MSG_TYPE(lease)* msgin = (void*)&msg->msg.msg;
+    msgin->count              = count;
     assert(!qstrempty(&self->uri));
     memcpy(msgin->uri, qstrgetstr(&self->uri), len + 1);
     put_ipc_info(self);
 
-    debug("ipc send to %u: " NS_CODE_STR(LEASE) "(%s)\n", leader, msgin->uri);
+    debug("ipc send to %u: " NS_CODE_STR(LEASE) "(%u, %s)\n", leader, count, msgin->uri);
 
-    ret = send_ipc_message_duplex(msg, port, NULL, lease);
+    /* without waiting, the offer adds the ranges when it arrives */
+    if (block)
+        ret = send_ipc_message_duplex(msg, port, NULL, lease);
+    else
+        ret = send_ipc_message(&msg->msg, port);
 out:
+    if (!block && (ret < 0 || leader == cur_process.vmid)) {
+        lock(&range_map_lock);
+        lease_prefetching = false;
+        unlock(&range_map_lock);
+    }
+
     if (port)
         put_ipc_port(port);
     SAVE_PROFILE_INTERVAL(NS_SEND(lease));
     return ret;
 }
 
+int NS_SEND(lease)(LEASETYPE* lease) {
+    return __lease_send(true, lease);
+}
+
 int NS_CALLBACK(lease)(IPC_CALLBACK_ARGS) {
     BEGIN_PROFILE_INTERVAL();
     NS_MSG_TYPE(lease)* msgin = (void*)&msg->msg;
 
-    debug("ipc callback from %u: " NS_CODE_STR(LEASE) "(%s)\n", msg->src, msgin->uri);
+    debug("ipc callback from %u: " NS_CODE_STR(LEASE) "(%u, %s)\n", msg->src, msgin->count,
+          msgin->uri);
 
     IDTYPE base     = 0;
+    IDTYPE count    = msgin->count;
     LEASETYPE lease = 0;
 
-    int ret = CONCAT3(alloc, NS, range)(msg->src, msgin->uri, &base, &lease);
+    if (!count)
+        count = 1;
+    if (count > MAX_LEASE_RANGES)
+        count = MAX_LEASE_RANGES;
+
+    int ret = CONCAT3(alloc, NS, range)(msg->src, msgin->uri, &count, &base, &lease);
     if (ret < 0)
         goto out;
 
-    ret = NS_SEND(offer)(port, msg->src, base, RANGE_SIZE, lease, msg->seq);
+    ret = NS_SEND(offer)(port, msg->src, base, count * RANGE_SIZE, lease, msg->seq);
 
 out:
     SAVE_PROFILE_INTERVAL(NS_CALLBACK(lease));
@@ -1172,26 +1262,30 @@ int NS_CALLBACK(offer)(IPC_CALLBACK_ARGS) {
 
     struct shim_ipc_msg_duplex* obj = pop_ipc_msg_duplex(port, msg->seq);
 
-    switch (msgin->size) {
-        case RANGE_SIZE:
-            CONCAT3(add, NS, range)(msgin->base, cur_process.vmid,
-                                    qstrgetstr(&cur_process.self->uri), msgin->lease);
-            LEASETYPE* priv = obj ? obj->private : NULL;
+    if (msgin->size == 1) {
+        if (obj) {
+            NS_MSG_TYPE(sublease)* s = (void*)&obj->msg.msg;
+            CONCAT3(add, NS, subrange)(s->idx, s->tenant, s->uri, &msgin->lease);
+
+            LEASETYPE* priv = obj->private;
             if (priv)
                 *priv = msgin->lease;
-            break;
-        case 1:
-            if (obj) {
-                NS_MSG_TYPE(sublease)* s = (void*)&obj->msg.msg;
-                CONCAT3(add, NS, subrange)(s->idx, s->tenant, s->uri, &msgin->lease);
+        }
+    } else if (msgin->size && !(msgin->size % RANGE_SIZE)) {
+        /* a lease may be offered several ranges in a row */
+        for (IDTYPE base = msgin->base; base < msgin->base + msgin->size; base += RANGE_SIZE)
+            CONCAT3(add, NS, range)(base, cur_process.vmid, qstrgetstr(&cur_process.self->uri),
+                                    msgin->lease);
+
+        lock(&range_map_lock);
+        lease_prefetching = false;
+        unlock(&range_map_lock);
 
-                LEASETYPE* priv = obj->private;
-                if (priv)
-                    *priv = msgin->lease;
-            }
-            break;
-        default:
-            goto out;
+        LEASETYPE* priv = obj ? obj->private : NULL;
+        if (priv)
+            *priv = msgin->lease;
+    } else {
+        goto out;
     }
 
     if (obj && obj->thread)
@@ -1297,6 +1391,9 @@ int NS_SEND(sublease)(IDTYPE tenant, IDTYPE idx, const char* uri, LEASETYPE* lea
     debug("ipc send to %u: " NS_CODE_STR(SUBLEASE) "(%u, %u, %s)\n", leader, tenant, idx,
           msgin->uri);
 
+    /* Wait for the offer even if nobody needs the lease: until the leader
+     * has the subrange, it would answer queries for the name with the owner
+     * of the whole range */
     ret = send_ipc_message_duplex(msg, port, NULL, lease);
 out:
     if (port)
@@ -1365,30 +1462,83 @@ int NS_CALLBACK(query)(IPC_CALLBACK_ARGS) {
 
     debug("ipc callback from %u: " NS_CODE_STR(QUERY) "(%u)\n", msg->src, msgin->idx);
 
-    struct CONCAT2(NS, range) range;
-    int ret = 0;
-    memset(&range, 0, sizeof(struct CONCAT2(NS, range)));
+    IDTYPE off  = (msgin->idx - 1) / RANGE_SIZE;
+    IDTYPE base = off * RANGE_SIZE + 1;
+    int ret     = 0;
 
-    ret = CONCAT3(get, NS, range)(msgin->idx, &range, NULL);
-    if (ret < 0)
+    lock(&range_map_lock);
+
+    struct range* r = __get_range(off);
+    if (!r || (!r->owner && !(r->subranges && r->subranges->map[msgin->idx - base]))) {
+        unlock(&range_map_lock);
+        ret = -ESRCH;
         goto out;
+    }
+
+    /*
+     * Answer the owners of the whole range, not only of the queried name: the
+     * querier caches them, and finds the names next to it (e.g., the other
+     * children of the same parent) without asking again. Entry -1 is the
+     * owner of the range, and the others its subranges.
+     */
+    int nentries = r->subranges ? (int)RANGE_SIZE : 0;
+    int nanswers = 0, nowners = 0, i;
+    size_t ownerbufsz = 0;
+
+    for (i = -1; i < nentries; i++) {
+        struct shim_ipc_info* p = i < 0 ? r->owner :
+                                  r->subranges->map[i] ? r->subranges->map[i]->owner : NULL;
+        if (p)
+            ownerbufsz += sizeof(struct ipc_ns_client) + p->uri.len;
+    }
 
-    assert(msgin->idx >= range.base && msgin->idx < range.base + range.size);
-    assert(range.owner);
-    assert(!qstrempty(&range.uri));
-
-    struct ipc_ns_offered ans;
-    ans.base                    = range.base;
-    ans.size                    = range.size;
-    ans.lease                   = range.lease;
-    ans.owner_offset            = 0;
-    int ownerdatasz             = sizeof(struct ipc_ns_client) + range.uri.len;
-    struct ipc_ns_client* owner = __alloca(ownerdatasz);
-    owner->vmid                 = range.owner;
-    assert(!qstrempty(&range.uri));
-    memcpy(owner->uri, qstrgetstr(&range.uri), range.uri.len + 1);
-
-    ret = NS_SEND(answer)(port, msg->src, 1, &ans, 1, &owner, &ownerdatasz, msg->seq);
+    int maxanswers = 1 + nentries;
+    struct ipc_ns_offered* answers   = __alloca(sizeof(struct ipc_ns_offered) * maxanswers);
+    struct ipc_ns_client** ownerdata = __alloca(sizeof(struct ipc_ns_client*) * maxanswers);
+    int* ownerdatasz                 = __alloca(sizeof(int) * maxanswers);
+    char* ownerbuf                   = __alloca(ownerbufsz);
+    int owner_offset                 = 0;
+
+    for (i = -1; i < nentries; i++) {
+        struct shim_ipc_info* p;
+        LEASETYPE lease;
+
+        if (i < 0) {
+            p     = r->owner;
+            lease = r->lease;
+        } else {
+            struct subrange* sub = r->subranges->map[i];
+            p     = sub ? sub->owner : NULL;
+            lease = sub ? sub->lease : 0;
+        }
+
+        if (!p)
+            continue;
+
+        int datasz                  = sizeof(struct ipc_ns_client) + p->uri.len;
+        struct ipc_ns_client* owner = (void*)(ownerbuf + owner_offset);
+
+        assert(!qstrempty(&p->uri));
+        owner->vmid = p->vmid;
+        memcpy(owner->uri, qstrgetstr(&p->uri), p->uri.len + 1);
+
+        answers[nanswers].base         = i < 0 ? base : base + i;
+        answers[nanswers].size         = i < 0 ? RANGE_SIZE : 1;
+        answers[nanswers].lease        = lease;
+        answers[nanswers].owner_offset = owner_offset;
+        nanswers++;
+
+        ownerdata[nowners]   = owner;
+        ownerdatasz[nowners] = datasz;
+        nowners++;
+
+        owner_offset += datasz;
+    }
+
+    unlock(&range_map_lock);
+
+    ret = NS_SEND(answer)(port, msg->src, nanswers, answers, nowners, ownerdata, ownerdatasz,
+                          msg->seq);
 out:
     SAVE_PROFILE_INTERVAL(NS_CALLBACK(query));
     return ret;
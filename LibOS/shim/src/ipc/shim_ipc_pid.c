@@ -695,8 +695,9 @@ int ipc_pid_sendrpc_send (IDTYPE pid, IDTYPE sender, const void * buf,
     if ((ret = get_pid_port(pid, &dest, &port)) < 0)
         return ret;
 
+    /* the payload is sent from buf, only the header is built here */
     size_t total_msg_size = get_ipc_msg_size(sizeof(struct shim_ipc_pid_sendrpc) + len);
-    struct shim_ipc_msg* msg = __alloca(total_msg_size);
+    struct shim_ipc_msg* msg = __alloca(total_msg_size - len);
     init_ipc_msg(msg, IPC_PID_SENDRPC, total_msg_size, dest);
     struct shim_ipc_pid_sendrpc * msgin =
                     (struct shim_ipc_pid_sendrpc *) &msg->msg;
@@ -704,9 +705,8 @@ int ipc_pid_sendrpc_send (IDTYPE pid, IDTYPE sender, const void * buf,
     debug("ipc send to %u: IPC_PID_SENDPRC(%d)\n", dest, len);
     msgin->sender = sender;
     msgin->len = len;
-    memcpy(msgin->payload, buf, len);
 
-    ret = send_ipc_message(msg, port);
+    ret = send_ipc_message_payload(msg, buf, len, port);
     put_ipc_port(port);
     SAVE_PROFILE_INTERVAL(ipc_pid_sendrpc_send);
     return ret;
@@ -717,7 +717,9 @@ struct rpcmsg {
     LIST_TYPE(rpcmsg) list;
     IDTYPE sender;
     int len;
-    char payload[];
+    const char * payload;
+    struct shim_ipc_msg * msg;  /* kept IPC message holding the payload, or
+                                   NULL if the payload follows this struct */
 };
 
 DEFINE_LIST(rpcreq);
@@ -746,8 +748,11 @@ int get_rpc_msg(IDTYPE* sender, void* buf, int len) {
             len = m->len;
         if (sender)
             *sender = m->sender;
-        memcpy(buf, m->payload, len);
         unlock(&rpc_queue_lock);
+
+        memcpy(buf, m->payload, len);
+        free(m->msg);
+        free(m);
         return len;
     }
 
@@ -801,7 +806,10 @@ int ipc_pid_sendrpc_callback (IPC_CALLBACK_ARGS)
         goto out;
     }
 
-    struct rpcmsg * m = malloc(sizeof(struct rpcmsg) + msgin->len);
+    /* nobody is waiting: queue the payload, in the IPC message itself if
+       the message can be kept */
+    bool keep = msg->size >= IPC_MSG_KEEP_MIN;
+    struct rpcmsg * m = malloc(sizeof(struct rpcmsg) + (keep ? 0 : msgin->len));
     if (!m) {
         ret = -ENOMEM;
         goto out;
@@ -810,7 +818,15 @@ int ipc_pid_sendrpc_callback (IPC_CALLBACK_ARGS)
     INIT_LIST_HEAD(m, list);
     m->sender = msgin->sender;
     m->len = msgin->len;
-    memcpy(m->payload, msgin->payload, msgin->len);
+    if (keep) {
+        m->payload = msgin->payload;
+        m->msg = msg;
+        ret = KEEP_IPC_MSG;
+    } else {
+        m->payload = (char *) (m + 1);
+        m->msg = NULL;
+        memcpy(m + 1, msgin->payload, msgin->len);
+    }
     LISTP_ADD_TAIL(m, &rpc_msgs, list);
 out:
     unlock(&rpc_queue_lock);
@@ -217,18 +217,18 @@ int ipc_sysv_msgsnd_send(struct shim_ipc_port* port, IDTYPE dest, IDTYPE msgid,
         owned = false;
     }
 
+    /* the message text is sent from buf, only the header is built here */
     size_t total_msg_size    = get_ipc_msg_size(sizeof(struct shim_ipc_sysv_msgsnd) + size);
-    struct shim_ipc_msg* msg = __alloca(total_msg_size);
+    struct shim_ipc_msg* msg = __alloca(total_msg_size - size);
     init_ipc_msg(msg, IPC_SYSV_MSGSND, total_msg_size, dest);
     struct shim_ipc_sysv_msgsnd* msgin = (struct shim_ipc_sysv_msgsnd*)&msg->msg;
     msgin->msgid                       = msgid;
     msgin->msgtype                     = msgtype;
-    memcpy(msgin->msg, buf, size);
     msg->seq = seq;
 
     debug("ipc send to %u: IPC_SYSV_MSGSND(%u, %ld)\n", dest, msgid, msgtype);
 
-    ret = send_ipc_message(msg, port);
+    ret = send_ipc_message_payload(msg, buf, size, port);
 
     if (!owned)
         put_ipc_port(port);
@@ -271,16 +271,22 @@ int ipc_sysv_msgsnd_callback(IPC_CALLBACK_ARGS) {
         goto out;
     }
 
+    /* a big message is queued as it is, instead of copying its text */
+    void* keep = msg->size >= IPC_MSG_KEEP_MIN ? msg : NULL;
+
     if (msg->seq) {
-        ret = add_sysv_msg(msgq, msgin->msgtype, size, msgin->msg, NULL);
+        ret = add_sysv_msg(msgq, msgin->msgtype, size, msgin->msg, &keep, NULL);
     } else {
         struct sysv_client src;
         src.port = port;
         src.vmid = msg->src;
         src.seq  = msg->seq;
-        ret      = add_sysv_msg(msgq, msgin->msgtype, size, msgin->msg, &src);
+        ret      = add_sysv_msg(msgq, msgin->msgtype, size, msgin->msg, &keep, &src);
     }
 
+    if (!ret && msg->size >= IPC_MSG_KEEP_MIN && !keep)
+        ret = KEEP_IPC_MSG;
+
 out:
     SAVE_PROFILE_INTERVAL(ipc_sysv_msgsnd_callback);
     return ret;
@@ -49,6 +49,10 @@ DEFINE_PROFILE_INTERVAL(checkpoint_destroy_map, checkpoint);
 
 DEFINE_PROFILE_OCCURENCE(checkpoint_count,      checkpoint);
 DEFINE_PROFILE_OCCURENCE(checkpoint_total_size, checkpoint);
+DEFINE_PROFILE_OCCURENCE(checkpoint_zero_pages, checkpoint);
+DEFINE_PROFILE_OCCURENCE(checkpoint_dup_pages,  checkpoint);
+DEFINE_PROFILE_OCCURENCE(checkpoint_lz4_pages,  checkpoint);
+DEFINE_PROFILE_OCCURENCE(checkpoint_chunks,     checkpoint);
 
 DEFINE_PROFILE_CATEGORY(resume, migrate);
 DEFINE_PROFILE_INTERVAL(child_created_in_new_process,  resume);
@@ -59,118 +63,148 @@ DEFINE_PROFILE_INTERVAL(child_load_checkpoint_by_gipc, resume);
 DEFINE_PROFILE_INTERVAL(child_load_memory_by_gipc,     resume);
 DEFINE_PROFILE_INTERVAL(child_load_checkpoint_on_pipe, resume);
 DEFINE_PROFILE_INTERVAL(child_receive_handles,         resume);
+DEFINE_PROFILE_INTERVAL(child_restore_postcopy,        resume);
 DEFINE_PROFILE_INTERVAL(restore_checkpoint,            resume);
 DEFINE_PROFILE_CATEGORY(resume_func,                   resume);
 DEFINE_PROFILE_INTERVAL(child_total_migration_time,    resume);
 
-#define CP_HASH_SIZE    256
-#define CP_HASH(addr) ((hashfunc((ptr_t)(addr))) & (CP_HASH_SIZE - 1))
+/*
+ * The map from the checkpointed objects to their offsets in the checkpoint is
+ * an open-addressing hash table with linear probing over a flat array, so a
+ * lookup touches one or two cache lines instead of walking a bucket list.
+ * The table stays at most half full: it starts at the size the previous
+ * checkpoint of this process needed (the checkpoint functions walk the
+ * objects only once, so that is the closest to a pre-pass we have), and
+ * doubles when it fills up.
+ */
+#define CP_MAP_MIN_SIZE     256
+#define CP_MAP_REHASH_BATCH 8
 
-typedef uint16_t FASTHASHTYPE;
+struct cp_map {
+    struct shim_cp_map_entry * entries;     /* free slots have addr == NULL */
+    size_t size, cnt;                       /* size is a power of 2 */
+    struct shim_cp_map_entry null_entry;    /* an entry of addr == NULL */
+    bool null_used;
+};
 
-#define CP_MAP_ENTRY_NUM 64
+/* entries of the last checkpoint, to size the map of the next one */
+static size_t last_cp_map_cnt;
 
-DEFINE_LIST(cp_map_entry);
-struct cp_map_entry
+static inline size_t cp_map_slot (void * addr, size_t size)
 {
-    LIST_TYPE(cp_map_entry) hlist;
-    struct shim_cp_map_entry entry;
-};
+    return hashfunc((ptr_t) addr) & (size - 1);
+}
 
-DEFINE_LISTP(cp_map_entry);
-struct cp_map {
-    struct cp_map_buffer {
-        struct cp_map_buffer * next;
-        int num, cnt;
-        struct cp_map_entry entries[0];
-    } * buffers;
-
-    struct hash_map {
-        LISTP_TYPE(cp_map_entry) head[CP_HASH_SIZE];
-    } map;
-};
+/* returns the entry of addr, or the free slot to insert it into */
+static inline struct shim_cp_map_entry *
+cp_map_probe (struct shim_cp_map_entry * entries, size_t size, size_t slot,
+              void * addr)
+{
+    while (entries[slot].addr && entries[slot].addr != addr)
+        slot = (slot + 1) & (size - 1);
+    return &entries[slot];
+}
 
 void * create_cp_map (void)
 {
-    void * data = malloc(sizeof(struct cp_map) + sizeof(struct cp_map_buffer) +
-                         sizeof(struct cp_map_entry) * CP_MAP_ENTRY_NUM);
-
-    if (!data)
+    struct cp_map * map = malloc(sizeof(struct cp_map));
+    if (!map)
         return NULL;
 
-    struct cp_map * map = (struct cp_map *) data;
-    struct cp_map_buffer * buffer =
-                    (struct cp_map_buffer *) (data + sizeof(struct cp_map));
+    size_t size = CP_MAP_MIN_SIZE;
+    while (size < last_cp_map_cnt * 2)
+        size <<= 1;
 
-    memset(map, 0, sizeof(*map));
-    map->buffers = buffer;
-    buffer->next = NULL;
-    buffer->num  = CP_MAP_ENTRY_NUM;
-    buffer->cnt  = 0;
+    map->entries = calloc(size, sizeof(struct shim_cp_map_entry));
+    if (!map->entries) {
+        free(map);
+        return NULL;
+    }
 
+    map->size      = size;
+    map->cnt       = 0;
+    map->null_used = false;
     return (void *) map;
 }
 
 void destroy_cp_map (void * map)
 {
     struct cp_map * m = (struct cp_map *) map;
-    struct cp_map_buffer * buffer = m->buffers, * next;
-
-    for (next = buffer ? buffer->next : NULL ;
-         buffer && next ;
-         buffer = next, next = next ? next->next : NULL)
-        free(buffer);
 
+    last_cp_map_cnt = m->cnt;
+    free(m->entries);
     free(m);
 }
 
-static inline
-struct cp_map_buffer * extend_cp_map (struct cp_map * map)
+/* Doubles the table. The entries are moved in batches: the new slots of a
+ * batch are prefetched before any of them is written, so the cache misses of
+ * the random writes overlap. */
+static int extend_cp_map (struct cp_map * map)
 {
-    struct cp_map_buffer * buffer =
-                malloc(sizeof(struct cp_map_buffer) +
-                       sizeof(struct cp_map_entry) * CP_MAP_ENTRY_NUM);
+    size_t size = map->size * 2;
+    struct shim_cp_map_entry * entries =
+                calloc(size, sizeof(struct shim_cp_map_entry));
 
-    if (!buffer)
-        return NULL;
+    if (!entries)
+        return -ENOMEM;
+
+    for (size_t i = 0 ; i < map->size ; i += CP_MAP_REHASH_BATCH) {
+        struct shim_cp_map_entry * batch = &map->entries[i];
+        size_t slots[CP_MAP_REHASH_BATCH];
 
-    buffer->next = map->buffers;
-    map->buffers = buffer;
-    buffer->num  = CP_MAP_ENTRY_NUM;
-    buffer->cnt  = 0;
+        for (int j = 0 ; j < CP_MAP_REHASH_BATCH ; j++)
+            if (batch[j].addr) {
+                slots[j] = cp_map_slot(batch[j].addr, size);
+                __builtin_prefetch(&entries[slots[j]], 1);
+            }
 
-    return buffer;
+        for (int j = 0 ; j < CP_MAP_REHASH_BATCH ; j++)
+            if (batch[j].addr)
+                *cp_map_probe(entries, size, slots[j], batch[j].addr) = batch[j];
+    }
+
+    free(map->entries);
+    map->entries = entries;
+    map->size    = size;
+    return 0;
 }
 
+/* The returned entry is valid until the next entry is created */
 struct shim_cp_map_entry *
 get_cp_map_entry (void * map, void * addr, bool create)
 {
     struct cp_map * m = (struct cp_map *) map;
 
-    FASTHASHTYPE hash = CP_HASH(addr);
-    LISTP_TYPE(cp_map_entry) * head = &m->map.head[hash];
-    struct cp_map_entry * tmp;
-    struct shim_cp_map_entry * e = NULL;
-
-    LISTP_FOR_EACH_ENTRY(tmp, head, hlist)
-        if (tmp->entry.addr == addr)
-            e = &tmp->entry;
-
-    if (create && !e) {
-        struct cp_map_buffer * buffer = m->buffers;
+    if (!addr) {
+        if (!m->null_used && !create)
+            return NULL;
+        if (!m->null_used) {
+            m->null_entry.addr = NULL;
+            m->null_entry.off  = 0;
+            m->null_used = true;
+        }
+        return &m->null_entry;
+    }
 
-        if (buffer->cnt == buffer->num)
-            buffer = extend_cp_map(m);
+    struct shim_cp_map_entry * e =
+                cp_map_probe(m->entries, m->size, cp_map_slot(addr, m->size), addr);
 
-        struct cp_map_entry *new = &buffer->entries[buffer->cnt++];
-        INIT_LIST_HEAD(new, hlist);
-        LISTP_ADD(new, head, hlist);
+    if (e->addr)
+        return e;
+    if (!create)
+        return NULL;
 
-        new->entry.addr = addr;
-        new->entry.off  = 0;
-        e = &new->entry;
+    if (m->cnt + 1 > m->size / 2) {
+        /* without memory to grow, fill the table up to one free slot */
+        if (extend_cp_map(m) == 0)
+            e = cp_map_probe(m->entries, m->size, cp_map_slot(addr, m->size), addr);
+        else if (m->cnt + 1 == m->size)
+            return NULL;
     }
 
+    e->addr = addr;
+    e->off  = 0;
+    m->cnt++;
     return e;
 }
 
@@ -221,8 +255,20 @@ BEGIN_RS_FUNC(palhdl)
 
     struct shim_palhdl_entry * ent = (void *) (base + GET_CP_FUNC_ENTRY());
 
-    if (ent->phandle && !ent->phandle && ent->uri) {
-        /* XXX: reopen the stream */
+    /* Handles are not sent along with a snapshot, but reopened here
+     * (see restore_from_snapshot()); only files and devices can be, the
+     * other end of pipes and sockets is gone */
+    const char * uri = ent->phandle && !*ent->phandle && ent->uri ?
+                       qstrgetstr(ent->uri) : NULL;
+
+    if (uri && (strstartswith_static(uri, "file:") ||
+                strstartswith_static(uri, "dev:"))) {
+        PAL_HANDLE hdl = DkStreamOpen(uri, PAL_ACCESS_RDWR, 0, 0, 0);
+        if (!hdl)
+            hdl = DkStreamOpen(uri, PAL_ACCESS_RDONLY, 0, 0, 0);
+        if (!hdl)
+            debug("failed reopening %s (ignored)\n", uri);
+        *ent->phandle = hdl;
     }
 }
 END_RS_FUNC(palhdl)
@@ -453,26 +499,802 @@ static int send_checkpoint_by_gipc (PAL_HANDLE gipc_store,
     gipc_sizes += cnt;
     nentries   -= cnt;
 
-    /* Chia-Che: sending an empty page can't ever be a smart idea.
-       we might rather fail here */
-    npages = DkPhysicalMemoryCommit(gipc_store, nentries, gipc_addrs,
-                                    gipc_sizes);
+    /* Chia-Che: sending an empty page can't ever be a smart idea.
+       we might rather fail here */
+    npages = DkPhysicalMemoryCommit(gipc_store, nentries, gipc_addrs,
+                                    gipc_sizes);
+
+    if (npages < total_pages) {
+        debug("gipc supposed to send %d pages, but only %d pages sent\n",
+              total_pages, npages);
+        return -ENOMEM;
+    }
+
+    ADD_PROFILE_OCCURENCE(migrate_send_gipc_pages, npages);
+    return 0;
+}
+
+/*
+ * Memory sent on the RPC stream is encoded page by page: all-zero pages are
+ * skipped, pages identical to one sent earlier (as told by two hashes of
+ * the bytes sent) are replaced by a reference to it, and (if sys.checkpoint.compress is set) the remaining pages are
+ * LZ4-compressed when that makes them smaller. Each record is decoded into
+ * the data area of the checkpoint, which follows the entries at
+ * mem_header.dataoffset, so the layout seen by restore_checkpoint() is the
+ * same as for raw memory. Records are batched into length-prefixed frames,
+ * so the receiver never reads past the memory into the handles sent next.
+ */
+enum {
+    CP_PAGE_RAW = 0,    /* followed by size bytes */
+    CP_PAGE_ZERO,       /* size bytes of zeros */
+    CP_PAGE_DUP,        /* copy of size bytes at offset ref in the data area */
+    CP_PAGE_LZ4,        /* followed by len bytes of LZ4 data */
+};
+
+struct cp_page_record {
+    unsigned int type;
+    unsigned int len;
+    unsigned long size;
+    unsigned long ref;
+};
+
+#define CP_STREAM_BUFSIZE   (64 * 1024)
+#define CP_DEDUP_HASH_LOG   14
+
+/* A page is only known by two hashes of the bytes sent for it: the memory
+ * it was read from may have changed, or be inaccessible again, since. */
+struct cp_dedup_slot {
+    bool used;
+    unsigned long hash, check;
+    unsigned long offset;
+};
+
+/* The first word of buf holds the length of the frame being written */
+struct cp_stream_buf {
+    PAL_HANDLE stream;
+    char * buf;
+    size_t start, end;
+};
+
+/*
+ * With sys.checkpoint.workers, helper threads encode the memory of a large
+ * checkpoint in chunks of CP_CHUNK_PAGES pages while the calling thread sends
+ * the chunks already encoded, and the new process copies the memory into
+ * place with as many helpers, in pieces of CP_COPY_SIZE bytes.
+ */
+#define CP_MAX_WORKERS      16
+#define CP_WORKERS_MIN_SIZE (8 * 1024 * 1024)
+#define CP_CHUNK_PAGES      256
+#define CP_COPY_SIZE        (1024 * 1024)
+
+static bool checkpoint_compress = false;
+static int checkpoint_workers = 0;
+static const char * snapshot_uri = NULL;
+
+int init_checkpoint (void)
+{
+    char cfg[CONFIG_MAX];
+    ssize_t len;
+
+    if (root_config &&
+        get_config(root_config, "sys.checkpoint.compress", cfg, CONFIG_MAX) > 0)
+        checkpoint_compress = parse_int(cfg) != 0;
+
+    if (root_config &&
+        get_config(root_config, "sys.checkpoint.workers", cfg, CONFIG_MAX) > 0) {
+        checkpoint_workers = parse_int(cfg);
+        if (checkpoint_workers < 0)
+            checkpoint_workers = 0;
+        if (checkpoint_workers > CP_MAX_WORKERS)
+            checkpoint_workers = CP_MAX_WORKERS;
+    }
+
+    if (root_config &&
+        (len = get_config(root_config, "sys.snapshot", cfg, CONFIG_MAX)) > 0) {
+        /* The snapshot file holds the memory of the enclave in the clear,
+         * and nothing verifies it when it is restored */
+        if (!strcmp_static(PAL_CB(host_type), "Linux-SGX"))
+            SYS_PRINTF("WARNING: sys.snapshot is not supported on Linux-SGX\n");
+        else
+            snapshot_uri = malloc_copy(cfg, len + 1);
+    }
+
+    return 0;
+}
+
+/*
+ * The helpers are plain PAL threads, not LibOS threads: a new process
+ * restores its checkpoint before its LibOS threads are initialized. So their
+ * jobs only compute and copy memory, and never allocate, lock or print. The
+ * helpers are started on the first use and then wait on their events for the
+ * next job. One job runs at a time; a checkpoint which finds the helpers
+ * busy (another thread forking) is done by the calling thread alone.
+ */
+static struct {
+    struct atomic_int busy;
+    struct atomic_int running;
+    int nthreads;
+    bool no_more_threads;
+    PAL_HANDLE start[CP_MAX_WORKERS];
+    PAL_HANDLE done;
+    void (*func) (void * arg);
+    void * arg;
+} cp_workers;
+
+static int cp_worker_thread (void * arg)
+{
+    PAL_HANDLE start = arg;
+
+    while (true) {
+        if (!DkObjectsWaitAny(1, &start, NO_TIMEOUT))
+            continue;
+
+        cp_workers.func(cp_workers.arg);
+
+        if (atomic_dec_and_test(&cp_workers.running))
+            DkEventSet(cp_workers.done);
+    }
+
+    return 0;
+}
+
+/* Claims the helpers, starting up to nworkers of them. Returns the number of
+   helpers, or 0 if there are none or they are busy. */
+static int get_cp_workers (int nworkers)
+{
+    if (nworkers <= 0 || atomic_cmpxchg(&cp_workers.busy, 0, 1) != 0)
+        return 0;
+
+    if (!cp_workers.done &&
+        !(cp_workers.done = DkSynchronizationEventCreate(PAL_FALSE)))
+        goto out;
+
+    /* a host may limit the threads of a process (e.g., sgx.thread_num) */
+    while (!cp_workers.no_more_threads &&
+           cp_workers.nthreads < MIN(nworkers, CP_MAX_WORKERS)) {
+        PAL_HANDLE start = DkSynchronizationEventCreate(PAL_FALSE);
+
+        if (!start || !DkThreadCreate(cp_worker_thread, start)) {
+            if (start)
+                DkObjectClose(start);
+            cp_workers.no_more_threads = true;
+            break;
+        }
+
+        cp_workers.start[cp_workers.nthreads++] = start;
+    }
+
+out:
+    if (!cp_workers.nthreads) {
+        atomic_set(&cp_workers.busy, 0);
+        return 0;
+    }
+
+    return cp_workers.nthreads;
+}
+
+static void release_cp_workers (void)
+{
+    atomic_set(&cp_workers.busy, 0);
+}
+
+/* Runs func(arg) on each of the claimed helpers */
+static void run_cp_workers (void (*func) (void * arg), void * arg)
+{
+    cp_workers.func = func;
+    cp_workers.arg  = arg;
+    atomic_set(&cp_workers.running, cp_workers.nthreads);
+
+    for (int i = 0 ; i < cp_workers.nthreads ; i++)
+        DkEventSet(cp_workers.start[i]);
+}
+
+/* Waits for the helpers to finish the job and releases them */
+static void wait_cp_workers (void)
+{
+    while (!DkObjectsWaitAny(1, &cp_workers.done, NO_TIMEOUT));
+    release_cp_workers();
+}
+
+static int write_stream (PAL_HANDLE stream, const void * buf, size_t size)
+{
+    size_t bytes = 0;
+
+    do {
+        size_t ret = DkStreamWrite(stream, 0, size - bytes,
+                                   (void *) buf + bytes, NULL);
+
+        if (!ret) {
+            if (PAL_ERRNO == EINTR || PAL_ERRNO == EAGAIN ||
+                PAL_ERRNO == EWOULDBLOCK)
+                continue;
+            return -PAL_ERRNO;
+        }
+
+        bytes += ret;
+    } while (bytes < size);
+
+    ADD_PROFILE_OCCURENCE(migrate_send_on_stream, size);
+    return 0;
+}
+
+static int flush_stream_buf (struct cp_stream_buf * sbuf)
+{
+    int ret = 0;
+
+    if (sbuf->end > sizeof(unsigned long)) {
+        *(unsigned long *) sbuf->buf = sbuf->end - sizeof(unsigned long);
+        ret = write_stream(sbuf->stream, sbuf->buf, sbuf->end);
+    }
+
+    sbuf->end = sizeof(unsigned long);
+    return ret;
+}
+
+static int append_stream_buf (struct cp_stream_buf * sbuf, const void * data,
+                              size_t size)
+{
+    int ret;
+
+    while (size) {
+        if (sbuf->end == CP_STREAM_BUFSIZE &&
+            (ret = flush_stream_buf(sbuf)) < 0)
+            return ret;
+
+        size_t bytes = MIN(size, CP_STREAM_BUFSIZE - sbuf->end);
+        memcpy(sbuf->buf + sbuf->end, data, bytes);
+        sbuf->end += bytes;
+        data += bytes;
+        size -= bytes;
+    }
+
+    return 0;
+}
+
+/* Returns true if the page is all zeros; otherwise stores two independent
+ * hashes of it, which together identify the page for deduplication. */
+static inline bool scan_page (const void * page, unsigned long * hash,
+                              unsigned long * check)
+{
+    const unsigned long * p = page;
+    const unsigned long * end = page + PAGE_SIZE;
+    unsigned long h = 0, c = 0, bits = 0;
+
+    for (; p < end ; p++) {
+        bits |= *p;
+        h = (h + *p) * 0x9e3779b97f4a7c15UL;
+        h ^= h >> 32;
+        c = (c ^ *p) * 0xc4ceb9fe1a85ec53UL;
+        c ^= c >> 29;
+    }
+
+    *hash = h;
+    *check = c;
+    return !bits;
+}
+
+static inline bool range_is_zero (const char * data, size_t size)
+{
+    for (size_t i = 0 ; i < size ; i++)
+        if (data[i])
+            return false;
+    return true;
+}
+
+/*
+ * Chooses the record of a page which is not all zeros: a copy of an earlier
+ * page in the dedup table (otherwise the page is added to the table), LZ4
+ * data written to lz4_buf if compressing, or the raw page. The page is the
+ * private copy which is sent, so the hashes describe what the receiver gets.
+ */
+static void encode_page (struct cp_dedup_slot * slots, const char * page,
+                         size_t psize, bool full, unsigned long hash,
+                         unsigned long check, unsigned long offset,
+                         void * lz4_buf, void * lz4_workspace,
+                         struct cp_page_record * rec)
+{
+    *rec = (struct cp_page_record) { .type = CP_PAGE_RAW, .size = psize };
+
+    if (full) {
+        struct cp_dedup_slot * slot =
+                &slots[hash & ((1 << CP_DEDUP_HASH_LOG) - 1)];
+
+        if (slot->used && slot->hash == hash && slot->check == check) {
+            rec->type = CP_PAGE_DUP;
+            rec->ref  = slot->offset;
+            ADD_PROFILE_OCCURENCE(checkpoint_dup_pages, 1);
+            return;
+        }
+
+        slot->used   = true;
+        slot->hash   = hash;
+        slot->check  = check;
+        slot->offset = offset;
+    }
+
+    if (checkpoint_compress) {
+        ssize_t len = lz4_compress(page, psize, lz4_buf, psize - 1,
+                                   lz4_workspace);
+        if (len > 0) {
+            rec->type = CP_PAGE_LZ4;
+            rec->len  = len;
+            ADD_PROFILE_OCCURENCE(checkpoint_lz4_pages, 1);
+        }
+    }
+}
+
+struct cp_encode_chunk {
+    int entry;              /* memory entry of the first page */
+    size_t pos;             /* position of the first page in the entry */
+    unsigned long offset;   /* offset of the first page in the data area */
+};
+
+struct cp_encode_slot {
+    PAL_HANDLE free, filled;
+    char * buf;
+    size_t len;
+};
+
+/*
+ * The helpers take the chunks in order, so the pages in the dedup table of a
+ * helper always precede the chunk it encodes, as the decoder requires. A
+ * chunk is encoded into the slot of its number modulo nslots once the chunk
+ * before it in the slot is sent.
+ */
+struct cp_encode_job {
+    struct shim_mem_entry ** mem_entries;
+    int mem_nentries;
+    struct cp_encode_chunk * chunks;
+    int nchunks;
+    struct cp_encode_slot * slots;
+    int nslots;
+    struct cp_dedup_slot * dedup[CP_MAX_WORKERS];
+    void * lz4_workspace[CP_MAX_WORKERS];
+    char * page_buf[CP_MAX_WORKERS];
+    struct atomic_int next_chunk;
+    struct atomic_int next_worker;
+    struct atomic_int failed;
+};
+
+#define CP_CHUNK_BUFSIZE \
+    (CP_CHUNK_PAGES * (2 * sizeof(struct cp_page_record) + PAGE_SIZE) + \
+     sizeof(struct cp_page_record))
+
+/* Encodes CP_CHUNK_PAGES pages from the start of the chunk into buf, in the
+   records which send_encoded_memory() sends. Returns the encoded size. */
+static size_t encode_memory_chunk (struct cp_encode_job * job,
+                                   struct cp_encode_chunk * chunk,
+                                   struct cp_dedup_slot * slots,
+                                   void * lz4_workspace, char * page_buf,
+                                   char * buf)
+{
+    struct cp_page_record rec;
+    unsigned long offset = chunk->offset;
+    size_t pos = chunk->pos, zero_size = 0, len = 0;
+    int npages = 0;
+
+    for (int i = chunk->entry ;
+         i < job->mem_nentries && npages < CP_CHUNK_PAGES ; i++, pos = 0) {
+        const char * addr = job->mem_entries[i]->addr;
+        size_t size = job->mem_entries[i]->size;
+
+        for (; pos < size && npages < CP_CHUNK_PAGES ; npages++) {
+            const char * page = page_buf;
+            size_t psize = MIN((size_t) PAGE_SIZE, size - pos);
+            unsigned long hash = 0, check = 0;
+            bool full = psize == PAGE_SIZE;
+
+            /* the page may change meanwhile: hash and send one copy of it */
+            memcpy(page_buf, addr + pos, psize);
+            bool zero = full ? scan_page(page, &hash, &check) :
+                        range_is_zero(page, psize);
+
+            pos += psize;
+
+            if (zero) {
+                zero_size += psize;
+                offset += psize;
+                ADD_PROFILE_OCCURENCE(checkpoint_zero_pages, 1);
+                continue;
+            }
+
+            if (zero_size) {
+                rec = (struct cp_page_record) {
+                    .type = CP_PAGE_ZERO, .size = zero_size };
+                memcpy(buf + len, &rec, sizeof(rec));
+                len += sizeof(rec);
+                zero_size = 0;
+            }
+
+            encode_page(slots, page, psize, full, hash, check, offset,
+                        buf + len + sizeof(rec), lz4_workspace, &rec);
+            memcpy(buf + len, &rec, sizeof(rec));
+            len += sizeof(rec);
+
+            if (rec.type == CP_PAGE_RAW) {
+                memcpy(buf + len, page, psize);
+                len += psize;
+            } else if (rec.type == CP_PAGE_LZ4) {
+                len += rec.len;
+            }
+
+            offset += psize;
+        }
+    }
+
+    if (zero_size) {
+        rec = (struct cp_page_record) {
+            .type = CP_PAGE_ZERO, .size = zero_size };
+        memcpy(buf + len, &rec, sizeof(rec));
+        len += sizeof(rec);
+    }
+
+    return len;
+}
+
+static void encode_memory_worker (void * arg)
+{
+    struct cp_encode_job * job = arg;
+    int worker = atomic_inc_return(&job->next_worker) - 1;
+    int c;
+
+    while ((c = atomic_inc_return(&job->next_chunk) - 1) < job->nchunks) {
+        struct cp_encode_slot * slot = &job->slots[c % job->nslots];
+
+        while (!DkObjectsWaitAny(1, &slot->free, NO_TIMEOUT));
+
+        slot->len = atomic_read(&job->failed) ? 0 :
+                    encode_memory_chunk(job, &job->chunks[c],
+                                        job->dedup[worker],
+                                        job->lz4_workspace[worker],
+                                        job->page_buf[worker], slot->buf);
+        DkEventSet(slot->filled);
+    }
+}
+
+/* Sends the memory encoded by nworkers claimed helpers, in the same records
+   as send_encoded_memory() */
+static int send_encoded_memory_by_workers (PAL_HANDLE stream,
+                                          struct shim_mem_entry ** mem_entries,
+                                          int mem_nentries, int nworkers)
+{
+    struct cp_stream_buf sbuf = { .stream = stream,
+                                  .end = sizeof(unsigned long) };
+    struct cp_encode_job job;
+    unsigned long npages = 0, offset = 0;
+    int ret = -ENOMEM;
+
+    memset(&job, 0, sizeof(job));
+    job.mem_entries  = mem_entries;
+    job.mem_nentries = mem_nentries;
+
+    for (int i = 0 ; i < mem_nentries ; i++)
+        npages += (mem_entries[i]->size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    job.nchunks = (npages + CP_CHUNK_PAGES - 1) / CP_CHUNK_PAGES;
+    job.nslots  = MIN(nworkers * 2, job.nchunks);
+
+    sbuf.buf   = malloc(CP_STREAM_BUFSIZE);
+    job.chunks = malloc(sizeof(struct cp_encode_chunk) * job.nchunks);
+    job.slots  = calloc(job.nslots, sizeof(struct cp_encode_slot));
+    if (!sbuf.buf || !job.chunks || !job.slots) {
+        release_cp_workers();
+        goto out;
+    }
+
+    for (int s = 0 ; s < job.nslots ; s++) {
+        struct cp_encode_slot * slot = &job.slots[s];
+        slot->buf    = malloc(CP_CHUNK_BUFSIZE);
+        slot->free   = DkSynchronizationEventCreate(PAL_TRUE);
+        slot->filled = DkSynchronizationEventCreate(PAL_FALSE);
+        if (!slot->buf || !slot->free || !slot->filled) {
+            release_cp_workers();
+            goto out;
+        }
+    }
+
+    for (int w = 0 ; w < nworkers ; w++) {
+        job.dedup[w] = calloc(1 << CP_DEDUP_HASH_LOG,
+                              sizeof(struct cp_dedup_slot));
+        job.page_buf[w] = malloc(PAGE_SIZE);
+        if (checkpoint_compress)
+            job.lz4_workspace[w] = malloc(LZ4_WORKSPACE_SIZE);
+        if (!job.dedup[w] || !job.page_buf[w] ||
+            (checkpoint_compress && !job.lz4_workspace[w])) {
+            release_cp_workers();
+            goto out;
+        }
+    }
+
+    /* A chunk starts every CP_CHUNK_PAGES pages, as the helpers step */
+    npages = 0;
+    for (int i = 0 ; i < mem_nentries ; i++) {
+        size_t size = mem_entries[i]->size;
+
+        for (size_t pos = 0 ; pos < size ; pos += PAGE_SIZE, npages++)
+            if (npages % CP_CHUNK_PAGES == 0)
+                job.chunks[npages / CP_CHUNK_PAGES] = (struct cp_encode_chunk) {
+                    .entry = i, .pos = pos, .offset = offset + pos };
+
+        offset += size;
+    }
+
+    ADD_PROFILE_OCCURENCE(checkpoint_chunks, job.nchunks);
+    run_cp_workers(encode_memory_worker, &job);
+
+    /* Send the chunks in order; after a failure, only let the helpers run
+       out of chunks */
+    ret = 0;
+    for (int c = 0 ; c < job.nchunks ; c++) {
+        struct cp_encode_slot * slot = &job.slots[c % job.nslots];
+
+        while (!DkObjectsWaitAny(1, &slot->filled, NO_TIMEOUT));
+
+        if (!ret && (ret = append_stream_buf(&sbuf, slot->buf, slot->len)) < 0)
+            atomic_set(&job.failed, 1);
+
+        DkEventSet(slot->free);
+    }
+
+    wait_cp_workers();
+
+    for (int i = 0 ; i < mem_nentries ; i++)
+        if (!(mem_entries[i]->prot & PAL_PROT_READ))
+            DkVirtualMemoryProtect(mem_entries[i]->addr, mem_entries[i]->size,
+                                   mem_entries[i]->prot);
+
+    if (!ret)
+        ret = flush_stream_buf(&sbuf);
+out:
+    if (job.slots)
+        for (int s = 0 ; s < job.nslots ; s++) {
+            free(job.slots[s].buf);
+            if (job.slots[s].free)
+                DkObjectClose(job.slots[s].free);
+            if (job.slots[s].filled)
+                DkObjectClose(job.slots[s].filled);
+        }
+    for (int w = 0 ; w < nworkers ; w++) {
+        free(job.dedup[w]);
+        free(job.page_buf[w]);
+        free(job.lz4_workspace[w]);
+    }
+    free(job.slots);
+    free(job.chunks);
+    free(sbuf.buf);
+    return ret;
+}
+
+static int send_encoded_memory (PAL_HANDLE stream,
+                                struct shim_mem_entry ** mem_entries,
+                                int mem_nentries, int nworkers)
+{
+    struct cp_stream_buf sbuf = { .stream = stream,
+                                  .end = sizeof(unsigned long) };
+    struct cp_dedup_slot * slots = NULL;
+    char * page_buf = NULL;
+    void * lz4_buf = NULL, * lz4_workspace = NULL;
+    struct cp_page_record rec;
+    unsigned long offset = 0;
+    size_t zero_size = 0;
+    int ret = -ENOMEM;
+
+    if ((nworkers = get_cp_workers(nworkers)))
+        return send_encoded_memory_by_workers(stream, mem_entries,
+                                              mem_nentries, nworkers);
+
+    sbuf.buf = malloc(CP_STREAM_BUFSIZE);
+    slots = calloc(1 << CP_DEDUP_HASH_LOG, sizeof(struct cp_dedup_slot));
+    page_buf = malloc(PAGE_SIZE);
+    if (!sbuf.buf || !slots || !page_buf)
+        goto out;
+
+    if (checkpoint_compress) {
+        lz4_buf = malloc(PAGE_SIZE);
+        lz4_workspace = malloc(LZ4_WORKSPACE_SIZE);
+        if (!lz4_buf || !lz4_workspace)
+            goto out;
+    }
+
+    for (int i = 0 ; i < mem_nentries ; i++) {
+        const char * addr = mem_entries[i]->addr;
+        size_t size = mem_entries[i]->size;
+
+        for (size_t pos = 0 ; pos < size ; ) {
+            const char * page = page_buf;
+            size_t psize = MIN((size_t) PAGE_SIZE, size - pos);
+            unsigned long hash = 0, check = 0;
+            bool full = psize == PAGE_SIZE;
+
+            /* the page may change meanwhile: hash and send one copy of it */
+            memcpy(page_buf, addr + pos, psize);
+            bool zero = full ? scan_page(page, &hash, &check) :
+                        range_is_zero(page, psize);
+
+            pos += psize;
+
+            /* Runs of zero pages are coalesced into one record */
+            if (zero) {
+                zero_size += psize;
+                offset += psize;
+                ADD_PROFILE_OCCURENCE(checkpoint_zero_pages, 1);
+                continue;
+            }
+
+            if (zero_size) {
+                rec = (struct cp_page_record) {
+                    .type = CP_PAGE_ZERO, .size = zero_size };
+                if ((ret = append_stream_buf(&sbuf, &rec, sizeof(rec))) < 0)
+                    goto out;
+                zero_size = 0;
+            }
+
+            encode_page(slots, page, psize, full, hash, check, offset,
+                        lz4_buf, lz4_workspace, &rec);
+
+            if ((ret = append_stream_buf(&sbuf, &rec, sizeof(rec))) < 0)
+                goto out;
+
+            if (rec.type == CP_PAGE_RAW)
+                ret = append_stream_buf(&sbuf, page, psize);
+            else if (rec.type == CP_PAGE_LZ4)
+                ret = append_stream_buf(&sbuf, lz4_buf, rec.len);
+            if (ret < 0)
+                goto out;
+
+            offset += psize;
+        }
+
+        if (!(mem_entries[i]->prot & PAL_PROT_READ))
+            DkVirtualMemoryProtect((void *) addr, size, mem_entries[i]->prot);
+    }
+
+    if (zero_size) {
+        rec = (struct cp_page_record) {
+            .type = CP_PAGE_ZERO, .size = zero_size };
+        if ((ret = append_stream_buf(&sbuf, &rec, sizeof(rec))) < 0)
+            goto out;
+    }
+
+    ret = flush_stream_buf(&sbuf);
+out:
+    free(sbuf.buf);
+    free(slots);
+    free(page_buf);
+    free(lz4_buf);
+    free(lz4_workspace);
+    return ret;
+}
+
+static int read_stream (PAL_HANDLE stream, void * buf, size_t size)
+{
+    size_t bytes = 0;
+
+    while (bytes < size) {
+        size_t ret = DkStreamRead(stream, 0, size - bytes, buf + bytes,
+                                  NULL, 0);
+
+        if (!ret) {
+            if (PAL_ERRNO == EINTR || PAL_ERRNO == EAGAIN ||
+                PAL_ERRNO == EWOULDBLOCK)
+                continue;
+            return -PAL_ERRNO;
+        }
+
+        bytes += ret;
+    }
+
+    return 0;
+}
+
+static int consume_stream_buf (struct cp_stream_buf * sbuf, void * data,
+                               size_t size)
+{
+    int ret;
+
+    while (size) {
+        if (sbuf->start == sbuf->end) {
+            unsigned long frame_size;
+
+            if ((ret = read_stream(sbuf->stream, &frame_size,
+                                   sizeof(frame_size))) < 0)
+                return ret;
+            if (!frame_size || frame_size > CP_STREAM_BUFSIZE)
+                return -EINVAL;
+            if ((ret = read_stream(sbuf->stream, sbuf->buf, frame_size)) < 0)
+                return ret;
+
+            sbuf->start = 0;
+            sbuf->end = frame_size;
+        }
+
+        size_t bytes = MIN(size, sbuf->end - sbuf->start);
+        memcpy(data, sbuf->buf + sbuf->start, bytes);
+        sbuf->start += bytes;
+        data += bytes;
+        size -= bytes;
+    }
+
+    return 0;
+}
+
+/*
+ * Decode the memory records into the data area of the checkpoint. The area
+ * is freshly mapped, so zero pages need no work.
+ */
+static int receive_encoded_memory (PAL_HANDLE stream, void * data,
+                                   size_t data_size)
+{
+    struct cp_stream_buf sbuf = { .stream = stream };
+    void * lz4_buf = NULL;
+    struct cp_page_record rec;
+    size_t offset = 0;
+    int ret = -ENOMEM;
+
+    sbuf.buf = malloc(CP_STREAM_BUFSIZE);
+    lz4_buf = malloc(PAGE_SIZE);
+    if (!sbuf.buf || !lz4_buf)
+        goto out;
+
+    while (offset < data_size) {
+        if ((ret = consume_stream_buf(&sbuf, &rec, sizeof(rec))) < 0)
+            goto out;
+
+        ret = -EINVAL;
+        if (rec.size > data_size - offset)
+            goto out;
+
+        switch (rec.type) {
+            case CP_PAGE_RAW:
+                ret = consume_stream_buf(&sbuf, data + offset, rec.size);
+                break;
+
+            case CP_PAGE_ZERO:
+                ret = 0;
+                break;
+
+            case CP_PAGE_DUP:
+                if (rec.ref > offset || rec.size > offset - rec.ref)
+                    goto out;
+                memcpy(data + offset, data + rec.ref, rec.size);
+                ret = 0;
+                break;
+
+            case CP_PAGE_LZ4:
+                if (rec.len > PAGE_SIZE)
+                    goto out;
+                if ((ret = consume_stream_buf(&sbuf, lz4_buf, rec.len)) < 0)
+                    goto out;
+                if (lz4_decompress(lz4_buf, rec.len, data + offset, rec.size)
+                    != (ssize_t) rec.size)
+                    ret = -EINVAL;
+                break;
+
+            default:
+                break;
+        }
+
+        if (ret < 0)
+            goto out;
 
-    if (npages < total_pages) {
-        debug("gipc supposed to send %d pages, but only %d pages sent\n",
-              total_pages, npages);
-        return -ENOMEM;
+        offset += rec.size;
     }
 
-    ADD_PROFILE_OCCURENCE(migrate_send_gipc_pages, npages);
-    return 0;
+    /* The parent stops writing after the last record */
+    ret = sbuf.start == sbuf.end ? 0 : -EINVAL;
+out:
+    free(sbuf.buf);
+    free(lz4_buf);
+    return ret;
 }
 
 static int send_checkpoint_on_stream (PAL_HANDLE stream,
-                                      struct shim_cp_store * store)
+                                      struct shim_cp_store * store,
+                                      bool encoded, int nworkers)
 {
     int mem_nentries = store->mem_nentries;
     struct shim_mem_entry ** mem_entries;
+    int ret;
 
     if (mem_nentries) {
         mem_entries = __alloca(sizeof(struct shim_mem_entry *) * mem_nentries);
@@ -496,52 +1318,29 @@ static int send_checkpoint_on_stream (PAL_HANDLE stream,
         }
     }
 
-    size_t total_bytes = store->offset;
-    size_t bytes = 0;
-
-    do {
-        size_t ret = DkStreamWrite(stream, 0, total_bytes - bytes,
-                                   (void *) store->base + bytes, NULL);
-
-        if (!ret) {
-            if (PAL_ERRNO == EINTR || PAL_ERRNO == EAGAIN ||
-                PAL_ERRNO == EWOULDBLOCK)
-                continue;
-            return -PAL_ERRNO;
-        }
+    if ((ret = write_stream(stream, (void *) store->base, store->offset)) < 0)
+        return ret;
 
-        bytes += ret;
-    } while (bytes < total_bytes);
+    if (!mem_nentries)
+        return 0;
 
-    ADD_PROFILE_OCCURENCE(migrate_send_on_stream, total_bytes);
+    if (encoded)
+        return send_encoded_memory(stream, mem_entries, mem_nentries,
+                                   nworkers);
 
     for (int i = 0 ; i < mem_nentries ; i++) {
         size_t mem_size = mem_entries[i]->size;
         void * mem_addr = mem_entries[i]->addr;
-        bytes = 0;
-        do {
-            size_t ret = DkStreamWrite(stream, 0, mem_size - bytes,
-                                       mem_addr + bytes, NULL);
-            if (!ret) {
-                if (PAL_ERRNO == EINTR || PAL_ERRNO == EAGAIN ||
-                    PAL_ERRNO == EWOULDBLOCK)
-                    continue;
-                return -PAL_ERRNO;
-            }
 
-            bytes += ret;
-        } while (bytes < mem_entries[i]->size);
+        if ((ret = write_stream(stream, mem_addr, mem_size)) < 0)
+            return ret;
 
         if (!(mem_entries[i]->prot & PAL_PROT_READ))
             DkVirtualMemoryProtect(mem_addr, mem_size, mem_entries[i]->prot);
-
-        mem_entries[i]->size = mem_size;
-        ADD_PROFILE_OCCURENCE(migrate_send_on_stream, mem_size);
     }
 
     return 0;
- }
-
+}
 
 static int restore_gipc (PAL_HANDLE gipc, struct gipc_header * hdr, ptr_t base,
                          long rebase)
@@ -591,6 +1390,75 @@ static int restore_gipc (PAL_HANDLE gipc, struct gipc_header * hdr, ptr_t base,
     return 0;
 }
 
+struct cp_copy_piece {
+    void * dest;
+    const void * src;
+    size_t size;
+};
+
+struct cp_copy_job {
+    struct cp_copy_piece * pieces;
+    int npieces;
+    struct atomic_int next_piece;
+};
+
+static void copy_memory_worker (void * arg)
+{
+    struct cp_copy_job * job = arg;
+    int p;
+
+    while ((p = atomic_inc_return(&job->next_piece) - 1) < job->npieces)
+        memcpy(job->pieces[p].dest, job->pieces[p].src, job->pieces[p].size);
+}
+
+/* Copies the memory of the entries into place with up to nworkers helpers
+   and the current thread, then protects the entries which are not writable.
+   The helpers start after the entries are allocated, so that their stacks
+   cannot take the addresses of the entries. */
+static void copy_memory_by_workers (struct shim_mem_entry ** entries,
+                                    int nentries, int nworkers)
+{
+    struct cp_copy_job job;
+    memset(&job, 0, sizeof(job));
+
+    for (int i = 0 ; i < nentries ; i++)
+        job.npieces += (entries[i]->size + CP_COPY_SIZE - 1) / CP_COPY_SIZE;
+
+    if (get_cp_workers(nworkers) &&
+        !(job.pieces = malloc(sizeof(struct cp_copy_piece) * job.npieces)))
+        release_cp_workers();
+
+    if (job.pieces) {
+        int p = 0;
+        for (int i = 0 ; i < nentries ; i++)
+            for (size_t pos = 0 ; pos < entries[i]->size ; pos += CP_COPY_SIZE)
+                job.pieces[p++] = (struct cp_copy_piece) {
+                    .dest = entries[i]->addr + pos,
+                    .src  = entries[i]->data + pos,
+                    .size = MIN(entries[i]->size - pos, (size_t) CP_COPY_SIZE),
+                };
+
+        run_cp_workers(copy_memory_worker, &job);
+        copy_memory_worker(&job);
+        wait_cp_workers();
+        free(job.pieces);
+    } else {
+        for (int i = 0 ; i < nentries ; i++)
+            memcpy(entries[i]->addr, entries[i]->data, entries[i]->size);
+    }
+
+    for (int i = 0 ; i < nentries ; i++) {
+        if (entries[i]->prot & PAL_PROT_WRITE)
+            continue;
+
+        PAL_PTR addr = PAGE_ALIGN_DOWN_PTR(entries[i]->addr);
+        PAL_NUM size = PAGE_ALIGN_UP_PTR(entries[i]->addr + entries[i]->size) - (void*)addr;
+
+        if (!DkVirtualMemoryProtect(addr, size, entries[i]->prot))
+            debug("failed protecting %p-%p (ignored)\n", addr, addr + size);
+    }
+}
+
 int restore_checkpoint (struct cp_header * cphdr, struct mem_header * memhdr,
                         ptr_t base, ptr_t type)
 {
@@ -610,6 +1478,14 @@ int restore_checkpoint (struct cp_header * cphdr, struct mem_header * memhdr,
         struct shim_mem_entry * entry =
                     (void *) (base + memhdr->entoffset);
 
+        /* With helpers, the entries are allocated here and copied at once */
+        struct shim_mem_entry ** copy_entries = NULL;
+        int copy_nentries = 0;
+
+        if (memhdr->workers)
+            copy_entries = malloc(sizeof(struct shim_mem_entry *) *
+                                  memhdr->nentries);
+
         for (; entry ; entry = entry->prev) {
             CP_REBASE(entry->prev);
             CP_REBASE(entry->paddr);
@@ -626,10 +1502,18 @@ int restore_checkpoint (struct cp_header * cphdr, struct mem_header * memhdr,
 
                 if (!DkVirtualMemoryAlloc(addr, size, 0, prot|PAL_PROT_WRITE)) {
                     debug("failed allocating %p-%p\n", addr, addr + size);
-                    return -PAL_ERRNO;
+                    ret = -PAL_ERRNO;
+                    free(copy_entries);
+                    return ret;
                 }
 
                 CP_REBASE(entry->data);
+
+                if (copy_entries && copy_nentries < memhdr->nentries) {
+                    copy_entries[copy_nentries++] = entry;
+                    continue;
+                }
+
                 memcpy(entry->addr, entry->data, entry->size);
 
                 if (!(entry->prot & PAL_PROT_WRITE) &&
@@ -638,6 +1522,12 @@ int restore_checkpoint (struct cp_header * cphdr, struct mem_header * memhdr,
                 }
             }
         }
+
+        if (copy_entries) {
+            copy_memory_by_workers(copy_entries, copy_nentries,
+                                   memhdr->workers);
+            free(copy_entries);
+        }
     }
 
     struct shim_cp_entry * cpent = NEXT_CP_ENTRY();
@@ -891,6 +1781,26 @@ static void * cp_alloc (struct shim_cp_store * store, void * addr, size_t size)
     return addr;
 }
 
+static bool init_cp_store (struct shim_cp_store * store)
+{
+    store->alloc = cp_alloc;
+    store->bound = CP_INIT_VMA_SIZE;
+
+    while (1) {
+        /*
+         * Try allocating a space of a certain size. If the allocation fails,
+         * continue to try with smaller sizes.
+         */
+        store->base = (ptr_t) cp_alloc(store, 0, store->bound);
+        if (store->base)
+            return true;
+
+        store->bound >>= 1;
+        if (store->bound < g_pal_alloc_align)
+            return false;
+    }
+}
+
 DEFINE_PROFILE_CATEGORY(migrate_proc, migrate);
 DEFINE_PROFILE_INTERVAL(migrate_create_process,   migrate_proc);
 DEFINE_PROFILE_INTERVAL(migrate_create_gipc,      migrate_proc);
@@ -931,8 +1841,12 @@ int do_migrate_process (int (*migrate) (struct shim_cp_store *,
     struct newproc_header hdr;
     size_t bytes;
     PAL_HANDLE gipc_hdl = NULL;
+    bool use_postcopy = false;
     memset(&hdr, 0, sizeof(hdr));
 
+    /* Memory still owned by our own parent has to be pulled in first */
+    postcopy_fetch_all();
+
 #ifdef PROFILE
     unsigned long begin_create_time = GET_PROFILE_INTERVAL();
     unsigned long create_time = begin_create_time;
@@ -943,10 +1857,14 @@ int do_migrate_process (int (*migrate) (struct shim_cp_store *,
      * Create the process first. The new process requires some time
      * to initialize before starting to receive checkpoint data.
      * Parallizing the process creation and checkpointing can improve
-     * the latency of forking.
+     * the latency of forking. A fork can skip this entirely by claiming
+     * an idle process from the pool (see shim_procpool.c).
      */
-    PAL_HANDLE proc = DkProcessCreate(exec ? qstrgetstr(&exec->uri) :
-                                      pal_control.executable, argv);
+    PAL_HANDLE proc = (!exec && !argv) ? get_pooled_process() : NULL;
+    bool pooled = proc != NULL;
+    if (!proc)
+        proc = DkProcessCreate(exec ? qstrgetstr(&exec->uri) :
+                               pal_control.executable, argv);
 
     if (!proc) {
         ret = -PAL_ERRNO;
@@ -990,30 +1908,28 @@ int do_migrate_process (int (*migrate) (struct shim_cp_store *,
     /* Allocate a space for dumping the checkpoint data. */
     struct shim_cp_store cpstore;
     memset(&cpstore, 0, sizeof(cpstore));
-    cpstore.alloc    = cp_alloc;
     cpstore.use_gipc = use_gipc;
-    cpstore.bound    = CP_INIT_VMA_SIZE;
-
-    while (1) {
-        /*
-         * Try allocating a space of a certain size. If the allocation fails,
-         * continue to try with smaller sizes.
-         */
-        cpstore.base = (ptr_t) cp_alloc(&cpstore, 0, cpstore.bound);
-        if (cpstore.base)
-            break;
+    cpstore.share_memory = true;
 
-        cpstore.bound >>= 1;
-        if (cpstore.bound < g_pal_alloc_align)
-            break;
-    }
-
-    if (!cpstore.base) {
+    if (!init_cp_store(&cpstore)) {
         ret = -ENOMEM;
         debug("failed creating checkpoint store\n");
         goto out;
     }
 
+    /*
+     * Large anonymous memory of a forked child can be transferred lazily,
+     * after the child starts running (see shim_postcopy.c).
+     */
+    if (!exec && !use_gipc) {
+        ret = postcopy_prepare_server(&cpstore, hdr.checkpoint.postcopy.uri,
+                                      sizeof(hdr.checkpoint.postcopy.uri));
+        if (ret < 0)
+            debug("post-copy not available (ret = %d)\n", ret);
+        use_postcopy = cpstore.use_postcopy;
+        ret = 0;
+    }
+
     SAVE_PROFILE_INTERVAL(migrate_init_checkpoint);
 
     /* Calling the migration function defined by caller. The thread argument
@@ -1027,6 +1943,11 @@ int do_migrate_process (int (*migrate) (struct shim_cp_store *,
         goto out;
     }
 
+    if ((ret = postcopy_start_server(&cpstore)) < 0) {
+        debug("failed starting post-copy page server (ret = %d)\n", ret);
+        goto out;
+    }
+
     SAVE_PROFILE_INTERVAL(migrate_save_checkpoint);
 
     unsigned long checkpoint_time = GET_PROFILE_INTERVAL();
@@ -1043,6 +1964,10 @@ int do_migrate_process (int (*migrate) (struct shim_cp_store *,
         hdr.checkpoint.mem.entoffset =
                     (ptr_t) cpstore.last_mem_entry - cpstore.base;
         hdr.checkpoint.mem.nentries  = cpstore.mem_nentries;
+        hdr.checkpoint.mem.dataoffset = cpstore.offset;
+        hdr.checkpoint.mem.encoded = !cpstore.use_gipc;
+        if (cpstore.mem_size >= CP_WORKERS_MIN_SIZE)
+            hdr.checkpoint.mem.workers = checkpoint_workers;
     }
 
     if (cpstore.use_gipc) {
@@ -1062,6 +1987,14 @@ int do_migrate_process (int (*migrate) (struct shim_cp_store *,
         hdr.checkpoint.palhdl.nentries  = cpstore.palhdl_nentries;
     }
 
+    if (cpstore.use_postcopy) {
+        hdr.checkpoint.postcopy.entoffset =
+                    (ptr_t) cpstore.last_postcopy_entry - cpstore.base;
+        hdr.checkpoint.postcopy.nentries  = cpstore.postcopy_nentries;
+    } else {
+        hdr.checkpoint.postcopy.uri[0] = 0;
+    }
+
 #ifdef PROFILE
     hdr.begin_create_time  = begin_create_time;
     hdr.create_time = create_time;
@@ -1073,6 +2006,21 @@ int do_migrate_process (int (*migrate) (struct shim_cp_store *,
      * notify the process to start receiving the checkpoint.
      */
     bytes = DkStreamWrite(proc, 0, sizeof(struct newproc_header), &hdr, NULL);
+
+    /* The process from the pool may have died since it was checked; nothing
+     * was sent to it yet, so send the checkpoint to a new process instead */
+    if (!bytes && pooled) {
+        debug("process from the pool is gone, creating a new one\n");
+        DkObjectClose(proc);
+        pooled = false;
+        if (!(proc = DkProcessCreate(pal_control.executable, NULL))) {
+            ret = -PAL_ERRNO;
+            goto out;
+        }
+        bytes = DkStreamWrite(proc, 0, sizeof(struct newproc_header), &hdr,
+                              NULL);
+    }
+
     if (!bytes) {
         ret = -PAL_ERRNO;
         debug("failed writing to process stream (ret = %d)\n", ret);
@@ -1087,7 +2035,9 @@ int do_migrate_process (int (*migrate) (struct shim_cp_store *,
 
     /* Sending the checkpoint either through GIPC or the RPC stream */
     ret = cpstore.use_gipc ? send_checkpoint_by_gipc(gipc_hdl, &cpstore) :
-          send_checkpoint_on_stream(proc, &cpstore);
+          send_checkpoint_on_stream(proc, &cpstore,
+                                    hdr.checkpoint.mem.encoded,
+                                    hdr.checkpoint.mem.workers);
 
     if (ret < 0) {
         debug("failed sending checkpoint (ret = %d)\n", ret);
@@ -1127,14 +2077,19 @@ int do_migrate_process (int (*migrate) (struct shim_cp_store *,
 
     SAVE_PROFILE_INTERVAL(migrate_wait_response);
 
+    if (use_postcopy)
+        postcopy_child_restored();
+
     /* exec != NULL implies the execve case so the new process "replaces"
      * this current process: no need to notify the leader or establish IPC */
     if (!exec) {
         /* fork/clone case: new process is an actual child process for this
          * current process, so notify the leader regarding subleasing of TID
-         * (child must create self-pipe with convention of pipe:child-vmid) */
+         * (child must create self-pipe with convention of <type>:child-vmid,
+         * see ipc_pipe_type()) */
         char new_process_self_uri[256];
-        snprintf(new_process_self_uri, sizeof(new_process_self_uri), "pipe:%u", res.child_vmid);
+        snprintf(new_process_self_uri, sizeof(new_process_self_uri), "%s:%u", ipc_pipe_type(),
+                 res.child_vmid);
         ipc_pid_sublease_send(res.child_vmid, thread->tid, new_process_self_uri, NULL);
 
         /* listen on the new IPC port to the new child process */
@@ -1149,6 +2104,10 @@ int do_migrate_process (int (*migrate) (struct shim_cp_store *,
      * die right after this anyway) */
     thread->vmid = res.child_vmid;
 
+    /* Replace the process taken from the pool (or warm up the pool) */
+    if (!exec)
+        refill_procpool();
+
     ret = 0;
 out:
     if (gipc_hdl)
@@ -1157,6 +2116,8 @@ out:
         free_process(new_process);
 
     if (ret < 0) {
+        if (use_postcopy)
+            postcopy_abort_server();
         if (proc)
             DkObjectClose(proc);
         SYS_PRINTF("process creation failed\n");
@@ -1165,6 +2126,311 @@ out:
     return ret;
 }
 
+/*
+ * Snapshots: the checkpoint of an initialized process saved in a file, from
+ * which new instances of the application start instead of initializing
+ * themselves again (see sys.snapshot in the manifest). The file starts with
+ * a page of header, followed by the checkpoint data and then the memory of
+ * each entry, which starts on a page boundary so that it can be mapped from
+ * the file directly at the address it is restored to.
+ */
+#define SNAPSHOT_MAGIC      "GRSNAP01"
+
+struct snapshot_header {
+    char magic[8];
+    /* the LibOS of the new instance must be loaded at the same address */
+    void * load_address;
+    struct newproc_cp_header checkpoint;
+};
+
+static int write_file (PAL_HANDLE file, unsigned long offset,
+                       const void * buf, size_t size)
+{
+    size_t bytes = 0;
+
+    while (bytes < size) {
+        size_t ret = DkStreamWrite(file, offset + bytes, size - bytes,
+                                   (void *) buf + bytes, NULL);
+
+        if (!ret) {
+            if (PAL_ERRNO == EINTR || PAL_ERRNO == EAGAIN ||
+                PAL_ERRNO == EWOULDBLOCK)
+                continue;
+            return -PAL_ERRNO;
+        }
+
+        bytes += ret;
+    }
+
+    return 0;
+}
+
+/*
+ * Save the states of the process in the snapshot file given by sys.snapshot.
+ *
+ * @migrate: migration function defined by the caller
+ * @thread: thread to be resumed when the snapshot is restored
+ *
+ * The snapshot is restored as a new process with no parent, so the process
+ * it is taken from is not checkpointed; the remaining arguments are passed
+ * into the migration function.
+ */
+int do_snapshot_process (int (*migrate) (struct shim_cp_store *,
+                                         struct shim_thread *,
+                                         struct shim_process *, va_list),
+                         struct shim_thread * thread, ...)
+{
+    struct snapshot_header hdr;
+    struct shim_process new_process;
+    struct shim_cp_store cpstore;
+    int ret;
+
+    if (!snapshot_uri)
+        return -EINVAL;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memset(&new_process, 0, sizeof(new_process));
+    memset(&cpstore, 0, sizeof(cpstore));
+
+    /* The restored process takes the state of this one, but not its
+     * identity: like a forked process it gets a new vmid (vmid 0), and it
+     * has no parent and leads its own namespaces, since the IPC ports of
+     * this run are gone by the time it starts */
+    lock(&cur_process.lock);
+    memcpy(&new_process, &cur_process, sizeof(new_process));
+    unlock(&cur_process.lock);
+    new_process.vmid   = 0;
+    new_process.self   = NULL;
+    new_process.parent = NULL;
+    memset(new_process.ns, 0, sizeof(new_process.ns));
+
+    PAL_HANDLE file = DkStreamOpen(snapshot_uri, PAL_ACCESS_RDWR,
+                                   PAL_SHARE_OWNER_R|PAL_SHARE_OWNER_W,
+                                   PAL_CREATE_TRY, 0);
+    if (!file)
+        return -PAL_ERRNO;
+
+    /* A snapshot being overwritten must not be restored any more */
+    if ((ret = write_file(file, 0, &hdr, sizeof(hdr))) < 0) {
+        DkObjectClose(file);
+        return ret;
+    }
+
+    /* The memory in the snapshot must not be left behind in our parent */
+    postcopy_fetch_all();
+
+    if (!init_cp_store(&cpstore)) {
+        debug("failed creating checkpoint store\n");
+        DkObjectClose(file);
+        return -ENOMEM;
+    }
+
+    va_list ap;
+    va_start(ap, thread);
+    ret = (*migrate) (&cpstore, thread, &new_process, ap);
+    va_end(ap);
+    if (ret < 0) {
+        debug("failed creating checkpoint (ret = %d)\n", ret);
+        goto out;
+    }
+
+    int mem_nentries = cpstore.mem_nentries;
+    struct shim_mem_entry ** mem_entries =
+            __alloca(sizeof(struct shim_mem_entry *) * mem_nentries);
+    struct shim_mem_entry * mem_ent = cpstore.last_mem_entry;
+
+    for (int cnt = mem_nentries ; mem_ent ; mem_ent = mem_ent->prev) {
+        if (!cnt) {
+            ret = -EINVAL;
+            goto out;
+        }
+        mem_entries[--cnt] = mem_ent;
+    }
+
+    /* The data pointers are set as if the file after the header were mapped
+     * at the base of the checkpoint */
+    unsigned long dataoffset = PAGE_ALIGN_UP(cpstore.offset);
+    unsigned long size = dataoffset;
+
+    for (int i = 0 ; i < mem_nentries ; i++) {
+        mem_entries[i]->data = (void *) cpstore.base + size;
+        size += PAGE_ALIGN_UP(mem_entries[i]->size);
+    }
+
+    memcpy(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic));
+    hdr.load_address = &__load_address;
+    hdr.checkpoint.hdr.addr = (void *) cpstore.base;
+    hdr.checkpoint.hdr.size = size;
+
+    if (mem_nentries) {
+        hdr.checkpoint.mem.entoffset =
+                    (ptr_t) cpstore.last_mem_entry - cpstore.base;
+        hdr.checkpoint.mem.nentries  = mem_nentries;
+        hdr.checkpoint.mem.dataoffset = dataoffset;
+    }
+
+    if (cpstore.palhdl_nentries) {
+        hdr.checkpoint.palhdl.entoffset =
+                    (ptr_t) cpstore.last_palhdl_entry - cpstore.base;
+        hdr.checkpoint.palhdl.nentries  = cpstore.palhdl_nentries;
+    }
+
+    debug("snapshot of %lu bytes created\n", size);
+
+    if ((ret = write_file(file, PAGE_SIZE, (void *) cpstore.base,
+                          cpstore.offset)) < 0)
+        goto out;
+
+    for (int i = 0 ; i < mem_nentries ; i++) {
+        void * mem_addr = mem_entries[i]->addr;
+        size_t mem_size = mem_entries[i]->size;
+        unsigned long offset = PAGE_SIZE +
+                               (mem_entries[i]->data - (void *) cpstore.base);
+
+        ret = write_file(file, offset, mem_addr, mem_size);
+
+        if (!(mem_entries[i]->prot & PAL_PROT_READ))
+            DkVirtualMemoryProtect(mem_addr, mem_size, mem_entries[i]->prot);
+
+        if (ret < 0)
+            goto out;
+    }
+
+    /* The file is mapped to the end of the last page of memory */
+    PAL_NUM err = DkStreamSetLength(file, PAGE_SIZE + size);
+    if (err) {
+        ret = -err;
+        goto out;
+    }
+
+    /* The header goes last, so that a partial snapshot is never restored */
+
+    ret = write_file(file, 0, &hdr, sizeof(hdr));
+out:
+    bkeep_munmap((void *) cpstore.base, cpstore.bound, CP_VMA_FLAGS);
+    DkVirtualMemoryFree((PAL_PTR) cpstore.base, cpstore.bound);
+    DkObjectClose(file);
+    return ret;
+}
+
+/*
+ * Load a snapshot file created by do_snapshot_process(). The checkpoint is
+ * mapped copy-on-write from the file, and so is the memory that can be
+ * mapped in place; restore_checkpoint() copies the rest. Returns -ENOENT if
+ * the file holds no snapshot that can be restored, which is always the case
+ * on Linux-SGX: the file is neither encrypted nor verified.
+ *
+ * @file: PAL handle of the snapshot file
+ * @hdr: returning the checkpoint header
+ * @cpptr: returning the pointer of the loaded checkpoint
+ */
+int restore_from_snapshot (PAL_HANDLE file, struct newproc_cp_header * hdr,
+                           void ** cpptr)
+{
+    struct snapshot_header shdr;
+    PAL_FLG pal_prot = PAL_PROT_READ|PAL_PROT_WRITE|PAL_PROT_WRITECOPY;
+    void * base = NULL;
+
+    if (!strcmp_static(PAL_CB(host_type), "Linux-SGX"))
+        return -ENOENT;
+
+    if (DkStreamRead(file, 0, sizeof(shdr), &shdr, NULL, 0) != sizeof(shdr) ||
+        memcmp(shdr.magic, SNAPSHOT_MAGIC, sizeof(shdr.magic)))
+        return -ENOENT;
+
+    if (shdr.load_address != &__load_address) {
+        SYS_PRINTF("WARNING: snapshot ignored, it was taken with the library OS "
+                   "loaded at %p, not %p\n", shdr.load_address, &__load_address);
+        return -ENOENT;
+    }
+
+    *hdr = shdr.checkpoint;
+    size_t size = hdr->hdr.size;
+
+    if (lookup_overlap_vma(hdr->hdr.addr, size, NULL) == -ENOENT &&
+        bkeep_mmap(hdr->hdr.addr, size, PROT_READ|PROT_WRITE, CP_VMA_FLAGS,
+                   NULL, 0, "cpstore") == 0)
+        base = hdr->hdr.addr;
+
+    if (!base) {
+        base = bkeep_unmapped_any(size, PROT_READ|PROT_WRITE, CP_VMA_FLAGS, 0,
+                                  "cpstore");
+        if (!base)
+            return -ENOMEM;
+    }
+
+    debug("snapshot mapped at %p-%p\n", base, base + size);
+
+    long rebase = (long) ((uintptr_t) base - (uintptr_t) hdr->hdr.addr);
+
+    if (!DkStreamMap(file, base, pal_prot, PAGE_SIZE, size)) {
+        /* The host cannot map the file, so read it */
+        if (!DkVirtualMemoryAlloc(base, size, 0, PAL_PROT_READ|PAL_PROT_WRITE))
+            return -PAL_ERRNO;
+
+        for (size_t bytes = 0 ; bytes < size ; ) {
+            PAL_NUM ret = DkStreamRead(file, PAGE_SIZE + bytes, size - bytes,
+                                       base + bytes, NULL, 0);
+            if (!ret)
+                return PAL_ERRNO ? -PAL_ERRNO : -EINVAL;
+            bytes += ret;
+        }
+    } else if (hdr->mem.nentries) {
+        /*
+         * Map the memory of whole pages from the file in place, and leave
+         * only the other entries on the list walked by restore_checkpoint(),
+         * which expects the pointers in the list not to be rebased yet.
+         */
+        struct shim_mem_entry * entry = base + hdr->mem.entoffset;
+        struct shim_mem_entry * first = NULL, * last = NULL;
+        int nentries = 0;
+
+        while (entry) {
+            struct shim_mem_entry * prev = entry->prev;
+            void * data = entry->data + rebase;
+            CP_REBASE(prev);
+
+            if (entry->paddr || !IS_PAGE_ALIGNED_PTR(entry->addr) ||
+                !IS_PAGE_ALIGNED(entry->size) ||
+                !DkStreamMap(file, entry->addr, entry->prot|PAL_PROT_WRITECOPY,
+                             PAGE_SIZE + (data - base), entry->size)) {
+                if (last)
+                    last->prev = (void *) entry - rebase;
+                else
+                    first = entry;
+                last = entry;
+                nentries++;
+            }
+
+            entry = prev;
+        }
+
+        if (last)
+            last->prev = NULL;
+
+        hdr->mem.entoffset = first ? (void *) first - base : 0;
+        hdr->mem.nentries = nentries;
+    }
+
+    /* The PAL handles are reopened by their URIs when the checkpoint is
+     * restored (see the palhdl restore function) */
+    struct shim_palhdl_entry * palhdl = hdr->palhdl.nentries ?
+            (void *) base + hdr->palhdl.entoffset : NULL;
+
+    for (; palhdl ; palhdl = palhdl->prev) {
+        CP_REBASE(palhdl->prev);
+        CP_REBASE(palhdl->phandle);
+        CP_REBASE(palhdl->uri);
+        if (palhdl->phandle)
+            *palhdl->phandle = NULL;
+    }
+
+    migrated_memory_start = base;
+    migrated_memory_end = base + size;
+    *cpptr = base;
+    return 0;
+}
+
 /*
  * Loading the checkpoint from the parent process or a checkpoint file
  *
@@ -1255,24 +2521,21 @@ int do_migration (struct newproc_cp_header * hdr, void ** cpptr)
         SAVE_PROFILE_INTERVAL(child_load_memory_by_gipc);
         DkStreamDelete(gipc_store, 0);
     } else {
-        size_t total_bytes = 0;
-        while (total_bytes < size) {
-            int bytes = DkStreamRead(PAL_CB(parent_process), 0,
-                                     size - total_bytes,
-                                     (void *) base + total_bytes, NULL, 0);
-
-            if (!bytes) {
-                if (PAL_ERRNO == EINTR || PAL_ERRNO == EAGAIN ||
-                    PAL_ERRNO == EWOULDBLOCK)
-                    continue;
-                return -PAL_ERRNO;
-            }
+        size_t raw_size = hdr->mem.encoded ? hdr->mem.dataoffset : size;
+
+        ret = read_stream(PAL_CB(parent_process), base, raw_size);
+        if (ret < 0)
+            return ret;
 
-            total_bytes += bytes;
+        if (hdr->mem.encoded) {
+            ret = receive_encoded_memory(PAL_CB(parent_process),
+                                         base + raw_size, size - raw_size);
+            if (ret < 0)
+                return ret;
         }
 
         SAVE_PROFILE_INTERVAL(child_load_checkpoint_on_pipe);
-        debug("%lu bytes read on stream\n", total_bytes);
+        debug("%lu bytes read on stream\n", size);
     }
 
     /* Receive socket or RPC handles from the parent process. */
@@ -1284,6 +2547,14 @@ int do_migration (struct newproc_cp_header * hdr, void ** cpptr)
 
     SAVE_PROFILE_INTERVAL(child_receive_handles);
 
+    /* Map the memory left behind in the parent, to be fetched lazily. */
+    if (hdr->postcopy.uri[0]) {
+        if ((ret = restore_postcopy(&hdr->postcopy, (ptr_t) base, rebase)) < 0)
+            return ret;
+
+        SAVE_PROFILE_INTERVAL(child_restore_postcopy);
+    }
+
     migrated_memory_start = (void *) mapaddr;
     migrated_memory_end = (void *) mapaddr + mapsize;
     *cpptr = (void *) base;
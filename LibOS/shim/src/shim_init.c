@@ -540,6 +540,79 @@ fail:
     return ret;
 }
 
+/*
+ * Start from the snapshot given by sys.snapshot in the manifest, if it holds
+ * one (see create_snapshot()). The snapshot has to be restored before the
+ * manifest is loaded for good, so the option is read from a copy parsed here.
+ * Snapshots are not supported on Linux-SGX (see restore_from_snapshot()).
+ */
+static int init_snapshot (PAL_HANDLE manifest_handle,
+                          struct newproc_cp_header * hdr, void ** cpptr)
+{
+    char * data = NULL;
+    size_t size;
+    int ret = 0;
+
+    if (!strcmp_static(PAL_CB(host_type), "Linux-SGX"))
+        return 0;
+
+    if (PAL_CB(manifest_preload.start)) {
+        size = PAL_CB(manifest_preload.end) - PAL_CB(manifest_preload.start);
+    } else {
+        PAL_STREAM_ATTR attr;
+        if (!DkStreamAttributesQueryByHandle(manifest_handle, &attr))
+            return -PAL_ERRNO;
+        size = attr.pending_size;
+
+        if (!(data = malloc(size)))
+            return -ENOMEM;
+
+        for (size_t bytes = 0 ; bytes < size ; ) {
+            PAL_NUM len = DkStreamRead(manifest_handle, bytes, size - bytes,
+                                       data + bytes, NULL, 0);
+            if (!len) {
+                free(data);
+                return PAL_ERRNO ? -PAL_ERRNO : -EINVAL;
+            }
+            bytes += len;
+        }
+    }
+
+    struct config_store config = {
+        .raw_data = data ? : PAL_CB(manifest_preload.start),
+        .raw_size = size,
+        .malloc   = __malloc,
+        .free     = __free,
+    };
+    const char * errstring = "Unexpected error";
+    char uri[CONFIG_MAX];
+
+    if ((ret = read_config(&config, NULL, &errstring)) < 0) {
+        SYS_PRINTF("Unable to read manifest file: %s\n", errstring);
+        goto out;
+    }
+
+    if (get_config(&config, "sys.snapshot", uri, CONFIG_MAX) <= 0)
+        goto out_config;
+
+    PAL_HANDLE file = DkStreamOpen(uri, PAL_ACCESS_RDONLY, 0, 0, 0);
+    if (!file)
+        goto out_config;
+
+    ret = restore_from_snapshot(file, hdr, cpptr);
+    if (ret == -ENOENT)
+        ret = 0;
+    else if (ret == 0)
+        debug("restored from snapshot %s\n", uri);
+
+    DkObjectClose(file);
+out_config:
+    free_config(&config);
+out:
+    free(data);
+    return ret;
+}
+
 #ifdef PROFILE
 struct shim_profile profile_root;
 #endif
@@ -623,6 +696,10 @@ static int init_newproc (struct newproc_header * hdr)
     if (!bytes)
         return -PAL_ERRNO;
 
+    /* An idle process from the fork pool of the parent is not needed */
+    if (hdr->failure == -ECANCELED)
+        DkProcessExit(0);
+
     SAVE_PROFILE_INTERVAL(child_wait_header);
     SAVE_PROFILE_INTERVAL_SINCE(child_receive_header, hdr->write_proc_time);
     return hdr->failure;
@@ -653,17 +730,22 @@ DEFINE_PROFILE_INTERVAL(init_newproc,               init);
 DEFINE_PROFILE_INTERVAL(init_mount_root,            init);
 DEFINE_PROFILE_INTERVAL(init_from_checkpoint_file,  init);
 DEFINE_PROFILE_INTERVAL(restore_from_file,          init);
+DEFINE_PROFILE_INTERVAL(init_snapshot,              init);
 DEFINE_PROFILE_INTERVAL(init_manifest,              init);
 DEFINE_PROFILE_INTERVAL(init_ipc,                   init);
 DEFINE_PROFILE_INTERVAL(init_thread,                init);
 DEFINE_PROFILE_INTERVAL(init_important_handles,     init);
 DEFINE_PROFILE_INTERVAL(init_mount,                 init);
 DEFINE_PROFILE_INTERVAL(init_async,                 init);
+DEFINE_PROFILE_INTERVAL(init_debug_log,             init);
 DEFINE_PROFILE_INTERVAL(init_stack,                 init);
 DEFINE_PROFILE_INTERVAL(read_environs,              init);
 DEFINE_PROFILE_INTERVAL(init_loader,                init);
 DEFINE_PROFILE_INTERVAL(init_ipc_helper,            init);
 DEFINE_PROFILE_INTERVAL(init_signal,                init);
+DEFINE_PROFILE_INTERVAL(init_checkpoint,            init);
+DEFINE_PROFILE_INTERVAL(init_postcopy,              init);
+DEFINE_PROFILE_INTERVAL(init_procpool,              init);
 
 #define CALL_INIT(func, args ...)   func(args)
 
@@ -750,6 +832,10 @@ noreturn void* shim_init (int argc, void * args)
         }
     }
 
+    if (!cpaddr && !PAL_CB(parent_process) && PAL_CB(manifest_handle))
+        RUN_INIT(init_snapshot, PAL_CB(manifest_handle), &hdr.checkpoint,
+                 &cpaddr);
+
     if (!cpaddr && PAL_CB(parent_process)) {
         RUN_INIT(init_newproc, &hdr);
         SAVE_PROFILE_INTERVAL_SET(child_created_in_new_process,
@@ -778,10 +864,14 @@ noreturn void* shim_init (int argc, void * args)
     RUN_INIT(init_mount);
     RUN_INIT(init_important_handles);
     RUN_INIT(init_async);
+    RUN_INIT(init_debug_log);
     RUN_INIT(init_stack, argv, envp, &argcp, &argp, &auxp, 0);
     RUN_INIT(init_loader);
     RUN_INIT(init_ipc_helper);
     RUN_INIT(init_signal);
+    RUN_INIT(init_checkpoint);
+    RUN_INIT(init_postcopy);
+    RUN_INIT(init_procpool);
 
     if (PAL_CB(parent_process)) {
         /* Notify the parent process */
@@ -857,28 +947,37 @@ static int create_unique (int (*mkname) (char *, size_t, void *),
     }
 }
 
+/* pipes and rings share the naming scheme: "<type>.srv:<id>" for the server
+ * and "<type>:<id>" for the clients */
+struct pipe_name {
+    const char * type;
+    IDTYPE pipeid;
+};
+
 static int name_pipe_rand (char * uri, size_t size, void * id)
 {
+    struct pipe_name * name = id;
     IDTYPE pipeid;
     size_t len;
     int ret = DkRandomBitsRead(&pipeid, sizeof(pipeid));
     if (ret < 0)
         return -convert_pal_errno(-ret);
-    debug("creating pipe: pipe.srv:%u\n", pipeid);
-    if ((len = snprintf(uri, size, "pipe.srv:%u", pipeid)) >= size)
+    debug("creating pipe: %s.srv:%u\n", name->type, pipeid);
+    if ((len = snprintf(uri, size, "%s.srv:%u", name->type, pipeid)) >= size)
         return -ERANGE;
-    *((IDTYPE *)id) = pipeid;
+    name->pipeid = pipeid;
     return len;
 }
 
 static int name_pipe_vmid (char * uri, size_t size, void * id)
 {
+    struct pipe_name * name = id;
     IDTYPE pipeid = cur_process.vmid;
     size_t len;
-    debug("creating pipe: pipe.srv:%u\n", pipeid);
-    if ((len = snprintf(uri, size, "pipe.srv:%u", pipeid)) >= size)
+    debug("creating pipe: %s.srv:%u\n", name->type, pipeid);
+    if ((len = snprintf(uri, size, "%s.srv:%u", name->type, pipeid)) >= size)
         return -ERANGE;
-    *((IDTYPE *)id) = pipeid;
+    name->pipeid = pipeid;
     return len;
 }
 
@@ -898,31 +997,44 @@ static int open_pipe (const char * uri, void * obj)
 static int pipe_addr (char * uri, size_t size, const void * id,
                       struct shim_qstr * qstr)
 {
-    IDTYPE pipeid = *((IDTYPE *) id);
+    const struct pipe_name * name = id;
     size_t len;
-    if ((len = snprintf(uri, size, "pipe:%u", pipeid)) == size)
+    if ((len = snprintf(uri, size, "%s:%u", name->type, name->pipeid)) == size)
         return -ERANGE;
     if (qstr)
         qstrsetstr(qstr, uri, len);
     return len;
 }
 
-int create_pipe (IDTYPE * id, char * uri, size_t size, PAL_HANDLE * hdl,
-                 struct shim_qstr * qstr, bool use_vmid_for_name)
+static int __create_pipe (const char * type, IDTYPE * id, char * uri,
+                          size_t size, PAL_HANDLE * hdl,
+                          struct shim_qstr * qstr, bool use_vmid_for_name)
 {
-    IDTYPE pipeid;
+    struct pipe_name name = { .type = type, .pipeid = 0 };
     int ret;
     if (use_vmid_for_name)
         ret = create_unique(&name_pipe_vmid, &open_pipe, &pipe_addr,
-                            uri, size, &pipeid, hdl, qstr);
+                            uri, size, &name, hdl, qstr);
     else
         ret = create_unique(&name_pipe_rand, &open_pipe, &pipe_addr,
-                            uri, size, &pipeid, hdl, qstr);
+                            uri, size, &name, hdl, qstr);
     if (ret > 0 && id)
-        *id = pipeid;
+        *id = name.pipeid;
     return ret;
 }
 
+int create_pipe (IDTYPE * id, char * uri, size_t size, PAL_HANDLE * hdl,
+                 struct shim_qstr * qstr, bool use_vmid_for_name)
+{
+    return __create_pipe("pipe", id, uri, size, hdl, qstr, use_vmid_for_name);
+}
+
+int create_ring (IDTYPE * id, char * uri, size_t size, PAL_HANDLE * hdl,
+                 struct shim_qstr * qstr, bool use_vmid_for_name)
+{
+    return __create_pipe("ring", id, uri, size, hdl, qstr, use_vmid_for_name);
+}
+
 static int name_path (char * path, size_t size, void * id)
 {
     unsigned int suffix;
@@ -1201,6 +1313,7 @@ int shim_clean (int err)
 
     shim_stdio = NULL;
     debug("process %u exited with status %d\n", cur_process.vmid & 0xFFFF, cur_process.exit_code);
+    debug_log_flush();
     MASTER_LOCK();
     DkProcessExit(cur_process.exit_code);
     return 0;
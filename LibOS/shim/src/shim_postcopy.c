@@ -0,0 +1,907 @@
+/* Copyright (C) 2014 Stony Brook University
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * shim_postcopy.c
+ *
+ * This file contains the post-copy (lazy) memory transfer for fork. Instead
+ * of writing every byte of large anonymous VMAs down the process stream
+ * before the child can run, the parent only sends the checkpoint metadata.
+ * The child maps the lazy regions without any access permission and pulls
+ * their contents from a page-server thread in the parent, either on demand
+ * (from the memory fault upcall) or in the background (prefetcher thread).
+ * The contents are written through the host's /proc/self/mem while the
+ * chunks are still inaccessible, and only then the chunks are given their
+ * permissions, so another thread either faults (and waits for the fetch) or
+ * sees the parent's memory, never the empty pages.
+ *
+ * To preserve fork semantics, the parent write-protects the lazy regions
+ * while a session is active. The first write to a chunk saves a private
+ * snapshot of its pre-fork contents, which the page server then serves
+ * instead of the live memory. When the child has fetched everything (or
+ * exits), the parent drops the snapshots and restores the protections.
+ *
+ * Only one post-copy session is active at a time; a fork issued while a
+ * session is still running falls back to the eager copy. Post-copy is not
+ * used on Linux-SGX, which does not report faulting addresses precisely.
+ */
+
+#include <shim_internal.h>
+#include <shim_utils.h>
+#include <shim_thread.h>
+#include <shim_vma.h>
+#include <shim_checkpoint.h>
+#include <shim_profile.h>
+
+#include <pal.h>
+#include <pal_error.h>
+
+#define POSTCOPY_CHUNK_SIZE     (64 * 1024)
+#define POSTCOPY_BATCH          16      /* max chunks per request */
+#define POSTCOPY_DONE           ((uint32_t) -1)
+#define POSTCOPY_ACCEPT_TIMEOUT 100000  /* 100 ms */
+#define POSTCOPY_CONNECT_TIMEOUT 1000000 /* 1 s, once the child is restored */
+
+#define BITS_PER_LONG           (8 * sizeof(unsigned long))
+
+DEFINE_PROFILE_CATEGORY(postcopy, migrate);
+DEFINE_PROFILE_OCCURENCE(postcopy_demand_chunks,   postcopy);
+DEFINE_PROFILE_OCCURENCE(postcopy_prefetch_chunks, postcopy);
+DEFINE_PROFILE_OCCURENCE(postcopy_snapshot_chunks, postcopy);
+
+struct postcopy_request {
+    uint32_t region;
+    uint32_t chunk;
+    uint32_t nchunks;
+};
+
+struct postcopy_region {
+    void * addr;
+    size_t size;
+    int prot;
+    size_t nchunks;
+    /* child: bitmap of fetched chunks */
+    unsigned long * fetched;
+    /* parent: pre-fork copies of chunks written since the fork */
+    void ** snapshots;
+};
+
+enum { POSTCOPY_NONE = 0, POSTCOPY_SERVER, POSTCOPY_CLIENT };
+
+static struct {
+    int role;
+    bool aborted;
+    /* parent: when to stop waiting for the child to connect, 0 if unset */
+    uint64_t connect_deadline;
+    PAL_HANDLE stream;
+    /* child: the host's /proc/self/mem, to fill inaccessible chunks */
+    PAL_HANDLE mem;
+    struct postcopy_region * regions;
+    int nregions;
+    size_t remaining;
+    void * buf;
+    /* prefetch starts from here, updated by demand faults */
+    int hint_region;
+    size_t hint_chunk;
+} postcopy;
+
+/* can be read without postcopy_lock but always written with lock held */
+static bool postcopy_active;
+
+static struct shim_lock postcopy_lock;
+static AEVENTTYPE postcopy_done_event;
+
+static bool postcopy_allowed;
+static size_t postcopy_min_size = DEFAULT_POSTCOPY_MIN_SIZE;
+
+static int postcopy_start_thread (void (*func) (void *));
+static void postcopy_prefetcher (void * arg);
+
+static inline bool chunk_fetched (struct postcopy_region * r, size_t i)
+{
+    return r->fetched[i / BITS_PER_LONG] & (1UL << (i % BITS_PER_LONG));
+}
+
+static inline void set_chunk_fetched (struct postcopy_region * r, size_t i)
+{
+    r->fetched[i / BITS_PER_LONG] |= 1UL << (i % BITS_PER_LONG);
+}
+
+static inline void * chunk_addr (struct postcopy_region * r, size_t i)
+{
+    return r->addr + i * POSTCOPY_CHUNK_SIZE;
+}
+
+static inline size_t chunk_size (struct postcopy_region * r, size_t i,
+                                 size_t n)
+{
+    size_t start = i * POSTCOPY_CHUNK_SIZE;
+    size_t end = start + n * POSTCOPY_CHUNK_SIZE;
+    return (end > r->size ? r->size : end) - start;
+}
+
+static struct postcopy_region * find_region (void * addr)
+{
+    for (int i = 0 ; i < postcopy.nregions ; i++) {
+        struct postcopy_region * r = &postcopy.regions[i];
+        if (addr >= r->addr && addr < r->addr + r->size)
+            return r;
+    }
+    return NULL;
+}
+
+static int postcopy_write (PAL_HANDLE stream, const void * buf, size_t size)
+{
+    size_t bytes = 0;
+    while (bytes < size) {
+        size_t ret = DkStreamWrite(stream, 0, size - bytes,
+                                   (void *) buf + bytes, NULL);
+        if (!ret) {
+            if (PAL_ERRNO == EINTR || PAL_ERRNO == EAGAIN ||
+                PAL_ERRNO == EWOULDBLOCK)
+                continue;
+            return -PAL_ERRNO;
+        }
+        bytes += ret;
+    }
+    return 0;
+}
+
+static int postcopy_read (PAL_HANDLE stream, void * buf, size_t size)
+{
+    size_t bytes = 0;
+    while (bytes < size) {
+        size_t ret = DkStreamRead(stream, 0, size - bytes, buf + bytes,
+                                  NULL, 0);
+        if (!ret) {
+            if (PAL_ERRNO == EINTR || PAL_ERRNO == EAGAIN ||
+                PAL_ERRNO == EWOULDBLOCK)
+                continue;
+            return -PAL_ERRNO;
+        }
+        bytes += ret;
+    }
+    return 0;
+}
+
+static void free_regions (void)
+{
+    for (int i = 0 ; i < postcopy.nregions ; i++) {
+        struct postcopy_region * r = &postcopy.regions[i];
+        if (r->snapshots) {
+            for (size_t j = 0 ; j < r->nchunks ; j++)
+                free(r->snapshots[j]);
+            free(r->snapshots);
+        }
+        free(r->fetched);
+    }
+
+    free(postcopy.regions);
+    free(postcopy.buf);
+    postcopy.regions = NULL;
+    postcopy.nregions = 0;
+    postcopy.buf = NULL;
+}
+
+int init_postcopy (void)
+{
+    if (!lock_created(&postcopy_lock))
+        create_lock(&postcopy_lock);
+    create_event(&postcopy_done_event);
+
+    if (root_config && strcmp_static(PAL_CB(host_type), "Linux-SGX")) {
+        char cfg[CONFIG_MAX];
+        if (get_config(root_config, "sys.fork.postcopy", cfg, CONFIG_MAX) > 0)
+            postcopy_allowed = parse_int(cfg) != 0;
+        if (get_config(root_config, "sys.fork.postcopy_min_size", cfg,
+                       CONFIG_MAX) > 0)
+            postcopy_min_size = PAGE_ALIGN_UP(parse_int(cfg));
+    }
+
+    if (postcopy.role == POSTCOPY_CLIENT) {
+        /* Prefetch from the region holding the stack we are resuming on */
+        shim_tcb_t * tcb = shim_get_tls();
+        if (tcb->context.regs) {
+            struct postcopy_region * r =
+                    find_region((void *) tcb->context.regs->rsp);
+            if (r) {
+                postcopy.hint_region = r - postcopy.regions;
+                postcopy.hint_chunk  = ((void *) tcb->context.regs->rsp -
+                                        r->addr) / POSTCOPY_CHUNK_SIZE;
+            }
+        }
+
+        int ret = postcopy_start_thread(&postcopy_prefetcher);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+bool postcopy_eligible (void * addr, size_t size, int prot, bool file_backed)
+{
+    __UNUSED(addr);
+    return !file_backed && (prot & PAL_PROT_READ) && size >= postcopy_min_size;
+}
+
+BEGIN_CP_FUNC(postcopy)
+{
+    ptr_t off = ADD_CP_OFFSET(sizeof(struct shim_postcopy_entry));
+    struct shim_postcopy_entry * entry = (void *) (base + off);
+
+    entry->addr = obj;
+    entry->size = size;
+    entry->prot = PAL_PROT_READ|PAL_PROT_WRITE;
+    entry->prev = store->last_postcopy_entry;
+    store->last_postcopy_entry = entry;
+    store->postcopy_nentries++;
+
+    if (objp)
+        *objp = entry;
+}
+END_CP_FUNC_NO_RS(postcopy)
+
+static int postcopy_start_thread (void (*func) (void *))
+{
+    struct shim_thread * new = get_new_internal_thread();
+    if (!new)
+        return -ENOMEM;
+
+    PAL_HANDLE handle = thread_create(func, new);
+    if (!handle) {
+        put_thread(new);
+        return -PAL_ERRNO;
+    }
+
+    new->pal_handle = handle;
+    return 0;
+}
+
+/*
+ * Parent side (page server)
+ */
+
+/* this should be called with the postcopy_lock held */
+static bool snapshot_chunk (struct postcopy_region * r, size_t i, bool flush)
+{
+    if (r->snapshots[i])
+        return false;
+
+    /* Only writable regions are write-protected; others can only change
+     * through mprotect/munmap, which flush the range first. */
+    if (!flush && !(r->prot & PAL_PROT_WRITE))
+        return false;
+
+    size_t size = chunk_size(r, i, 1);
+    void * copy = malloc(size);
+    if (!copy)
+        return false;
+
+    memcpy(copy, chunk_addr(r, i), size);
+    r->snapshots[i] = copy;
+
+    if (!flush)
+        DkVirtualMemoryProtect(chunk_addr(r, i), size, r->prot);
+
+    ADD_PROFILE_OCCURENCE(postcopy_snapshot_chunks, 1);
+    return true;
+}
+
+static void postcopy_release_server (void)
+{
+    lock(&postcopy_lock);
+
+    /* Give the write permission back to chunks that were never written */
+    for (int i = 0 ; i < postcopy.nregions ; i++) {
+        struct postcopy_region * r = &postcopy.regions[i];
+        if (!r->snapshots || !(r->prot & PAL_PROT_WRITE))
+            continue;
+
+        for (size_t j = 0 ; j < r->nchunks ; j++) {
+            if (r->snapshots[j])
+                continue;
+
+            size_t n = 1;
+            while (j + n < r->nchunks && !r->snapshots[j + n])
+                n++;
+
+            DkVirtualMemoryProtect(chunk_addr(r, j), chunk_size(r, j, n),
+                                   r->prot);
+            j += n;
+        }
+    }
+
+    free_regions();
+
+    if (postcopy.stream) {
+        DkObjectClose(postcopy.stream);
+        postcopy.stream = NULL;
+    }
+
+    postcopy_active = false;
+    postcopy.role = POSTCOPY_NONE;
+    unlock(&postcopy_lock);
+
+    set_event(&postcopy_done_event, 1);
+    debug("post-copy session released\n");
+}
+
+static void postcopy_server (void * arg)
+{
+    struct shim_thread * self = (struct shim_thread *) arg;
+    if (!arg)
+        return;
+
+    __libc_tcb_t tcb;
+    allocate_tls(&tcb, false, self);
+    debug_setbuf(&tcb.shim_tcb, true);
+    debug("Post-copy page server started\n");
+
+    /* Poll with a timeout, so a failed fork can abort the session, and a
+     * child which is gone without connecting does not hold it forever */
+    PAL_HANDLE client = NULL;
+    while (!postcopy.aborted) {
+        PAL_HANDLE srv = postcopy.stream;
+        if (DkObjectsWaitAny(1, &srv, POSTCOPY_ACCEPT_TIMEOUT)) {
+            client = DkStreamWaitForClient(srv);
+            break;
+        }
+
+        uint64_t deadline = postcopy.connect_deadline;
+        if (deadline && DkSystemTimeQuery() > deadline) {
+            debug("the child never connected to the post-copy server\n");
+            break;
+        }
+    }
+
+    void * buf = malloc(POSTCOPY_BATCH * POSTCOPY_CHUNK_SIZE);
+
+    while (client && buf) {
+        struct postcopy_request req;
+        if (postcopy_read(client, &req, sizeof(req)) < 0 ||
+            req.region == POSTCOPY_DONE)
+            break;
+
+        lock(&postcopy_lock);
+
+        struct postcopy_region * r = req.region < (uint32_t) postcopy.nregions ?
+                                     &postcopy.regions[req.region] : NULL;
+        if (!r || !req.nchunks || req.nchunks > POSTCOPY_BATCH ||
+            req.chunk >= r->nchunks || req.nchunks > r->nchunks - req.chunk) {
+            unlock(&postcopy_lock);
+            debug("invalid post-copy request\n");
+            break;
+        }
+
+        /* Serve the pre-fork contents: the snapshot if the chunk has been
+         * written since the fork, otherwise the (write-protected) memory. */
+        for (uint32_t i = 0 ; i < req.nchunks ; i++) {
+            size_t c = req.chunk + i;
+            void * src = r->snapshots[c] ? r->snapshots[c] : chunk_addr(r, c);
+            memcpy(buf + i * POSTCOPY_CHUNK_SIZE, src, chunk_size(r, c, 1));
+        }
+
+        size_t size = chunk_size(r, req.chunk, req.nchunks);
+        unlock(&postcopy_lock);
+
+        if (postcopy_write(client, buf, size) < 0)
+            break;
+    }
+
+    if (client)
+        DkObjectClose(client);
+    free(buf);
+
+    postcopy_release_server();
+    debug("Post-copy page server terminated\n");
+
+    put_thread(self);
+    DkThreadExit();
+}
+
+int postcopy_prepare_server (struct shim_cp_store * store, char * uri,
+                             size_t size)
+{
+    if (!postcopy_allowed)
+        return 0;
+
+    lock(&postcopy_lock);
+
+    /* Only one session at a time; other forks use the eager copy */
+    if (postcopy.role != POSTCOPY_NONE) {
+        unlock(&postcopy_lock);
+        return 0;
+    }
+
+    int ret = create_pipe(NULL, uri, size, &postcopy.stream, NULL, false);
+    if (ret < 0) {
+        unlock(&postcopy_lock);
+        return ret;
+    }
+
+    postcopy.role = POSTCOPY_SERVER;
+    postcopy.aborted = false;
+    postcopy.connect_deadline = 0;
+    clear_event(&postcopy_done_event);
+    unlock(&postcopy_lock);
+
+    store->use_postcopy = true;
+    return 0;
+}
+
+int postcopy_start_server (struct shim_cp_store * store)
+{
+    if (!store->use_postcopy)
+        return 0;
+
+    int nentries = store->postcopy_nentries;
+    if (!nentries) {
+        store->use_postcopy = false;
+        postcopy_release_server();
+        return 0;
+    }
+
+    struct postcopy_region * regions = calloc(nentries, sizeof(*regions));
+    if (!regions)
+        return -ENOMEM;
+
+    lock(&postcopy_lock);
+    postcopy.regions  = regions;
+    postcopy.nregions = nentries;
+
+    struct shim_postcopy_entry * entry = store->last_postcopy_entry;
+    for (int i = nentries - 1 ; i >= 0 && entry ; i--, entry = entry->prev) {
+        struct postcopy_region * r = &regions[i];
+        r->addr    = entry->addr;
+        r->size    = entry->size;
+        r->prot    = entry->prot;
+        r->nchunks = ALIGN_UP(r->size, POSTCOPY_CHUNK_SIZE) /
+                     POSTCOPY_CHUNK_SIZE;
+        r->snapshots = calloc(r->nchunks, sizeof(void *));
+        if (!r->snapshots) {
+            unlock(&postcopy_lock);
+            return -ENOMEM;
+        }
+    }
+
+    /* Write-protect the lazy regions, so the first write to each chunk
+     * saves its pre-fork contents for the child. */
+    for (int i = 0 ; i < nentries ; i++)
+        if (regions[i].prot & PAL_PROT_WRITE)
+            DkVirtualMemoryProtect(regions[i].addr, regions[i].size,
+                                   regions[i].prot & ~PAL_PROT_WRITE);
+
+    postcopy_active = true;
+    unlock(&postcopy_lock);
+
+    int ret = postcopy_start_thread(&postcopy_server);
+    if (ret < 0) {
+        store->use_postcopy = false;
+        postcopy_release_server();
+        return ret;
+    }
+
+    debug("post-copy session started: %d regions\n", nentries);
+    return 0;
+}
+
+void postcopy_abort_server (void)
+{
+    lock(&postcopy_lock);
+    bool release = postcopy.role == POSTCOPY_SERVER && !postcopy_active;
+    if (postcopy.role == POSTCOPY_SERVER)
+        postcopy.aborted = true;
+    unlock(&postcopy_lock);
+
+    /* Nobody is serving the session yet, release it here */
+    if (release)
+        postcopy_release_server();
+}
+
+/* The child has restored its memory, so it has connected to the server by
+ * now (the connection waits to be accepted) unless it failed to */
+void postcopy_child_restored (void)
+{
+    lock(&postcopy_lock);
+    if (postcopy.role == POSTCOPY_SERVER)
+        postcopy.connect_deadline = DkSystemTimeQuery() + POSTCOPY_CONNECT_TIMEOUT;
+    unlock(&postcopy_lock);
+}
+
+/*
+ * Child side (page client)
+ */
+
+/* this should be called with the postcopy_lock held */
+static void postcopy_finish_client (bool failed)
+{
+    if (postcopy.stream) {
+        if (!failed) {
+            struct postcopy_request req = { .region = POSTCOPY_DONE };
+            postcopy_write(postcopy.stream, &req, sizeof(req));
+        }
+        DkObjectClose(postcopy.stream);
+        postcopy.stream = NULL;
+    }
+
+    if (postcopy.mem) {
+        DkObjectClose(postcopy.mem);
+        postcopy.mem = NULL;
+    }
+
+    free_regions();
+    postcopy.remaining = 0;
+    postcopy_active = false;
+    postcopy.role = POSTCOPY_NONE;
+    debug("post-copy session %s\n", failed ? "failed" : "completed");
+}
+
+/* this should be called with the postcopy_lock held; [first, first + n)
+ * must all be unfetched */
+static int fetch_chunks (struct postcopy_region * r, size_t first, size_t n)
+{
+    struct postcopy_request req = {
+        .region = r - postcopy.regions, .chunk = first, .nchunks = n,
+    };
+    void * addr = chunk_addr(r, first);
+    size_t size = chunk_size(r, first, n);
+    int ret;
+
+    if ((ret = postcopy_write(postcopy.stream, &req, sizeof(req))) < 0 ||
+        (ret = postcopy_read(postcopy.stream, postcopy.buf, size)) < 0) {
+        debug("failed fetching post-copy memory %p-%p (%d)\n",
+              addr, addr + size, ret);
+        postcopy_finish_client(true);
+        return ret;
+    }
+
+    /* The chunks stay inaccessible until they are filled */
+    for (size_t done = 0 ; done < size ; ) {
+        PAL_NUM bytes = DkStreamWrite(postcopy.mem, (PAL_NUM) addr + done,
+                                      size - done, postcopy.buf + done, NULL);
+        if (!bytes) {
+            ret = -PAL_ERRNO;
+            debug("failed filling post-copy memory %p-%p (%d)\n",
+                  addr, addr + size, ret);
+            postcopy_finish_client(true);
+            return ret;
+        }
+        done += bytes;
+    }
+
+    if (!DkVirtualMemoryProtect(addr, size, r->prot))
+        return -PAL_ERRNO;
+
+    for (size_t i = first ; i < first + n ; i++)
+        set_chunk_fetched(r, i);
+
+    postcopy.remaining -= n;
+    return 0;
+}
+
+/* length of the run of unfetched chunks starting at chunk i */
+static size_t unfetched_run (struct postcopy_region * r, size_t i)
+{
+    size_t n = 1;
+    while (n < POSTCOPY_BATCH && i + n < r->nchunks && !chunk_fetched(r, i + n))
+        n++;
+    return n;
+}
+
+/* find the next unfetched chunk, starting from the prefetch hint */
+static struct postcopy_region * next_unfetched (size_t * chunk)
+{
+    int nregions = postcopy.nregions;
+    int ri = postcopy.hint_region;
+    size_t ci = postcopy.hint_chunk;
+
+    for (int scanned = 0 ; scanned <= nregions ; scanned++) {
+        struct postcopy_region * r = &postcopy.regions[ri];
+        for (; ci < r->nchunks ; ci++)
+            if (!chunk_fetched(r, ci)) {
+                *chunk = ci;
+                return r;
+            }
+
+        ri = (ri + 1) % nregions;
+        ci = 0;
+    }
+
+    return NULL;
+}
+
+static void postcopy_prefetcher (void * arg)
+{
+    struct shim_thread * self = (struct shim_thread *) arg;
+    if (!arg)
+        return;
+
+    __libc_tcb_t tcb;
+    allocate_tls(&tcb, false, self);
+    debug_setbuf(&tcb.shim_tcb, true);
+    debug("Post-copy prefetcher started\n");
+
+    lock(&postcopy_lock);
+
+    while (postcopy.role == POSTCOPY_CLIENT && postcopy.remaining) {
+        size_t i;
+        struct postcopy_region * r = next_unfetched(&i);
+        if (!r)
+            break;
+
+        size_t n = unfetched_run(r, i);
+        if (fetch_chunks(r, i, n) < 0)
+            break;
+
+        ADD_PROFILE_OCCURENCE(postcopy_prefetch_chunks, n);
+        postcopy.hint_region = r - postcopy.regions;
+        postcopy.hint_chunk  = i + n;
+
+        /* let demand faults go first between batches */
+        unlock(&postcopy_lock);
+        lock(&postcopy_lock);
+    }
+
+    if (postcopy.role == POSTCOPY_CLIENT && !postcopy.remaining)
+        postcopy_finish_client(false);
+
+    unlock(&postcopy_lock);
+    debug("Post-copy prefetcher terminated\n");
+
+    put_thread(self);
+    DkThreadExit();
+}
+
+/* Used until init_signal() installs memfault_upcall(): restoring the
+ * checkpoint may already touch lazily transferred memory. */
+static void postcopy_early_upcall (PAL_PTR event, PAL_NUM arg,
+                                   PAL_CONTEXT * context)
+{
+    __UNUSED(context);
+
+    if (!arg || !postcopy_handle_fault((void *) arg)) {
+        SYS_PRINTF("memory fault at 0x%08lx while restoring checkpoint\n",
+                   arg);
+        shim_terminate(-EFAULT);
+    }
+
+    DkExceptionReturn(event);
+}
+
+int restore_postcopy (struct postcopy_header * hdr, ptr_t base, long rebase)
+{
+    int nentries = hdr->nentries;
+    if (!nentries)
+        return 0;
+
+    debug("restore memory by post-copy: %d entries\n", nentries);
+
+    struct postcopy_region * regions = calloc(nentries, sizeof(*regions));
+    if (!regions)
+        return -ENOMEM;
+
+    postcopy.regions  = regions;
+    postcopy.nregions = nentries;
+
+    struct shim_postcopy_entry * entry = (void *) (base + hdr->entoffset);
+    int cnt = nentries;
+
+    for (; entry ; entry = entry->prev) {
+        CP_REBASE(entry->prev);
+        if (!cnt)
+            goto inval;
+
+        struct postcopy_region * r = &regions[--cnt];
+        r->addr    = entry->addr;
+        r->size    = entry->size;
+        r->prot    = entry->prot;
+        r->nchunks = ALIGN_UP(r->size, POSTCOPY_CHUNK_SIZE) /
+                     POSTCOPY_CHUNK_SIZE;
+        r->fetched = calloc(ALIGN_UP(r->nchunks, BITS_PER_LONG) / BITS_PER_LONG,
+                            sizeof(unsigned long));
+        if (!r->fetched)
+            goto nomem;
+
+        /* Reserve the region without access; faults pull in the data. */
+        if (DkVirtualMemoryAlloc(r->addr, r->size, 0, PAL_PROT_NONE) != r->addr) {
+            debug("failed allocating %p-%p\n", r->addr, r->addr + r->size);
+            free_regions();
+            return -PAL_ERRNO;
+        }
+
+        postcopy.remaining += r->nchunks;
+    }
+
+    if (cnt)
+        goto inval;
+
+    if (!(postcopy.buf = malloc(POSTCOPY_BATCH * POSTCOPY_CHUNK_SIZE)))
+        goto nomem;
+
+    postcopy.mem = DkStreamOpen("file:/proc/self/mem", PAL_ACCESS_RDWR, 0, 0, 0);
+    if (!postcopy.mem) {
+        debug("cannot open /proc/self/mem for post-copy memory\n");
+        free_regions();
+        return -PAL_ERRNO;
+    }
+
+    postcopy.stream = DkStreamOpen(hdr->uri, PAL_ACCESS_RDWR, 0, 0, 0);
+    if (!postcopy.stream) {
+        DkObjectClose(postcopy.mem);
+        postcopy.mem = NULL;
+        free_regions();
+        return -PAL_ERRNO;
+    }
+
+    if (!lock_created(&postcopy_lock))
+        create_lock(&postcopy_lock);
+
+    postcopy.role = POSTCOPY_CLIENT;
+    postcopy_active = true;
+    DkSetExceptionHandler(&postcopy_early_upcall, PAL_EVENT_MEMFAULT);
+    return 0;
+
+inval:
+    free_regions();
+    return -EINVAL;
+nomem:
+    free_regions();
+    return -ENOMEM;
+}
+
+/*
+ * Called from the memory fault upcall before anything else: a fault on a
+ * lazy region is resolved here and the faulting instruction is retried.
+ * This also covers test_user_memory(), so system calls prefault the user
+ * buffers before the host touches them.
+ */
+bool postcopy_handle_fault (void * addr)
+{
+    if (!postcopy_active)
+        return false;
+
+    bool handled = false;
+    lock(&postcopy_lock);
+
+    struct postcopy_region * r = postcopy_active ? find_region(addr) : NULL;
+    if (r) {
+        size_t i = (addr - r->addr) / POSTCOPY_CHUNK_SIZE;
+
+        if (postcopy.role == POSTCOPY_SERVER) {
+            handled = snapshot_chunk(r, i, false);
+        } else if (chunk_fetched(r, i)) {
+            /* fetched by another thread while this one waited for the lock */
+            handled = true;
+        } else {
+            handled = fetch_chunks(r, i, 1) == 0;
+            if (handled) {
+                ADD_PROFILE_OCCURENCE(postcopy_demand_chunks, 1);
+                /* prefetch the neighbourhood of the working set next */
+                postcopy.hint_region = r - postcopy.regions;
+                postcopy.hint_chunk  = i + 1;
+            }
+        }
+    }
+
+    unlock(&postcopy_lock);
+    return handled;
+}
+
+/*
+ * Called before [addr, addr + size) is unmapped, remapped or reprotected.
+ * The parent saves the pre-fork contents of the range; the child either
+ * pulls the range in, or drops it if its contents are going away.
+ */
+void postcopy_flush_range (void * addr, size_t size, bool discard)
+{
+    if (!postcopy_active)
+        return;
+
+    lock(&postcopy_lock);
+
+    for (int i = 0 ; postcopy_active && i < postcopy.nregions ; i++) {
+        struct postcopy_region * r = &postcopy.regions[i];
+        if (addr + size <= r->addr || addr >= r->addr + r->size)
+            continue;
+
+        void * start = addr > r->addr ? addr : r->addr;
+        void * end = addr + size < r->addr + r->size ? addr + size :
+                     r->addr + r->size;
+        size_t first = (start - r->addr) / POSTCOPY_CHUNK_SIZE;
+        size_t last  = (end - 1 - r->addr) / POSTCOPY_CHUNK_SIZE;
+
+        for (size_t j = first ; j <= last ; j++) {
+            if (postcopy.role == POSTCOPY_SERVER) {
+                snapshot_chunk(r, j, true);
+            } else if (!chunk_fetched(r, j)) {
+                if (discard) {
+                    set_chunk_fetched(r, j);
+                    postcopy.remaining--;
+                } else if (fetch_chunks(r, j, 1) < 0) {
+                    break;
+                }
+            }
+        }
+    }
+
+    if (postcopy.role == POSTCOPY_CLIENT && !postcopy.remaining)
+        postcopy_finish_client(false);
+
+    unlock(&postcopy_lock);
+}
+
+/* Fetches what the child still needs (if @need_data) and lets the parent
+ * go; returns false if this process is not a post-copy child */
+static bool postcopy_drain_client (bool need_data)
+{
+    lock(&postcopy_lock);
+
+    if (postcopy.role != POSTCOPY_CLIENT) {
+        unlock(&postcopy_lock);
+        return false;
+    }
+
+    while (need_data && postcopy.role == POSTCOPY_CLIENT &&
+           postcopy.remaining) {
+        size_t i;
+        struct postcopy_region * r = next_unfetched(&i);
+        if (!r || fetch_chunks(r, i, unfetched_run(r, i)) < 0)
+            break;
+    }
+
+    if (postcopy.role == POSTCOPY_CLIENT)
+        postcopy_finish_client(false);
+
+    unlock(&postcopy_lock);
+    return true;
+}
+
+/*
+ * Pulls in the memory still owned by our own parent, before this process
+ * forks or takes a snapshot. A session served to our own child goes on; a
+ * second fork meanwhile uses the eager copy.
+ */
+void postcopy_fetch_all (void)
+{
+    if (!postcopy_active)
+        return;
+
+    postcopy_drain_client(true);
+}
+
+/*
+ * Ends the post-copy session before the process exits or execs. The child
+ * fetches what it still needs (if @need_data) and lets the parent go; the
+ * parent waits until its child has released it.
+ */
+void postcopy_drain (bool need_data)
+{
+    if (!postcopy_active && postcopy.role == POSTCOPY_NONE)
+        return;
+
+    if (postcopy_drain_client(need_data))
+        return;
+
+    lock(&postcopy_lock);
+    bool wait = postcopy.role == POSTCOPY_SERVER;
+    unlock(&postcopy_lock);
+
+    if (wait) {
+        debug("waiting for the post-copy session to complete\n");
+        wait_event(&postcopy_done_event);
+    }
+}
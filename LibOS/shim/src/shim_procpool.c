@@ -0,0 +1,203 @@
+/* Copyright (C) 2014 Stony Brook University
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * shim_procpool.c
+ *
+ * This file contains the pool of pre-created processes used by fork. A new
+ * process spends most of its creation time loading the PAL and the library
+ * OS (and on SGX, building and attesting the enclave) before it blocks in
+ * init_newproc() waiting for the checkpoint header. A process in the pool
+ * has already gone through all of that, so a fork that claims one only has
+ * to send the checkpoint.
+ *
+ * The pool is filled lazily: a process starts filling its pool (in the
+ * background) after its first fork, so processes which never fork, or only
+ * fork once, do not keep idle children around. Only fork uses the pool;
+ * execve needs a process created for the new executable.
+ *
+ * Only the initial process (and what it execve()s into) keeps a pool. The
+ * manifest is the same for the whole process tree, so if every forked child
+ * kept one too, the idle processes would multiply with each generation.
+ */
+
+#include <shim_internal.h>
+#include <shim_utils.h>
+#include <shim_thread.h>
+#include <shim_checkpoint.h>
+#include <shim_ipc.h>
+#include <shim_profile.h>
+
+#include <pal.h>
+#include <pal_error.h>
+
+DEFINE_PROFILE_CATEGORY(procpool, migrate);
+DEFINE_PROFILE_OCCURENCE(procpool_hit,  procpool);
+DEFINE_PROFILE_OCCURENCE(procpool_miss, procpool);
+
+static struct shim_lock procpool_lock;
+static PAL_HANDLE * procpool;
+static int procpool_size;
+static int procpool_count;
+static bool procpool_filling;
+
+int init_procpool (void)
+{
+    if (!lock_created(&procpool_lock))
+        create_lock(&procpool_lock);
+
+    if (root_config) {
+        char cfg[CONFIG_MAX];
+        if (get_config(root_config, "sys.fork.pool_size", cfg, CONFIG_MAX) > 0)
+            procpool_size = parse_int(cfg);
+    }
+
+    /* a forked process has a parent; an execve() keeps the parent of the
+       process it replaces */
+    if (cur_process.parent)
+        procpool_size = 0;
+
+    if (procpool_size <= 0) {
+        procpool_size = 0;
+        return 0;
+    }
+
+    procpool = malloc(sizeof(PAL_HANDLE) * procpool_size);
+    if (!procpool)
+        return -ENOMEM;
+
+    debug("keeping up to %d idle processes for fork\n", procpool_size);
+    return 0;
+}
+
+/* Tell an idle process that it is not needed, so it exits quietly. */
+static void release_process (PAL_HANDLE proc)
+{
+    struct newproc_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.failure = -ECANCELED;
+
+    DkStreamWrite(proc, 0, sizeof(hdr), &hdr, NULL);
+    DkObjectClose(proc);
+}
+
+static void procpool_filler (void * arg)
+{
+    struct shim_thread * self = (struct shim_thread *) arg;
+    if (!arg)
+        return;
+
+    __libc_tcb_t tcb;
+    allocate_tls(&tcb, false, self);
+    debug_setbuf(&tcb.shim_tcb, true);
+    debug("Process pool filler started\n");
+
+    while (1) {
+        PAL_HANDLE proc = DkProcessCreate(pal_control.executable, NULL);
+
+        lock(&procpool_lock);
+        if (!proc || procpool_count >= procpool_size) {
+            procpool_filling = false;
+            unlock(&procpool_lock);
+            if (proc)
+                release_process(proc);
+            break;
+        }
+
+        procpool[procpool_count++] = proc;
+        bool full = procpool_count == procpool_size;
+        if (full)
+            procpool_filling = false;
+        unlock(&procpool_lock);
+
+        if (full)
+            break;
+    }
+
+    debug("Process pool filler terminated\n");
+    put_thread(self);
+    DkThreadExit();
+}
+
+PAL_HANDLE get_pooled_process (void)
+{
+    PAL_HANDLE proc = NULL;
+
+    if (!procpool_size)
+        return NULL;
+
+    while (true) {
+        lock(&procpool_lock);
+        proc = procpool_count ? procpool[--procpool_count] : NULL;
+        unlock(&procpool_lock);
+
+        if (!proc)
+            break;
+
+        /* An idle process sends nothing before it gets the checkpoint
+         * header, so a readable one has died (e.g. killed by the host) */
+        PAL_FLG events = PAL_WAIT_READ, ret_events = 0;
+        if (!DkStreamsWaitEvents(1, &proc, &events, &ret_events, 0))
+            break;
+
+        debug("process in the pool is gone, dropping it\n");
+        DkObjectClose(proc);
+    }
+
+    if (proc)
+        ADD_PROFILE_OCCURENCE(procpool_hit, 1);
+    else
+        ADD_PROFILE_OCCURENCE(procpool_miss, 1);
+
+    return proc;
+}
+
+void refill_procpool (void)
+{
+    if (!procpool_size)
+        return;
+
+    lock(&procpool_lock);
+    if (procpool_filling || procpool_count >= procpool_size) {
+        unlock(&procpool_lock);
+        return;
+    }
+
+    struct shim_thread * new = get_new_internal_thread();
+    if (new) {
+        PAL_HANDLE handle = thread_create(procpool_filler, new);
+        if (handle) {
+            new->pal_handle = handle;
+            procpool_filling = true;
+        } else {
+            put_thread(new);
+        }
+    }
+    unlock(&procpool_lock);
+}
+
+void destroy_procpool (void)
+{
+    if (!procpool_size)
+        return;
+
+    lock(&procpool_lock);
+    /* A running filler releases the process it is creating */
+    procpool_size = 0;
+    while (procpool_count)
+        release_process(procpool[--procpool_count]);
+    unlock(&procpool_lock);
+}
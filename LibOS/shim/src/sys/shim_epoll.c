@@ -107,8 +107,8 @@ static void update_epoll(struct shim_epoll_handle* epoll) {
         if (!tmp->pal_handle)
             continue;
 
-        debug("found handle %p (pal handle %p) from epoll handle %p\n", tmp->handle,
-              tmp->pal_handle, epoll);
+        debug_trace("found handle %p (pal handle %p) from epoll handle %p\n", tmp->handle,
+                    tmp->pal_handle, epoll);
 
         epoll->pal_fds[npals]     = tmp->fd;
         epoll->pal_handles[npals] = tmp->pal_handle;
@@ -331,7 +331,7 @@ retry:
 
     LISTP_FOR_EACH_ENTRY(epoll_fd, &epoll->fds, list) {
         if (polled == epoll_fd->pal_handle) {
-            debug("epoll: fd %d (handle %p) polled\n", epoll_fd->fd, epoll_fd->handle);
+            debug_trace("epoll: fd %d (handle %p) polled\n", epoll_fd->fd, epoll_fd->handle);
 
             if (attr.disconnected) {
                 epoll_fd->revents |= EPOLLERR | EPOLLHUP | EPOLLRDHUP;
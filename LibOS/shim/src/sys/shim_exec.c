@@ -331,6 +331,9 @@ int shim_do_execve (const char * file, const char ** argv,
             return -EFAULT;
     }
 
+    /* The old image goes away: finish any post-copy fork session first */
+    postcopy_drain(true);
+
     BEGIN_PROFILE_INTERVAL();
 
 
@@ -537,6 +540,8 @@ err:
      * to not confuse the parent and the execve'ed child */
     debug("Temporary process %u exited after emulating execve (by forking new process to replace this one)\n",
           cur_process.vmid & 0xFFFF);
+    destroy_procpool();
+    debug_log_flush();
     MASTER_LOCK();
     DkProcessExit(0);
 
@@ -144,6 +144,10 @@ int try_process_exit (int error_code, int term_signal)
     if (check_last_thread(cur_thread))
         return 0;
 
+    /* A child forked with post-copy may still read our memory */
+    postcopy_drain(false);
+    destroy_procpool();
+
     struct shim_thread * async_thread = terminate_async_helper();
     if (async_thread)
         /* TODO: wait for the thread to exit in host.
@@ -69,6 +69,7 @@ int create_checkpoint(const char* cpdir, IDTYPE* sid) {
     INIT_LIST_HEAD(cpsession, list);
     cpsession->finish_event = DkNotificationEventCreate(PAL_FALSE);
     cpsession->cpfile       = NULL;
+    memset(&cpsession->cpstore, 0, sizeof(cpsession->cpstore));
 
     int len        = strlen(cpdir);
     char* filename = __alloca(len + 10);
@@ -283,3 +284,34 @@ int shim_do_checkpoint(const char* filename) {
 
     return 0;
 }
+
+static int migrate_snapshot(struct shim_cp_store* store, struct shim_thread* thread,
+                            struct shim_process* process, va_list ap) {
+    __UNUSED(ap);
+    BEGIN_MIGRATION_DEF(snapshot, struct shim_thread* thread, struct shim_process* process) {
+        DEFINE_MIGRATE(process, process, sizeof(struct shim_process));
+        DEFINE_MIGRATE(all_mounts, NULL, 0);
+        DEFINE_MIGRATE(all_vmas, NULL, 0);
+        DEFINE_MIGRATE(running_thread, thread, sizeof(struct shim_thread));
+        DEFINE_MIGRATE(handle_map, thread->handle_map, sizeof(struct shim_handle_map));
+        DEFINE_MIGRATE(migratable, NULL, 0);
+        DEFINE_MIGRATE(brk, NULL, 0);
+        DEFINE_MIGRATE(loaded_libraries, NULL, 0);
+#ifdef DEBUG
+        DEFINE_MIGRATE(gdb_map, NULL, 0);
+#endif
+    }
+    END_MIGRATION_DEF(snapshot)
+
+    return START_MIGRATE(store, snapshot, thread, process);
+}
+
+/* Save the process in the snapshot file given by sys.snapshot. Only the calling
+ * thread is saved (as in fork), and it resumes in the restored process by
+ * returning 0 from the system call it is in. */
+int create_snapshot(void) {
+    int ret = do_snapshot_process(&migrate_snapshot, get_cur_thread());
+    if (ret < 0)
+        debug("failed creating snapshot (ret = %d)\n", ret);
+    return ret;
+}
@@ -25,6 +25,7 @@
 #include <pal_error.h>
 #include <shim_fs.h>
 #include <shim_handle.h>
+#include <shim_checkpoint.h>
 #include <shim_internal.h>
 #include <shim_profile.h>
 #include <shim_table.h>
@@ -97,9 +98,19 @@ void* shim_do_mmap(void* addr, size_t length, int prot, int flags, int fd, off_t
             put_handle(hdl);
             return (void*)-ENODEV;
         }
+    } else if (flags & MAP_SHARED) {
+        /*
+         * Back shared anonymous memory with a "shm:" stream, so that child
+         * processes map the same memory instead of receiving a copy of it.
+         * Hosts without shared memory (e.g., SGX) keep it private.
+         */
+        if (create_shm_handle(length, &hdl) < 0)
+            hdl = NULL;
+        offset = 0;
     }
 
     if (addr) {
+        postcopy_flush_range(addr, length, true);
         bkeep_mmap(addr, length, prot, flags, hdl, offset, NULL);
     } else {
         addr = bkeep_unmapped_heap(length, prot, flags, hdl, offset, NULL);
@@ -154,6 +165,8 @@ int shim_do_mprotect(void* addr, size_t length, int prot) {
     if (!IS_PAGE_ALIGNED(length))
         length = PAGE_ALIGN_UP(length);
 
+    postcopy_flush_range(addr, length, false);
+
     if (bkeep_mprotect(addr, length, prot, 0) < 0)
         return -EPERM;
 
@@ -195,6 +208,8 @@ int shim_do_munmap(void* addr, size_t length) {
     if (bkeep_mprotect(addr, length, PROT_NONE, 0) < 0)
         return -EPERM;
 
+    postcopy_flush_range(addr, length, true);
+
     DkVirtualMemoryFree(addr, length);
 
     if (bkeep_munmap(addr, length, 0) < 0)
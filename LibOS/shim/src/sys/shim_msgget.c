@@ -217,11 +217,35 @@ static void __free_msg_linked_qobjs(struct shim_msg_handle* msgq, void* obj) {
     }
 }
 
+/* Frees the buffers of the kept texts of all messages in the queue */
+static void __free_msg_kept_texts(struct shim_msg_handle* msgq) {
+    for (struct msg_type* mtype = msgq->types; mtype < &msgq->types[msgq->ntypes]; mtype++) {
+        struct msg_item* msg = mtype->msgs;
+        while (msg) {
+            void* next = msg->next;
+
+            if (msg->kept) {
+                free(((struct msg_kept_text*)msg->data)->buf);
+            } else {
+                /* skip the extension objects of the message */
+                size_t copysize = MSG_ITEM_DATA_SIZE(msg->size);
+                while (copysize < msg->size) {
+                    copysize += MSG_EXT_ITEM_DATA_SIZE(msg->size - copysize);
+                    next = ((struct msg_ext_item*)next)->next;
+                }
+            }
+
+            msg = next;
+        }
+    }
+}
+
 static int __del_msg_handle(struct shim_msg_handle* msgq) {
     if (msgq->deleted)
         return -EIDRM;
 
     msgq->deleted = true;
+    __free_msg_kept_texts(msgq);
     free(msgq->queue);
     msgq->queuesize = 0;
     msgq->queueused = 0;
@@ -378,7 +402,7 @@ int shim_do_msgsnd(int msqid, const void* msgp, size_t msgsz, int msgflg) {
     if ((ret = connect_msg_handle(msqid, &msgq)) < 0)
         return ret;
 
-    ret = add_sysv_msg(msgq, msgbuf->mtype, msgsz, msgbuf->mtext, NULL);
+    ret = add_sysv_msg(msgq, msgbuf->mtype, msgsz, msgbuf->mtext, NULL, NULL);
     put_msg_handle(msgq);
     return ret;
 }
@@ -481,8 +505,15 @@ static struct msg_type* __add_msg_type(int type, struct msg_type** ptypes, int*
 
 static int __load_msg_qobjs(struct shim_msg_handle* msgq, struct msg_type* mtype,
                             struct msg_item* msg, void* data) {
-    size_t copysize = MSG_ITEM_DATA_SIZE(msg->size);
-    memcpy(data, msg->data, copysize);
+    size_t copysize = msg->size;
+    if (msg->kept) {
+        struct msg_kept_text* kept = (struct msg_kept_text*)msg->data;
+        memcpy(data, kept->text, msg->size);
+        free(kept->buf);
+    } else {
+        copysize = MSG_ITEM_DATA_SIZE(msg->size);
+        memcpy(data, msg->data, copysize);
+    }
     mtype->msgs = msg->next;
     __free_msg_qobj(msgq, msg);
 
@@ -505,7 +536,7 @@ static int __load_msg_qobjs(struct shim_msg_handle* msgq, struct msg_type* mtype
 }
 
 static int __store_msg_qobjs(struct shim_msg_handle* msgq, struct msg_type* mtype, size_t size,
-                             const void* data) {
+                             const void* data, void** bufp) {
     struct msg_item* newmsg = __get_msg_qobj(msgq);
     if (!newmsg)
         return -EAGAIN;
@@ -514,8 +545,18 @@ static int __store_msg_qobjs(struct shim_msg_handle* msgq, struct msg_type* mtyp
 
     newmsg->next    = NULL;
     newmsg->size    = size;
-    size_t copysize = MSG_ITEM_DATA_SIZE(size);
-    memcpy(newmsg->data, data, copysize);
+    newmsg->kept    = bufp && *bufp;
+    size_t copysize = size;
+    if (newmsg->kept) {
+        /* take the buffer instead of copying the text into queue objects */
+        struct msg_kept_text* kept = (struct msg_kept_text*)newmsg->data;
+        kept->buf  = *bufp;
+        kept->text = data;
+        *bufp      = NULL;
+    } else {
+        copysize = MSG_ITEM_DATA_SIZE(size);
+        memcpy(newmsg->data, data, copysize);
+    }
 
     if (mtype->msg_tail) {
         mtype->msg_tail->next = newmsg;
@@ -566,7 +607,7 @@ static struct sysv_balance_policy msg_policy = {
 DEFINE_PROFILE_INTERVAL(add_sysv_msg, sysv_msg);
 
 int add_sysv_msg(struct shim_msg_handle* msgq, long type, size_t size, const void* data,
-                 struct sysv_client* src) {
+                 void** bufp, struct sysv_client* src) {
     BEGIN_PROFILE_INTERVAL();
 
     struct shim_handle* hdl = MSG_TO_HANDLE(msgq);
@@ -586,7 +627,7 @@ int add_sysv_msg(struct shim_msg_handle* msgq, long type, size_t size, const voi
 
     struct msg_type* mtype = __add_msg_type(type, &msgq->types, &msgq->ntypes, &msgq->maxtypes);
 
-    if ((ret = __store_msg_qobjs(msgq, mtype, size, data)) < 0)
+    if ((ret = __store_msg_qobjs(msgq, mtype, size, data, bufp)) < 0)
         goto out_locked;
 
 #if MIGRATE_SYSV_MSG == 1
@@ -864,7 +905,7 @@ static int __load_msg_persist(struct shim_msg_handle* msgq, bool readmsg) {
         if (!mtype || mtype->type != m->type)
             mtype = __add_msg_type(m->type, &msgq->types, &msgq->ntypes, &msgq->maxtypes);
 
-        if ((ret = __store_msg_qobjs(msgq, mtype, m->size, m->data)) < 0)
+        if ((ret = __store_msg_qobjs(msgq, mtype, m->size, m->data, NULL)) < 0)
             goto out;
     };
 
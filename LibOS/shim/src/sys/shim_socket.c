@@ -964,6 +964,164 @@ int shim_do_accept4(int fd, struct sockaddr* addr, socklen_t* addrlen, int flags
     return ret;
 }
 
+static void inet_to_pal_addr(int domain, PAL_SOCKADDR* paddr, const struct addr_inet* addr) {
+    memset(paddr, 0, sizeof(*paddr));
+    paddr->port = addr->ext_port;
+
+    if (domain == AF_INET) {
+        paddr->family = PAL_AF_INET;
+        memcpy(paddr->addr, &addr->addr.v4, sizeof(addr->addr.v4));
+    } else {
+        paddr->family = PAL_AF_INET6;
+        memcpy(paddr->addr, &addr->addr.v6, sizeof(addr->addr.v6));
+    }
+}
+
+static int inet_from_pal_addr(int domain, struct addr_inet* addr, const PAL_SOCKADDR* paddr) {
+    if (domain == AF_INET && paddr->family == PAL_AF_INET) {
+        memcpy(&addr->addr.v4, paddr->addr, sizeof(addr->addr.v4));
+    } else if (domain == AF_INET6 && paddr->family == PAL_AF_INET6) {
+        memcpy(&addr->addr.v6, paddr->addr, sizeof(addr->addr.v6));
+    } else {
+        return -EINVAL;
+    }
+
+    addr->ext_port = paddr->port;
+    return 0;
+}
+
+/* Datagrams on unconnected sockets are sent and received with binary
+ * addresses through DkDatagramSend() and DkDatagramReceive(), this many at a
+ * time for sendmmsg() and recvmmsg(). */
+#define DGRAM_BATCH 16
+
+/* Fill in a datagram to send from an iovec array and a destination address.
+ * Several buffers are gathered into a new one, returned in *bounce. */
+static int dgram_prepare(struct shim_sock_handle* sock, PAL_DATAGRAM* dgram, void** bounce,
+                         struct iovec* bufs, size_t nbufs, const struct sockaddr* addr,
+                         socklen_t addrlen) {
+    *bounce = NULL;
+
+    if (!addr)
+        return -EDESTADDRREQ;
+
+    if (test_user_memory((void*)addr, addrlen, false) || addrlen < sizeof(sa_family_t))
+        return -EFAULT;
+
+    if (addr->sa_family != sock->domain || addrlen < minimal_addrlen(addr->sa_family))
+        return -EINVAL;
+
+    if (nbufs && (!bufs || test_user_memory(bufs, sizeof(*bufs) * nbufs, false)))
+        return -EFAULT;
+
+    size_t size = 0;
+    for (size_t i = 0; i < nbufs; i++) {
+        if (!bufs[i].iov_base || test_user_memory(bufs[i].iov_base, bufs[i].iov_len, false))
+            return -EFAULT;
+        size += bufs[i].iov_len;
+    }
+
+    struct addr_inet dest;
+    inet_save_addr(sock->domain, &dest, addr);
+    inet_rebase_port(false, sock->domain, &dest, false);
+    inet_to_pal_addr(sock->domain, &dgram->addr, &dest);
+
+    dgram->size  = size;
+    dgram->bytes = 0;
+
+    if (nbufs == 1) {
+        dgram->buffer = bufs[0].iov_base;
+        return 0;
+    }
+
+    char* buf = malloc(size ? size : 1);
+    if (!buf)
+        return -ENOMEM;
+
+    for (size_t i = 0, off = 0; i < nbufs; off += bufs[i].iov_len, i++)
+        memcpy(buf + off, bufs[i].iov_base, bufs[i].iov_len);
+
+    dgram->buffer = buf;
+    *bounce = buf;
+    return 0;
+}
+
+/* Send the messages of sendmmsg() on an unconnected datagram socket. Returns
+ * the number of messages sent, or an error if none was. */
+static ssize_t dgram_sendmmsg(struct shim_sock_handle* sock, PAL_HANDLE pal_hdl,
+                              struct mmsghdr* msgs, size_t vlen) {
+    PAL_DATAGRAM dgrams[DGRAM_BATCH];
+    void* bounces[DGRAM_BATCH];
+    size_t sent = 0;
+    int ret = 0;
+
+    while (sent < vlen && !ret) {
+        size_t n;
+        for (n = 0; n < DGRAM_BATCH && sent + n < vlen; n++) {
+            struct msghdr* m = &msgs[sent + n].msg_hdr;
+            ret = dgram_prepare(sock, &dgrams[n], &bounces[n], m->msg_iov, m->msg_iovlen,
+                                m->msg_name, m->msg_namelen);
+            if (ret < 0)
+                break;
+        }
+
+        if (!n)
+            break;
+
+        PAL_NUM done = DkDatagramSend(pal_hdl, dgrams, n);
+        if (!done)
+            ret = (PAL_NATIVE_ERRNO == PAL_ERROR_STREAMEXIST) ? -ECONNABORTED : -PAL_ERRNO;
+
+        for (size_t i = 0; i < n; i++) {
+            if (i < done)
+                msgs[sent + i].msg_len = dgrams[i].bytes;
+            free(bounces[i]);
+        }
+
+        sent += done;
+        if (done < n)
+            break;
+    }
+
+    return sent ? (ssize_t)sent : ret;
+}
+
+/* Check that a socket can send, and open the PAL handle of a datagram socket
+ * which is neither bound nor connected. Sets *by_addr if each datagram is
+ * sent to its own address. Called with hdl->lock held. */
+static int sock_prepare_send(struct shim_handle* hdl, PAL_HANDLE* pal_hdl, bool* by_addr) {
+    struct shim_sock_handle* sock = &hdl->info.sock;
+
+    *pal_hdl = hdl->pal_handle;
+    *by_addr = false;
+
+    /* Data gram sock need not be conneted or bound at all */
+    if (sock->sock_type == SOCK_STREAM && sock->sock_state != SOCK_CONNECTED &&
+        sock->sock_state != SOCK_BOUNDCONNECTED && sock->sock_state != SOCK_ACCEPTED)
+        return -ENOTCONN;
+
+    if (sock->sock_type == SOCK_DGRAM && sock->sock_state == SOCK_SHUTDOWN)
+        return -ENOTCONN;
+
+    if (!(hdl->acc_mode & MAY_WRITE))
+        return -ECONNRESET;
+
+    if (sock->sock_type == SOCK_DGRAM && sock->sock_state != SOCK_BOUNDCONNECTED &&
+        sock->sock_state != SOCK_CONNECTED) {
+        if (sock->sock_state == SOCK_CREATED && !*pal_hdl) {
+            *pal_hdl = DkStreamOpen("udp:", 0, 0, 0, hdl->flags & O_NONBLOCK);
+            if (!*pal_hdl)
+                return -PAL_ERRNO;
+
+            hdl->pal_handle = *pal_hdl;
+        }
+
+        *by_addr = true;
+    }
+
+    return 0;
+}
+
 static ssize_t do_sendmsg(int fd, struct iovec* bufs, int nbufs, int flags,
                           const struct sockaddr* addr, socklen_t addrlen) {
     // Issue #752 - https://github.com/oscarlab/graphene/issues/752
@@ -993,71 +1151,41 @@ static ssize_t do_sendmsg(int fd, struct iovec* bufs, int nbufs, int flags,
 
     lock(&hdl->lock);
 
-    PAL_HANDLE pal_hdl = hdl->pal_handle;
-    char* uri          = NULL;
-
-    /* Data gram sock need not be conneted or bound at all */
-    if (sock->sock_type == SOCK_STREAM && sock->sock_state != SOCK_CONNECTED &&
-        sock->sock_state != SOCK_BOUNDCONNECTED && sock->sock_state != SOCK_ACCEPTED) {
-        ret = -ENOTCONN;
-        goto out_locked;
-    }
-
-    if (sock->sock_type == SOCK_DGRAM && sock->sock_state == SOCK_SHUTDOWN) {
-        ret = -ENOTCONN;
-        goto out_locked;
-    }
+    PAL_HANDLE pal_hdl;
+    bool by_addr;
 
-    if (!(hdl->acc_mode & MAY_WRITE)) {
-        ret = -ECONNRESET;
+    ret = sock_prepare_send(hdl, &pal_hdl, &by_addr);
+    if (ret < 0)
         goto out_locked;
-    }
 
-    if (sock->sock_type == SOCK_DGRAM && sock->sock_state != SOCK_BOUNDCONNECTED &&
-        sock->sock_state != SOCK_CONNECTED) {
-        if (!addr) {
-            ret = -EDESTADDRREQ;
-            goto out_locked;
-        }
-
-        if (sock->sock_state == SOCK_CREATED && !pal_hdl) {
-            pal_hdl = DkStreamOpen("udp:", 0, 0, 0, hdl->flags & O_NONBLOCK);
-            if (!pal_hdl) {
-                ret = -PAL_ERRNO;
-                goto out_locked;
-            }
-
-            hdl->pal_handle = pal_hdl;
-        }
+    unlock(&hdl->lock);
 
-        if (addr && addr->sa_family != sock->domain) {
-            ret = -EINVAL;
-            goto out_locked;
+    if (by_addr) {
+        /* one datagram, whatever the number of buffers */
+        PAL_DATAGRAM dgram;
+        void* bounce;
+
+        ret = dgram_prepare(sock, &dgram, &bounce, bufs, nbufs, addr, addrlen);
+        if (ret == 0) {
+            if (DkDatagramSend(pal_hdl, &dgram, 1))
+                ret = dgram.bytes;
+            else
+                ret = (PAL_NATIVE_ERRNO == PAL_ERROR_STREAMEXIST) ? -ECONNABORTED : -PAL_ERRNO;
+            free(bounce);
         }
 
-        uri = __alloca(SOCK_URI_SIZE);
-    }
-
-    unlock(&hdl->lock);
-
-    if (uri) {
-        struct addr_inet addr_buf;
-        inet_save_addr(sock->domain, &addr_buf, addr);
-        inet_rebase_port(false, sock->domain, &addr_buf, false);
-        memcpy(uri, "udp:", 5);
-        if ((ret = inet_translate_addr(sock->domain, uri + 4, SOCK_URI_SIZE - 4, &addr_buf)) < 0) {
+        if (ret < 0) {
             lock(&hdl->lock);
             goto out_locked;
         }
-
-        debug("next packet send to %s\n", uri);
+        goto out;
     }
 
     int bytes = 0;
     ret       = 0;
 
     for (int i = 0; i < nbufs; i++) {
-        ret = DkStreamWrite(pal_hdl, 0, bufs[i].iov_len, bufs[i].iov_base, uri);
+        ret = DkStreamWrite(pal_hdl, 0, bufs[i].iov_len, bufs[i].iov_base, NULL);
 
         if (!ret) {
             ret = (PAL_NATIVE_ERRNO == PAL_ERROR_STREAMEXIST) ? -ECONNABORTED : -PAL_ERRNO;
@@ -1101,9 +1229,46 @@ ssize_t shim_do_sendmsg(int sockfd, struct msghdr* msg, int flags) {
 }
 
 ssize_t shim_do_sendmmsg(int sockfd, struct mmsghdr* msg, size_t vlen, int flags) {
+    if (test_user_memory(msg, sizeof(*msg) * vlen, true))
+        return -EFAULT;
+
+    struct shim_handle* hdl = get_fd_handle(sockfd, NULL, NULL);
+    if (!hdl)
+        return -EBADF;
+
+    ssize_t ret = -ENOTSOCK;
+    if (hdl->type != TYPE_SOCK) {
+        put_handle(hdl);
+        return ret;
+    }
+
+    struct shim_sock_handle* sock = &hdl->info.sock;
+    PAL_HANDLE pal_hdl;
+    bool by_addr;
+
+    lock(&hdl->lock);
+    ret = sock_prepare_send(hdl, &pal_hdl, &by_addr);
+    if (ret < 0)
+        sock->error = -ret;
+    unlock(&hdl->lock);
+
+    if (ret >= 0 && by_addr) {
+        ret = dgram_sendmmsg(sock, pal_hdl, msg, vlen);
+        if (ret < 0) {
+            lock(&hdl->lock);
+            sock->error = -ret;
+            unlock(&hdl->lock);
+        }
+    }
+
+    put_handle(hdl);
+
+    if (ret < 0 || by_addr)
+        return ret;
+
     ssize_t total = 0;
 
-    for (size_t i = 0; i * sizeof(struct mmsghdr) < vlen; i++) {
+    for (size_t i = 0; i < vlen; i++) {
         struct msghdr* m = &msg[i].msg_hdr;
 
         ssize_t bytes =
@@ -1118,6 +1283,92 @@ ssize_t shim_do_sendmmsg(int sockfd, struct mmsghdr* msg, size_t vlen, int flags
     return total;
 }
 
+/* Copy a received datagram out to an iovec array. The rest is discarded, as
+ * the kernel does. */
+static size_t dgram_scatter(struct iovec* bufs, int nbufs, const char* data, size_t size) {
+    size_t copied = 0;
+
+    for (int i = 0; i < nbufs && copied < size; i++) {
+        size_t n = MIN(bufs[i].iov_len, size - copied);
+        memcpy(bufs[i].iov_base, data + copied, n);
+        copied += n;
+    }
+
+    return copied;
+}
+
+static int dgram_copy_addr(struct shim_sock_handle* sock, const PAL_SOCKADDR* src,
+                           struct sockaddr* addr, socklen_t* addrlen) {
+    struct addr_inet from;
+
+    if (inet_from_pal_addr(sock->domain, &from, src) < 0)
+        return -EINVAL;
+
+    inet_rebase_port(true, sock->domain, &from, false);
+    inet_copy_addr(sock->domain, addr, &from);
+    *addrlen = (sock->domain == AF_INET) ? sizeof(struct sockaddr_in)
+                                         : sizeof(struct sockaddr_in6);
+    return 0;
+}
+
+/* Receive one datagram on an unconnected datagram socket. With MSG_PEEK, or
+ * with several buffers, the datagram goes to the peek buffer first. */
+static ssize_t dgram_recvmsg(struct shim_sock_handle* sock, PAL_HANDLE pal_hdl,
+                             struct shim_peek_buffer** peek, struct iovec* bufs, int nbufs,
+                             int flags, struct sockaddr* addr, socklen_t* addrlen) {
+    struct shim_peek_buffer* peek_buffer = *peek;
+    PAL_DATAGRAM dgram;
+    ssize_t ret;
+
+    if (!peek_buffer && nbufs == 1 && !(flags & MSG_PEEK)) {
+        dgram.buffer = bufs[0].iov_base;
+        dgram.size   = bufs[0].iov_len;
+
+        if (!DkDatagramReceive(pal_hdl, &dgram, 1))
+            return (PAL_NATIVE_ERRNO == PAL_ERROR_STREAMNOTEXIST) ? -ECONNABORTED : -PAL_ERRNO;
+
+        ret = MIN(dgram.bytes, dgram.size);
+        if (addr && dgram_copy_addr(sock, &dgram.addr, addr, addrlen) < 0)
+            return -EINVAL;
+        return ret;
+    }
+
+    if (!peek_buffer) {
+        peek_buffer = malloc(sizeof(struct shim_peek_buffer) + UDP_MAX);
+        if (!peek_buffer)
+            return -ENOMEM;
+
+        peek_buffer->size  = UDP_MAX;
+        peek_buffer->start = 0;
+        peek_buffer->end   = 0;
+
+        dgram.buffer = peek_buffer->buf;
+        dgram.size   = UDP_MAX;
+
+        if (!DkDatagramReceive(pal_hdl, &dgram, 1)) {
+            free(peek_buffer);
+            return (PAL_NATIVE_ERRNO == PAL_ERROR_STREAMNOTEXIST) ? -ECONNABORTED : -PAL_ERRNO;
+        }
+
+        peek_buffer->end  = MIN(dgram.bytes, dgram.size);
+        peek_buffer->addr = dgram.addr;
+        *peek = peek_buffer;
+    }
+
+    ret = dgram_scatter(bufs, nbufs, peek_buffer->buf + peek_buffer->start,
+                        peek_buffer->end - peek_buffer->start);
+
+    if (addr && dgram_copy_addr(sock, &peek_buffer->addr, addr, addrlen) < 0)
+        ret = -EINVAL;
+
+    if (!(flags & MSG_PEEK)) {
+        free(peek_buffer);
+        *peek = NULL;
+    }
+
+    return ret;
+}
+
 static ssize_t do_recvmsg(int fd, struct iovec* bufs, int nbufs, int flags, struct sockaddr* addr,
                           socklen_t* addrlen) {
     /* TODO handle flags properly. For now, explicitly return an error. */
@@ -1166,7 +1417,7 @@ static ssize_t do_recvmsg(int fd, struct iovec* bufs, int nbufs, int flags, stru
     peek_buffer = sock->peek_buffer;
     sock->peek_buffer = NULL;
     PAL_HANDLE pal_hdl = hdl->pal_handle;
-    char* uri          = NULL;
+    bool by_addr       = false;
 
     if (sock->sock_type == SOCK_STREAM && sock->sock_state != SOCK_CONNECTED &&
         sock->sock_state != SOCK_BOUNDCONNECTED && sock->sock_state != SOCK_ACCEPTED) {
@@ -1179,18 +1430,27 @@ static ssize_t do_recvmsg(int fd, struct iovec* bufs, int nbufs, int flags, stru
         goto out_locked;
     }
 
-    if (addr && sock->sock_type == SOCK_DGRAM && sock->sock_state != SOCK_CONNECTED &&
+    if (sock->sock_type == SOCK_DGRAM && sock->sock_state != SOCK_CONNECTED &&
         sock->sock_state != SOCK_BOUNDCONNECTED) {
         if (sock->sock_state == SOCK_CREATED) {
             ret = -EINVAL;
             goto out_locked;
         }
 
-        uri = __alloca(SOCK_URI_SIZE);
+        by_addr = true;
     }
 
     unlock(&hdl->lock);
 
+    if (by_addr) {
+        ret = dgram_recvmsg(sock, pal_hdl, &peek_buffer, bufs, nbufs, flags, addr, addrlen);
+        if (ret < 0) {
+            lock(&hdl->lock);
+            goto free_peek;
+        }
+        goto save_peek;
+    }
+
     if (flags & MSG_PEEK) {
         /*build buffer*/
         if (!peek_buffer) {
@@ -1224,13 +1484,9 @@ static ssize_t do_recvmsg(int fd, struct iovec* bufs, int nbufs, int flags, stru
     if (peek_buffer && peek_buffer->end - peek_buffer->start < expected_size) {
         /*fill buffer*/
         ret = DkStreamRead(pal_hdl, 0, peek_buffer->size - peek_buffer->end,
-                            &peek_buffer->buf[peek_buffer->end], uri, uri ? SOCK_URI_SIZE : 0);
-        if (ret != 0) {
+                            &peek_buffer->buf[peek_buffer->end], NULL, 0);
+        if (ret != 0)
             peek_buffer->end += ret;
-
-            if (uri)
-                memcpy(peek_buffer->uri, uri, SOCK_URI_SIZE);
-        }
     }
 
     for (int i = 0; i < nbufs; i++) {
@@ -1239,10 +1495,8 @@ static ssize_t do_recvmsg(int fd, struct iovec* bufs, int nbufs, int flags, stru
             /*copy date from peek buffer*/
             received = MIN(bufs[i].iov_len, peek_buffer->end - (peek_buffer->start + bytes));
             memcpy(bufs[i].iov_base, &peek_buffer->buf[peek_buffer->start], received);
-            uri = peek_buffer->uri;
         } else {
-            received = DkStreamRead(pal_hdl, 0, bufs[i].iov_len, bufs[i].iov_base, uri,
-                               uri ? SOCK_URI_SIZE : 0);
+            received = DkStreamRead(pal_hdl, 0, bufs[i].iov_len, bufs[i].iov_base, NULL, 0);
         }
 
         if (!received) {
@@ -1259,22 +1513,7 @@ static ssize_t do_recvmsg(int fd, struct iovec* bufs, int nbufs, int flags, stru
             }
 
             if (sock->domain == AF_INET || sock->domain == AF_INET6) {
-                if (uri) {
-                    struct addr_inet conn;
-
-                    if ((ret = inet_parse_addr(sock->domain, sock->sock_type, uri, &conn, NULL)) < 0) {
-                        lock(&hdl->lock);
-                        goto free_peek;
-                    }
-
-                    debug("last packet received from %s\n", uri);
-
-                    inet_rebase_port(true, sock->domain, &conn, false);
-                    inet_copy_addr(sock->domain, addr, &conn);
-                } else {
-                    inet_copy_addr(sock->domain, addr, &sock->addr.in.conn);
-                }
-
+                inet_copy_addr(sock->domain, addr, &sock->addr.in.conn);
                 *addrlen = (sock->domain == AF_INET) ? sizeof(struct sockaddr_in)
                                                      : sizeof(struct sockaddr_in6);
             }
@@ -1303,6 +1542,7 @@ static ssize_t do_recvmsg(int fd, struct iovec* bufs, int nbufs, int flags, stru
         }
     }
 
+save_peek:
     if (!peek_buffer)
         goto out;
 
@@ -1342,6 +1582,90 @@ ssize_t shim_do_recvmsg(int sockfd, struct msghdr* msg, int flags) {
                       &msg->msg_namelen);
 }
 
+/* Receive the messages of recvmmsg() on an unconnected datagram socket, in
+ * batches. Each message must have a single buffer. Returns 0 if the socket
+ * or the messages do not allow it, for the caller to fall back to recvmsg(). */
+static ssize_t dgram_recvmmsg(int sockfd, struct mmsghdr* msgs, size_t vlen, int flags) {
+    for (size_t i = 0; i < vlen; i++) {
+        struct msghdr* m = &msgs[i].msg_hdr;
+        if (m->msg_iovlen != 1 || test_user_memory(m->msg_iov, sizeof(*m->msg_iov), false) ||
+            !m->msg_iov[0].iov_base ||
+            test_user_memory(m->msg_iov[0].iov_base, m->msg_iov[0].iov_len, true))
+            return 0;
+        if (m->msg_name && test_user_memory(m->msg_name, m->msg_namelen, true))
+            return 0;
+    }
+
+    struct shim_handle* hdl = get_fd_handle(sockfd, NULL, NULL);
+    if (!hdl)
+        return -EBADF;
+
+    ssize_t ret = 0;
+    if (hdl->type != TYPE_SOCK)
+        goto out;
+
+    struct shim_sock_handle* sock = &hdl->info.sock;
+    PAL_HANDLE pal_hdl = hdl->pal_handle;
+
+    lock(&hdl->lock);
+    bool batch = sock->sock_type == SOCK_DGRAM && !sock->peek_buffer &&
+                 (sock->domain == AF_INET || sock->domain == AF_INET6) &&
+                 (sock->sock_state == SOCK_BOUND || sock->sock_state == SOCK_LISTENED) &&
+                 (hdl->acc_mode & MAY_READ);
+    unlock(&hdl->lock);
+
+    if (!batch)
+        goto out;
+
+    PAL_DATAGRAM dgrams[DGRAM_BATCH];
+    size_t received = 0;
+
+    while (received < vlen) {
+        size_t n = MIN(vlen - received, (size_t)DGRAM_BATCH);
+
+        for (size_t i = 0; i < n; i++) {
+            struct iovec* iov = msgs[received + i].msg_hdr.msg_iov;
+            dgrams[i].buffer = iov[0].iov_base;
+            dgrams[i].size   = iov[0].iov_len;
+        }
+
+        PAL_NUM done = DkDatagramReceive(pal_hdl, dgrams, n);
+        if (!done) {
+            ret = (PAL_NATIVE_ERRNO == PAL_ERROR_STREAMNOTEXIST) ? -ECONNABORTED : -PAL_ERRNO;
+            break;
+        }
+
+        for (size_t i = 0; i < done; i++) {
+            struct mmsghdr* m = &msgs[received + i];
+            m->msg_len = MIN(dgrams[i].bytes, dgrams[i].size);
+            if (m->msg_hdr.msg_name) {
+                if (m->msg_hdr.msg_namelen < minimal_addrlen(sock->domain) ||
+                    dgram_copy_addr(sock, &dgrams[i].addr, m->msg_hdr.msg_name,
+                                    &m->msg_hdr.msg_namelen) < 0)
+                    m->msg_hdr.msg_namelen = 0;
+            }
+        }
+
+        received += done;
+
+        /* with MSG_WAITFORONE, return what was queued rather than block */
+        if (flags & MSG_WAITFORONE)
+            break;
+    }
+
+    if (received) {
+        ret = received;
+    } else if (ret < 0) {
+        lock(&hdl->lock);
+        sock->error = -ret;
+        unlock(&hdl->lock);
+    }
+
+out:
+    put_handle(hdl);
+    return ret;
+}
+
 ssize_t shim_do_recvmmsg(int sockfd, struct mmsghdr* msg, size_t vlen, int flags,
                          struct __kernel_timespec* timeout) {
     ssize_t total = 0;
@@ -1353,16 +1677,28 @@ ssize_t shim_do_recvmmsg(int sockfd, struct mmsghdr* msg, size_t vlen, int flags
         return -EOPNOTSUPP;
     }
 
-    for (size_t i = 0; i * sizeof(struct mmsghdr) < vlen; i++) {
+    if (test_user_memory(msg, sizeof(*msg) * vlen, true))
+        return -EFAULT;
+
+    if (!(flags & ~MSG_WAITFORONE) && vlen) {
+        total = dgram_recvmmsg(sockfd, msg, vlen, flags);
+        if (total)
+            return total;
+    }
+
+    for (size_t i = 0; i < vlen; i++) {
         struct msghdr* m = &msg[i].msg_hdr;
 
-        ssize_t bytes =
-            do_recvmsg(sockfd, m->msg_iov, m->msg_iovlen, flags, m->msg_name, &m->msg_namelen);
+        ssize_t bytes = do_recvmsg(sockfd, m->msg_iov, m->msg_iovlen, flags & ~MSG_WAITFORONE,
+                                   m->msg_name, &m->msg_namelen);
         if (bytes < 0)
             return total > 0 ? total : bytes;
 
         msg[i].msg_len = bytes;
         total++;
+
+        if (flags & MSG_WAITFORONE)
+            break;
     }
 
     return total;
@@ -27,6 +27,7 @@
 #include <shim_handle.h>
 #include <shim_internal.h>
 #include <shim_table.h>
+#include <shim_vdso.h>
 
 int shim_do_gettimeofday(struct __kernel_timeval* tv, struct __kernel_timezone* tz) {
     if (!tv)
@@ -38,26 +39,26 @@ int shim_do_gettimeofday(struct __kernel_timeval* tv, struct __kernel_timezone*
     if (tz && test_user_memory(tz, sizeof(*tz), true))
         return -EFAULT;
 
-    long time = DkSystemTimeQuery();
+    uint64_t time = vdso_time_query_ns();
 
-    if (time == -1)
+    if (!time)
         return -PAL_ERRNO;
 
-    tv->tv_sec  = time / 1000000;
-    tv->tv_usec = time % 1000000;
+    tv->tv_sec  = time / 1000000000;
+    tv->tv_usec = time % 1000000000 / 1000;
     return 0;
 }
 
 time_t shim_do_time(time_t* tloc) {
-    long time = DkSystemTimeQuery();
+    uint64_t time = vdso_time_query_ns();
 
-    if (time == -1)
+    if (!time)
         return -PAL_ERRNO;
 
     if (tloc && test_user_memory(tloc, sizeof(*tloc), true))
         return -EFAULT;
 
-    time_t t = time / 1000000;
+    time_t t = time / 1000000000;
 
     if (tloc)
         *tloc = t;
@@ -75,13 +76,13 @@ int shim_do_clock_gettime(clockid_t which_clock, struct timespec* tp) {
     if (test_user_memory(tp, sizeof(*tp), true))
         return -EFAULT;
 
-    long time = DkSystemTimeQuery();
+    uint64_t time = vdso_time_query_ns();
 
-    if (time == -1)
+    if (!time)
         return -PAL_ERRNO;
 
-    tp->tv_sec  = time / 1000000;
-    tp->tv_nsec = (time % 1000000) * 1000;
+    tp->tv_sec  = time / 1000000000;
+    tp->tv_nsec = time % 1000000000;
     return 0;
 }
 
@@ -96,6 +97,6 @@ int shim_do_clock_getres(clockid_t which_clock, struct timespec* tp) {
         return -EFAULT;
 
     tp->tv_sec  = 0;
-    tp->tv_nsec = 1000;
+    tp->tv_nsec = 1;
     return 0;
 }
@@ -19,18 +19,296 @@
 #include <shim_defs.h>
 #include <shim_internal.h>
 #include <shim_ipc.h>
+#include <shim_thread.h>
+#include <shim_utils.h>
 #include <stdarg.h>
 #include <stdint.h>
 
 PAL_HANDLE debug_handle = NULL;
+int debug_level = LOG_LEVEL_TRACE;
+
+/*
+ * Debug output is asynchronous once init_debug_log() has run: every thread
+ * formats its messages into its own debug_buf, and copies each complete line
+ * into the log ring, which the log writer thread writes to debug_handle in
+ * large batches. When the ring is full, lines are dropped and the writer
+ * reports how many. Before that (or with "sys.debug.async = 0"), each line
+ * is written right away.
+ *
+ * Putting a line into the ring takes no lock, so that a thread can still
+ * print from a signal upcall which interrupted its own debug_log_put() (or
+ * from lock() itself, with DEBUG_LOCK). A producer reserves space for a
+ * record by moving head forward, copies the line, and then sets the header
+ * of the record to its length. The writer stops at the first record whose
+ * header is still zero, and zeroes the records it took before it moves tail,
+ * so that the free part of the ring is always zero.
+ *
+ * The log writer must not print debug messages itself.
+ */
+
+#define DEBUG_LOG_SIZE_DEFAULT  (256 * 1024)
+#define DEBUG_LOG_OUT_SIZE      (64 * 1024)
+#define DEBUG_LOG_PERIOD_US     10000   /* a line waits at most this long */
+#define DEBUG_LOG_DROPPED_MSG   "[...] %lu debug lines dropped\n"
+
+/* a record is a header (the length of the line) and the line, padded to
+ * the header size; a record never wraps around the end of the ring */
+#define DEBUG_LOG_HDR_SIZE      sizeof(int64_t)
+#define DEBUG_LOG_HDR_SKIP      ((int64_t)-1)   /* the ring ends unused here */
+
+static struct {
+    char* buf;
+    size_t size;                /* power of two */
+    volatile int64_t head, tail;/* free-running offsets */
+    struct atomic_int dropped;
+    volatile int64_t wakeup_sent;
+    unsigned long rate_limit;   /* lines per second, 0 for no limit */
+    volatile int64_t rate_tokens;
+    volatile int64_t rate_time;
+    char* out;                  /* the lines to write, in one batch */
+    size_t out_size;
+    struct shim_lock write_lock;/* held while writing to debug_handle */
+    PAL_HANDLE wakeup;
+    bool async;
+} debug_log;
+
+static inline volatile int64_t* debug_log_hdr(size_t off) {
+    return (volatile int64_t*)(debug_log.buf + (off & (debug_log.size - 1)));
+}
+
+static int debug_log_put(const char* str, int len) {
+    size_t need = DEBUG_LOG_HDR_SIZE + ALIGN_UP(len, DEBUG_LOG_HDR_SIZE);
+    int64_t head, tail;
+    size_t skip;
+
+    do {
+        head = debug_log.head;
+        tail = debug_log.tail;
+        size_t off = head & (debug_log.size - 1);
+        skip = debug_log.size - off < need ? debug_log.size - off : 0;
+
+        if (debug_log.size - (head - tail) < skip + need) {
+            atomic_inc(&debug_log.dropped);
+            return -1;
+        }
+    } while (cmpxchg(&debug_log.head, head, head + skip + need) != head);
+
+    if (skip) {
+        *debug_log_hdr(head) = DEBUG_LOG_HDR_SKIP;
+        head += skip;
+    }
+
+    memcpy((char*)debug_log_hdr(head) + DEBUG_LOG_HDR_SIZE, str, len);
+
+    /* publish the line before the header which covers it */
+    COMPILER_BARRIER();
+    *debug_log_hdr(head) = len;
+
+    /* wake up the writer early only once the ring is half full */
+    if (!debug_log.wakeup_sent &&
+        (size_t)(head + need - tail) >= debug_log.size / 2 &&
+        !cmpxchg(&debug_log.wakeup_sent, 0, 1))
+        DkEventSet(debug_log.wakeup);
+    return 0;
+}
+
+/* Writes out everything in the ring. Returns false if there was nothing to
+ * write. */
+static bool debug_log_write(void) {
+    bool written = false;
+
+    lock(&debug_log.write_lock);
+
+    while (true) {
+        unsigned long dropped = xchg(&debug_log.dropped.counter, 0);
+        if (dropped) {
+            char msg[64];
+            int msg_len = snprintf(msg, sizeof(msg), DEBUG_LOG_DROPPED_MSG, dropped);
+            DkStreamWrite(debug_handle, 0, msg_len, msg, NULL);
+        }
+
+        /* gather the complete lines, up to a batch; producers never write
+         * to [tail, head) once a header is set, so no lock is needed */
+        int64_t tail = debug_log.tail;
+        size_t len = 0;
+        while (tail != debug_log.head) {
+            volatile int64_t* hdr = debug_log_hdr(tail);
+            int64_t line = *hdr;
+
+            if (!line)
+                break;
+            if (line == DEBUG_LOG_HDR_SKIP) {
+                size_t skip = debug_log.size - (tail & (debug_log.size - 1));
+                memset((char*)hdr, 0, skip);
+                tail += skip;
+                continue;
+            }
+            if (len + line > debug_log.out_size)
+                break;
+
+            size_t rec = DEBUG_LOG_HDR_SIZE + ALIGN_UP(line, DEBUG_LOG_HDR_SIZE);
+            COMPILER_BARRIER();
+            memcpy(debug_log.out + len, (char*)hdr + DEBUG_LOG_HDR_SIZE, line);
+            len += line;
+            memset((char*)hdr, 0, rec);
+            tail += rec;
+        }
+
+        /* hand the space back only after zeroing it */
+        COMPILER_BARRIER();
+        bool empty = tail == debug_log.tail;
+        debug_log.tail = tail;
+
+        if (empty) {
+            debug_log.wakeup_sent = 0;
+            break;
+        }
+
+        /* drop what cannot be written */
+        for (size_t done = 0; done < len;) {
+            PAL_NUM bytes = DkStreamWrite(debug_handle, 0, len - done,
+                                          debug_log.out + done, NULL);
+            if (!bytes)
+                break;
+            done += bytes;
+        }
+        written = true;
+    }
+
+    unlock(&debug_log.write_lock);
+    return written;
+}
+
+static void debug_log_writer(void* arg) {
+    __UNUSED(arg);
+
+    __libc_tcb_t tcb;
+    allocate_tls(&tcb, false, NULL);
+
+    while (true) {
+        DkObjectsWaitAny(1, &debug_log.wakeup, DEBUG_LOG_PERIOD_US);
+        debug_log_write();
+    }
+}
+
+/* Writes out the pending lines, before the process exits */
+void debug_log_flush(void) {
+    if (debug_log.async)
+        debug_log_write();
+}
+
+/* Takes a token for a new line, if lines are rate-limited. Like
+ * debug_log_put(), this takes no lock. */
+static bool debug_log_admit(void) {
+    if (!debug_log.rate_limit)
+        return true;
+
+    /* refill the tokens of the time since the last refill, up to a second's;
+     * only the thread which moves rate_time adds them */
+    int64_t now  = DkSystemTimeQuery();
+    int64_t last = debug_log.rate_time;
+    int64_t tokens = (now - last) * debug_log.rate_limit / 1000000;
+    if (tokens > 0 && cmpxchg(&debug_log.rate_time, last, now) == last) {
+        int64_t old, new;
+        do {
+            old = debug_log.rate_tokens;
+            new = MIN(old + tokens, (int64_t)debug_log.rate_limit);
+        } while (cmpxchg(&debug_log.rate_tokens, old, new) != old);
+    }
+
+    int64_t old;
+    do {
+        old = debug_log.rate_tokens;
+        if (!old) {
+            atomic_inc(&debug_log.dropped);
+            return false;
+        }
+    } while (cmpxchg(&debug_log.rate_tokens, old, old - 1) != old);
+    return true;
+}
+
+int init_debug_log(void) {
+    char cfg[CONFIG_MAX];
+
+    if (!debug_handle || !root_config)
+        return 0;
+
+    if (get_config(root_config, "sys.debug.level", cfg, CONFIG_MAX) > 0) {
+        if (!strcmp_static(cfg, "error"))
+            debug_level = LOG_LEVEL_ERROR;
+        else if (!strcmp_static(cfg, "warning"))
+            debug_level = LOG_LEVEL_WARNING;
+        else if (!strcmp_static(cfg, "debug"))
+            debug_level = LOG_LEVEL_DEBUG;
+        else if (!strcmp_static(cfg, "trace"))
+            debug_level = LOG_LEVEL_TRACE;
+        else
+            return -EINVAL;
+    }
+
+    if (get_config(root_config, "sys.debug.rate_limit", cfg, CONFIG_MAX) > 0) {
+        debug_log.rate_limit  = parse_int(cfg);
+        debug_log.rate_tokens = debug_log.rate_limit;
+        debug_log.rate_time   = DkSystemTimeQuery();
+    }
+
+    if (get_config(root_config, "sys.debug.async", cfg, CONFIG_MAX) > 0 && cfg[0] == '0')
+        return 0;
+
+    size_t size = DEBUG_LOG_SIZE_DEFAULT;
+    if (get_config(root_config, "sys.debug.buffer_size", cfg, CONFIG_MAX) > 0)
+        size = parse_int(cfg);
+    if (size < DEBUGBUF_SIZE)
+        return -EINVAL;
+    /* round up to a power of two, for the ring offsets */
+    while (size & (size - 1))
+        size += size & -size;
+
+    debug_log.buf = malloc(size);
+    if (!debug_log.buf)
+        return -ENOMEM;
+    /* the free part of the ring is all zero, see debug_log_write() */
+    memset(debug_log.buf, 0, size);
+    debug_log.size = size;
+
+    debug_log.out_size = MIN(size, (size_t)DEBUG_LOG_OUT_SIZE);
+    debug_log.out = malloc(debug_log.out_size);
+    if (!debug_log.out)
+        return -ENOMEM;
+
+    create_lock(&debug_log.write_lock);
+    debug_log.wakeup = DkSynchronizationEventCreate(PAL_FALSE);
+    if (!debug_log.wakeup)
+        return -PAL_ERRNO;
+
+    /* lines go to the ring from now on, even before the writer runs */
+    debug_log.async = true;
+
+    if (!thread_create(debug_log_writer, NULL)) {
+        debug_log.async = false;
+        return -PAL_ERRNO;
+    }
+    return 0;
+}
 
 static inline int debug_fputs(const char* buf, int len) {
+    if (debug_log.async)
+        return debug_log_put(buf, len);
+
     if (DkStreamWrite(debug_handle, 0, len, (void*)buf, NULL) == (PAL_NUM)len)
         return 0;
     else
         return -1;
 }
 
+/* A new line is rate-limited before anything of it is formatted, and then
+ * skipped up to its end */
+static inline bool debug_skip_line(struct debug_buf* buf) {
+    if (buf->end == buf->start && !buf->dropping)
+        buf->dropping = !debug_log_admit();
+    return buf->dropping;
+}
+
 static int debug_fputch(void* f, int ch, void* b) {
     __UNUSED(f);
     struct debug_buf* buf = (struct debug_buf*)b;
@@ -66,6 +344,12 @@ void debug_puts(const char* str) {
     int len               = strlen(str);
     struct debug_buf* buf = shim_get_tls()->debug_buf;
 
+    if (debug_skip_line(buf)) {
+        if (len && str[len - 1] == '\n')
+            buf->dropping = false;
+        return;
+    }
+
     while (len) {
         int rem     = DEBUGBUF_SIZE - 4 - buf->end;
         bool isfull = true;
@@ -95,11 +379,28 @@ void debug_puts(const char* str) {
 }
 
 void debug_putch(int ch) {
-    debug_fputch(NULL, ch, shim_get_tls()->debug_buf);
+    struct debug_buf* buf = shim_get_tls()->debug_buf;
+
+    if (debug_skip_line(buf)) {
+        if (ch == '\n')
+            buf->dropping = false;
+        return;
+    }
+
+    debug_fputch(NULL, ch, buf);
 }
 
 void debug_vprintf(const char* fmt, va_list ap) {
-    vfprintfmt((void*)debug_fputch, NULL, shim_get_tls()->debug_buf, fmt, ap);
+    struct debug_buf* buf = shim_get_tls()->debug_buf;
+
+    if (debug_skip_line(buf)) {
+        int len = strlen(fmt);
+        if (len && fmt[len - 1] == '\n')
+            buf->dropping = false;
+        return;
+    }
+
+    vfprintfmt((void*)debug_fputch, NULL, buf, fmt, ap);
 }
 
 void debug_printf(const char* fmt, ...) {
@@ -115,6 +416,7 @@ void debug_setprefix(shim_tcb_t* tcb) {
 
     struct debug_buf* buf = tcb->debug_buf;
     buf->start = buf->end = 0;
+    buf->dropping = false;
 
     if (tcb->tid && !is_internal_tid(tcb->tid))
         fprintfmt(debug_fputch, NULL, buf, TID_PREFIX, tcb->tid);
@@ -20,6 +20,7 @@
 */
 
 #include <shim_types.h>
+#include <shim_vdso.h>
 
 /*
  * The symbols below need to be exported for libsysdb to inject those values,
@@ -31,16 +32,37 @@ static int (*shim_clock_gettime)(clockid_t clock, struct timespec* t)    = NULL;
 static int (*shim_gettimeofday)(struct timeval* tv, struct timezone* tz) = NULL;
 static time_t (*shim_time)(time_t* t)                                    = NULL;
 static long (*shim_getcpu)(unsigned* cpu, struct getcpu_cache* unused)   = NULL;
+static struct vdso_time_data* shim_time_data                             = NULL;
 
 EXPORT_SYMBOL(shim_clock_gettime);
 EXPORT_SYMBOL(shim_gettimeofday);
 EXPORT_SYMBOL(shim_time);
 EXPORT_SYMBOL(shim_getcpu);
+EXPORT_SYMBOL(shim_time_data);
+
+/* Reads the time from the data page; calls into the LibOS when this fails, so
+ * that it renews the mapping */
+static inline uint64_t vdso_time_ns(void) {
+    return shim_time_data ? vdso_time_read_ns(shim_time_data) : 0;
+}
 
 #define EXPORT_WEAK_SYMBOL(name) \
     __typeof__(__vdso_##name) name __attribute__((weak, alias("__vdso_" #name)))
 
 int __vdso_clock_gettime(clockid_t clock, struct timespec* t) {
+    /* the LibOS has the same time for all clocks, but only the wall and
+     * monotonic clocks come from the data page */
+    if (t && (clock == CLOCK_REALTIME || clock == CLOCK_MONOTONIC ||
+              clock == CLOCK_MONOTONIC_RAW || clock == CLOCK_REALTIME_COARSE ||
+              clock == CLOCK_MONOTONIC_COARSE || clock == CLOCK_BOOTTIME)) {
+        uint64_t ns = vdso_time_ns();
+        if (ns) {
+            t->tv_sec  = ns / 1000000000;
+            t->tv_nsec = ns % 1000000000;
+            return 0;
+        }
+    }
+
     if (shim_clock_gettime)
         return (*shim_clock_gettime)(clock, t);
     return -ENOSYS;
@@ -48,6 +70,15 @@ int __vdso_clock_gettime(clockid_t clock, struct timespec* t) {
 EXPORT_WEAK_SYMBOL(clock_gettime);
 
 int __vdso_gettimeofday(struct timeval* tv, struct timezone* tz) {
+    if (tv && !tz) {
+        uint64_t ns = vdso_time_ns();
+        if (ns) {
+            tv->tv_sec  = ns / 1000000000;
+            tv->tv_usec = ns % 1000000000 / 1000;
+            return 0;
+        }
+    }
+
     if (shim_gettimeofday)
         return (*shim_gettimeofday)(tv, tz);
     return -ENOSYS;
@@ -55,6 +86,13 @@ int __vdso_gettimeofday(struct timeval* tv, struct timezone* tz) {
 EXPORT_WEAK_SYMBOL(gettimeofday);
 
 time_t __vdso_time(time_t* t) {
+    uint64_t ns = vdso_time_ns();
+    if (ns) {
+        if (t)
+            *t = ns / 1000000000;
+        return ns / 1000000000;
+    }
+
     if (shim_time)
         return (*shim_time)(t);
     return -ENOSYS;
@@ -1,18 +1,42 @@
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+/*
+ *  USAGE:
+ *      ./fork_latency [processes] [heap MB] [fds]
+ *
+ *  Each process touches a heap of the given size and opens the given number
+ *  of file descriptors (dup()s of a pipe), then forks children one at a time.
+ *  To see what helper threads gain for large processes, compare e.g.
+ *  "./fork_latency 1 256 500" with and without sys.checkpoint.workers in the
+ *  manifest.
+ */
+
 #define DO_BENCH   1
 #define NTRIES     100
 #define TEST_TIMES 64
 
 int pids[TEST_TIMES];
 
+struct result {
+    struct timeval timevals[2];
+    /* sum of delays between fork() and the first instruction of the child */
+    unsigned long long first_insn_time;
+};
+
+static unsigned long long tv_usec(struct timeval* tv) {
+    return tv->tv_sec * 1000000ULL + tv->tv_usec;
+}
+
 int main(int argc, char** argv) {
     int times = TEST_TIMES;
+    size_t heap_size = 0;
+    int nfds = 0;
     int pipes[6];
     int i = 0;
 
@@ -22,6 +46,14 @@ int main(int argc, char** argv) {
             return -1;
     }
 
+    /* optional heap size (in MB) of the forking processes */
+    if (argc >= 3)
+        heap_size = (size_t)atoi(argv[2]) * 1024 * 1024;
+
+    /* optional number of extra file descriptors of the forking processes */
+    if (argc >= 4)
+        nfds = atoi(argv[3]);
+
     pipe(&pipes[0]);
     pipe(&pipes[2]);
     pipe(&pipes[4]);
@@ -39,27 +71,54 @@ int main(int argc, char** argv) {
             close(pipes[2]);
             close(pipes[5]);
 
+            char* heap = NULL;
+            if (heap_size) {
+                heap = malloc(heap_size);
+                if (!heap)
+                    exit(1);
+                memset(heap, 1, heap_size);
+            }
+
+            for (int fd = 0; fd < nfds; fd++)
+                if (dup(pipes[0]) < 0)
+                    exit(1);
+
+            int first_insn[2];
+            pipe(first_insn);
+
             char byte;
             read(pipes[0], &byte, 1);
 
-            struct timeval timevals[2];
-            gettimeofday(&timevals[0], NULL);
+            struct result result;
+            result.first_insn_time = 0;
+            gettimeofday(&result.timevals[0], NULL);
 
             for (int count = 0; count < NTRIES; count++) {
+                struct timeval before, after;
+                gettimeofday(&before, NULL);
                 int child = fork();
 
-                if (!child)
+                if (!child) {
+                    gettimeofday(&after, NULL);
+                    write(first_insn[1], &after, sizeof(after));
                     exit(0);
+                }
 
-                if (child > 0)
+                if (child > 0) {
+                    read(first_insn[0], &after, sizeof(after));
+                    result.first_insn_time += tv_usec(&after) - tv_usec(&before);
                     waitpid(child, NULL, 0);
+                }
             }
 
-            gettimeofday(&timevals[1], NULL);
+            gettimeofday(&result.timevals[1], NULL);
 
             close(pipes[0]);
+            close(first_insn[0]);
+            close(first_insn[1]);
+            free(heap);
 
-            write(pipes[3], timevals, sizeof(struct timeval) * 2);
+            write(pipes[3], &result, sizeof(result));
             close(pipes[3]);
 
             read(pipes[4], &byte, 1);
@@ -80,16 +139,18 @@ int main(int argc, char** argv) {
     unsigned long long start_time = 0;
     unsigned long long end_time   = 0;
     unsigned long long total_time = 0;
-    struct timeval timevals[2];
+    unsigned long long first_insn_time = 0;
+    struct result result;
     for (int i = 0; i < times; i++) {
-        read(pipes[2], timevals, sizeof(struct timeval) * 2);
-        unsigned long s = timevals[0].tv_sec * 1000000ULL + timevals[0].tv_usec;
-        unsigned long e = timevals[1].tv_sec * 1000000ULL + timevals[1].tv_usec;
+        read(pipes[2], &result, sizeof(result));
+        unsigned long s = tv_usec(&result.timevals[0]);
+        unsigned long e = tv_usec(&result.timevals[1]);
         if (!start_time || s < start_time)
             start_time = s;
         if (!end_time || e > end_time)
             end_time = e;
         total_time += e - s;
+        first_insn_time += result.first_insn_time;
     }
     close(pipes[2]);
 
@@ -101,10 +162,11 @@ int main(int argc, char** argv) {
     }
 
     printf(
-        "%d processes fork %d children: throughput = %lf procs/second, "
-        "latency = %lf microseconds\n",
-        times, NTRIES, 1.0 * NTRIES * times * 1000000 / (end_time - start_time),
-        1.0 * total_time / (NTRIES * times));
+        "%d processes (heap = %lu MB, %d fds) fork %d children: throughput = %lf procs/second, "
+        "latency = %lf microseconds, time-to-first-instruction = %lf microseconds\n",
+        times, heap_size / (1024 * 1024), nfds, NTRIES,
+        1.0 * NTRIES * times * 1000000 / (end_time - start_time),
+        1.0 * total_time / (NTRIES * times), 1.0 * first_insn_time / (NTRIES * times));
 
     return 0;
 }
@@ -0,0 +1,90 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ *  USAGE:
+ *      ./fork_objects [max objects] [forks per step]
+ *
+ *  Measures how the time of fork grows with the number of objects the
+ *  checkpoint has to walk. Each step adds objects, up to 4x the previous
+ *  step, and times fork() until the child exits:
+ *    - memory areas: separate PROT_NONE pages, so no page data is copied
+ *    - file descriptors: dup()s of one file, which all refer to the same
+ *      handle and so are found in the checkpoint map after the first one
+ *
+ *  Prints one line per step: the number of objects and the microseconds per
+ *  fork. With PROFILING=1, the profile printed at exit splits the time of
+ *  the checkpoints into checkpoint_create_map, checkpoint_copy and
+ *  checkpoint_destroy_map.
+ */
+
+#define MIN_OBJECTS 1000
+#define MAX_FDS     900
+
+static unsigned long long now_usec(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+int main(int argc, char** argv) {
+    int max_objects = argc >= 2 ? atoi(argv[1]) : 64000;
+    int forks       = argc >= 3 ? atoi(argv[2]) : 20;
+    if (max_objects < MIN_OBJECTS || forks <= 0)
+        return -1;
+
+    /* every other page of the area is unmapped, which leaves one memory
+       area per mapped page */
+    long page = sysconf(_SC_PAGESIZE);
+    char* area = mmap(NULL, page * max_objects * 2, PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (area == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+
+    int fd = open(argv[0], O_RDONLY);
+    if (fd < 0) {
+        perror("open");
+        return -1;
+    }
+
+    int vmas = 0, fds = 1;
+
+    printf("objects\tusec_per_fork\n");
+    for (int objects = MIN_OBJECTS; objects <= max_objects; objects *= 4) {
+        for (; fds < MAX_FDS && fds < objects / 8; fds++)
+            if (dup(fd) < 0) {
+                perror("dup");
+                return -1;
+            }
+
+        for (; vmas + fds < objects; vmas++)
+            if (munmap(area + page * (vmas * 2 + 1), page) < 0) {
+                perror("munmap");
+                return -1;
+            }
+
+        unsigned long long start = now_usec();
+        for (int i = 0; i < forks; i++) {
+            pid_t pid = fork();
+            if (pid < 0) {
+                perror("fork");
+                return -1;
+            }
+            if (pid == 0)
+                _exit(0);
+            waitpid(pid, NULL, 0);
+        }
+
+        printf("%d\t%llu\n", vmas + fds, (now_usec() - start) / forks);
+        fflush(stdout);
+    }
+
+    return 0;
+}
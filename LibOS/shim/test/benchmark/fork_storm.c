@@ -0,0 +1,101 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ *  USAGE:
+ *      ./fork_storm [forks] [batch]
+ *
+ *  Forks short-lived children in batches, and looks up each child with
+ *  kill(pid, 0) from a sibling before reaping the batch, like a shell
+ *  script or a pre-forking server does. Every fork allocates a PID, and
+ *  every lookup resolves the owner of one; both may go to the leader of the
+ *  PID namespace.
+ *
+ *  To count the round trips to the leader, build Graphene with PROFILING=1:
+ *  the profile printed at exit counts ipc_pid_lease_send,
+ *  ipc_pid_sublease_send and ipc_pid_query_send, which divided by the
+ *  number of forks gives the round trips per fork.
+ */
+
+#define MAX_BATCH 256
+
+static unsigned long long now_usec(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+int main(int argc, char** argv) {
+    int forks = argc >= 2 ? atoi(argv[1]) : 1000;
+    int batch = argc >= 3 ? atoi(argv[2]) : 16;
+
+    if (forks <= 0 || batch <= 0 || batch > MAX_BATCH)
+        return -1;
+
+    pid_t pids[MAX_BATCH];
+    int pipes[2];
+    unsigned long long start = now_usec();
+    int done = 0;
+
+    while (done < forks) {
+        int n = forks - done < batch ? forks - done : batch;
+
+        if (pipe(pipes) < 0) {
+            perror("pipe");
+            return -1;
+        }
+
+        for (int i = 0; i < n; i++) {
+            pids[i] = fork();
+            if (pids[i] < 0) {
+                perror("fork");
+                return -1;
+            }
+
+            if (!pids[i]) {
+                /* wait until the whole batch is there */
+                char byte;
+                close(pipes[1]);
+                read(pipes[0], &byte, 1);
+                exit(0);
+            }
+        }
+
+        /* a sibling looks up the children of the batch */
+        pid_t checker = fork();
+        if (checker < 0) {
+            perror("fork");
+            return -1;
+        }
+
+        if (!checker) {
+            for (int i = 0; i < n; i++)
+                if (kill(pids[i], 0) < 0)
+                    exit(1);
+            exit(0);
+        }
+
+        int status = 0;
+        waitpid(checker, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+            printf("lookup of a child failed\n");
+            return -1;
+        }
+
+        close(pipes[0]);
+        close(pipes[1]);
+
+        for (int i = 0; i < n; i++)
+            waitpid(pids[i], NULL, 0);
+
+        done += n + 1;
+    }
+
+    unsigned long long elapsed = now_usec() - start;
+    printf("%d forks in %llu us (%llu us per fork)\n", done, elapsed, elapsed / done);
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+/*
+ *  USAGE:
+ *      ./poll_many [pipes] [ready pipes] [iterations]
+ *
+ *  Creates the pipes, writes a byte into the given number of them (spread
+ *  over the array), and times poll() for reading on all of them. Every call
+ *  must report exactly the ready pipes. Also times a poll() where the same
+ *  pipe is repeated in every entry.
+ */
+
+static unsigned long long now_usec(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+static int time_poll(struct pollfd* fds, int nfds, int expected, int iterations,
+                     const char* what) {
+    unsigned long long start = now_usec();
+
+    for (int i = 0; i < iterations; i++) {
+        int ret = poll(fds, nfds, 0);
+        if (ret != expected) {
+            printf("%s: poll returned %d, expected %d\n", what, ret, expected);
+            return -1;
+        }
+    }
+
+    unsigned long long time = now_usec() - start;
+    printf("%s: %d fds, %d ready: %.2f us per poll\n", what, nfds, expected,
+           (double)time / iterations);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int npipes     = argc >= 2 ? atoi(argv[1]) : 256;
+    int nready     = argc >= 3 ? atoi(argv[2]) : 16;
+    int iterations = argc >= 4 ? atoi(argv[3]) : 1000;
+
+    if (npipes <= 0 || nready < 0 || nready > npipes || iterations <= 0)
+        return -1;
+
+    struct rlimit rlim = {.rlim_cur = npipes * 2 + 16, .rlim_max = npipes * 2 + 16};
+    setrlimit(RLIMIT_NOFILE, &rlim);
+
+    struct pollfd* fds = malloc(sizeof(struct pollfd) * npipes);
+    int* wfds = malloc(sizeof(int) * npipes);
+    if (!fds || !wfds)
+        return -1;
+
+    for (int i = 0; i < npipes; i++) {
+        int p[2];
+        if (pipe(p) < 0) {
+            perror("pipe");
+            return -1;
+        }
+        fds[i].fd     = p[0];
+        fds[i].events = POLLIN;
+        wfds[i]       = p[1];
+    }
+
+    for (int i = 0; i < nready; i++)
+        if (write(wfds[(long)i * npipes / nready], "x", 1) != 1) {
+            perror("write");
+            return -1;
+        }
+
+    if (time_poll(fds, npipes, nready, iterations, "distinct pipes") < 0)
+        return -1;
+
+    for (int i = 0; i < npipes; i++)
+        fds[i].fd = fds[0].fd;
+
+    if (time_poll(fds, npipes, nready ? npipes : 0, iterations, "repeated pipe") < 0)
+        return -1;
+
+    return 0;
+}
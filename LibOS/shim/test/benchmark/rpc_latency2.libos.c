@@ -8,12 +8,25 @@
 
 #define NTRIES     10000
 #define TEST_TIMES 32
+#define MAX_SIZE   65536
+
+/*
+ *  USAGE:
+ *      ./rpc_latency2 [processes] [message size]
+ *
+ *  Pairs of processes bounce messages with send_rpc() and recv_rpc(). With a
+ *  message size of a few KB, the throughput shows the cost of copying the
+ *  payloads on the way through the library OS.
+ */
+
+static char buf[MAX_SIZE];
 
 int main(int argc, char** argv) {
     int times = TEST_TIMES;
     int pipes[6];
     int pids[TEST_TIMES][2];
     int i = 0;
+    int size = 1;
 
     if (argc >= 2) {
         times = atoi(argv[1]) / 2;
@@ -21,6 +34,12 @@ int main(int argc, char** argv) {
             return -1;
     }
 
+    if (argc >= 3) {
+        size = atoi(argv[2]);
+        if (size <= 0 || size > MAX_SIZE)
+            return -1;
+    }
+
     pipe(&pipes[0]);
     pipe(&pipes[2]);
     pipe(&pipes[4]);
@@ -43,8 +62,8 @@ int main(int argc, char** argv) {
             char byte;
             for (int i = 0; i < NTRIES; i++) {
                 pid_t pid;
-                recv_rpc(&pid, &byte, 1);
-                send_rpc(pid, &byte, 1);
+                recv_rpc(&pid, buf, size);
+                send_rpc(pid, buf, size);
             }
 
             read(pipes[2], &byte, 1);
@@ -72,8 +91,8 @@ int main(int argc, char** argv) {
 
             pid_t pid = pids[i][0];
             for (int i = 0; i < NTRIES; i++) {
-                send_rpc(pid, &byte, 1);
-                recv_rpc(NULL, &byte, 1);
+                send_rpc(pid, buf, size);
+                recv_rpc(NULL, buf, size);
             }
 
             gettimeofday(&timevals[1], NULL);
@@ -120,8 +139,8 @@ int main(int argc, char** argv) {
         waitpid(pids[i][1], NULL, 0);
     }
 
-    printf("throughput for %d processes to send %d message: %lf bytes/second\n", times, NTRIES,
-           1.0 * NTRIES * 2 * times * 1000000 / (end_time - start_time));
+    printf("throughput for %d processes to send %d messages of %d bytes: %lf bytes/second\n",
+           times, NTRIES, size, 1.0 * NTRIES * 2 * times * size * 1000000 / (end_time - start_time));
 
     return 0;
 }
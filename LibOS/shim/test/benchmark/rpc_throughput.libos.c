@@ -0,0 +1,82 @@
+#include <shim_unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define NTRIES     1000
+#define TEST_TIMES 64
+
+/* Many children send RPCs to their parent, which answers each of them. All
+ * messages go through the IPC threads of the parent, so this measures how well
+ * one process handles IPC from many others. */
+int main(int argc, char** argv) {
+    int times = TEST_TIMES / 4;
+    int pipes[2];
+    int pids[TEST_TIMES];
+    int i = 0;
+
+    if (argc >= 2) {
+        times = atoi(argv[1]);
+        if (times <= 0 || times > TEST_TIMES)
+            return -1;
+    }
+
+    pipe(pipes);
+
+    for (i = 0; i < times; i++) {
+        pids[i] = fork();
+
+        if (pids[i] < 0) {
+            printf("fork failed\n");
+            return -1;
+        }
+
+        if (pids[i] == 0) {
+            close(pipes[1]);
+            char byte;
+            read(pipes[0], &byte, 1);
+            close(pipes[0]);
+
+            pid_t parent = getppid();
+            for (int i = 0; i < NTRIES; i++) {
+                send_rpc(parent, &byte, 1);
+                recv_rpc(NULL, &byte, 1);
+            }
+
+            exit(0);
+        }
+    }
+
+    close(pipes[0]);
+
+    sleep(1);
+    char bytes[TEST_TIMES];
+    struct timeval timevals[2];
+    gettimeofday(&timevals[0], NULL);
+
+    write(pipes[1], bytes, times);
+    close(pipes[1]);
+
+    for (i = 0; i < times * NTRIES; i++) {
+        pid_t pid;
+        char byte;
+        recv_rpc(&pid, &byte, 1);
+        send_rpc(pid, &byte, 1);
+    }
+
+    gettimeofday(&timevals[1], NULL);
+
+    for (i = 0; i < times; i++)
+        waitpid(pids[i], NULL, 0);
+
+    unsigned long long start_time = timevals[0].tv_sec * 1000000ULL + timevals[0].tv_usec;
+    unsigned long long end_time   = timevals[1].tv_sec * 1000000ULL + timevals[1].tv_usec;
+
+    printf("throughput for %d processes to send %d messages each to their parent: "
+           "%lf messages/second\n",
+           times, NTRIES, 1.0 * NTRIES * 2 * times * 1000000 / (end_time - start_time));
+
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ *  USAGE:
+ *      ./shared_counter [children] [increments per child]
+ *
+ *  Forks the children, which increment atomic counters in a shared anonymous
+ *  mapping of the parent, and checks that the parent sees every increment.
+ *  Without memory shared between the processes, the children only update
+ *  their own copies and the check fails.
+ */
+
+#define NCOUNTERS 16
+#define MAX_CHILDREN 64
+
+static unsigned long long now_usec(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+int main(int argc, char** argv) {
+    int children = argc >= 2 ? atoi(argv[1]) : 4;
+    long increments = argc >= 3 ? atol(argv[2]) : 1000000;
+
+    if (children <= 0 || children > MAX_CHILDREN || increments <= 0)
+        return -1;
+
+    /* one counter per cache line, so the children do not share lines by accident */
+    long* counters = mmap(NULL, NCOUNTERS * 64, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (counters == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+
+    unsigned long long start = now_usec();
+    pid_t pids[MAX_CHILDREN];
+
+    for (int i = 0; i < children; i++) {
+        pids[i] = fork();
+        if (pids[i] < 0) {
+            perror("fork");
+            return -1;
+        }
+
+        if (!pids[i]) {
+            for (long j = 0; j < increments; j++)
+                __atomic_fetch_add(&counters[(j % NCOUNTERS) * 8], 1, __ATOMIC_RELAXED);
+            exit(0);
+        }
+    }
+
+    for (int i = 0; i < children; i++)
+        waitpid(pids[i], NULL, 0);
+
+    unsigned long long elapsed = now_usec() - start;
+
+    long total = 0;
+    for (int i = 0; i < NCOUNTERS; i++)
+        total += __atomic_load_n(&counters[i * 8], __ATOMIC_RELAXED);
+
+    if (total != children * increments) {
+        printf("counted %ld increments, expected %ld\n", total, children * increments);
+        return -1;
+    }
+
+    printf("%d children counted %ld increments in %llu us (%.1f ns each)\n", children, total,
+           elapsed, elapsed * 1000.0 / total);
+    return 0;
+}
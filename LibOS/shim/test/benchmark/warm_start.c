@@ -0,0 +1,118 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ *  USAGE:
+ *      ./warm_start [prefixes to the program ...]
+ *
+ *  EXAMPLES:
+ *      ./warm_start                                => native
+ *      ./warm_start ../../../../Runtime/pal_loader => graphene
+ *
+ *  Measures the time from starting a server to its answer to the first
+ *  request. The server spends a while initializing its state first; with
+ *  sys.snapshot set in the manifest, the first run saves itself to the
+ *  snapshot once initialized and the later runs start from there.
+ */
+
+#define TEST_TIMES 20
+#define STATE_SIZE (64 * 1024 * 1024)
+
+static unsigned long long now_usec(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+static int serve(void) {
+    /* the state a real server would load or compute at startup */
+    unsigned int* state = malloc(STATE_SIZE);
+    if (!state)
+        return -1;
+
+    unsigned int seed = 1;
+    for (size_t i = 0; i < STATE_SIZE / sizeof(unsigned int); i++) {
+        seed      = seed * 1103515245 + 12345;
+        state[i] = seed;
+    }
+
+    /* ready: save a snapshot, if Graphene is told where to */
+    int fd = open("/proc/snapshot", O_WRONLY);
+    if (fd >= 0) {
+        write(fd, "1", 1);
+        close(fd);
+    }
+
+    /* the first request */
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%u\n", state[STATE_SIZE / sizeof(unsigned int) / 2]);
+    write(1, buf, strlen(buf));
+    return 0;
+}
+
+int main(int argc, char** argv, char** envp) {
+    if (argc == 2 && !strcmp(argv[1], "-serve"))
+        return serve();
+
+    char* new_argv[argc + 2];
+    for (int i = 1; i < argc; i++) {
+        new_argv[i - 1] = argv[i];
+    }
+
+    new_argv[argc - 1] = "./warm_start";
+    new_argv[argc]     = "-serve";
+    new_argv[argc + 1] = NULL;
+
+    unsigned long long times[TEST_TIMES];
+    int i;
+
+    for (i = 0; i < TEST_TIMES; i++) {
+        int pipes[2];
+        if (pipe(pipes) < 0)
+            break;
+
+        unsigned long long start = now_usec();
+        pid_t pid = fork();
+
+        if (pid < 0)
+            break;
+
+        if (!pid) {
+            close(pipes[0]);
+            dup2(pipes[1], 1);
+            execve(new_argv[0], new_argv, envp);
+            exit(-1);
+        }
+
+        close(pipes[1]);
+
+        char buf[32];
+        ssize_t bytes = read(pipes[0], buf, sizeof(buf));
+        times[i] = now_usec() - start;
+
+        close(pipes[0]);
+        waitpid(pid, NULL, 0);
+
+        if (bytes <= 0) {
+            printf("no answer from the server\n");
+            return -1;
+        }
+    }
+
+    if (i < 2)
+        return -1;
+
+    unsigned long long sum = 0;
+    for (int j = 1; j < i; j++) {
+        sum += times[j];
+    }
+
+    printf("first request answered after %llu us in the first run, "
+           "%llu us on average in the next %d runs\n", times[0], sum / (i - 1), i - 1);
+    return 0;
+}
@@ -1,22 +1,153 @@
+#include <elf.h>
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/auxv.h>
 #include <sys/time.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 /*
  *  USAGE:
  *      ./test_start [prefixes to the program ...]
+ *      ./test_start --clock [iterations]
  *
  *  EXAMPLES:
  *      ./test_start                => native start time
  *      ./test_start ./libpal.so    => graphene start time
+ *      ./test_start --clock        => latency and resolution of clock_gettime(),
+ *                                     gettimeofday() and time(), through libc
+ *                                     (the system call) and through the vDSO
  */
 
 #define OVERHEAD_TIMES 30000
 #define TEST_TIMES     1000
+#define CLOCK_TIMES    1000000
+
+/* Finds a function exported by the vDSO; libc does not call the vDSO in
+ * Graphene, so look it up in the ELF image given in the aux vector */
+static void* vdso_sym(const char* name) {
+    Elf64_Ehdr* ehdr = (Elf64_Ehdr*)getauxval(AT_SYSINFO_EHDR);
+    if (!ehdr)
+        return NULL;
+
+    Elf64_Phdr* phdr = (Elf64_Phdr*)((char*)ehdr + ehdr->e_phoff);
+    Elf64_Dyn* dyn   = NULL;
+    uintptr_t load   = (uintptr_t)-1;
+
+    for (int i = 0; i < ehdr->e_phnum; i++) {
+        if (phdr[i].p_type == PT_LOAD && load == (uintptr_t)-1)
+            load = (uintptr_t)ehdr + phdr[i].p_offset - phdr[i].p_vaddr;
+        if (phdr[i].p_type == PT_DYNAMIC)
+            dyn = (Elf64_Dyn*)((char*)ehdr + phdr[i].p_offset);
+    }
+    if (!dyn || load == (uintptr_t)-1)
+        return NULL;
+
+    Elf64_Sym* symtab = NULL;
+    const char* strtab = NULL;
+    Elf64_Word* hash = NULL;
+
+    for (; dyn->d_tag != DT_NULL; dyn++) {
+        if (dyn->d_tag == DT_SYMTAB)
+            symtab = (Elf64_Sym*)(load + dyn->d_un.d_ptr);
+        else if (dyn->d_tag == DT_STRTAB)
+            strtab = (const char*)(load + dyn->d_un.d_ptr);
+        else if (dyn->d_tag == DT_HASH)
+            hash = (Elf64_Word*)(load + dyn->d_un.d_ptr);
+    }
+    if (!symtab || !strtab || !hash)
+        return NULL;
+
+    /* the number of symbols is the number of chains in the hash table */
+    for (Elf64_Word i = 0; i < hash[1]; i++)
+        if (symtab[i].st_shndx != SHN_UNDEF && !strcmp(strtab + symtab[i].st_name, name))
+            return (void*)(load + symtab[i].st_value);
+
+    return NULL;
+}
+
+static double now_nsec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void clock_test(const char* name, int (*func)(clockid_t, struct timespec*), int times) {
+    struct timespec ts, prev;
+    long resolution = -1;
+
+    if (!func) {
+        printf("%-30s not available\n", name);
+        return;
+    }
+
+    func(CLOCK_REALTIME, &prev);
+    double start = now_nsec();
+    for (int i = 0; i < times; i++) {
+        func(CLOCK_REALTIME, &ts);
+        long diff = (ts.tv_sec - prev.tv_sec) * 1000000000L + ts.tv_nsec - prev.tv_nsec;
+        if (diff > 0 && (resolution < 0 || diff < resolution))
+            resolution = diff;
+        prev = ts;
+    }
+    double time = now_nsec() - start;
+
+    printf("%-30s %8.1f ns per call, %ld ns resolution\n", name, time / times, resolution);
+}
+
+static void gettimeofday_test(const char* name, int (*func)(struct timeval*, struct timezone*),
+                              int times) {
+    struct timeval tv;
+
+    if (!func) {
+        printf("%-30s not available\n", name);
+        return;
+    }
+
+    double start = now_nsec();
+    for (int i = 0; i < times; i++)
+        func(&tv, NULL);
+    double time = now_nsec() - start;
+
+    printf("%-30s %8.1f ns per call\n", name, time / times);
+}
+
+static void time_test(const char* name, time_t (*func)(time_t*), int times) {
+    if (!func) {
+        printf("%-30s not available\n", name);
+        return;
+    }
+
+    double start = now_nsec();
+    for (int i = 0; i < times; i++)
+        func(NULL);
+    double time = now_nsec() - start;
+
+    printf("%-30s %8.1f ns per call\n", name, time / times);
+}
+
+/* the prototype of gettimeofday() differs between glibc versions */
+static int libc_gettimeofday(struct timeval* tv, struct timezone* tz) {
+    return gettimeofday(tv, tz);
+}
+
+static int clock_main(int argc, char** argv) {
+    int times = argc > 2 ? atoi(argv[2]) : CLOCK_TIMES;
+    if (times <= 0)
+        times = CLOCK_TIMES;
+
+    clock_test("clock_gettime (libc)", clock_gettime, times);
+    clock_test("clock_gettime (vDSO)", vdso_sym("__vdso_clock_gettime"), times);
+    gettimeofday_test("gettimeofday (libc)", libc_gettimeofday, times);
+    gettimeofday_test("gettimeofday (vDSO)", vdso_sym("__vdso_gettimeofday"), times);
+    time_test("time (libc)", time, times);
+    time_test("time (vDSO)", vdso_sym("__vdso_time"), times);
+    return 0;
+}
 
 void get_time(char* time_arg, unsigned long overhead) {
     struct timeval tv;
@@ -26,6 +157,9 @@ void get_time(char* time_arg, unsigned long overhead) {
 }
 
 int main(int argc, char** argv, char** envp) {
+    if (argc > 1 && !strcmp(argv[1], "--clock"))
+        return clock_main(argc, argv);
+
     char* new_argv[argc + 1];
     char time_arg[30];
 
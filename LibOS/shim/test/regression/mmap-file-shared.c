@@ -0,0 +1,64 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* A shared file mapping stays shared with a forked child: what the child
+   writes is seen by the parent, both in its mapping and in the file. */
+
+int main(int argc, const char** argv) {
+    int fd = open("mmap-file-shared.tmp", O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        perror("open");
+        return 1;
+    }
+
+    if (ftruncate(fd, 4096)) {
+        perror("ftruncate");
+        return 1;
+    }
+
+    volatile unsigned char* a = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (a == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+
+    a[0] = 1;
+
+    int pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        return 1;
+    }
+
+    if (pid == 0) {
+        if (a[0] == 1)
+            printf("mmap shared test 1 passed\n");
+        a[1] = 2;
+        return 0;
+    }
+
+    if (waitpid(pid, NULL, 0) == -1) {
+        perror("waitpid");
+        return 1;
+    }
+
+    if (a[1] == 2)
+        printf("mmap shared test 2 passed\n");
+
+    unsigned char byte = 0;
+    if (msync((void*)a, 4096, MS_SYNC) || pread(fd, &byte, 1, 1) != 1) {
+        perror("msync/pread");
+        return 1;
+    }
+    if (byte == 2)
+        printf("mmap shared test 3 passed\n");
+
+    munmap((void*)a, 4096);
+    close(fd);
+    return 0;
+}
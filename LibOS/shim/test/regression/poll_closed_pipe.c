@@ -0,0 +1,50 @@
+#include <poll.h>
+#include <stdio.h>
+#include <sys/select.h>
+#include <unistd.h>
+
+/* A pipe whose writer has closed its end still has the data written before,
+   and is then at EOF: both poll() and select() report it readable. */
+
+int main(int argc, const char** argv) {
+    int fds[2];
+    char buf[16];
+
+    if (pipe(fds)) {
+        perror("pipe");
+        return 1;
+    }
+
+    if (write(fds[1], "hello", 5) != 5) {
+        perror("write");
+        return 1;
+    }
+    close(fds[1]);
+
+    struct pollfd pfd = {.fd = fds[0], .events = POLLIN};
+    if (poll(&pfd, 1, 10000) == 1 && (pfd.revents & POLLIN) && (pfd.revents & POLLHUP))
+        printf("poll test 1 passed\n");
+
+    fd_set rfds;
+    FD_ZERO(&rfds);
+    FD_SET(fds[0], &rfds);
+    struct timeval tv = {.tv_sec = 10, .tv_usec = 0};
+    if (select(fds[0] + 1, &rfds, NULL, NULL, &tv) == 1 && FD_ISSET(fds[0], &rfds))
+        printf("select test 1 passed\n");
+
+    if (read(fds[0], buf, sizeof(buf)) != 5) {
+        perror("read");
+        return 1;
+    }
+
+    /* at EOF */
+    FD_ZERO(&rfds);
+    FD_SET(fds[0], &rfds);
+    tv.tv_sec = 10;
+    if (select(fds[0] + 1, &rfds, NULL, NULL, &tv) == 1 && FD_ISSET(fds[0], &rfds) &&
+        read(fds[0], buf, sizeof(buf)) == 0)
+        printf("select test 2 passed\n");
+
+    close(fds[0]);
+    return 0;
+}
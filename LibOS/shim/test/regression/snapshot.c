@@ -0,0 +1,68 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* The first run saves itself in the snapshot file given by sys.snapshot. The
+   next run starts from the snapshot, returning 0 from the same write(), and
+   checks that the memory of the first run came along. */
+
+#define HEAP_SIZE (256 * 1024)
+
+static char data[3 * 4096] = {1};
+static char bss[3 * 4096];
+
+static int check(const char* buf, size_t size, char seed) {
+    for (size_t i = 0; i < size; i++)
+        if (buf[i] != (char)(seed + i % 251))
+            return -1;
+    return 0;
+}
+
+static void fill(char* buf, size_t size, char seed) {
+    for (size_t i = 0; i < size; i++)
+        buf[i] = seed + i % 251;
+}
+
+int main(void) {
+    setbuf(stdout, NULL);
+
+    char* heap = malloc(HEAP_SIZE);
+    if (!heap)
+        abort();
+
+    volatile int counter = 41;
+    fill(data, sizeof(data), 1);
+    fill(bss, sizeof(bss), 2);
+    fill(heap, HEAP_SIZE, 3);
+
+    int fd = open("/proc/snapshot", O_WRONLY);
+    if (fd < 0) {
+        perror("open /proc/snapshot");
+        return 1;
+    }
+
+    ssize_t ret = write(fd, "1", 1);
+    if (ret < 0) {
+        perror("write /proc/snapshot");
+        return 1;
+    }
+    close(fd);
+
+    counter++;
+    if (ret == 1) {
+        printf("Snapshot saved (counter %d)\n", counter);
+        return 0;
+    }
+
+    if (counter != 42 || check(data, sizeof(data), 1) < 0 || check(bss, sizeof(bss), 2) < 0 ||
+        check(heap, HEAP_SIZE, 3) < 0) {
+        printf("Restored from snapshot with corrupted memory\n");
+        return 1;
+    }
+
+    printf("Restored from snapshot (counter %d)\n", counter);
+    free(heap);
+    return 0;
+}
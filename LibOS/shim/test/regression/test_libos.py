@@ -143,6 +143,21 @@ class TC_00_Bootstrap(RegressionTestCase):
         # Multiple thread creation
         self.assertIn('128 Threads Created', stdout)
 
+    @unittest.skipIf(HAS_SGX,
+        'Snapshots are not supported on SGX PAL, since the snapshot file is '
+        'neither encrypted nor verified.')
+    def test_700_snapshot(self):
+        if os.path.exists('snapshot.tmp'):
+            os.remove('snapshot.tmp')
+
+        stdout, stderr = self.run_binary(['snapshot'])
+        self.assertIn('Snapshot saved (counter 42)', stdout)
+
+        # The second run starts from the snapshot
+        stdout, stderr = self.run_binary(['snapshot'])
+        self.assertIn('Restored from snapshot (counter 42)', stdout)
+        self.assertNotIn('Snapshot saved', stdout)
+
 @unittest.skipUnless(HAS_SGX,
     'This test is only meaningful on SGX PAL because only SGX catches raw '
     'syscalls and redirects to Graphene\'s LibOS. If we will add seccomp to '
@@ -278,6 +293,16 @@ class TC_30_Syscall(RegressionTestCase):
         self.assertIn('mmap test 5 passed', stdout)
         self.assertIn('mmap test 8 passed', stdout)
 
+    @unittest.skipIf(HAS_SGX,
+        'On SGX, files cannot be mapped shared and writable.')
+    def test_053_mmap_file_shared(self):
+        stdout, stderr = self.run_binary(['mmap-file-shared'], timeout=60)
+
+        # Shared file mapping, written by a forked child
+        self.assertIn('mmap shared test 1 passed', stdout)
+        self.assertIn('mmap shared test 2 passed', stdout)
+        self.assertIn('mmap shared test 3 passed', stdout)
+
     def test_52_large_mmap(self):
         stdout, stderr = self.run_binary(['large-mmap'], timeout=240)
 
@@ -307,6 +332,14 @@ class TC_30_Syscall(RegressionTestCase):
         self.assertIn('OK on sigaltstack in main thread', stdout)
         self.assertIn('done exiting', stdout)
 
+    def test_070_poll_closed_pipe(self):
+        stdout, stderr = self.run_binary(['poll_closed_pipe'])
+
+        # A pipe at EOF, with and without data left
+        self.assertIn('poll test 1 passed', stdout)
+        self.assertIn('select test 1 passed', stdout)
+        self.assertIn('select test 2 passed', stdout)
+
 @unittest.skipUnless(HAS_SGX,
     'This test is only meaningful on SGX PAL because only SGX catches raw '
     'syscalls and redirects to Graphene\'s LibOS. If we will add seccomp to '
@@ -388,3 +421,9 @@ class TC_80_Socket(RegressionTestCase):
         self.assertIn('Data: This is packet 7', stdout)
         self.assertIn('Data: This is packet 8', stdout)
         self.assertIn('Data: This is packet 9', stdout)
+
+    def test_210_socket_udp_pps(self):
+        stdout, stderr = self.run_binary(['udp_pps', '3200'], timeout=50)
+        self.assertIn('sendto/recvfrom', stdout)
+        self.assertIn('sendmmsg/recvmmsg', stdout)
+        self.assertIn('TEST OK', stdout)
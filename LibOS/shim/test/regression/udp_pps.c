@@ -0,0 +1,183 @@
+/* UDP packets-per-second benchmark. One thread sends bursts of small
+ * datagrams to its own bound socket over the loopback and receives them back,
+ * first with sendto()/recvfrom() and then with sendmmsg()/recvmmsg(), and
+ * checks that each datagram arrives with its data and source address.
+ *
+ *   udp_pps [packets] [size]
+ */
+
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SRV_IP "127.0.0.1"
+#define PORT   9931
+#define BURST  32
+#define MAXLEN 1472
+
+static int srv, cli;
+static struct sockaddr_in srv_addr, cli_addr;
+static size_t size = 64;
+static char bufs[BURST][MAXLEN];
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void check_packet(const char* buf, ssize_t len, const struct sockaddr_in* from,
+                         unsigned int seq) {
+    unsigned int got;
+
+    if (len != (ssize_t)size) {
+        fprintf(stderr, "wrong length %zd\n", len);
+        exit(1);
+    }
+
+    memcpy(&got, buf, sizeof(got));
+    if (got != seq) {
+        fprintf(stderr, "wrong packet %u, expected %u\n", got, seq);
+        exit(1);
+    }
+
+    if (from->sin_family != AF_INET || from->sin_port != cli_addr.sin_port ||
+        from->sin_addr.s_addr != cli_addr.sin_addr.s_addr) {
+        fprintf(stderr, "wrong source address %s:%d\n", inet_ntoa(from->sin_addr),
+                ntohs(from->sin_port));
+        exit(1);
+    }
+}
+
+static void run_single(unsigned int packets) {
+    for (unsigned int seq = 0; seq < packets; seq += BURST) {
+        for (unsigned int i = 0; i < BURST; i++) {
+            unsigned int n = seq + i;
+            memcpy(bufs[i], &n, sizeof(n));
+            if (sendto(cli, bufs[i], size, 0, (struct sockaddr*)&srv_addr,
+                       sizeof(srv_addr)) != (ssize_t)size) {
+                perror("sendto");
+                exit(1);
+            }
+        }
+
+        for (unsigned int i = 0; i < BURST; i++) {
+            struct sockaddr_in from;
+            socklen_t fromlen = sizeof(from);
+            ssize_t len = recvfrom(srv, bufs[i], MAXLEN, 0, (struct sockaddr*)&from, &fromlen);
+            if (len < 0) {
+                perror("recvfrom");
+                exit(1);
+            }
+            check_packet(bufs[i], len, &from, seq + i);
+        }
+    }
+}
+
+static void run_batch(unsigned int packets) {
+    struct mmsghdr msgs[BURST];
+    struct iovec iovs[BURST];
+    struct sockaddr_in from[BURST];
+
+    for (unsigned int seq = 0; seq < packets; seq += BURST) {
+        memset(msgs, 0, sizeof(msgs));
+        for (unsigned int i = 0; i < BURST; i++) {
+            unsigned int n = seq + i;
+            memcpy(bufs[i], &n, sizeof(n));
+            iovs[i].iov_base = bufs[i];
+            iovs[i].iov_len  = size;
+            msgs[i].msg_hdr.msg_iov     = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen  = 1;
+            msgs[i].msg_hdr.msg_name    = &srv_addr;
+            msgs[i].msg_hdr.msg_namelen = sizeof(srv_addr);
+        }
+
+        for (unsigned int sent = 0; sent < BURST;) {
+            int ret = sendmmsg(cli, msgs + sent, BURST - sent, 0);
+            if (ret <= 0) {
+                perror("sendmmsg");
+                exit(1);
+            }
+            sent += ret;
+        }
+
+        memset(msgs, 0, sizeof(msgs));
+        for (unsigned int i = 0; i < BURST; i++) {
+            iovs[i].iov_base = bufs[i];
+            iovs[i].iov_len  = MAXLEN;
+            msgs[i].msg_hdr.msg_iov     = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen  = 1;
+            msgs[i].msg_hdr.msg_name    = &from[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+        }
+
+        for (unsigned int received = 0; received < BURST;) {
+            int ret = recvmmsg(srv, msgs + received, BURST - received, MSG_WAITFORONE, NULL);
+            if (ret <= 0) {
+                perror("recvmmsg");
+                exit(1);
+            }
+            for (int i = 0; i < ret; i++)
+                check_packet(bufs[received + i], msgs[received + i].msg_len, &from[received + i],
+                             seq + received + i);
+            received += ret;
+        }
+    }
+}
+
+static void bench(const char* name, void (*run)(unsigned int), unsigned int packets) {
+    double start = now();
+    run(packets);
+    double elapsed = now() - start;
+
+    printf("%-20s %u packets of %zu bytes: %10.0f packets/s\n", name, packets, size,
+           packets / elapsed);
+}
+
+int main(int argc, char** argv) {
+    unsigned int packets = argc > 1 ? atoi(argv[1]) : 100000;
+    if (argc > 2)
+        size = atoi(argv[2]);
+
+    if (size < sizeof(unsigned int) || size > MAXLEN) {
+        fprintf(stderr, "size must be between %zu and %d\n", sizeof(unsigned int), MAXLEN);
+        return 1;
+    }
+
+    packets = (packets + BURST - 1) / BURST * BURST;
+
+    memset(&srv_addr, 0, sizeof(srv_addr));
+    srv_addr.sin_family = AF_INET;
+    srv_addr.sin_port   = htons(PORT);
+    inet_aton(SRV_IP, &srv_addr.sin_addr);
+
+    memset(&cli_addr, 0, sizeof(cli_addr));
+    cli_addr.sin_family = AF_INET;
+    cli_addr.sin_port   = htons(PORT + 1);
+    inet_aton(SRV_IP, &cli_addr.sin_addr);
+
+    if ((srv = socket(AF_INET, SOCK_DGRAM, 0)) < 0 || (cli = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+        perror("socket");
+        return 1;
+    }
+
+    if (bind(srv, (struct sockaddr*)&srv_addr, sizeof(srv_addr)) < 0 ||
+        bind(cli, (struct sockaddr*)&cli_addr, sizeof(cli_addr)) < 0) {
+        perror("bind");
+        return 1;
+    }
+
+    bench("sendto/recvfrom", run_single, packets);
+    bench("sendmmsg/recvmmsg", run_batch, packets);
+
+    close(cli);
+    close(srv);
+    printf("TEST OK\n");
+    return 0;
+}
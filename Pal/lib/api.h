@@ -197,6 +197,15 @@ uint16_t __ntohs (uint16_t x);
 
 extern const char * const * sys_errlist_internal;
 
+/* LZ4 block compression. lz4_compress() returns 0 if the output does not fit
+ * in dst_size bytes; workspace must hold LZ4_WORKSPACE_SIZE bytes. */
+#define LZ4_WORKSPACE_SIZE  (16 * 1024)
+
+ssize_t lz4_compress (const void * src, size_t src_size, void * dst,
+                      size_t dst_size, void * workspace);
+ssize_t lz4_decompress (const void * src, size_t src_size, void * dst,
+                        size_t dst_size);
+
 /* Graphene functions */
 
 int get_norm_path(const char* path, char* buf, size_t* size);
@@ -207,10 +216,16 @@ int get_base_name(const char* path, char* buf, size_t* size);
 #include <list.h>
 
 struct config;
+struct config_chunk;
 DEFINE_LISTP(config);
 struct config_store {
     LISTP_TYPE(config) root;
     LISTP_TYPE(config) entries;
+    struct config ** index;       /* all nodes, hashed by parent and key */
+    size_t           index_size;
+    size_t           nentries;
+    struct config_chunk * chunks; /* nodes are allocated from these */
+    struct config *  free_nodes;
     void *           raw_data;
     int              raw_size;
     void *           (*malloc) (size_t);
@@ -159,6 +159,16 @@ static inline int64_t cmpxchg(volatile int64_t *p, int64_t t, int64_t s)
     return t;
 }
 
+/* Helper function to atomically store s in the value pointed to by p.
+ * Returns the value originally in p. */
+static inline int64_t xchg(volatile int64_t *p, int64_t s)
+{
+    __asm__ __volatile__ (
+        "xchg %0, %1"
+        : "=r"(s), "+m"(*p) : "0"(s) : "memory");
+    return s;
+}
+
 #define atomic_add_return(i, v)  _atomic_add(i, v)
 #define atomic_inc_return(v)     _atomic_add(1, v)
 
@@ -0,0 +1,130 @@
+/* Copyright (C) 2014 Stony Brook University
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * Benchmark of the manifest parser (graphene/config.c). It generates a
+ * manifest with N sgx.trusted_files entries (and as many checksums, as
+ * pal-sgx-sign writes them), parses it, looks up every entry and copies the
+ * store. It runs on the host, outside of Graphene:
+ *
+ *   gcc -O2 -fno-builtin -I. -I../include/pal -I../src \
+ *       config-bench.c graphene/config.c stdlib/printfmt.c -o config-bench
+ *   ./config-bench [entries]
+ *
+ * The default of 20000 entries is the size of a manifest of a large
+ * application with all its files trusted.
+ */
+
+#include <time.h>
+
+#include "api.h"
+#include "pal_error.h"
+
+/* api.h declares the string functions and snprintf() of Graphene; take the
+   rest from the host libc */
+int printf(const char* fmt, ...);
+int strcmp(const char* s1, const char* s2);
+void exit(int status);
+
+static double now_usec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+}
+
+static void check(int ok, const char* what) {
+    if (!ok) {
+        printf("%s failed\n", what);
+        exit(1);
+    }
+}
+
+int main(int argc, char** argv) {
+    int entries = argc > 1 ? atoi(argv[1]) : 20000;
+    check(entries > 0, "argument");
+
+    size_t size = 1024 + entries * 256UL;
+    char* manifest = malloc(size);
+    check(manifest != NULL, "malloc");
+
+    int len = snprintf(manifest, size,
+                       "loader.preload = file:libsysdb.so\n"
+                       "loader.exec = file:app\n"
+                       "fs.mount.lib.type = chroot\n"
+                       "fs.mount.lib.path = /lib\n"
+                       "fs.mount.lib.uri = file:/lib\n"
+                       "sgx.enclave_size = 1G\n");
+    for (int i = 0; i < entries; i++)
+        len += snprintf(manifest + len, size - len,
+                        "sgx.trusted_files.file%d = file:/usr/lib/app/file%d.so\n"
+                        "sgx.trusted_checksum.file%d = "
+                        "%064x\n", i, i, i, i);
+
+    struct config_store store = {
+        .raw_data = manifest,
+        .raw_size = len,
+        .malloc   = malloc,
+        .free     = free,
+    };
+    const char* err = NULL;
+
+    double start = now_usec();
+    int ret      = read_config(&store, NULL, &err);
+    double parse = now_usec() - start;
+    check(ret == 0, "read_config");
+
+    char key[64], val[CONFIG_MAX], expected[64];
+
+    start = now_usec();
+    for (int i = 0; i < entries; i++) {
+        snprintf(key, sizeof(key), "sgx.trusted_files.file%d", i);
+        ssize_t vlen = get_config(&store, key, val, sizeof(val));
+        snprintf(expected, sizeof(expected), "file:/usr/lib/app/file%d.so", i);
+        check(vlen > 0 && !strcmp(val, expected), "get_config");
+    }
+    double lookup = now_usec() - start;
+
+    ssize_t esize = get_config_entries_size(&store, "sgx.trusted_files");
+    check(esize > 0, "get_config_entries_size");
+    char* names = malloc(esize);
+    check(names && get_config_entries(&store, "sgx.trusted_files", names, esize) == entries,
+          "get_config_entries");
+    check(!strcmp(names, "file0"), "entry order");
+
+    struct config_store copy = {.malloc = malloc, .free = free};
+    start = now_usec();
+    ret = copy_config(&store, &copy);
+    double dup = now_usec() - start;
+    check(ret == 0 && get_config(&copy, "sgx.trusted_files.file0", val, sizeof(val)) > 0,
+          "copy_config");
+
+    check(set_config(&copy, "sgx.trusted_files.file0", NULL) == 0 &&
+          get_config(&copy, "sgx.trusted_files.file0", val, sizeof(val)) < 0 &&
+          set_config(&copy, "sgx.trusted_files.file0", "file:new") == 0 &&
+          get_config(&copy, "sgx.trusted_files.file0", val, sizeof(val)) > 0 &&
+          !strcmp(val, "file:new"), "set_config");
+
+    printf("%d entries (%d KB): parse %.0f us, %d lookups %.0f us (%.0f ns each), "
+           "copy %.0f us\n", entries * 2 + 6, len / 1024, parse, entries, lookup,
+           lookup * 1000 / entries, dup);
+
+    free_config(&copy);
+    free(copy.raw_data);
+    free_config(&store);
+    free(names);
+    free(manifest);
+    return 0;
+}
@@ -0,0 +1,267 @@
+/* Copyright (C) 2014 Stony Brook University
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * Benchmark of the crypto used between enclaves on SGX: the key exchanges
+ * for the parent/child handshake (2048-bit finite-field Diffie-Hellman and
+ * X25519), and the AES-GCM throughput of the record layer which encrypts
+ * process and pipe streams. It runs on the host, outside of Graphene:
+ *
+ *   gcc -O2 -fno-builtin -DCRYPTO_USE_MBEDTLS -I. -I../include/pal -I../src \
+ *       crypto-bench.c crypto/adapters/x25519.c crypto/adapters/mbedtls_dh.c \
+ *       crypto/adapters/mbedtls_gcm.c crypto/adapters/mbedtls_adapter.c \
+ *       crypto/mbedtls/[a-z]*.c -o crypto-bench
+ *   ./crypto-bench [iterations] [MB]
+ *
+ * Each handshake runs both sides (key generation, public key, shared
+ * secret and the SHA-256 key derivation), as _DkStreamKeyExchange() does.
+ * The AES-GCM test seals and opens MB megabytes in records of each size,
+ * the largest being the record size of enclave_stream.c.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+#include <time.h>
+
+#include "pal_crypto.h"
+
+size_t _DkRandomBitsRead(void* buffer, size_t size) {
+    if (getrandom(buffer, size, 0) != (ssize_t)size)
+        return -1;
+    return 0;
+}
+
+int pal_printf(const char* fmt, ...) {
+    (void)fmt;
+    return 0;
+}
+
+static double now_usec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+}
+
+static void check(int ret, const char* what) {
+    if (ret) {
+        printf("%s failed: %d\n", what, ret);
+        exit(1);
+    }
+}
+
+static void derive_key(const uint8_t* secret, uint64_t size, uint8_t* key) {
+    LIB_SHA256_CONTEXT sha;
+    check(lib_SHA256Init(&sha), "lib_SHA256Init");
+    check(lib_SHA256Update(&sha, secret, size), "lib_SHA256Update");
+    check(lib_SHA256Final(&sha, key), "lib_SHA256Final");
+}
+
+static void dh_handshake(void) {
+    LIB_DH_CONTEXT ctx[2];
+    uint8_t pub[2][DH_SIZE], secret[2][DH_SIZE], key[2][SHA256_DIGEST_LEN];
+
+    for (int i = 0; i < 2; i++) {
+        uint64_t size = DH_SIZE;
+        check(lib_DhInit(&ctx[i]), "lib_DhInit");
+        check(lib_DhCreatePublic(&ctx[i], pub[i], &size), "lib_DhCreatePublic");
+    }
+
+    for (int i = 0; i < 2; i++) {
+        uint64_t size = DH_SIZE;
+        check(lib_DhCalcSecret(&ctx[i], pub[1 - i], DH_SIZE, secret[i], &size),
+              "lib_DhCalcSecret");
+        derive_key(secret[i], size, key[i]);
+        lib_DhFinal(&ctx[i]);
+    }
+
+    if (memcmp(key[0], key[1], SHA256_DIGEST_LEN)) {
+        printf("DH: keys do not match\n");
+        exit(1);
+    }
+}
+
+static void ecdh_handshake(void) {
+    LIB_ECDH_CONTEXT ctx[2];
+    uint8_t pub[2][ECDH_SIZE], secret[2][ECDH_SIZE], key[2][SHA256_DIGEST_LEN];
+
+    for (int i = 0; i < 2; i++) {
+        uint64_t size = ECDH_SIZE;
+        check(lib_EcdhInit(&ctx[i]), "lib_EcdhInit");
+        check(lib_EcdhCreatePublic(&ctx[i], pub[i], &size), "lib_EcdhCreatePublic");
+    }
+
+    for (int i = 0; i < 2; i++) {
+        uint64_t size = ECDH_SIZE;
+        check(lib_EcdhCalcSecret(&ctx[i], pub[1 - i], ECDH_SIZE, secret[i], &size),
+              "lib_EcdhCalcSecret");
+        derive_key(secret[i], size, key[i]);
+        lib_EcdhFinal(&ctx[i]);
+    }
+
+    if (memcmp(key[0], key[1], SHA256_DIGEST_LEN)) {
+        printf("ECDH: keys do not match\n");
+        exit(1);
+    }
+}
+
+static void hex2bin(const char* hex, uint8_t* bin, size_t size) {
+    for (size_t i = 0; i < size; i++)
+        sscanf(hex + 2 * i, "%2hhx", &bin[i]);
+}
+
+/* Test vector from RFC 7748, section 6.1 */
+static void check_x25519(void) {
+    LIB_ECDH_CONTEXT alice;
+    uint8_t pub[ECDH_SIZE], bob_pub[ECDH_SIZE], secret[ECDH_SIZE], expected[ECDH_SIZE];
+    uint64_t size = ECDH_SIZE;
+
+    hex2bin("77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a", alice.priv,
+            ECDH_SIZE);
+    hex2bin("de9edb7d7b7dc1b4d35b61c2ece435373f8343c85b78674dadfc7e146f882b4f", bob_pub,
+            ECDH_SIZE);
+
+    hex2bin("8520f0098930a754748b7ddcb43ef75a0dbf3a0d26381af4eba4a98eaa9b4e6a", expected,
+            ECDH_SIZE);
+    if (lib_EcdhCreatePublic(&alice, pub, &size) || memcmp(pub, expected, ECDH_SIZE)) {
+        printf("X25519: wrong public key\n");
+        exit(1);
+    }
+
+    hex2bin("4a5d9d5ba4ce2de1728e3bf480350f25e07e21c947d19e3376f09b3c1e161742", expected,
+            ECDH_SIZE);
+    if (lib_EcdhCalcSecret(&alice, bob_pub, ECDH_SIZE, secret, &size) ||
+        memcmp(secret, expected, ECDH_SIZE)) {
+        printf("X25519: wrong shared secret\n");
+        exit(1);
+    }
+}
+
+/* Test case 16 of the GCM specification (AES-256, with additional data) */
+static void check_gcm(void) {
+    LIB_AESGCM_CONTEXT ctx;
+    uint8_t key[32], iv[AES_GCM_IV_SIZE], aad[20], pt[60], ct[60], expected[60];
+    uint8_t tag[AES_GCM_TAG_SIZE], expected_tag[AES_GCM_TAG_SIZE];
+
+    hex2bin("feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308", key,
+            sizeof(key));
+    hex2bin("cafebabefacedbaddecaf888", iv, sizeof(iv));
+    hex2bin("feedfacedeadbeeffeedfacedeadbeefabaddad2", aad, sizeof(aad));
+    hex2bin("d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+            "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39", pt, sizeof(pt));
+    hex2bin("522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa"
+            "8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662", expected,
+            sizeof(expected));
+    hex2bin("76fc6ece0f4e1768cddf8853bb2d551b", expected_tag, sizeof(expected_tag));
+
+    check(lib_AESGCMInit(&ctx, key, sizeof(key)), "lib_AESGCMInit");
+    check(lib_AESGCMEncrypt(&ctx, iv, aad, sizeof(aad), pt, sizeof(pt), ct, tag),
+          "lib_AESGCMEncrypt");
+    if (memcmp(ct, expected, sizeof(ct)) || memcmp(tag, expected_tag, sizeof(tag))) {
+        printf("AES-GCM: wrong ciphertext\n");
+        exit(1);
+    }
+
+    check(lib_AESGCMDecrypt(&ctx, iv, aad, sizeof(aad), ct, sizeof(ct), ct, tag),
+          "lib_AESGCMDecrypt");
+    if (memcmp(ct, pt, sizeof(pt))) {
+        printf("AES-GCM: wrong plaintext\n");
+        exit(1);
+    }
+
+    tag[0] ^= 1;
+    if (!lib_AESGCMDecrypt(&ctx, iv, aad, sizeof(aad), expected, sizeof(expected), ct, tag)) {
+        printf("AES-GCM: forged tag accepted\n");
+        exit(1);
+    }
+    lib_AESGCMFinal(&ctx);
+}
+
+static void bench_gcm(size_t record_size, size_t total) {
+    LIB_AESGCM_CONTEXT ctx;
+    uint8_t key[32], iv[AES_GCM_IV_SIZE], aad[24], tag[AES_GCM_TAG_SIZE];
+    uint8_t* plain  = malloc(record_size);
+    uint8_t* sealed = malloc(record_size);
+
+    if (!plain || !sealed) {
+        printf("out of memory\n");
+        exit(1);
+    }
+
+    memset(key, 0x42, sizeof(key));
+    memset(iv, 0, sizeof(iv));
+    memset(aad, 0, sizeof(aad));
+    memset(plain, 0x5a, record_size);
+    check(lib_AESGCMInit(&ctx, key, sizeof(key)), "lib_AESGCMInit");
+
+    size_t records = total / record_size;
+    if (!records)
+        records = 1;
+
+    double start = now_usec();
+    for (size_t i = 0; i < records; i++) {
+        memcpy(iv, &i, sizeof(i));
+        check(lib_AESGCMEncrypt(&ctx, iv, aad, sizeof(aad), plain, record_size, sealed, tag),
+              "lib_AESGCMEncrypt");
+    }
+    double sealing = now_usec() - start;
+
+    /* open the last record over and over */
+    start = now_usec();
+    for (size_t i = 0; i < records; i++)
+        check(lib_AESGCMDecrypt(&ctx, iv, aad, sizeof(aad), sealed, record_size, plain, tag),
+              "lib_AESGCMDecrypt");
+    double opening = now_usec() - start;
+
+    double mb = (double)records * record_size / (1024 * 1024);
+    printf("AES-256-GCM %6zu-byte records: seal %8.1f MB/s, open %8.1f MB/s\n", record_size,
+           mb / (sealing / 1000000.0), mb / (opening / 1000000.0));
+
+    lib_AESGCMFinal(&ctx);
+    free(plain);
+    free(sealed);
+}
+
+static void bench(const char* name, void (*handshake)(void), int iterations) {
+    double start = now_usec();
+    for (int i = 0; i < iterations; i++)
+        handshake();
+    double elapsed = now_usec() - start;
+
+    printf("%-12s %d handshakes: %10.1f microseconds per handshake\n", name, iterations,
+           elapsed / iterations);
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 100;
+    if (iterations <= 0)
+        iterations = 100;
+
+    int megabytes = argc > 2 ? atoi(argv[2]) : 256;
+    if (megabytes <= 0)
+        megabytes = 256;
+
+    check_x25519();
+    check_gcm();
+
+    bench("DH-2048", dh_handshake, iterations);
+    bench("X25519", ecdh_handshake, iterations);
+
+    for (size_t size = 4096; size <= 64 * 1024; size *= 4)
+        bench_gcm(size, (size_t)megabytes * 1024 * 1024);
+    return 0;
+}
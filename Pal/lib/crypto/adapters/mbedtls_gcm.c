@@ -0,0 +1,497 @@
+/* Copyright (C) 2014 Stony Brook University
+
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * AES-GCM (NIST SP 800-38D) on top of the mbedtls AES block cipher.
+ *
+ * The bundled mbedtls is built without its GCM module, so the mode is
+ * implemented here. When the CPU has both AES-NI and PCLMULQDQ, the bulk of
+ * a message goes four blocks at a time: the four counter blocks are
+ * encrypted in parallel, and GHASH multiplies them by H^4..H^1 and reduces
+ * once. The rest goes block by block through mbedtls_aes_crypt_ecb() and
+ * gcm_mult(), which uses the carry-less multiplication of aesni.c, or the
+ * 4-bit table method (Shoup's, as in mbedtls' own gcm.c) without PCLMULQDQ.
+ *
+ * This is kept in a separate object from mbedtls_adapter.c, so that the
+ * LibOS, which links the same library but never uses AES-GCM, does not pull
+ * it in.
+ */
+
+#include "api.h"
+#include "pal_crypto.h"
+#include "pal_error.h"
+#include "crypto/mbedtls/mbedtls/aes.h"
+#include "crypto/mbedtls/mbedtls/aesni.h"
+
+#if defined(MBEDTLS_AESNI_C) && defined(MBEDTLS_HAVE_X86_64)
+#define GCM_AESNI
+#include <immintrin.h>
+#endif
+
+#define GCM_BLOCK_SIZE 16
+
+static inline uint64_t get_be64(const uint8_t* p) {
+    return ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48) | ((uint64_t)p[2] << 40) |
+           ((uint64_t)p[3] << 32) | ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16) |
+           ((uint64_t)p[6] << 8) | (uint64_t)p[7];
+}
+
+static inline void put_be64(uint64_t v, uint8_t* p) {
+    for (int i = 7; i >= 0; i--) {
+        p[i] = v & 0xff;
+        v >>= 8;
+    }
+}
+
+/* Precompute the multiples of H for the 4-bit table method. */
+static void gcm_gen_table(LIB_AESGCM_CONTEXT* context) {
+    uint64_t vh = get_be64(context->H);
+    uint64_t vl = get_be64(context->H + 8);
+
+    context->HL[8] = vl;
+    context->HH[8] = vh;
+    context->HL[0] = 0;
+    context->HH[0] = 0;
+
+    for (int i = 4; i > 0; i >>= 1) {
+        uint64_t t = (vl & 1) * 0xe1000000U;
+        vl = (vh << 63) | (vl >> 1);
+        vh = (vh >> 1) ^ (t << 32);
+        context->HL[i] = vl;
+        context->HH[i] = vh;
+    }
+
+    for (int i = 2; i <= 8; i *= 2) {
+        uint64_t* hl = context->HL + i;
+        uint64_t* hh = context->HH + i;
+        vh = *hh;
+        vl = *hl;
+        for (int j = 1; j < i; j++) {
+            hh[j] = vh ^ context->HH[j];
+            hl[j] = vl ^ context->HL[j];
+        }
+    }
+}
+
+static const uint64_t last4[16] = {
+    0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+    0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0,
+};
+
+/* x = x * H in GF(2^128) */
+static void gcm_mult(LIB_AESGCM_CONTEXT* context, uint8_t x[GCM_BLOCK_SIZE]) {
+#ifdef GCM_AESNI
+    if (context->clmul) {
+        uint8_t out[GCM_BLOCK_SIZE];
+        mbedtls_aesni_gcm_mult(out, x, context->H);
+        memcpy(x, out, GCM_BLOCK_SIZE);
+        return;
+    }
+#endif
+
+    uint8_t lo = x[15] & 0xf;
+    uint64_t zh = context->HH[lo];
+    uint64_t zl = context->HL[lo];
+
+    for (int i = 15; i >= 0; i--) {
+        lo = x[i] & 0xf;
+        uint8_t hi = x[i] >> 4;
+        uint8_t rem;
+
+        if (i != 15) {
+            rem = zl & 0xf;
+            zl = (zh << 60) | (zl >> 4);
+            zh = (zh >> 4) ^ (last4[rem] << 48);
+            zh ^= context->HH[lo];
+            zl ^= context->HL[lo];
+        }
+
+        rem = zl & 0xf;
+        zl = (zh << 60) | (zl >> 4);
+        zh = (zh >> 4) ^ (last4[rem] << 48);
+        zh ^= context->HH[hi];
+        zl ^= context->HL[hi];
+    }
+
+    put_be64(zh, x);
+    put_be64(zl, x + 8);
+}
+
+#ifdef GCM_AESNI
+/* The bulk path handles this many blocks per iteration. */
+#define GCM_WIDE_BLOCKS 4
+#define GCM_WIDE_SIZE   (GCM_WIDE_BLOCKS * GCM_BLOCK_SIZE)
+
+/* The library is not built with -maes and -mpclmul everywhere, so only these
+ * functions are, and they run only after checking the CPU. */
+#define GCM_TARGET __attribute__((target("aes,pclmul,ssse3")))
+
+/* GHASH is computed on byte-reversed blocks, as in Intel's white paper
+ * "Intel Carry-Less Multiplication Instruction and its Usage for Computing
+ * the GCM Mode". */
+GCM_TARGET static inline __m128i bswap128(__m128i x) {
+    return _mm_shuffle_epi8(x, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+                                            8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+/* Accumulate the 256-bit carry-less product of a and b into (lo, mid, hi). */
+GCM_TARGET static inline void clmul_acc(__m128i a, __m128i b, __m128i* lo, __m128i* mid,
+                                        __m128i* hi) {
+    *lo  = _mm_xor_si128(*lo, _mm_clmulepi64_si128(a, b, 0x00));
+    *hi  = _mm_xor_si128(*hi, _mm_clmulepi64_si128(a, b, 0x11));
+    *mid = _mm_xor_si128(*mid, _mm_clmulepi64_si128(a, b, 0x10));
+    *mid = _mm_xor_si128(*mid, _mm_clmulepi64_si128(a, b, 0x01));
+}
+
+/* Reduce an accumulated product modulo x^128 + x^7 + x^2 + x + 1. Both steps
+ * are linear, so a sum of products needs only one reduction. */
+GCM_TARGET static inline __m128i gf_reduce(__m128i lo, __m128i mid, __m128i hi) {
+    lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+    /* shift the 256-bit product left by one bit (bit-reflected operands) */
+    __m128i c_lo = _mm_srli_epi32(lo, 31);
+    __m128i c_hi = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    hi = _mm_or_si128(hi, _mm_srli_si128(c_lo, 12));
+    hi = _mm_or_si128(hi, _mm_slli_si128(c_hi, 4));
+    lo = _mm_or_si128(lo, _mm_slli_si128(c_lo, 4));
+
+    __m128i t = _mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30));
+    t = _mm_xor_si128(t, _mm_slli_epi32(lo, 25));
+    __m128i carry = _mm_srli_si128(t, 4);
+    lo = _mm_xor_si128(lo, _mm_slli_si128(t, 12));
+
+    __m128i u = _mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2));
+    u = _mm_xor_si128(u, _mm_srli_epi32(lo, 7));
+    u = _mm_xor_si128(u, carry);
+    lo = _mm_xor_si128(lo, u);
+    return _mm_xor_si128(hi, lo);
+}
+
+GCM_TARGET static __m128i gf_mul(__m128i a, __m128i b) {
+    __m128i lo = _mm_setzero_si128(), mid = lo, hi = lo;
+    clmul_acc(a, b, &lo, &mid, &hi);
+    return gf_reduce(lo, mid, hi);
+}
+
+GCM_TARGET static void gcm_gen_powers(LIB_AESGCM_CONTEXT* context) {
+    __m128i h = bswap128(_mm_loadu_si128((const __m128i*)context->H));
+    __m128i p = h;
+
+    _mm_storeu_si128((__m128i*)context->Hpow[0], h);
+    for (int i = 1; i < GCM_WIDE_BLOCKS; i++) {
+        p = gf_mul(p, h);
+        _mm_storeu_si128((__m128i*)context->Hpow[i], p);
+    }
+}
+
+/* y = (y ^ c[0]) * H^4 ^ c[1] * H^3 ^ c[2] * H^2 ^ c[3] * H, on reversed blocks */
+GCM_TARGET static inline __m128i ghash_wide(const LIB_AESGCM_CONTEXT* context, __m128i y,
+                                            const __m128i c[GCM_WIDE_BLOCKS]) {
+    __m128i lo = _mm_setzero_si128(), mid = lo, hi = lo;
+
+    for (int i = 0; i < GCM_WIDE_BLOCKS; i++) {
+        __m128i x = bswap128(c[i]);
+        if (i == 0)
+            x = _mm_xor_si128(x, y);
+        __m128i h = _mm_loadu_si128(
+            (const __m128i*)context->Hpow[GCM_WIDE_BLOCKS - 1 - i]);
+        clmul_acc(x, h, &lo, &mid, &hi);
+    }
+    return gf_reduce(lo, mid, hi);
+}
+
+/* GHASH 'blocks' whole blocks, a multiple of GCM_WIDE_BLOCKS. */
+GCM_TARGET static void ghash_update_wide(const LIB_AESGCM_CONTEXT* context,
+                                         uint8_t y[GCM_BLOCK_SIZE], const uint8_t* data,
+                                         uint64_t blocks) {
+    __m128i acc = bswap128(_mm_loadu_si128((const __m128i*)y));
+    __m128i c[GCM_WIDE_BLOCKS];
+
+    for (; blocks; blocks -= GCM_WIDE_BLOCKS, data += GCM_WIDE_SIZE) {
+        for (int i = 0; i < GCM_WIDE_BLOCKS; i++)
+            c[i] = _mm_loadu_si128((const __m128i*)data + i);
+        acc = ghash_wide(context, acc, c);
+    }
+    _mm_storeu_si128((__m128i*)y, bswap128(acc));
+}
+
+/* Encrypt GCM_WIDE_BLOCKS counter blocks following ctr, and advance ctr. */
+GCM_TARGET static inline void ctr_wide(const __m128i* rk, int nr, __m128i* ctr,
+                                       __m128i ks[GCM_WIDE_BLOCKS]) {
+    const __m128i one = _mm_set_epi32(0, 0, 0, 1);
+
+    /* ctr holds the reversed counter block, so that the 32-bit counter is
+     * the lowest lane */
+    for (int i = 0; i < GCM_WIDE_BLOCKS; i++) {
+        *ctr = _mm_add_epi32(*ctr, one);
+        ks[i] = _mm_xor_si128(bswap128(*ctr), rk[0]);
+    }
+    for (int r = 1; r < nr; r++)
+        for (int i = 0; i < GCM_WIDE_BLOCKS; i++)
+            ks[i] = _mm_aesenc_si128(ks[i], rk[r]);
+    for (int i = 0; i < GCM_WIDE_BLOCKS; i++)
+        ks[i] = _mm_aesenclast_si128(ks[i], rk[nr]);
+}
+
+/*
+ * Run the counter mode over 'blocks' whole blocks, a multiple of
+ * GCM_WIDE_BLOCKS. With 'y', also GHASH the output: each ciphertext block is
+ * hashed from registers before it is stored, so the output is never read.
+ */
+GCM_TARGET static void ctr_update_wide(const LIB_AESGCM_CONTEXT* context,
+                                       uint8_t ctr[GCM_BLOCK_SIZE], uint8_t* y,
+                                       const uint8_t* input, uint8_t* output,
+                                       uint64_t blocks) {
+    const uint8_t* keys = (const uint8_t*)context->aes.rk;
+    int nr = context->aes.nr;
+    __m128i rk[15];
+
+    for (int r = 0; r <= nr; r++)
+        rk[r] = _mm_loadu_si128((const __m128i*)keys + r);
+
+    __m128i counter = bswap128(_mm_loadu_si128((const __m128i*)ctr));
+    __m128i acc = y ? bswap128(_mm_loadu_si128((const __m128i*)y)) : _mm_setzero_si128();
+    __m128i c[GCM_WIDE_BLOCKS];
+
+    for (; blocks; blocks -= GCM_WIDE_BLOCKS) {
+        ctr_wide(rk, nr, &counter, c);
+        for (int i = 0; i < GCM_WIDE_BLOCKS; i++)
+            c[i] = _mm_xor_si128(c[i], _mm_loadu_si128((const __m128i*)input + i));
+        if (y)
+            acc = ghash_wide(context, acc, c);
+        for (int i = 0; i < GCM_WIDE_BLOCKS; i++)
+            _mm_storeu_si128((__m128i*)output + i, c[i]);
+        input += GCM_WIDE_SIZE;
+        output += GCM_WIDE_SIZE;
+    }
+
+    _mm_storeu_si128((__m128i*)ctr, bswap128(counter));
+    if (y)
+        _mm_storeu_si128((__m128i*)y, bswap128(acc));
+}
+
+/* Number of blocks at the start of a message of 'len' bytes for the bulk path */
+static inline uint64_t gcm_wide_blocks(const LIB_AESGCM_CONTEXT* context, uint64_t len) {
+    if (!context->wide)
+        return 0;
+    return len / GCM_WIDE_SIZE * GCM_WIDE_BLOCKS;
+}
+#endif /* GCM_AESNI */
+
+static void ghash_update(LIB_AESGCM_CONTEXT* context, uint8_t y[GCM_BLOCK_SIZE],
+                         const uint8_t* data, uint64_t len) {
+#ifdef GCM_AESNI
+    uint64_t blocks = gcm_wide_blocks(context, len);
+    if (blocks) {
+        ghash_update_wide(context, y, data, blocks);
+        data += blocks * GCM_BLOCK_SIZE;
+        len -= blocks * GCM_BLOCK_SIZE;
+    }
+#endif
+
+    while (len) {
+        uint64_t n = len < GCM_BLOCK_SIZE ? len : GCM_BLOCK_SIZE;
+        for (uint64_t i = 0; i < n; i++)
+            y[i] ^= data[i];
+        gcm_mult(context, y);
+        data += n;
+        len -= n;
+    }
+}
+
+static int gcm_block_ctr(LIB_AESGCM_CONTEXT* context, uint8_t ctr[GCM_BLOCK_SIZE],
+                         uint8_t ks[GCM_BLOCK_SIZE]) {
+    /* the counter is the last 32 bits, big-endian */
+    for (int i = GCM_BLOCK_SIZE - 1; i >= GCM_BLOCK_SIZE - 4; i--)
+        if (++ctr[i])
+            break;
+
+    if (mbedtls_aes_crypt_ecb(&context->aes, MBEDTLS_AES_ENCRYPT, ctr, ks) != 0)
+        return -PAL_ERROR_CRYPTO_BAD_INPUT_DATA;
+    return 0;
+}
+
+static int gcm_finish(LIB_AESGCM_CONTEXT* context, const uint8_t j0[GCM_BLOCK_SIZE],
+                      uint8_t y[GCM_BLOCK_SIZE], uint64_t aad_len, uint64_t len,
+                      uint8_t tag[AES_GCM_TAG_SIZE]) {
+    uint8_t lens[GCM_BLOCK_SIZE];
+    uint8_t ek[GCM_BLOCK_SIZE];
+
+    put_be64(aad_len * 8, lens);
+    put_be64(len * 8, lens + 8);
+    ghash_update(context, y, lens, sizeof(lens));
+
+    if (mbedtls_aes_crypt_ecb(&context->aes, MBEDTLS_AES_ENCRYPT, j0, ek) != 0)
+        return -PAL_ERROR_CRYPTO_BAD_INPUT_DATA;
+
+    for (int i = 0; i < AES_GCM_TAG_SIZE; i++)
+        tag[i] = y[i] ^ ek[i];
+    return 0;
+}
+
+static void gcm_j0(const uint8_t* iv, uint8_t j0[GCM_BLOCK_SIZE]) {
+    memcpy(j0, iv, AES_GCM_IV_SIZE);
+    j0[12] = 0;
+    j0[13] = 0;
+    j0[14] = 0;
+    j0[15] = 1;
+}
+
+/* The counter is 32 bits, so one message is at most 2^32 - 2 blocks. */
+static bool gcm_check_len(uint64_t len) {
+    return len <= ((1ULL << 32) - 2) * GCM_BLOCK_SIZE;
+}
+
+int lib_AESGCMInit(LIB_AESGCM_CONTEXT* context, const uint8_t* key, uint64_t key_len) {
+    if (key_len != 16 && key_len != 24 && key_len != 32)
+        return -PAL_ERROR_CRYPTO_INVALID_KEY_LENGTH;
+
+    memset(context, 0, sizeof(*context));
+    mbedtls_aes_init(&context->aes);
+
+    int ret = mbedtls_aes_setkey_enc(&context->aes, key, key_len * 8);
+    if (ret != 0) {
+        mbedtls_aes_free(&context->aes);
+        return -PAL_ERROR_CRYPTO_INVALID_KEY_LENGTH;
+    }
+
+    uint8_t zero[GCM_BLOCK_SIZE];
+    memset(zero, 0, sizeof(zero));
+    mbedtls_aes_crypt_ecb(&context->aes, MBEDTLS_AES_ENCRYPT, zero, context->H);
+
+#ifdef GCM_AESNI
+    context->clmul = mbedtls_aesni_has_support(MBEDTLS_AESNI_CLMUL);
+    /* the round keys are in the AES-NI layout only if mbedtls uses AES-NI */
+    context->wide = context->clmul && mbedtls_aesni_has_support(MBEDTLS_AESNI_AES);
+    if (context->wide)
+        gcm_gen_powers(context);
+#endif
+    if (!context->clmul)
+        gcm_gen_table(context);
+
+    return 0;
+}
+
+/* The output may be in untrusted memory, so each ciphertext block is hashed
+ * before it is stored, and never read back. */
+int lib_AESGCMEncrypt(LIB_AESGCM_CONTEXT* context, const uint8_t* iv, const uint8_t* aad,
+                      uint64_t aad_len, const uint8_t* input, uint64_t input_len,
+                      uint8_t* output, uint8_t* tag) {
+    uint8_t j0[GCM_BLOCK_SIZE], ctr[GCM_BLOCK_SIZE];
+    uint8_t y[GCM_BLOCK_SIZE], block[GCM_BLOCK_SIZE];
+
+    if (!gcm_check_len(input_len))
+        return -PAL_ERROR_CRYPTO_INVALID_INPUT_LENGTH;
+
+    gcm_j0(iv, j0);
+    memcpy(ctr, j0, sizeof(ctr));
+    memset(y, 0, sizeof(y));
+    ghash_update(context, y, aad, aad_len);
+
+    uint64_t left = input_len;
+#ifdef GCM_AESNI
+    uint64_t blocks = gcm_wide_blocks(context, left);
+    if (blocks) {
+        ctr_update_wide(context, ctr, y, input, output, blocks);
+        input += blocks * GCM_BLOCK_SIZE;
+        output += blocks * GCM_BLOCK_SIZE;
+        left -= blocks * GCM_BLOCK_SIZE;
+    }
+#endif
+
+    while (left) {
+        int ret = gcm_block_ctr(context, ctr, block);
+        if (ret < 0)
+            return ret;
+
+        uint64_t n = left < GCM_BLOCK_SIZE ? left : GCM_BLOCK_SIZE;
+        for (uint64_t i = 0; i < n; i++) {
+            block[i] ^= input[i];
+            y[i] ^= block[i];
+        }
+        gcm_mult(context, y);
+        memcpy(output, block, n);
+
+        input += n;
+        output += n;
+        left -= n;
+    }
+
+    return gcm_finish(context, j0, y, aad_len, input_len, tag);
+}
+
+int lib_AESGCMDecrypt(LIB_AESGCM_CONTEXT* context, const uint8_t* iv, const uint8_t* aad,
+                      uint64_t aad_len, const uint8_t* input, uint64_t input_len,
+                      uint8_t* output, const uint8_t* tag) {
+    uint8_t j0[GCM_BLOCK_SIZE], ctr[GCM_BLOCK_SIZE];
+    uint8_t y[GCM_BLOCK_SIZE], block[GCM_BLOCK_SIZE];
+    uint8_t expected[AES_GCM_TAG_SIZE];
+
+    if (!gcm_check_len(input_len))
+        return -PAL_ERROR_CRYPTO_INVALID_INPUT_LENGTH;
+
+    gcm_j0(iv, j0);
+    memset(y, 0, sizeof(y));
+    ghash_update(context, y, aad, aad_len);
+    ghash_update(context, y, input, input_len);
+
+    int ret = gcm_finish(context, j0, y, aad_len, input_len, expected);
+    if (ret < 0)
+        return ret;
+
+    /* compare in constant time, and only then release the plaintext */
+    uint8_t diff = 0;
+    for (int i = 0; i < AES_GCM_TAG_SIZE; i++)
+        diff |= expected[i] ^ tag[i];
+    if (diff)
+        return -PAL_ERROR_CRYPTO_AUTH_FAILED;
+
+    memcpy(ctr, j0, sizeof(ctr));
+    uint64_t left = input_len;
+#ifdef GCM_AESNI
+    uint64_t blocks = gcm_wide_blocks(context, left);
+    if (blocks) {
+        ctr_update_wide(context, ctr, NULL, input, output, blocks);
+        input += blocks * GCM_BLOCK_SIZE;
+        output += blocks * GCM_BLOCK_SIZE;
+        left -= blocks * GCM_BLOCK_SIZE;
+    }
+#endif
+
+    while (left) {
+        ret = gcm_block_ctr(context, ctr, block);
+        if (ret < 0)
+            return ret;
+
+        uint64_t n = left < GCM_BLOCK_SIZE ? left : GCM_BLOCK_SIZE;
+        for (uint64_t i = 0; i < n; i++)
+            output[i] = input[i] ^ block[i];
+
+        input += n;
+        output += n;
+        left -= n;
+    }
+    return 0;
+}
+
+void lib_AESGCMFinal(LIB_AESGCM_CONTEXT* context) {
+    mbedtls_aes_free(&context->aes);
+    memset(context, 0, sizeof(*context));
+}
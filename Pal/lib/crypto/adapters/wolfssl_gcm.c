@@ -0,0 +1,78 @@
+/* Copyright (C) 2014 Stony Brook University
+
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+/*
+ * AES-GCM on top of the GCM mode of wolfSSL.
+ *
+ * wolfSSL hashes the ciphertext after it has stored it, so it must not
+ * encrypt straight into untrusted memory: the ciphertext goes through a
+ * private buffer first. It checks the tag before it decrypts anything.
+ *
+ * This is kept in a separate object from wolfssl_adapter.c, so that the
+ * LibOS, which links the same library but never uses AES-GCM, does not pull
+ * it in.
+ */
+
+#include "api.h"
+#include "pal_crypto.h"
+#include "pal_error.h"
+
+int lib_AESGCMInit(LIB_AESGCM_CONTEXT* context, const uint8_t* key, uint64_t key_len) {
+    if (key_len != 16 && key_len != 24 && key_len != 32)
+        return -PAL_ERROR_CRYPTO_INVALID_KEY_LENGTH;
+
+    memset(context, 0, sizeof(*context));
+    if (AesGcmSetKey(context, key, key_len) != 0)
+        return -PAL_ERROR_CRYPTO_INVALID_KEY_LENGTH;
+    return 0;
+}
+
+int lib_AESGCMEncrypt(LIB_AESGCM_CONTEXT* context, const uint8_t* iv, const uint8_t* aad,
+                      uint64_t aad_len, const uint8_t* input, uint64_t input_len,
+                      uint8_t* output, uint8_t* tag) {
+    if (input_len > UINT32_MAX || aad_len > UINT32_MAX)
+        return -PAL_ERROR_CRYPTO_INVALID_INPUT_LENGTH;
+
+    uint8_t* buf = malloc(input_len ? input_len : 1);
+    if (!buf)
+        return -PAL_ERROR_NOMEM;
+
+    int ret = AesGcmEncrypt(context, buf, input, input_len, iv, AES_GCM_IV_SIZE, tag,
+                            AES_GCM_TAG_SIZE, aad, aad_len);
+    if (ret == 0)
+        memcpy(output, buf, input_len);
+
+    free(buf);
+    return ret == 0 ? 0 : -PAL_ERROR_CRYPTO_BAD_INPUT_DATA;
+}
+
+int lib_AESGCMDecrypt(LIB_AESGCM_CONTEXT* context, const uint8_t* iv, const uint8_t* aad,
+                      uint64_t aad_len, const uint8_t* input, uint64_t input_len,
+                      uint8_t* output, const uint8_t* tag) {
+    if (input_len > UINT32_MAX || aad_len > UINT32_MAX)
+        return -PAL_ERROR_CRYPTO_INVALID_INPUT_LENGTH;
+
+    int ret = AesGcmDecrypt(context, output, input, input_len, iv, AES_GCM_IV_SIZE, tag,
+                            AES_GCM_TAG_SIZE, aad, aad_len);
+    if (ret == AES_GCM_AUTH_E)
+        return -PAL_ERROR_CRYPTO_AUTH_FAILED;
+    return ret == 0 ? 0 : -PAL_ERROR_CRYPTO_BAD_INPUT_DATA;
+}
+
+void lib_AESGCMFinal(LIB_AESGCM_CONTEXT* context) {
+    /* Clear the round keys and the hash subkey. */
+    memset(context, 0, sizeof(*context));
+}
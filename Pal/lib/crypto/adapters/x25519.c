@@ -0,0 +1,318 @@
+/* Copyright (C) 2014 Stony Brook University
+
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * Elliptic-curve Diffie-Hellman over Curve25519 (X25519, RFC 7748).
+ *
+ * This does not depend on the crypto provider (the vendored mbedTLS has no
+ * ECP module), so it is built for every provider. Field elements are kept
+ * in radix 2^51: five 51-bit limbs in 64-bit integers, multiplied into
+ * 128-bit products. The Montgomery ladder uses constant-time conditional
+ * swaps, so the running time does not depend on the secret scalar.
+ */
+
+#include "api.h"
+#include "pal_crypto.h"
+#include "pal_error.h"
+
+/* This is declared in pal_internal.h, but that can't be included here. */
+size_t _DkRandomBitsRead(void* buffer, size_t size);
+
+typedef unsigned __int128 uint128_t;
+typedef uint64_t fe25519[5];
+
+#define FE_MASK ((1ULL << 51) - 1)
+
+/*
+ * Limbs of the products are carried back below 2^51 (the first one may
+ * exceed it slightly); 2^255 = 19 (mod p) folds the top carry into limb 0.
+ * Sums and differences are not carried, so inputs of fe_mul() stay below
+ * 2^54 and no 128-bit accumulator overflows.
+ */
+static void fe_carry_wide(fe25519 o, uint128_t t[5]) {
+    t[1] += (uint64_t)(t[0] >> 51);
+    t[2] += (uint64_t)(t[1] >> 51);
+    t[3] += (uint64_t)(t[2] >> 51);
+    t[4] += (uint64_t)(t[3] >> 51);
+    uint64_t c = (uint64_t)(t[4] >> 51);
+
+    o[0] = ((uint64_t)t[0] & FE_MASK) + c * 19;
+    o[1] = (uint64_t)t[1] & FE_MASK;
+    o[2] = (uint64_t)t[2] & FE_MASK;
+    o[3] = (uint64_t)t[3] & FE_MASK;
+    o[4] = (uint64_t)t[4] & FE_MASK;
+    o[1] += o[0] >> 51;
+    o[0] &= FE_MASK;
+}
+
+static void fe_carry(fe25519 o) {
+    o[1] += o[0] >> 51;
+    o[0] &= FE_MASK;
+    o[2] += o[1] >> 51;
+    o[1] &= FE_MASK;
+    o[3] += o[2] >> 51;
+    o[2] &= FE_MASK;
+    o[4] += o[3] >> 51;
+    o[3] &= FE_MASK;
+    o[0] += (o[4] >> 51) * 19;
+    o[4] &= FE_MASK;
+}
+
+/* Swap p and q if b == 1, without branching on b. */
+static void fe_cswap(fe25519 p, fe25519 q, uint64_t b) {
+    uint64_t mask = 0 - b;
+    for (int i = 0; i < 5; i++) {
+        uint64_t t = mask & (p[i] ^ q[i]);
+        p[i] ^= t;
+        q[i] ^= t;
+    }
+}
+
+static uint64_t load64(const uint8_t* in) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--)
+        v = (v << 8) | in[i];
+    return v;
+}
+
+static void store64(uint8_t* out, uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        out[i] = v & 0xff;
+        v >>= 8;
+    }
+}
+
+static void fe_pack(uint8_t* out, const fe25519 n) {
+    fe25519 t;
+
+    memcpy(t, n, sizeof(t));
+    fe_carry(t);
+    fe_carry(t);
+
+    /* Now 0 <= t < 2^255. Add 19, so that t >= p carries into bit 255 */
+    t[0] += 19;
+    fe_carry(t);
+
+    /* Add 2^255 - 19 back, then drop bit 255: this subtracts p exactly once
+     * if t was at least p, and leaves t unchanged otherwise. */
+    t[0] += FE_MASK + 1 - 19;
+    t[1] += FE_MASK;
+    t[2] += FE_MASK;
+    t[3] += FE_MASK;
+    t[4] += FE_MASK;
+    t[1] += t[0] >> 51;
+    t[0] &= FE_MASK;
+    t[2] += t[1] >> 51;
+    t[1] &= FE_MASK;
+    t[3] += t[2] >> 51;
+    t[2] &= FE_MASK;
+    t[4] += t[3] >> 51;
+    t[3] &= FE_MASK;
+    t[4] &= FE_MASK;
+
+    store64(out,      t[0] | (t[1] << 51));
+    store64(out + 8,  (t[1] >> 13) | (t[2] << 38));
+    store64(out + 16, (t[2] >> 26) | (t[3] << 25));
+    store64(out + 24, (t[3] >> 39) | (t[4] << 12));
+}
+
+static void fe_unpack(fe25519 o, const uint8_t* in) {
+    /* Bit 255 is ignored (RFC 7748, 5) */
+    o[0] = load64(in) & FE_MASK;
+    o[1] = (load64(in + 6) >> 3) & FE_MASK;
+    o[2] = (load64(in + 12) >> 6) & FE_MASK;
+    o[3] = (load64(in + 19) >> 1) & FE_MASK;
+    o[4] = (load64(in + 24) >> 12) & FE_MASK;
+}
+
+static void fe_add(fe25519 o, const fe25519 a, const fe25519 b) {
+    for (int i = 0; i < 5; i++)
+        o[i] = a[i] + b[i];
+}
+
+/* o = a + 2p - b, so the limbs don't underflow while b is carried */
+static void fe_sub(fe25519 o, const fe25519 a, const fe25519 b) {
+    o[0] = a[0] + 2 * (FE_MASK - 18) - b[0];
+    for (int i = 1; i < 5; i++)
+        o[i] = a[i] + 2 * FE_MASK - b[i];
+}
+
+static void fe_mul(fe25519 o, const fe25519 a, const fe25519 b) {
+    uint128_t t[5];
+    uint64_t b1_19 = b[1] * 19;
+    uint64_t b2_19 = b[2] * 19;
+    uint64_t b3_19 = b[3] * 19;
+    uint64_t b4_19 = b[4] * 19;
+
+    t[0] = (uint128_t)a[0] * b[0] + (uint128_t)a[1] * b4_19 + (uint128_t)a[2] * b3_19
+           + (uint128_t)a[3] * b2_19 + (uint128_t)a[4] * b1_19;
+    t[1] = (uint128_t)a[0] * b[1] + (uint128_t)a[1] * b[0] + (uint128_t)a[2] * b4_19
+           + (uint128_t)a[3] * b3_19 + (uint128_t)a[4] * b2_19;
+    t[2] = (uint128_t)a[0] * b[2] + (uint128_t)a[1] * b[1] + (uint128_t)a[2] * b[0]
+           + (uint128_t)a[3] * b4_19 + (uint128_t)a[4] * b3_19;
+    t[3] = (uint128_t)a[0] * b[3] + (uint128_t)a[1] * b[2] + (uint128_t)a[2] * b[1]
+           + (uint128_t)a[3] * b[0] + (uint128_t)a[4] * b4_19;
+    t[4] = (uint128_t)a[0] * b[4] + (uint128_t)a[1] * b[3] + (uint128_t)a[2] * b[2]
+           + (uint128_t)a[3] * b[1] + (uint128_t)a[4] * b[0];
+
+    fe_carry_wide(o, t);
+}
+
+static void fe_sq(fe25519 o, const fe25519 a) {
+    uint128_t t[5];
+    uint64_t a0_2  = a[0] * 2;
+    uint64_t a1_2  = a[1] * 2;
+    uint64_t a2_2  = a[2] * 2;
+    uint64_t a3_19 = a[3] * 19;
+    uint64_t a4_19 = a[4] * 19;
+
+    t[0] = (uint128_t)a[0] * a[0] + (uint128_t)a1_2 * a4_19 + (uint128_t)a2_2 * a3_19;
+    t[1] = (uint128_t)a0_2 * a[1] + (uint128_t)a2_2 * a4_19 + (uint128_t)a[3] * a3_19;
+    t[2] = (uint128_t)a0_2 * a[2] + (uint128_t)a[1] * a[1] + (uint128_t)(a[3] * 2) * a4_19;
+    t[3] = (uint128_t)a0_2 * a[3] + (uint128_t)a1_2 * a[2] + (uint128_t)a[4] * a4_19;
+    t[4] = (uint128_t)a0_2 * a[4] + (uint128_t)a1_2 * a[3] + (uint128_t)a[2] * a[2];
+
+    fe_carry_wide(o, t);
+}
+
+static void fe_sq_n(fe25519 o, const fe25519 a, int n) {
+    fe_sq(o, a);
+    while (--n)
+        fe_sq(o, o);
+}
+
+static void fe_mul_small(fe25519 o, const fe25519 a, uint32_t b) {
+    uint128_t t[5];
+
+    for (int i = 0; i < 5; i++)
+        t[i] = (uint128_t)a[i] * b;
+
+    fe_carry_wide(o, t);
+}
+
+/* o = z^(p - 2) = z^-1 (mod p), with the usual chain of 254 squarings
+ * and 11 multiplications */
+static void fe_invert(fe25519 o, const fe25519 z) {
+    fe25519 z2, z9, z11, z2_5_0, z2_10_0, z2_20_0, z2_50_0, z2_100_0, t;
+
+    fe_sq(z2, z);
+    fe_sq_n(t, z2, 2);
+    fe_mul(z9, t, z);
+    fe_mul(z11, z9, z2);
+    fe_sq(t, z11);
+    fe_mul(z2_5_0, t, z9);
+    fe_sq_n(t, z2_5_0, 5);
+    fe_mul(z2_10_0, t, z2_5_0);
+    fe_sq_n(t, z2_10_0, 10);
+    fe_mul(z2_20_0, t, z2_10_0);
+    fe_sq_n(t, z2_20_0, 20);
+    fe_mul(t, t, z2_20_0);
+    fe_sq_n(t, t, 10);
+    fe_mul(z2_50_0, t, z2_10_0);
+    fe_sq_n(t, z2_50_0, 50);
+    fe_mul(z2_100_0, t, z2_50_0);
+    fe_sq_n(t, z2_100_0, 100);
+    fe_mul(t, t, z2_100_0);
+    fe_sq_n(t, t, 50);
+    fe_mul(t, t, z2_50_0);
+    fe_sq_n(t, t, 5);
+    fe_mul(o, t, z11);
+}
+
+static void x25519_scalarmult(uint8_t* out, const uint8_t* scalar, const uint8_t* point) {
+    uint8_t z[32];
+    fe25519 x, a, b, c, d, e, f;
+
+    memcpy(z, scalar, sizeof(z));
+    z[31] = (z[31] & 127) | 64;
+    z[0] &= 248;
+
+    fe_unpack(x, point);
+    memset(a, 0, sizeof(a));
+    memset(c, 0, sizeof(c));
+    memset(d, 0, sizeof(d));
+    memcpy(b, x, sizeof(b));
+    a[0] = d[0] = 1;
+
+    for (int i = 254; i >= 0; i--) {
+        uint64_t bit = (z[i >> 3] >> (i & 7)) & 1;
+        fe_cswap(a, b, bit);
+        fe_cswap(c, d, bit);
+        fe_add(e, a, c);
+        fe_sub(a, a, c);
+        fe_add(c, b, d);
+        fe_sub(b, b, d);
+        fe_sq(d, e);
+        fe_sq(f, a);
+        fe_mul(a, c, a);
+        fe_mul(c, b, e);
+        fe_add(e, a, c);
+        fe_sub(a, a, c);
+        fe_sq(b, a);
+        fe_sub(c, d, f);
+        fe_mul_small(a, c, 121665);
+        fe_add(a, a, d);
+        fe_mul(c, c, a);
+        fe_mul(a, d, f);
+        fe_mul(d, b, x);
+        fe_sq(b, e);
+        fe_cswap(a, b, bit);
+        fe_cswap(c, d, bit);
+    }
+
+    fe_invert(c, c);
+    fe_mul(a, a, c);
+    fe_pack(out, a);
+
+    memset(z, 0, sizeof(z));
+}
+
+int lib_EcdhInit(LIB_ECDH_CONTEXT* context) {
+    int ret = _DkRandomBitsRead(context->priv, sizeof(context->priv));
+    return ret < 0 ? ret : 0;
+}
+
+int lib_EcdhCreatePublic(LIB_ECDH_CONTEXT* context, uint8_t* public, uint64_t* public_size) {
+    static const uint8_t basepoint[ECDH_SIZE] = {9};
+
+    if (*public_size != ECDH_SIZE)
+        return -PAL_ERROR_INVAL;
+
+    x25519_scalarmult(public, context->priv, basepoint);
+    return 0;
+}
+
+int lib_EcdhCalcSecret(LIB_ECDH_CONTEXT* context, uint8_t* peer, uint64_t peer_size,
+                       uint8_t* secret, uint64_t* secret_size) {
+    if (peer_size != ECDH_SIZE || *secret_size != ECDH_SIZE)
+        return -PAL_ERROR_INVAL;
+
+    x25519_scalarmult(secret, context->priv, peer);
+
+    /* A peer key of small order yields an all-zero secret (RFC 7748, 6.1) */
+    uint8_t bits = 0;
+    for (int i = 0; i < ECDH_SIZE; i++)
+        bits |= secret[i];
+    if (!bits)
+        return -PAL_ERROR_INVAL;
+
+    return 0;
+}
+
+void lib_EcdhFinal(LIB_ECDH_CONTEXT* context) {
+    memset(context->priv, 0, sizeof(context->priv));
+}
@@ -0,0 +1,172 @@
+/* Copyright (C) 2014 Stony Brook University
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * Test of the file buffering of the PALs (graphene/file_buffer.c). It runs
+ * random reads, writes and flushes through a buffer against a file in
+ * memory, and checks every read and the final file against the same
+ * operations done without a buffer. It also counts the host calls of a
+ * line-by-line writer and reader. It runs on the host, outside of Graphene:
+ *
+ *   gcc -O2 -fno-builtin -I. -I../include/pal -I../src \
+ *       file-buffer-test.c graphene/file_buffer.c -o file-buffer-test
+ *   ./file-buffer-test [operations]
+ */
+
+#include "api.h"
+#include "file_buffer.h"
+#include "pal_error.h"
+
+/* api.h declares the string functions of Graphene; take the rest from the
+   host libc */
+int printf(const char* fmt, ...);
+void exit(int status);
+int rand(void);
+void srand(unsigned int seed);
+
+#define FILE_MAX (256 * 1024)
+
+struct test_file {
+    char data[FILE_MAX];
+    uint64_t size;
+    int reads, writes;
+};
+
+static struct test_file buffered, direct;
+
+static void check(int ok, const char* what) {
+    if (!ok) {
+        printf("%s failed\n", what);
+        exit(1);
+    }
+}
+
+static int64_t host_read(void* arg, uint64_t offset, void* buf, uint64_t count) {
+    struct test_file* f = arg;
+    f->reads++;
+    if (offset >= f->size)
+        return 0;
+    if (count > f->size - offset)
+        count = f->size - offset;
+    memcpy(buf, f->data + offset, count);
+    return count;
+}
+
+static int64_t host_write(void* arg, uint64_t offset, const void* buf, uint64_t count) {
+    struct test_file* f = arg;
+    f->writes++;
+    if (offset + count > FILE_MAX)
+        return -PAL_ERROR_NOMEM;
+    if (offset > f->size)
+        memset(f->data + f->size, 0, offset - f->size);
+    memcpy(f->data + offset, buf, count);
+    if (offset + count > f->size)
+        f->size = offset + count;
+    return count;
+}
+
+static const struct file_buffer_ops ops = {
+    .read  = host_read,
+    .write = host_write,
+};
+
+static uint64_t random_offset(void) {
+    /* mostly sequential-looking offsets within and just past the file */
+    uint64_t limit = direct.size + 4096;
+    if (limit > FILE_MAX - 8192)
+        limit = FILE_MAX - 8192;
+    return rand() % limit;
+}
+
+static void random_test(uint64_t read_ahead, uint64_t write_behind, int nops) {
+    memset(&buffered, 0, sizeof(buffered));
+    memset(&direct, 0, sizeof(direct));
+
+    struct file_buffer* fb = file_buffer_create(read_ahead, write_behind);
+    check(!!fb, "file_buffer_create");
+
+    static char buf1[8192], buf2[8192], data[8192];
+    uint64_t next = 0;
+
+    for (int i = 0; i < nops; i++) {
+        /* continue the previous operation half of the time */
+        uint64_t offset = (rand() % 2 && next < FILE_MAX - 8192) ? next : random_offset();
+        uint64_t count = (rand() % 4) ? rand() % 300 : rand() % 8192;
+        int op = rand() % 10;
+
+        if (op < 5) {
+            int64_t r1 = file_buffer_read(fb, &ops, &buffered, offset, buf1, count);
+            int64_t r2 = host_read(&direct, offset, buf2, count);
+            check(r1 == r2, "buffered read size");
+            check(!memcmp(buf1, buf2, r1), "buffered read content");
+            next = offset + r1;
+        } else if (op < 9) {
+            for (uint64_t j = 0; j < count; j++)
+                data[j] = rand();
+            int64_t r1 = file_buffer_write(fb, &ops, &buffered, offset, data, count);
+            int64_t r2 = host_write(&direct, offset, data, count);
+            check(r1 == r2, "buffered write size");
+            next = offset + r1;
+        } else {
+            check(file_buffer_flush(fb, &ops, &buffered) == 0, "flush");
+            check(buffered.size == direct.size &&
+                  !memcmp(buffered.data, direct.data, direct.size), "file after flush");
+        }
+    }
+
+    check(file_buffer_flush(fb, &ops, &buffered) == 0, "final flush");
+    check(buffered.size == direct.size && !memcmp(buffered.data, direct.data, direct.size),
+          "final file");
+    file_buffer_destroy(fb);
+}
+
+int main(int argc, char** argv) {
+    int nops = argc > 1 ? atoi(argv[1]) : 40000;
+    check(nops > 0, "argument");
+    srand(1);
+
+    check(!file_buffer_create(0, 0), "buffer without sizes");
+
+    random_test(4096, 4096, nops);
+    random_test(16384, 0, nops);
+    random_test(0, 16384, nops);
+    random_test(512, 65536, nops);
+
+    /* a log writer: 4000 lines of 64 bytes, then read back line by line */
+    memset(&buffered, 0, sizeof(buffered));
+    struct file_buffer* fb = file_buffer_create(64 * 1024, 64 * 1024);
+    check(!!fb, "file_buffer_create");
+
+    char line[64];
+    memset(line, 'x', sizeof(line) - 1);
+    line[sizeof(line) - 1] = '\n';
+    for (int i = 0; i < 4000; i++)
+        check(file_buffer_write(fb, &ops, &buffered, i * 64, line, 64) == 64, "log write");
+    check(file_buffer_flush(fb, &ops, &buffered) == 0, "log flush");
+    printf("4000 writes of 64 bytes: %d host writes\n", buffered.writes);
+    check(buffered.writes < 20, "coalesced writes");
+
+    for (int i = 0; i < 4000; i++)
+        check(file_buffer_read(fb, &ops, &buffered, i * 64, line, 64) == 64 &&
+              line[63] == '\n', "log read");
+    check(file_buffer_read(fb, &ops, &buffered, 4000 * 64, line, 64) == 0, "read at end");
+    printf("4000 reads of 64 bytes: %d host reads\n", buffered.reads);
+    check(buffered.reads < 20, "read ahead");
+    file_buffer_destroy(fb);
+
+    printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,81 @@
+/* Copyright (C) 2014 Stony Brook University
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * file_buffer.h
+ *
+ * Read-ahead and write-behind buffering of a file handle, for the PALs whose
+ * file reads and writes are expensive (e.g., an enclave exit each). The
+ * buffer holds either data read ahead of the reader, or data written but not
+ * yet passed to the host, never both:
+ *
+ * - A read is served from the buffer; a miss smaller than the read-ahead size
+ *   refills the buffer with one host read, and a larger one reads directly.
+ * - A write is appended to the buffer while it continues the previous one and
+ *   fits into the write-behind size; otherwise the buffer is flushed first.
+ *   A write larger than the write-behind size is passed on directly.
+ *
+ * The buffer is flushed before a read, by file_buffer_flush() (for fsync,
+ * close, and any operation which must see the file as written), and when a
+ * write does not continue the buffered ones (a seek). An error of a deferred
+ * write is returned by the operation which flushes it.
+ *
+ * The functions here do not lock; the caller serializes the calls on one
+ * buffer.
+ */
+
+#ifndef FILE_BUFFER_H
+#define FILE_BUFFER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Positional host I/O of the file. Return the bytes read or written, or a
+   negative PAL error. */
+struct file_buffer_ops {
+    int64_t (*read) (void * arg, uint64_t offset, void * buf, uint64_t count);
+    int64_t (*write) (void * arg, uint64_t offset, const void * buf, uint64_t count);
+};
+
+struct file_buffer {
+    uint64_t read_ahead;    /* 0 if reads are not buffered */
+    uint64_t write_behind;  /* 0 if writes are not buffered */
+    uint64_t start;         /* file offset of data[0] */
+    uint64_t len;           /* bytes in data */
+    bool     dirty;         /* data is written, not read ahead */
+    char     data[];
+};
+
+/* Returns NULL if both sizes are 0, or out of memory */
+struct file_buffer * file_buffer_create (uint64_t read_ahead,
+                                         uint64_t write_behind);
+
+/* Frees the buffer; the caller flushes it first */
+void file_buffer_destroy (struct file_buffer * fb);
+
+int64_t file_buffer_read (struct file_buffer * fb,
+                          const struct file_buffer_ops * ops, void * arg,
+                          uint64_t offset, void * buf, uint64_t count);
+
+int64_t file_buffer_write (struct file_buffer * fb,
+                           const struct file_buffer_ops * ops, void * arg,
+                           uint64_t offset, const void * buf, uint64_t count);
+
+/* Writes out the buffered writes and drops the data read ahead */
+int file_buffer_flush (struct file_buffer * fb,
+                       const struct file_buffer_ops * ops, void * arg);
+
+#endif /* FILE_BUFFER_H */
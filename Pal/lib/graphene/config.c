@@ -34,16 +34,199 @@ struct config {
                           of config value lengths plus one of all the
                           immediate children. */
     char* buf;
+    struct config* parent;
+    struct config* hnext; /* next node in the same bucket of store->index,
+                             or in store->free_nodes */
+    uint32_t hash;
     LIST_TYPE(config) list;
     LISTP_TYPE(config) children;
     LIST_TYPE(config) siblings;
 };
 
+/* Nodes are carved out of chunks, sized for the whole manifest when it is
+ * read, instead of being allocated one by one. */
+struct config_chunk {
+    struct config_chunk* next;
+    size_t size, used;
+    struct config nodes[];
+};
+
+#define CONFIG_CHUNK_MIN 64
+
+/* Every node is in one hash table per store, keyed by its parent and its
+ * own key token, so finding the child of a node takes the same time no matter
+ * how many siblings it has. */
+#define CONFIG_INDEX_MIN 64
+
+static uint32_t __hash_config(const struct config* parent, const char* key, size_t klen) {
+    /* FNV-1a over the token, seeded with the parent */
+    uint64_t p = (uint64_t)(uintptr_t)parent;
+    uint32_t h = 2166136261U ^ (uint32_t)(p ^ (p >> 32));
+    for (size_t i = 0; i < klen; i++) {
+        h ^= (unsigned char)key[i];
+        h *= 16777619U;
+    }
+    return h;
+}
+
+static struct config* __lookup_config(struct config_store* store, struct config* parent,
+                                      const char* key, size_t klen) {
+    if (!store->index_size)
+        return NULL;
+
+    uint32_t hash    = __hash_config(parent, key, klen);
+    struct config* e = store->index[hash & (store->index_size - 1)];
+
+    for (; e; e = e->hnext)
+        if (e->hash == hash && e->parent == parent && e->klen == klen &&
+            !memcmp(e->key, key, klen))
+            return e;
+
+    return NULL;
+}
+
+static int __resize_index(struct config_store* store, size_t size) {
+    struct config** index = store->malloc(sizeof(struct config*) * size);
+    if (!index)
+        return -PAL_ERROR_NOMEM;
+
+    memset(index, 0, sizeof(struct config*) * size);
+
+    for (size_t i = 0; i < store->index_size; i++) {
+        struct config* e = store->index[i];
+        while (e) {
+            struct config* n = e->hnext;
+            e->hnext = index[e->hash & (size - 1)];
+            index[e->hash & (size - 1)] = e;
+            e = n;
+        }
+    }
+
+    if (store->index)
+        store->free(store->index);
+    store->index      = index;
+    store->index_size = size;
+    return 0;
+}
+
+static int __index_config(struct config_store* store, struct config* e) {
+    /* keep the table at most half full */
+    if ((store->nentries + 1) * 2 > store->index_size) {
+        size_t size = store->index_size ? store->index_size * 2 : CONFIG_INDEX_MIN;
+        int ret = __resize_index(store, size);
+        if (ret < 0)
+            return ret;
+    }
+
+    e->hash = __hash_config(e->parent, e->key, e->klen);
+    struct config** bucket = &store->index[e->hash & (store->index_size - 1)];
+    e->hnext = *bucket;
+    *bucket  = e;
+    store->nentries++;
+    return 0;
+}
+
+static void __unindex_config(struct config_store* store, struct config* e) {
+    struct config** p = &store->index[e->hash & (store->index_size - 1)];
+    for (; *p; p = &(*p)->hnext)
+        if (*p == e) {
+            *p = e->hnext;
+            store->nentries--;
+            break;
+        }
+}
+
+static int __reserve_config(struct config_store* store, size_t nentries) {
+    size_t size = CONFIG_INDEX_MIN;
+    while (size < nentries * 2)
+        size *= 2;
+    if (size > store->index_size) {
+        int ret = __resize_index(store, size);
+        if (ret < 0)
+            return ret;
+    }
+
+    struct config_chunk* chunk = store->chunks;
+    if (chunk && chunk->size - chunk->used >= nentries)
+        return 0;
+
+    if (nentries < CONFIG_CHUNK_MIN)
+        nentries = CONFIG_CHUNK_MIN;
+
+    chunk = store->malloc(sizeof(struct config_chunk) + sizeof(struct config) * nentries);
+    if (!chunk)
+        return -PAL_ERROR_NOMEM;
+
+    chunk->next   = store->chunks;
+    chunk->size   = nentries;
+    chunk->used   = 0;
+    store->chunks = chunk;
+    return 0;
+}
+
+static struct config* __alloc_config(struct config_store* store, struct config* parent,
+                                     const char* key, size_t klen) {
+    struct config* e = store->free_nodes;
+
+    if (e) {
+        store->free_nodes = e->hnext;
+    } else {
+        struct config_chunk* chunk = store->chunks;
+        if (!chunk || chunk->used == chunk->size) {
+            /* grow geometrically, so adding N entries one by one allocates
+               O(log N) chunks */
+            if (__reserve_config(store, chunk ? chunk->size * 2 : CONFIG_CHUNK_MIN) < 0)
+                return NULL;
+            chunk = store->chunks;
+        }
+        e = &chunk->nodes[chunk->used++];
+    }
+
+    e->key    = key;
+    e->klen   = klen;
+    e->val    = NULL;
+    e->vlen   = 0;
+    e->buf    = NULL;
+    e->parent = parent;
+
+    if (__index_config(store, e) < 0) {
+        e->hnext          = store->free_nodes;
+        store->free_nodes = e;
+        return NULL;
+    }
+
+    INIT_LIST_HEAD(e, list);
+    LISTP_ADD_TAIL(e, &store->entries, list);
+    INIT_LISTP(&e->children);
+    INIT_LIST_HEAD(e, siblings);
+    LISTP_ADD_TAIL(e, parent ? &parent->children : &store->root, siblings);
+    return e;
+}
+
+static void __free_config(struct config_store* store, struct config* e) {
+    __unindex_config(store, e);
+    LISTP_DEL(e, e->parent ? &e->parent->children : &store->root, siblings);
+    LISTP_DEL(e, &store->entries, list);
+    if (e->buf)
+        store->free(e->buf);
+    e->hnext          = store->free_nodes;
+    store->free_nodes = e;
+}
+
+static void __init_config(struct config_store* store) {
+    INIT_LISTP(&store->root);
+    INIT_LISTP(&store->entries);
+    store->index      = NULL;
+    store->index_size = 0;
+    store->nentries   = 0;
+    store->chunks     = NULL;
+    store->free_nodes = NULL;
+}
+
 static int __add_config(struct config_store* store, const char* key, size_t klen, const char* val,
                         size_t vlen, struct config** entry) {
-    LISTP_TYPE(config)* list = &store->root;
-    struct config* e         = NULL;
-    struct config* parent    = NULL;
+    struct config* e      = NULL;
+    struct config* parent = NULL;
 
     while (klen) {
         if (e && e->val)
@@ -55,34 +238,19 @@ static int __add_config(struct config_store* store, const char* key, size_t klen
             if (token[len] == '.')
                 break;
 
-        LISTP_FOR_EACH_ENTRY(e, list, siblings) {
-            if (e->klen == len && !memcmp(e->key, token, len))
-                goto next;
+        e = __lookup_config(store, parent, token, len);
+        if (!e) {
+            e = __alloc_config(store, parent, token, len);
+            if (!e)
+                return -PAL_ERROR_NOMEM;
+            if (parent)
+                parent->vlen += (len + 1);
         }
 
-        e = store->malloc(sizeof(struct config));
-        if (!e)
-            return -PAL_ERROR_NOMEM;
-
-        e->key  = token;
-        e->klen = len;
-        e->val  = NULL;
-        e->vlen = 0;
-        e->buf  = NULL;
-        INIT_LIST_HEAD(e, list);
-        LISTP_ADD_TAIL(e, &store->entries, list);
-        INIT_LISTP(&e->children);
-        INIT_LIST_HEAD(e, siblings);
-        LISTP_ADD_TAIL(e, list, siblings);
-        if (parent)
-            parent->vlen += (len + 1);
-
-    next:
         if (len < klen)
             len++;
         key += len;
         klen -= len;
-        list   = &e->children;
         parent = e;
     }
 
@@ -99,8 +267,7 @@ static int __add_config(struct config_store* store, const char* key, size_t klen
 }
 
 static struct config* __get_config(struct config_store* store, const char* key) {
-    LISTP_TYPE(config)* list = &store->root;
-    struct config* e         = NULL;
+    struct config* e = NULL;
 
     while (*key) {
         const char* token = key;
@@ -109,18 +276,13 @@ static struct config* __get_config(struct config_store* store, const char* key)
             if (token[len] == '.')
                 break;
 
-        LISTP_FOR_EACH_ENTRY(e, list, siblings) {
-            if (e->klen == len && !memcmp(e->key, token, len))
-                goto next;
-        }
-
-        return NULL;
+        e = __lookup_config(store, e, token, len);
+        if (!e)
+            return NULL;
 
-    next:
         if (token[len])
             len++;
         key += len;
-        list = &e->children;
     }
 
     return e;
@@ -172,29 +334,20 @@ ssize_t get_config_entries_size(struct config_store* store, const char* key) {
     return e->vlen;
 }
 
-static int __del_config(struct config_store* store, LISTP_TYPE(config)* root, struct config* p,
-                        const char* key) {
-    struct config* e;
-    struct config* found = NULL;
+static int __del_config(struct config_store* store, struct config* p, const char* key) {
     size_t len = 0;
     for (; key[len]; len++)
         if (key[len] == '.')
             break;
 
-    LISTP_FOR_EACH_ENTRY(e, root, siblings) {
-        if (e->klen == len && !memcmp(e->key, key, len)) {
-            found = e;
-            break;
-        }
-    }
-
+    struct config* found = __lookup_config(store, p, key, len);
     if (!found)
         return -PAL_ERROR_INVAL;
 
     if (key[len]) {
         if (found->val)
             return -PAL_ERROR_INVAL;
-        int ret = __del_config(store, &found->children, found, key + len + 1);
+        int ret = __del_config(store, found, key + len + 1);
         if (ret < 0)
             return ret;
         if (!LISTP_EMPTY(&found->children))
@@ -206,11 +359,7 @@ static int __del_config(struct config_store* store, LISTP_TYPE(config)* root, st
 
     if (p)
         p->vlen -= (found->klen + 1);
-    LISTP_DEL(found, root, siblings);
-    LISTP_DEL(found, &store->entries, list);
-    if (found->buf)
-        store->free(found->buf);
-    store->free(found);
+    __free_config(store, found);
 
     return 0;
 }
@@ -220,7 +369,7 @@ int set_config(struct config_store* store, const char* key, const char* val) {
         return -PAL_ERROR_INVAL;
 
     if (!val) { /* deletion */
-        return __del_config(store, &store->root, 0, key);
+        return __del_config(store, NULL, key);
     }
 
     int klen = strlen(key);
@@ -235,6 +384,8 @@ int set_config(struct config_store* store, const char* key, const char* val) {
 
     struct config* e = __get_config(store, key);
     if (e) {
+        if (e->buf)
+            store->free(e->buf);
         e->val  = buf + klen + 1;
         e->vlen = vlen;
         e->buf  = buf;
@@ -252,14 +403,25 @@ int set_config(struct config_store* store, const char* key, const char* val) {
 
 int read_config(struct config_store* store, int (*filter)(const char* key, int ken),
                 const char** errstring) {
-    INIT_LISTP(&store->root);
-    INIT_LISTP(&store->entries);
+    __init_config(store);
 
     char* ptr     = store->raw_data;
     char* ptr_end = store->raw_data + store->raw_size;
 
     const char* err = "unknown error";
 
+    /* most lines of a manifest add one leaf and share their branches with
+       other lines, so size the nodes and the index for one entry per line */
+    size_t nlines = 1;
+    for (char* p = ptr; p < ptr_end; p++)
+        if (*p == '\n')
+            nlines++;
+
+    if (__reserve_config(store, nlines) < 0) {
+        err = "out of memory";
+        goto inval;
+    }
+
 #define IS_SPACE(c) ((c) == ' ' || (c) == '\t')
 #define IS_BREAK(c) ((c) == '\r' || (c) == '\n')
 #define IS_VALID(c)                                                                            \
@@ -360,6 +522,8 @@ int read_config(struct config_store* store, int (*filter)(const char* key, int k
                     GOTO_INVAL("key too long");
                 if (ret == -PAL_ERROR_INVAL)
                     GOTO_INVAL("key format invalid");
+                if (ret == -PAL_ERROR_NOMEM)
+                    GOTO_INVAL("out of memory");
 
                 GOTO_INVAL("unknown error");
             }
@@ -385,19 +549,27 @@ inval:
 
 int free_config(struct config_store* store) {
     struct config* e;
-    struct config* n;
-    LISTP_FOR_EACH_ENTRY_SAFE(e, n, &store->entries, list) {
-        store->free(e->buf);
-        store->free(e);
+    LISTP_FOR_EACH_ENTRY(e, &store->entries, list) {
+        if (e->buf)
+            store->free(e->buf);
     }
 
-    INIT_LISTP(&store->root);
-    INIT_LISTP(&store->entries);
+    struct config_chunk* chunk = store->chunks;
+    while (chunk) {
+        struct config_chunk* next = chunk->next;
+        store->free(chunk);
+        chunk = next;
+    }
+
+    if (store->index)
+        store->free(store->index);
+
+    __init_config(store);
     return 0;
 }
 
 static int __dup_config(const struct config_store* ss, const LISTP_TYPE(config) * sr,
-                        struct config_store* ts, LISTP_TYPE(config) * tr, void** data,
+                        struct config_store* ts, struct config* parent, void** data,
                         size_t* size) {
     struct config* e;
     struct config* new;
@@ -443,23 +615,19 @@ static int __dup_config(const struct config_store* ss, const LISTP_TYPE(config)
             memcpy(val, e->val, e->vlen);
         }
 
-        new = ts->malloc(sizeof(struct config));
-        if (!new)
+        new = __alloc_config(ts, parent, key, e->klen);
+        if (!new) {
+            if (buf)
+                ts->free(buf);
             return -PAL_ERROR_NOMEM;
+        }
 
-        new->key  = key;
-        new->klen = e->klen;
         new->val  = val;
         new->vlen = e->vlen;
         new->buf  = buf;
-        INIT_LIST_HEAD(new, list);
-        LISTP_ADD_TAIL(new, &ts->entries, list);
-        INIT_LISTP(&new->children);
-        INIT_LIST_HEAD(new, siblings);
-        LISTP_ADD_TAIL(new, tr, siblings);
 
         if (!LISTP_EMPTY(&e->children)) {
-            int ret = __dup_config(ss, &e->children, ts, &new->children, data, size);
+            int ret = __dup_config(ss, &e->children, ts, new, data, size);
             if (ret < 0)
                 return ret;
         }
@@ -469,8 +637,7 @@ static int __dup_config(const struct config_store* ss, const LISTP_TYPE(config)
 }
 
 int copy_config(struct config_store* store, struct config_store* new_store) {
-    INIT_LISTP(&new_store->root);
-    INIT_LISTP(&new_store->entries);
+    __init_config(new_store);
 
     struct config* e;
     size_t size = 0;
@@ -493,7 +660,11 @@ int copy_config(struct config_store* store, struct config_store* new_store) {
     new_store->raw_data = data;
     new_store->raw_size = size;
 
-    return __dup_config(store, &store->root, new_store, &new_store->root, &dataptr, &datasz);
+    int ret = __reserve_config(new_store, store->nentries);
+    if (ret < 0)
+        return ret;
+
+    return __dup_config(store, &store->root, new_store, NULL, &dataptr, &datasz);
 }
 
 static int __write_config(void* f, int (*write)(void*, void*, int), struct config_store* store,
@@ -0,0 +1,162 @@
+/* Copyright (C) 2014 Stony Brook University
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * file_buffer.c
+ *
+ * This file contains the read-ahead and write-behind buffering of file
+ * handles (see file_buffer.h).
+ */
+
+#include <api.h>
+#include <file_buffer.h>
+#include <pal_error.h>
+
+struct file_buffer * file_buffer_create (uint64_t read_ahead,
+                                         uint64_t write_behind)
+{
+    if (!read_ahead && !write_behind)
+        return NULL;
+
+    struct file_buffer * fb = malloc(sizeof(*fb) + MAX(read_ahead, write_behind));
+    if (!fb)
+        return NULL;
+
+    fb->read_ahead   = read_ahead;
+    fb->write_behind = write_behind;
+    fb->start        = 0;
+    fb->len          = 0;
+    fb->dirty        = false;
+    return fb;
+}
+
+void file_buffer_destroy (struct file_buffer * fb)
+{
+    free(fb);
+}
+
+int file_buffer_flush (struct file_buffer * fb,
+                       const struct file_buffer_ops * ops, void * arg)
+{
+    if (!fb->dirty) {
+        fb->len = 0;
+        return 0;
+    }
+
+    uint64_t done = 0;
+    int64_t ret = 0;
+
+    while (done < fb->len) {
+        ret = ops->write(arg, fb->start + done, fb->data + done, fb->len - done);
+        if (ret <= 0)
+            break;
+        done += ret;
+    }
+
+    /* the rest is lost if the host fails, as if the writes had failed */
+    bool short_write = done < fb->len;
+    fb->dirty = false;
+    fb->len = 0;
+
+    if (ret < 0)
+        return ret;
+    return short_write ? -PAL_ERROR_DENIED : 0;
+}
+
+int64_t file_buffer_read (struct file_buffer * fb,
+                          const struct file_buffer_ops * ops, void * arg,
+                          uint64_t offset, void * buf, uint64_t count)
+{
+    int64_t ret;
+
+    if (fb->dirty && (ret = file_buffer_flush(fb, ops, arg)) < 0)
+        return ret;
+
+    if (!fb->read_ahead)
+        return ops->read(arg, offset, buf, count);
+
+    uint64_t done = 0;
+    bool end = false;
+
+    while (done < count) {
+        uint64_t pos = offset + done;
+
+        if (pos >= fb->start && pos < fb->start + fb->len) {
+            uint64_t bytes = MIN(count - done, fb->start + fb->len - pos);
+            memcpy(buf + done, fb->data + (pos - fb->start), bytes);
+            done += bytes;
+            continue;
+        }
+
+        /* the last read from the host came up short: likely end of file */
+        if (end)
+            break;
+
+        if (count - done >= fb->read_ahead) {
+            ret = ops->read(arg, pos, buf + done, count - done);
+            if (ret < 0)
+                return done ? (int64_t) done : ret;
+            done += ret;
+            break;
+        }
+
+        ret = ops->read(arg, pos, fb->data, fb->read_ahead);
+        if (ret < 0) {
+            fb->len = 0;
+            return done ? (int64_t) done : ret;
+        }
+
+        fb->start = pos;
+        fb->len   = ret;
+        end       = (uint64_t) ret < fb->read_ahead;
+        if (!ret)
+            break;
+    }
+
+    return done;
+}
+
+int64_t file_buffer_write (struct file_buffer * fb,
+                           const struct file_buffer_ops * ops, void * arg,
+                           uint64_t offset, const void * buf, uint64_t count)
+{
+    int64_t ret;
+
+    if (!fb->dirty) {
+        /* the data read ahead may be overwritten */
+        fb->len = 0;
+    } else if (offset != fb->start + fb->len ||
+               fb->len + count > fb->write_behind) {
+        if ((ret = file_buffer_flush(fb, ops, arg)) < 0)
+            return ret;
+    }
+
+    if (!count)
+        return 0;
+
+    if (count >= fb->write_behind)
+        return ops->write(arg, offset, buf, count);
+
+    if (!fb->dirty) {
+        fb->start = offset;
+        fb->len   = 0;
+        fb->dirty = true;
+    }
+
+    memcpy(fb->data + fb->len, buf, count);
+    fb->len += count;
+    return count;
+}
@@ -0,0 +1,218 @@
+/* Copyright (C) 2014 Stony Brook University
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * Stress test and benchmark of the MPSC queue (mpsc_queue.h). N producer
+ * threads push M nodes each while one consumer pops them; the consumer checks
+ * that no node is lost or duplicated and that the nodes of each producer come
+ * out in the order they were pushed. The same run is then timed with a list
+ * under a mutex, the pattern the queue replaces. It runs on the host, outside
+ * of Graphene:
+ *
+ *   gcc -O2 -pthread -I. mpsc-queue-test.c -o mpsc-queue-test
+ *   ./mpsc-queue-test [producers] [nodes per producer]
+ */
+
+#include "mpsc_queue.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+struct item {
+    int producer;
+    int seq;
+    struct mpsc_node node;
+    struct item * next;     /* for the locked list */
+};
+
+static int nproducers = 4;
+static int nitems = 1000000;
+
+static struct mpsc_queue queue;
+
+static pthread_mutex_t list_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct item * list_head, * list_tail;
+
+static volatile int start;
+
+static double now (void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void * queue_producer (void * arg)
+{
+    struct item * items = arg;
+    while (!start)
+        CPU_RELAX();
+    for (int i = 0; i < nitems; i++)
+        mpsc_queue_push(&queue, &items[i].node);
+    return NULL;
+}
+
+static void * list_producer (void * arg)
+{
+    struct item * items = arg;
+    while (!start)
+        CPU_RELAX();
+    for (int i = 0; i < nitems; i++) {
+        items[i].next = NULL;
+        pthread_mutex_lock(&list_lock);
+        if (list_tail)
+            list_tail->next = &items[i];
+        else
+            list_head = &items[i];
+        list_tail = &items[i];
+        pthread_mutex_unlock(&list_lock);
+    }
+    return NULL;
+}
+
+static struct item * queue_pop (void)
+{
+    struct mpsc_node * node = mpsc_queue_pop(&queue);
+    return node ? (struct item *) ((char *) node - offsetof(struct item, node))
+                : NULL;
+}
+
+static struct item * list_pop (void)
+{
+    pthread_mutex_lock(&list_lock);
+    struct item * item = list_head;
+    if (item) {
+        list_head = item->next;
+        if (!list_head)
+            list_tail = NULL;
+    }
+    pthread_mutex_unlock(&list_lock);
+    return item;
+}
+
+/* Runs the producers and consumes all their items; returns the time taken,
+   or a negative value if the items came out wrong. */
+static double run (void * (*producer) (void *), struct item * (*pop) (void),
+                   struct item ** items)
+{
+    pthread_t threads[nproducers];
+    int expected[nproducers];
+
+    for (int p = 0; p < nproducers; p++) {
+        expected[p] = 0;
+        for (int i = 0; i < nitems; i++) {
+            items[p][i].producer = p;
+            items[p][i].seq = i;
+        }
+    }
+
+    start = 0;
+    for (int p = 0; p < nproducers; p++)
+        if (pthread_create(&threads[p], NULL, producer, items[p])) {
+            perror("pthread_create");
+            exit(1);
+        }
+
+    double begin = now();
+    start = 1;
+
+    long total = (long) nproducers * nitems;
+    for (long n = 0; n < total; ) {
+        struct item * item = pop();
+        if (!item) {
+            CPU_RELAX();
+            continue;
+        }
+        if (item->producer < 0 || item->producer >= nproducers ||
+            item->seq != expected[item->producer]) {
+            printf("got item %d of producer %d, expected item %d\n",
+                   item->seq, item->producer,
+                   expected[item->producer]);
+            return -1;
+        }
+        expected[item->producer]++;
+        n++;
+    }
+
+    double time = now() - begin;
+
+    for (int p = 0; p < nproducers; p++)
+        pthread_join(threads[p], NULL);
+
+    if (pop()) {
+        printf("extra item left after all items were consumed\n");
+        return -1;
+    }
+
+    return time;
+}
+
+int main (int argc, char ** argv)
+{
+    if (argc >= 2)
+        nproducers = atoi(argv[1]);
+    if (argc >= 3)
+        nitems = atoi(argv[2]);
+    if (nproducers <= 0 || nitems <= 0)
+        return 1;
+
+    struct item * items[nproducers];
+    for (int p = 0; p < nproducers; p++)
+        if (!(items[p] = malloc(sizeof(struct item) * nitems)))
+            return 1;
+
+    mpsc_queue_init(&queue);
+    if (!mpsc_queue_empty(&queue) || queue_pop()) {
+        printf("new queue is not empty\n");
+        return 1;
+    }
+
+    /* single-threaded: the queue is FIFO and drains back to empty */
+    for (int i = 0; i < 3; i++)
+        mpsc_queue_push(&queue, &items[0][i].node);
+    if (mpsc_queue_empty(&queue)) {
+        printf("queue with items is empty\n");
+        return 1;
+    }
+    for (int i = 0; i < 3; i++) {
+        struct item * item = queue_pop();
+        if (item != &items[0][i]) {
+            printf("item %d popped out of order\n", i);
+            return 1;
+        }
+    }
+    if (!mpsc_queue_empty(&queue) || queue_pop()) {
+        printf("drained queue is not empty\n");
+        return 1;
+    }
+
+    double queue_time = run(queue_producer, queue_pop, items);
+    if (queue_time < 0)
+        return 1;
+
+    double list_time = run(list_producer, list_pop, items);
+    if (list_time < 0)
+        return 1;
+
+    long total = (long) nproducers * nitems;
+    printf("%d producers, %ld items\n", nproducers, total);
+    printf("mpsc queue:   %.1f ns per item\n", queue_time * 1e9 / total);
+    printf("locked list:  %.1f ns per item\n", list_time * 1e9 / total);
+    printf("All tests passed\n");
+    return 0;
+}
@@ -0,0 +1,131 @@
+/* Copyright (C) 2014 Stony Brook University
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * mpsc_queue.h
+ *
+ * This file defines a lock-free, intrusive FIFO queue with many producers and
+ * a single consumer (D. Vyukov's algorithm), for the PAL and Library OS.
+ *
+ * Any thread (or signal handler) may push without a lock: a push is one
+ * atomic exchange plus one store, and never waits for other threads. Only one
+ * thread may pop at a time, which the user must guarantee (e.g., only the
+ * thread owning the queue pops).
+ *
+ * How-to:
+ *
+ * struct foo {
+ *   int x;
+ *   struct mpsc_node node; // The queue node
+ * };
+ *
+ * struct mpsc_queue queue;
+ * mpsc_queue_init(&queue);
+ *
+ * mpsc_queue_push(&queue, &foo->node);
+ *
+ * struct mpsc_node * node = mpsc_queue_pop(&queue);
+ * if (node)
+ *     foo = container_of(node, struct foo, node);
+ *
+ * The queue holds a stub node inside of it, so it must not be copied or
+ * moved after mpsc_queue_init(). A node must not be pushed again before it is
+ * popped.
+ *
+ * mpsc_queue_pop() returns NULL if the queue is empty, and also if the next
+ * node is being pushed right now (between the exchange and the store of the
+ * producer). The consumer must not spin on that, since the producer may be
+ * interrupted by the consumer itself; it should instead retry once it is
+ * notified of the push, which the producer does after mpsc_queue_push()
+ * returns.
+ */
+
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "atomic.h"
+
+struct mpsc_node {
+    struct mpsc_node * volatile next;
+};
+
+struct mpsc_queue {
+    struct mpsc_node * volatile head;   /* last pushed node; producers */
+    struct mpsc_node * tail;            /* next node to pop; consumer */
+    struct mpsc_node stub;
+};
+
+static inline void mpsc_queue_init (struct mpsc_queue * queue)
+{
+    queue->stub.next = NULL;
+    queue->head = &queue->stub;
+    queue->tail = &queue->stub;
+}
+
+static inline void mpsc_queue_push (struct mpsc_queue * queue,
+                                    struct mpsc_node * node)
+{
+    node->next = NULL;
+    /* serializes the producers; node is the new head from here on, and is
+       linked to its predecessor right after */
+    struct mpsc_node * prev = (struct mpsc_node *)
+        xchg((volatile int64_t *) &queue->head, (int64_t) node);
+    prev->next = node;
+}
+
+/* Returns true if no pushed node is visible to the consumer. May only be
+   called by the consumer, or by a thread which keeps the consumer out. */
+static inline bool mpsc_queue_empty (struct mpsc_queue * queue)
+{
+    return queue->tail == &queue->stub && !queue->stub.next;
+}
+
+static inline struct mpsc_node * mpsc_queue_pop (struct mpsc_queue * queue)
+{
+    struct mpsc_node * tail = queue->tail;
+    struct mpsc_node * next = tail->next;
+
+    if (tail == &queue->stub) {
+        if (!next)
+            return NULL;
+        queue->tail = tail = next;
+        next = next->next;
+    }
+
+    if (next) {
+        queue->tail = next;
+        return tail;
+    }
+
+    /* tail is the last linked node; unless a push is in progress, put the
+       stub back behind it, so that tail can be handed out */
+    if (tail != queue->head)
+        return NULL;
+
+    mpsc_queue_push(queue, &queue->stub);
+
+    next = tail->next;
+    if (!next)
+        return NULL;
+
+    queue->tail = next;
+    return tail;
+}
+
+#endif /* MPSC_QUEUE_H */
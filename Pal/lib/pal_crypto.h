@@ -50,6 +50,7 @@ typedef struct {
 } LIB_DH_CONTEXT __attribute__((aligned(DH_SIZE)));
 
 typedef struct RSAKey LIB_RSA_KEY;
+typedef Aes LIB_AESGCM_CONTEXT;
 #endif /* CRYPTO_USE_WOLFSSL */
 
 #ifdef CRYPTO_USE_MBEDTLS
@@ -73,6 +74,17 @@ typedef struct {
     mbedtls_cipher_type_t cipher;
     mbedtls_cipher_context_t ctx;
 } LIB_AESCMAC_CONTEXT;
+
+#include "crypto/mbedtls/mbedtls/aes.h"
+typedef struct {
+    mbedtls_aes_context aes;
+    uint8_t H[16];      /* hash subkey, E(K, 0^128) */
+    uint64_t HL[16];    /* GHASH table, used without PCLMULQDQ */
+    uint64_t HH[16];
+    uint8_t Hpow[4][16];  /* H^1..H^4, byte-reversed, used with AES-NI and PCLMULQDQ */
+    bool clmul;
+    bool wide;
+} LIB_AESGCM_CONTEXT;
 #endif /* CRYPTO_USE_MBEDTLS */
 
 #ifndef CRYPTO_PROVIDER_SPECIFIED
@@ -93,6 +105,21 @@ int lib_DhCalcSecret(LIB_DH_CONTEXT *context, uint8_t *peer, uint64_t peer_size,
                      uint8_t *secret, uint64_t *secret_size);
 void lib_DhFinal(LIB_DH_CONTEXT *context);
 
+/* Elliptic-curve Diffie-Hellman over Curve25519 (X25519). This does not
+ * depend on the crypto provider. */
+#define ECDH_SIZE 32
+
+typedef struct {
+    uint8_t priv[ECDH_SIZE];
+} LIB_ECDH_CONTEXT;
+
+int lib_EcdhInit(LIB_ECDH_CONTEXT *context);
+int lib_EcdhCreatePublic(LIB_ECDH_CONTEXT *context, uint8_t *public,
+                         uint64_t *public_size);
+int lib_EcdhCalcSecret(LIB_ECDH_CONTEXT *context, uint8_t *peer, uint64_t peer_size,
+                       uint8_t *secret, uint64_t *secret_size);
+void lib_EcdhFinal(LIB_ECDH_CONTEXT *context);
+
 /* AES-CMAC */
 int lib_AESCMAC(const uint8_t *key, uint64_t key_len, const uint8_t *input,
                 uint64_t input_len, uint8_t *mac, uint64_t mac_len);
@@ -106,6 +133,23 @@ int lib_AESCMACUpdate(LIB_AESCMAC_CONTEXT * context, const uint8_t * input,
 int lib_AESCMACFinish(LIB_AESCMAC_CONTEXT * context, uint8_t * mac,
                       uint64_t mac_len);
 
+/* AES-GCM with a 96-bit IV and a 128-bit tag. The record layer of the SGX
+ * PAL encrypts large records with it, so it uses AES-NI and PCLMULQDQ when
+ * the CPU has them. lib_AESGCMEncrypt() never reads back its output, which may
+ * be untrusted memory. lib_AESGCMDecrypt() checks the tag before it writes any
+ * plaintext, and fails with -PAL_ERROR_CRYPTO_AUTH_FAILED. */
+#define AES_GCM_IV_SIZE  12
+#define AES_GCM_TAG_SIZE 16
+
+int lib_AESGCMInit(LIB_AESGCM_CONTEXT *context, const uint8_t *key, uint64_t key_len);
+int lib_AESGCMEncrypt(LIB_AESGCM_CONTEXT *context, const uint8_t *iv,
+                      const uint8_t *aad, uint64_t aad_len, const uint8_t *input,
+                      uint64_t input_len, uint8_t *output, uint8_t *tag);
+int lib_AESGCMDecrypt(LIB_AESGCM_CONTEXT *context, const uint8_t *iv,
+                      const uint8_t *aad, uint64_t aad_len, const uint8_t *input,
+                      uint64_t input_len, uint8_t *output, const uint8_t *tag);
+void lib_AESGCMFinal(LIB_AESGCM_CONTEXT *context);
+
 /* RSA. Limited functionality. */
 // Initializes the key structure
 int lib_RSAInitKey(LIB_RSA_KEY *key);
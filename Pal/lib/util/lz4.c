@@ -0,0 +1,211 @@
+/* Copyright (C) 2014 Stony Brook University
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * lz4.c
+ *
+ * A small compressor and decompressor for the LZ4 block format. The
+ * compressor uses a single-entry hash table per bucket and is tuned for
+ * short (page-sized) inputs rather than compression ratio; its output can
+ * be decoded by any LZ4 block decoder.
+ */
+
+#include <api.h>
+#include <pal_error.h>
+
+#define LZ4_HASH_LOG        12
+#define LZ4_MIN_MATCH       4
+#define LZ4_LAST_LITERALS   5
+#define LZ4_MFLIMIT         12
+#define LZ4_MAX_OFFSET      65535
+#define LZ4_SKIP_TRIGGER    6
+
+static_assert(LZ4_WORKSPACE_SIZE >= sizeof(uint32_t) << LZ4_HASH_LOG,
+              "LZ4_WORKSPACE_SIZE is too small");
+
+static inline uint32_t read32 (const uint8_t * p)
+{
+    uint32_t val;
+    memcpy(&val, p, sizeof(val));
+    return val;
+}
+
+static inline uint32_t lz4_hash (uint32_t seq)
+{
+    return (seq * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+/* Write the extension bytes of a literal or match length. */
+static inline uint8_t * put_length (uint8_t * op, size_t len)
+{
+    for (; len >= 255 ; len -= 255)
+        *op++ = 255;
+    *op++ = (uint8_t) len;
+    return op;
+}
+
+static inline int get_length (const uint8_t ** ip, const uint8_t * iend,
+                              size_t * len)
+{
+    uint8_t b;
+    do {
+        if (*ip >= iend)
+            return -PAL_ERROR_INVAL;
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+    return 0;
+}
+
+/* Room needed for a sequence header plus its literals. */
+#define SEQ_BOUND(lit, mlen) (1 + (lit) / 255 + 1 + (lit) + 2 + (mlen) / 255 + 1)
+
+ssize_t lz4_compress (const void * src, size_t src_size, void * dst,
+                      size_t dst_size, void * workspace)
+{
+    const uint8_t * base = src;
+    const uint8_t * ip = base;
+    const uint8_t * anchor = base;
+    const uint8_t * iend = base + src_size;
+    uint8_t * op = dst;
+    uint8_t * oend = op + dst_size;
+    uint32_t * table = workspace;
+
+    if (src_size > UINT32_MAX)
+        return -PAL_ERROR_INVAL;
+
+    if (src_size > LZ4_MFLIMIT) {
+        const uint8_t * mflimit = iend - LZ4_MFLIMIT;
+        const uint8_t * matchlimit = iend - LZ4_LAST_LITERALS;
+
+        memset(table, 0, sizeof(uint32_t) << LZ4_HASH_LOG);
+
+        while (ip < mflimit) {
+            uint32_t seq = read32(ip);
+            uint32_t h = lz4_hash(seq);
+            const uint8_t * ref = base + table[h];
+            table[h] = ip - base;
+
+            if (ref >= ip || ip - ref > LZ4_MAX_OFFSET || read32(ref) != seq) {
+                /* Step faster through data that does not compress */
+                ip += 1 + ((ip - anchor) >> LZ4_SKIP_TRIGGER);
+                continue;
+            }
+
+            const uint8_t * mp = ip + LZ4_MIN_MATCH;
+            const uint8_t * rp = ref + LZ4_MIN_MATCH;
+            while (mp < matchlimit && *mp == *rp) {
+                mp++;
+                rp++;
+            }
+
+            size_t lit = ip - anchor;
+            size_t mlen = mp - ip - LZ4_MIN_MATCH;
+            if ((size_t) (oend - op) < SEQ_BOUND(lit, mlen))
+                return 0;
+
+            uint8_t * token = op++;
+            if (lit >= 15) {
+                *token = 15 << 4;
+                op = put_length(op, lit - 15);
+            } else {
+                *token = lit << 4;
+            }
+
+            memcpy(op, anchor, lit);
+            op += lit;
+
+            uint16_t offset = ip - ref;
+            *op++ = offset & 0xff;
+            *op++ = offset >> 8;
+
+            if (mlen >= 15) {
+                *token |= 15;
+                op = put_length(op, mlen - 15);
+            } else {
+                *token |= mlen;
+            }
+
+            ip = anchor = mp;
+        }
+    }
+
+    /* The last sequence only carries literals */
+    size_t lit = iend - anchor;
+    if ((size_t) (oend - op) < 1 + lit / 255 + 1 + lit)
+        return 0;
+
+    if (lit >= 15) {
+        *op++ = 15 << 4;
+        op = put_length(op, lit - 15);
+    } else {
+        *op++ = lit << 4;
+    }
+
+    memcpy(op, anchor, lit);
+    op += lit;
+    return op - (uint8_t *) dst;
+}
+
+ssize_t lz4_decompress (const void * src, size_t src_size, void * dst,
+                        size_t dst_size)
+{
+    const uint8_t * ip = src;
+    const uint8_t * iend = ip + src_size;
+    uint8_t * op = dst;
+    uint8_t * oend = op + dst_size;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+
+        size_t lit = token >> 4;
+        if (lit == 15 && get_length(&ip, iend, &lit) < 0)
+            return -PAL_ERROR_INVAL;
+
+        if (lit > (size_t) (iend - ip) || lit > (size_t) (oend - op))
+            return -PAL_ERROR_INVAL;
+
+        memcpy(op, ip, lit);
+        op += lit;
+        ip += lit;
+
+        if (ip == iend)
+            break;
+
+        if (iend - ip < 2)
+            return -PAL_ERROR_INVAL;
+
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (!offset || offset > (size_t) (op - (uint8_t *) dst))
+            return -PAL_ERROR_INVAL;
+
+        size_t mlen = token & 15;
+        if (mlen == 15 && get_length(&ip, iend, &mlen) < 0)
+            return -PAL_ERROR_INVAL;
+        mlen += LZ4_MIN_MATCH;
+
+        if (mlen > (size_t) (oend - op))
+            return -PAL_ERROR_INVAL;
+
+        /* Matches may overlap the output, so copy bytewise */
+        const uint8_t * match = op - offset;
+        while (mlen--)
+            *op++ = *match++;
+    }
+
+    return op - (uint8_t *) dst;
+}
@@ -2,6 +2,18 @@
 #include "pal.h"
 #include "pal_debug.h"
 
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static uint64_t tsc_to_ns(PAL_TSC_CALIBRATION* calib, uint64_t tsc) {
+    return calib->ns_base +
+           (uint64_t)(((unsigned __int128)(tsc - calib->tsc_base) * calib->mult) >>
+                      PAL_TSC_MULT_SHIFT);
+}
+
 int main(int argc, const char** argv, const char** envp) {
     unsigned long time1 = DkSystemTimeQuery();
     unsigned long time2 = DkSystemTimeQuery();
@@ -12,6 +24,30 @@ int main(int argc, const char** argv, const char** envp) {
     if (time1 <= time2)
         pal_printf("Query System Time OK\n");
 
+    unsigned long ns1 = DkSystemTimeQueryNs();
+    unsigned long time = DkSystemTimeQuery();
+    unsigned long ns2 = DkSystemTimeQueryNs();
+
+    if (ns1 && ns1 <= ns2 && ns1 / 1000 <= time && time <= ns2 / 1000)
+        pal_printf("Query System Time in Nanoseconds OK\n");
+
+    PAL_TSC_CALIBRATION calib;
+    if (DkSystemTimeCalibrate(&calib)) {
+        DkThreadDelayExecution(100000);
+        uint64_t tsc = rdtsc();
+        unsigned long ns = DkSystemTimeQueryNs();
+        uint64_t tsc_ns = tsc_to_ns(&calib, tsc);
+        long diff = tsc_ns > ns ? tsc_ns - ns : ns - tsc_ns;
+
+        pal_printf("TSC mapping is off by %ld Nanoseconds after 100000 Microseconds\n", diff);
+
+        /* the first calibration measures the rate over 1 ms only */
+        if (diff < 100000)
+            pal_printf("Calibrate TSC OK\n");
+    } else {
+        pal_printf("Calibrate TSC not supported\n");
+    }
+
     unsigned long time3 = DkSystemTimeQuery();
     DkThreadDelayExecution(10000);
     unsigned long time4 = DkSystemTimeQuery();
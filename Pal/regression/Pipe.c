@@ -38,6 +38,14 @@ int main(int argc, char** argv, char** envp) {
                 if (ret > 0)
                     pal_printf("Pipe Write 1 OK\n");
 
+                /* only the end which was written to is readable */
+                PAL_HANDLE hdls[2]  = {pipe2, pipe3};
+                PAL_FLG events[2]   = {PAL_WAIT_READ, PAL_WAIT_READ | PAL_WAIT_WRITE};
+                PAL_FLG revents[2]  = {0, 0};
+                if (DkStreamsWaitEvents(2, hdls, events, revents, 0) &&
+                    revents[0] == PAL_WAIT_READ && revents[1] == PAL_WAIT_WRITE)
+                    pal_printf("Pipe Wait Events OK\n");
+
                 ret = DkStreamRead(pipe2, 0, 20, buffer3, NULL, 0);
                 if (ret > 0)
                     pal_printf("Pipe Read 1: %s\n", buffer3);
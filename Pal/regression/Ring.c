@@ -0,0 +1,95 @@
+#include "api.h"
+#include "pal.h"
+#include "pal_debug.h"
+
+/* larger than the ring in each direction, so the writer has to wait */
+#define LARGE_SIZE (256 * 1024)
+
+static char large[LARGE_SIZE];
+
+static int thread_write(void* arg) {
+    PAL_HANDLE ring = arg;
+    size_t bytes = 0;
+
+    while (bytes < LARGE_SIZE) {
+        int ret = DkStreamWrite(ring, 0, LARGE_SIZE - bytes, large + bytes, NULL);
+        if (!ret)
+            break;
+        bytes += ret;
+    }
+
+    DkThreadExit();
+    return 0;
+}
+
+int main(int argc, char** argv, char** envp) {
+    char buffer1[20] = "Hello World 1", buffer2[20] = "Hello World 2";
+    char buffer3[20], buffer4[20];
+    int ret;
+
+    PAL_HANDLE ring1 = DkStreamOpen("ring.srv:1", PAL_ACCESS_RDWR, 0, 0, 0);
+    if (!ring1)
+        return 0;
+
+    pal_printf("Ring Creation 1 OK\n");
+
+    PAL_HANDLE ring2 = DkStreamOpen("ring:1", PAL_ACCESS_RDWR, 0, 0, 0);
+    if (!ring2)
+        return 0;
+
+    PAL_HANDLE ring3 = DkStreamWaitForClient(ring1);
+    if (!ring3)
+        return 0;
+
+    pal_printf("Ring Connection 1 OK\n");
+
+    ret = DkStreamWrite(ring3, 0, 20, buffer1, NULL);
+    if (ret > 0)
+        pal_printf("Ring Write 1 OK\n");
+
+    PAL_HANDLE polled = DkObjectsWaitAny(1, &ring2, NO_TIMEOUT);
+    if (polled == ring2)
+        pal_printf("Ring Wait 1 OK\n");
+
+    ret = DkStreamRead(ring2, 0, 20, buffer3, NULL, 0);
+    if (ret > 0)
+        pal_printf("Ring Read 1: %s\n", buffer3);
+
+    ret = DkStreamWrite(ring2, 0, 20, buffer2, NULL);
+    if (ret > 0)
+        pal_printf("Ring Write 2 OK\n");
+
+    ret = DkStreamRead(ring3, 0, 20, buffer4, NULL, 0);
+    if (ret > 0)
+        pal_printf("Ring Read 2: %s\n", buffer4);
+
+    for (int i = 0; i < LARGE_SIZE; i++)
+        large[i] = i % 251;
+
+    if (!DkThreadCreate(thread_write, ring2))
+        return 0;
+
+    size_t bytes = 0;
+    bool ok = true;
+    while (bytes < LARGE_SIZE) {
+        char buffer[4096];
+        ret = DkStreamRead(ring3, 0, sizeof(buffer), buffer, NULL, 0);
+        if (!ret)
+            break;
+        for (int i = 0; i < ret; i++)
+            if (buffer[i] != (char)((bytes + i) % 251))
+                ok = false;
+        bytes += ret;
+    }
+
+    if (ok && bytes == LARGE_SIZE)
+        pal_printf("Ring Large Transfer OK\n");
+
+    DkObjectClose(ring2);
+
+    ret = DkStreamRead(ring3, 0, 20, buffer4, NULL, 0);
+    if (!ret)
+        pal_printf("Ring Closed OK\n");
+
+    return 0;
+}
@@ -0,0 +1,56 @@
+#include "api.h"
+#include "pal.h"
+#include "pal_debug.h"
+
+#define SHM_SIZE 4096
+
+int main(int argc, char** argv) {
+    if (argc == 2 && !memcmp(argv[1], "Child", 6)) {
+        PAL_HANDLE shm = DkReceiveHandle(pal_control.parent_process);
+        if (!shm)
+            return 0;
+
+        char* mem = (char*)DkStreamMap(shm, NULL, PAL_PROT_READ | PAL_PROT_WRITE, 0, SHM_SIZE);
+        if (!mem)
+            return 0;
+
+        pal_printf("Shm Child Read: %s\n", mem);
+        memcpy(mem, "Hello Parent", 13);
+
+        DkStreamWrite(pal_control.parent_process, 0, 1, "1", NULL);
+        return 0;
+    }
+
+    PAL_HANDLE shm = DkStreamOpen("shm:", PAL_ACCESS_RDWR, 0, 0, 0);
+    if (!shm)
+        return 0;
+
+    pal_printf("Shm Creation OK\n");
+
+    if (DkStreamSetLength(shm, SHM_SIZE))
+        return 0;
+
+    char* mem = (char*)DkStreamMap(shm, NULL, PAL_PROT_READ | PAL_PROT_WRITE, 0, SHM_SIZE);
+    if (!mem)
+        return 0;
+
+    pal_printf("Shm Map OK\n");
+    memcpy(mem, "Hello Child", 12);
+
+    const char* args[3] = {"Shm", "Child", NULL};
+    PAL_HANDLE child = DkProcessCreate("file:Shm", args);
+    if (!child)
+        return 0;
+
+    if (!DkSendHandle(child, shm))
+        return 0;
+
+    char byte;
+    if (DkStreamRead(child, 0, 1, &byte, NULL, 0) == 1)
+        pal_printf("Shm Parent Read: %s\n", mem);
+
+    DkStreamUnmap(mem, SHM_SIZE);
+    DkObjectClose(shm);
+    pal_printf("Shm Closed OK\n");
+    return 0;
+}
@@ -22,6 +22,8 @@ int main(int argc, char** argv, char** envp) {
     PRINT_SYMBOL(DkStreamWaitForClient);
     PRINT_SYMBOL(DkStreamRead);
     PRINT_SYMBOL(DkStreamWrite);
+    PRINT_SYMBOL(DkDatagramSend);
+    PRINT_SYMBOL(DkDatagramReceive);
     PRINT_SYMBOL(DkStreamDelete);
     PRINT_SYMBOL(DkStreamMap);
     PRINT_SYMBOL(DkStreamUnmap);
@@ -52,9 +54,12 @@ int main(int argc, char** argv, char** envp) {
     PRINT_SYMBOL(DkEventClear);
 
     PRINT_SYMBOL(DkObjectsWaitAny);
+    PRINT_SYMBOL(DkStreamsWaitEvents);
     PRINT_SYMBOL(DkObjectClose);
 
     PRINT_SYMBOL(DkSystemTimeQuery);
+    PRINT_SYMBOL(DkSystemTimeQueryNs);
+    PRINT_SYMBOL(DkSystemTimeCalibrate);
     PRINT_SYMBOL(DkRandomBitsRead);
     PRINT_SYMBOL(DkInstructionCacheFlush);
     PRINT_SYMBOL(DkSegmentRegister);
@@ -162,6 +162,8 @@ class TC_02_Symbols(RegressionTestCase):
         'DkStreamWaitForClient',
         'DkStreamRead',
         'DkStreamWrite',
+        'DkDatagramSend',
+        'DkDatagramReceive',
         'DkStreamDelete',
         'DkStreamMap',
         'DkStreamUnmap',
@@ -188,8 +190,11 @@ class TC_02_Symbols(RegressionTestCase):
         'DkEventSet',
         'DkEventClear',
         'DkObjectsWaitAny',
+        'DkStreamsWaitEvents',
         'DkObjectClose',
         'DkSystemTimeQuery',
+        'DkSystemTimeQueryNs',
+        'DkSystemTimeCalibrate',
         'DkRandomBitsRead',
         'DkInstructionCacheFlush',
         'DkSegmentRegister',
@@ -405,10 +410,35 @@ class TC_20_SingleProcess(RegressionTestCase):
 
         # Pipe Transmission
         self.assertIn('Pipe Write 1 OK', stderr)
+        self.assertIn('Pipe Wait Events OK', stderr)
         self.assertIn('Pipe Read 1: Hello World 1', stderr)
         self.assertIn('Pipe Write 2 OK', stderr)
         self.assertIn('Pipe Read 2: Hello World 2', stderr)
 
+    @unittest.skipIf(HAS_SGX, 'ring streams are not supported on SGX')
+    def test_401_ring(self):
+        stdout, stderr = self.run_binary(['Ring'])
+
+        self.assertIn('Ring Creation 1 OK', stderr)
+        self.assertIn('Ring Connection 1 OK', stderr)
+        self.assertIn('Ring Write 1 OK', stderr)
+        self.assertIn('Ring Wait 1 OK', stderr)
+        self.assertIn('Ring Read 1: Hello World 1', stderr)
+        self.assertIn('Ring Write 2 OK', stderr)
+        self.assertIn('Ring Read 2: Hello World 2', stderr)
+        self.assertIn('Ring Large Transfer OK', stderr)
+        self.assertIn('Ring Closed OK', stderr)
+
+    @unittest.skipIf(HAS_SGX, 'shared memory is not supported on SGX')
+    def test_402_shm(self):
+        stdout, stderr = self.run_binary(['Shm'])
+
+        self.assertIn('Shm Creation OK', stderr)
+        self.assertIn('Shm Map OK', stderr)
+        self.assertIn('Shm Child Read: Hello Child', stderr)
+        self.assertIn('Shm Parent Read: Hello Parent', stderr)
+        self.assertIn('Shm Closed OK', stderr)
+
     def test_410_socket(self):
         stdout, stderr = self.run_binary(['Socket'])
 
@@ -476,6 +506,15 @@ class TC_20_SingleProcess(RegressionTestCase):
         stdout, stderr = self.run_binary(['Misc'])
         # Query System Time
         self.assertIn('Query System Time OK', stderr)
+        self.assertIn('Query System Time in Nanoseconds OK', stderr)
+
+        # TSC calibration needs an invariant TSC and is not available inside
+        # SGX enclaves
+        if HAS_SGX:
+            self.assertIn('Calibrate TSC not supported', stderr)
+        else:
+            self.assertTrue('Calibrate TSC OK' in stderr or
+                            'Calibrate TSC not supported' in stderr)
 
         # Delay Execution for 10000 Microseconds
         self.assertIn('Delay Execution for 10000 Microseconds OK', stderr)
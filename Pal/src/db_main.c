@@ -210,6 +210,37 @@ static void set_debug_type (void)
     __pal_control.debug_stream = handle;
 }
 
+static unsigned long get_config_size (const char * key)
+{
+    char cfgbuf[CONFIG_MAX];
+    ssize_t ret = get_config(pal_state.root_config, key, cfgbuf, CONFIG_MAX);
+    if (ret <= 0)
+        return 0;
+
+    char * end;
+    long size = strtol(cfgbuf, &end, 0);
+    if (size <= 0)
+        return 0;
+
+    if (*end == 'M' || *end == 'm')
+        size *= 1024 * 1024;
+    else if (*end == 'K' || *end == 'k')
+        size *= 1024;
+
+    return size;
+}
+
+/* Read-ahead and write-behind buffering of file handles opened from now on,
+   see file_buffer.h */
+static void set_file_buffer_sizes (void)
+{
+    if (!pal_state.root_config)
+        return;
+
+    pal_state.file_read_ahead   = get_config_size("loader.file_buffer.read_ahead");
+    pal_state.file_write_behind = get_config_size("loader.file_buffer.write_behind");
+}
+
 static int loader_filter (const char * key, int len)
 {
     /* try to do this as fast as possible */
@@ -432,6 +463,7 @@ noreturn void pal_main (
 #endif
 
     set_debug_type();
+    set_file_buffer_sizes();
 
     __pal_control.host_type          = XSTRINGIFY(HOST_TYPE);
     __pal_control.process_id         = _DkGetProcessId();
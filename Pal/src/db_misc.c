@@ -32,6 +32,31 @@ PAL_NUM DkSystemTimeQuery(void) {
     return time;
 }
 
+PAL_NUM DkSystemTimeQueryNs(void) {
+    ENTER_PAL_CALL(DkSystemTimeQueryNs);
+    unsigned long time = _DkSystemTimeQueryNs();
+    if (!time)
+        _DkRaiseFailure(PAL_ERROR_DENIED);
+    LEAVE_PAL_CALL_RETURN(time);
+}
+
+PAL_BOL DkSystemTimeCalibrate(PAL_TSC_CALIBRATION* calib) {
+    ENTER_PAL_CALL(DkSystemTimeCalibrate);
+
+    if (!calib) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    int ret = _DkSystemTimeCalibrate(calib);
+    if (ret < 0) {
+        _DkRaiseFailure(-ret);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    LEAVE_PAL_CALL_RETURN(PAL_TRUE);
+}
+
 static PAL_LOCK lock = LOCK_INIT;
 static unsigned long seed;
 
@@ -99,3 +99,30 @@ DkObjectsWaitAny(PAL_NUM count, PAL_HANDLE* handleArray, PAL_NUM timeout_us) {
 
     LEAVE_PAL_CALL_RETURN(polled);
 }
+
+// PAL call DkStreamsWaitEvents: wait for any of the events of the streams in
+// the handle array, and return the events of all of them.
+PAL_BOL
+DkStreamsWaitEvents(PAL_NUM count, PAL_HANDLE* handle_array, PAL_FLG* events,
+                    PAL_FLG* ret_events, PAL_NUM timeout_us) {
+    ENTER_PAL_CALL(DkStreamsWaitEvents);
+
+    if (!count || !handle_array || !events || !ret_events) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    for (PAL_NUM i = 0; i < count; i++)
+        if (handle_array[i] && UNKNOWN_HANDLE(handle_array[i])) {
+            _DkRaiseFailure(PAL_ERROR_BADHANDLE);
+            LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+        }
+
+    int ret = _DkStreamsWaitEvents(count, handle_array, events, ret_events, timeout_us);
+    if (ret < 0) {
+        _DkRaiseFailure(-ret);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    LEAVE_PAL_CALL_RETURN(PAL_TRUE);
+}
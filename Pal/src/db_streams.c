@@ -34,6 +34,8 @@
 extern struct handle_ops file_ops;
 extern struct handle_ops pipe_ops;
 extern struct handle_ops pipeprv_ops;
+extern struct handle_ops ring_ops;
+extern struct handle_ops shm_ops;
 extern struct handle_ops dev_ops;
 extern struct handle_ops dir_ops;
 extern struct handle_ops tcp_ops;
@@ -64,6 +66,9 @@ const struct handle_ops* pal_handle_ops[PAL_HANDLE_TYPE_BOUND] = {
     [pal_type_mutex]   = &mutex_ops,
     [pal_type_event]   = &event_ops,
     [pal_type_gipc]    = &gipc_ops,
+    [pal_type_ring]    = &ring_ops,
+    [pal_type_ringsrv] = &ring_ops,
+    [pal_type_shm]     = &shm_ops,
 };
 
 /* parse_stream_uri scan the uri, seperate prefix and search for
@@ -90,6 +95,8 @@ static int parse_stream_uri(const char** uri, char** prefix, struct handle_ops**
                 hops = &udp_ops;
             else if (strstartswith_static(u, "dev"))
                 hops = &dev_ops;
+            else if (strstartswith_static(u, "shm"))
+                hops = &shm_ops;
             break;
 
         case 4:
@@ -99,6 +106,8 @@ static int parse_stream_uri(const char** uri, char** prefix, struct handle_ops**
                 hops = &pipe_ops;
             else if (strstartswith_static(u, "gipc"))
                 hops = &gipc_ops;
+            else if (strstartswith_static(u, "ring"))
+                hops = &ring_ops;
             break;
 
         case 7:
@@ -111,6 +120,8 @@ static int parse_stream_uri(const char** uri, char** prefix, struct handle_ops**
         case 8:
             if (strstartswith_static(u, "pipe.srv"))
                 hops = &pipe_ops;
+            else if (strstartswith_static(u, "ring.srv"))
+                hops = &ring_ops;
             break;
 
         default:
@@ -150,8 +161,10 @@ int _DkStreamOpen(PAL_HANDLE* handle, const char* uri, int access, int share, in
     if (ret < 0)
         return ret;
 
-    assert(ops && ops->open);
-    ret = ops->open(handle, type, uri, access, share, create, options);
+    assert(ops);
+    /* some stream types are not available on every host */
+    ret = ops->open ? ops->open(handle, type, uri, access, share, create, options)
+                    : -PAL_ERROR_NOTSUPPORT;
     free(type);
     return ret;
 }
@@ -344,6 +357,82 @@ DkStreamWrite(PAL_HANDLE handle, PAL_NUM offset, PAL_NUM count, PAL_PTR buffer,
     LEAVE_PAL_CALL_RETURN(ret);
 }
 
+/* _DkDatagramSend for internal use. Send datagrams, each to its own binary
+   address. Return the number of datagrams sent. */
+int64_t _DkDatagramSend(PAL_HANDLE handle, PAL_DATAGRAM* msgs, uint64_t count) {
+    const struct handle_ops* ops = HANDLE_OPS(handle);
+
+    if (!ops)
+        return -PAL_ERROR_BADHANDLE;
+
+    if (!count)
+        return -PAL_ERROR_ZEROSIZE;
+
+    if (!ops->sendbatch)
+        return -PAL_ERROR_NOTSUPPORT;
+
+    return ops->sendbatch(handle, msgs, count);
+}
+
+/* PAL call DkDatagramSend: Send up to count datagrams. Return the number of
+   datagrams sent, or 0 for failure. Error code is notified. */
+PAL_NUM
+DkDatagramSend(PAL_HANDLE handle, PAL_DATAGRAM* msgs, PAL_NUM count) {
+    ENTER_PAL_CALL(DkDatagramSend);
+
+    if (!handle || !msgs) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL_RETURN(0);
+    }
+
+    int64_t ret = _DkDatagramSend(handle, msgs, count);
+
+    if (ret < 0) {
+        _DkRaiseFailure(-ret);
+        ret = 0;
+    }
+
+    LEAVE_PAL_CALL_RETURN(ret);
+}
+
+/* _DkDatagramReceive for internal use. Receive datagrams along with their
+   binary source addresses. Return the number of datagrams received. */
+int64_t _DkDatagramReceive(PAL_HANDLE handle, PAL_DATAGRAM* msgs, uint64_t count) {
+    const struct handle_ops* ops = HANDLE_OPS(handle);
+
+    if (!ops)
+        return -PAL_ERROR_BADHANDLE;
+
+    if (!count)
+        return -PAL_ERROR_ZEROSIZE;
+
+    if (!ops->recvbatch)
+        return -PAL_ERROR_NOTSUPPORT;
+
+    return ops->recvbatch(handle, msgs, count);
+}
+
+/* PAL call DkDatagramReceive: Receive up to count datagrams. Return the
+   number of datagrams received, or 0 for failure. Error code is notified. */
+PAL_NUM
+DkDatagramReceive(PAL_HANDLE handle, PAL_DATAGRAM* msgs, PAL_NUM count) {
+    ENTER_PAL_CALL(DkDatagramReceive);
+
+    if (!handle || !msgs) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL_RETURN(0);
+    }
+
+    int64_t ret = _DkDatagramReceive(handle, msgs, count);
+
+    if (ret < 0) {
+        _DkRaiseFailure(-ret);
+        ret = 0;
+    }
+
+    LEAVE_PAL_CALL_RETURN(ret);
+}
+
 /* _DkStreamAttributesQuery of internal use. The function query attribute
    of streams by their URI */
 int _DkStreamAttributesQuery(const char* uri, PAL_STREAM_ATTR* attr) {
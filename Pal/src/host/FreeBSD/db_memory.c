@@ -109,3 +109,6 @@ unsigned long _DkMemoryAvailableQuota(void) {
         return 0;
     return quota * 1024;
 }
+
+/* "shm:" streams (shared anonymous memory) are not implemented */
+struct handle_ops shm_ops;
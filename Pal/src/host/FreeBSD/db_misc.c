@@ -61,6 +61,16 @@ unsigned long _DkSystemTimeQuery (void)
 #endif
 }
 
+unsigned long _DkSystemTimeQueryNs (void)
+{
+    return 1000ULL * _DkSystemTimeQuery();
+}
+
+int _DkSystemTimeCalibrate (PAL_TSC_CALIBRATION * calib)
+{
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
+
 #if USE_ARCH_RDRAND == 1
 int _DkRandomBitsRead (void * buffer, int size)
 {
@@ -231,3 +231,9 @@ int _DkObjectsWaitAny (int count, PAL_HANDLE * handleArray, uint64_t timeout,
     *polled = polled_hdl;
     return polled_hdl ? 0 : -PAL_ERROR_TRYAGAIN;
 }
+
+int _DkStreamsWaitEvents (size_t count, PAL_HANDLE * handle_array, PAL_FLG * events,
+                          PAL_FLG * ret_events, int64_t timeout_us)
+{
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
@@ -622,3 +622,6 @@ struct handle_ops pipeprv_ops = {
         .attrquerybyhdl     = &pipe_attrquerybyhdl,
         .attrsetbyhdl       = &pipe_attrsetbyhdl,
     };
+
+/* "ring:" streams (pipes over shared memory) are not implemented */
+struct handle_ops ring_ops;
@@ -232,6 +232,14 @@ void _DkExceptionHandler (unsigned int exit_info, sgx_cpu_context_t * uc)
         }
     }
 
+    /* The first access to a lazy mapping of a trusted file, possibly from
+       the PAL itself; see map_trusted_file_lazily() */
+    if (event_num == PAL_EVENT_MEMFAULT && !ei.info.valid &&
+        handle_lazy_trusted_map_fault()) {
+        restore_sgx_context(uc);
+        return;
+    }
+
     if (ADDR_IN_PAL(uc->rip) &&
         /* event isn't asynchronous */
         (event_num != PAL_EVENT_QUIT &&
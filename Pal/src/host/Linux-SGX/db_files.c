@@ -25,6 +25,7 @@
 
 #include "api.h"
 #include "assert.h"
+#include "file_buffer.h"
 #include "pal.h"
 #include "pal_debug.h"
 #include "pal_defs.h"
@@ -82,7 +83,6 @@ static int file_open(PAL_HANDLE* handle, const char* type, const char* uri, int
 
     hdl->file.stubs  = (PAL_PTR)stubs;
     hdl->file.total  = total;
-    hdl->file.offset = 0;
 
     if (hdl->file.stubs) {
         /* case of trusted file: mmap the whole file in untrusted memory for future reads/writes */
@@ -94,29 +94,118 @@ static int file_open(PAL_HANDLE* handle, const char* type, const char* uri, int
         }
     }
 
+    file_init_buffer(hdl);
     *handle = hdl;
     return 0;
 }
 
+/* positional read and write of allowed files, one enclave exit each; files
+   which cannot seek (e.g., FIFOs) are read and written at their position */
+static int64_t file_pread(void* arg, uint64_t offset, void* buffer, uint64_t count) {
+    PAL_HANDLE handle = arg;
+
+    int64_t ret = ocall_pread(handle->file.fd, buffer, count, offset);
+    if (IS_ERR(ret) && ERRNO(ret) == ESPIPE)
+        ret = ocall_read(handle->file.fd, buffer, count);
+
+    return IS_ERR(ret) ? unix_to_pal_error(ERRNO(ret)) : ret;
+}
+
+static int64_t file_pwrite(void* arg, uint64_t offset, const void* buffer, uint64_t count) {
+    PAL_HANDLE handle = arg;
+
+    int64_t ret = ocall_pwrite(handle->file.fd, buffer, count, offset);
+    if (IS_ERR(ret) && ERRNO(ret) == ESPIPE)
+        ret = ocall_write(handle->file.fd, buffer, count);
+
+    return IS_ERR(ret) ? unix_to_pal_error(ERRNO(ret)) : ret;
+}
+
+static const struct file_buffer_ops file_buffer_ops = {
+    .read  = &file_pread,
+    .write = &file_pwrite,
+};
+
+/* the buffered file handles, for their writes to be written out at exit */
+static LISTP_TYPE(pal_handle) buffered_files = LISTP_INIT;
+static PAL_LOCK buffered_files_lock = LOCK_INIT;
+
+/* Only regular files are buffered: devices, FIFOs and sockets must be read and written when asked.
+   So must the files of /proc and /sys, which are regular but are views of the kernel (e.g.,
+   /proc/self/mem). Reads of trusted files are verified against the stubs, never buffered. */
+static bool file_can_buffer(PAL_HANDLE handle) {
+    if (handle->file.stubs || handle->file.fd == PAL_IDX_POISON)
+        return false;
+
+    if (strstartswith_static(handle->file.realpath, "/proc/") ||
+        strstartswith_static(handle->file.realpath, "/sys/"))
+        return false;
+
+    struct stat stat_buf;
+    int ret = ocall_fstat(handle->file.fd, &stat_buf);
+    return !IS_ERR(ret) && S_ISREG(stat_buf.st_mode);
+}
+
+void file_init_buffer(PAL_HANDLE handle) {
+    handle->file.buffer = file_can_buffer(handle)
+                          ? file_buffer_create(pal_state.file_read_ahead,
+                                               pal_state.file_write_behind)
+                          : NULL;
+    handle->file.buffer_lock = (PAL_LOCK)LOCK_INIT;
+    INIT_LIST_HEAD(handle, file.buffered);
+
+    if (handle->file.buffer) {
+        _DkInternalLock(&buffered_files_lock);
+        LISTP_ADD(handle, &buffered_files, file.buffered);
+        _DkInternalUnlock(&buffered_files_lock);
+    }
+}
+
+static void file_destroy_buffer(PAL_HANDLE handle) {
+    if (!handle->file.buffer)
+        return;
+
+    _DkInternalLock(&buffered_files_lock);
+    LISTP_DEL_INIT(handle, &buffered_files, file.buffered);
+    _DkInternalUnlock(&buffered_files_lock);
+
+    file_buffer_destroy(handle->file.buffer);
+    handle->file.buffer = NULL;
+}
+
+void file_flush_buffers(void) {
+    PAL_HANDLE handle;
+
+    _DkInternalLock(&buffered_files_lock);
+    LISTP_FOR_EACH_ENTRY(handle, &buffered_files, file.buffered)
+        file_flush_buffer(handle);
+    _DkInternalUnlock(&buffered_files_lock);
+}
+
+int file_flush_buffer(PAL_HANDLE handle) {
+    if (!handle->file.buffer)
+        return 0;
+
+    _DkInternalLock(&handle->file.buffer_lock);
+    int ret = file_buffer_flush(handle->file.buffer, &file_buffer_ops, handle);
+    _DkInternalUnlock(&handle->file.buffer_lock);
+    return ret;
+}
+
 /* 'read' operation for file streams. */
 static int64_t file_read(PAL_HANDLE handle, uint64_t offset, uint64_t count, void* buffer) {
     int64_t ret;
     sgx_stub_t* stubs = (sgx_stub_t*)handle->file.stubs;
 
     if (!stubs) {
-        /* case of allowed file: emulate via lseek + read */
-        if (handle->file.offset != offset) {
-            ret = ocall_lseek(handle->file.fd, offset, SEEK_SET);
-            if (IS_ERR(ret))
-                return -PAL_ERROR_DENIED;
-            handle->file.offset = offset;
-        }
-
-        ret = ocall_read(handle->file.fd, buffer, count);
-        if (IS_ERR(ret))
-            return unix_to_pal_error(ERRNO(ret));
-
-        handle->file.offset = offset + ret;
+        /* case of allowed file: through the buffer, if any */
+        if (!handle->file.buffer)
+            return file_pread(handle, offset, buffer, count);
+
+        _DkInternalLock(&handle->file.buffer_lock);
+        ret = file_buffer_read(handle->file.buffer, &file_buffer_ops, handle, offset, buffer,
+                               count);
+        _DkInternalUnlock(&handle->file.buffer_lock);
         return ret;
     }
 
@@ -146,19 +235,14 @@ static int64_t file_write(PAL_HANDLE handle, uint64_t offset, uint64_t count, co
     sgx_stub_t* stubs = (sgx_stub_t*)handle->file.stubs;
 
     if (!stubs) {
-        /* case of allowed file: emulate via lseek + write */
-        if (handle->file.offset != offset) {
-            ret = ocall_lseek(handle->file.fd, offset, SEEK_SET);
-            if (IS_ERR(ret))
-                return -PAL_ERROR_DENIED;
-            handle->file.offset = offset;
-        }
-
-        ret = ocall_write(handle->file.fd, buffer, count);
-        if (IS_ERR(ret))
-            return unix_to_pal_error(ERRNO(ret));
-
-        handle->file.offset = offset + ret;
+        /* case of allowed file: through the buffer, if any */
+        if (!handle->file.buffer)
+            return file_pwrite(handle, offset, buffer, count);
+
+        _DkInternalLock(&handle->file.buffer_lock);
+        ret = file_buffer_write(handle->file.buffer, &file_buffer_ops, handle, offset, buffer,
+                                count);
+        _DkInternalUnlock(&handle->file.buffer_lock);
         return ret;
     }
 
@@ -172,6 +256,10 @@ static int64_t file_write(PAL_HANDLE handle, uint64_t offset, uint64_t count, co
 static int file_close(PAL_HANDLE handle) {
     int fd = handle->file.fd;
 
+    /* an error of the deferred writes is returned by close, as by NFS */
+    int ret = file_flush_buffer(handle);
+    file_destroy_buffer(handle);
+
     if (handle->file.stubs) {
         /* case of trusted file: the whole file was mmapped in untrusted memory */
         ocall_unmap_untrusted(handle->file.umem, handle->file.total);
@@ -183,7 +271,7 @@ static int file_close(PAL_HANDLE handle) {
     if (handle->file.realpath && handle->file.realpath != (void*)handle + HANDLE_SIZE(file))
         free((void*)handle->file.realpath);
 
-    return 0;
+    return ret;
 }
 
 /* 'delete' operation for file streams. It will actually delete
@@ -204,6 +292,9 @@ static int file_map(PAL_HANDLE handle, void** addr, int prot, uint64_t offset, u
     void* umem;
     int ret;
 
+    if ((ret = file_flush_buffer(handle)) < 0)
+        return ret;
+
     /*
      * If the file is listed in the manifest as an "allowed" file,
      * we allow mapping the file outside the enclave, if the library OS
@@ -225,10 +316,25 @@ static int file_map(PAL_HANDLE handle, void** addr, int prot, uint64_t offset, u
         return -PAL_ERROR_DENIED;
     }
 
+    bool fixed = !!mem;
     mem = get_reserved_pages(mem, size);
     if (!mem)
         return -PAL_ERROR_NOMEM;
 
+    if (fixed)
+        release_lazy_trusted_maps(mem, size);
+
+    if (stubs && offset < total && lazy_trusted_mmap(size)) {
+        ret = map_trusted_file_lazily(handle->file.realpath, handle->file.fd, stubs, total, mem,
+                                      offset, size);
+        if (ret < 0) {
+            SGX_DBG(DBG_E, "file_map - lazy mapping returned %d\n", ret);
+            return ret;
+        }
+        *addr = mem;
+        return 0;
+    }
+
     uint64_t end = (offset + size > total) ? total : offset + size;
     uint64_t map_start, map_end;
 
@@ -266,7 +372,11 @@ static int file_map(PAL_HANDLE handle, void** addr, int prot, uint64_t offset, u
 
 /* 'setlength' operation for file stream. */
 static int64_t file_setlength(PAL_HANDLE handle, uint64_t length) {
-    int ret = ocall_ftruncate(handle->file.fd, length);
+    int ret = file_flush_buffer(handle);
+    if (ret < 0)
+        return ret;
+
+    ret = ocall_ftruncate(handle->file.fd, length);
     if (IS_ERR(ret))
         return unix_to_pal_error(ERRNO(ret));
 
@@ -276,8 +386,9 @@ static int64_t file_setlength(PAL_HANDLE handle, uint64_t length) {
 
 /* 'flush' operation for file stream. */
 static int file_flush(PAL_HANDLE handle) {
+    int ret = file_flush_buffer(handle);
     ocall_fsync(handle->file.fd);
-    return 0;
+    return ret;
 }
 
 static inline int file_stat_type(struct stat* stat) {
@@ -333,7 +444,12 @@ static int file_attrquerybyhdl(PAL_HANDLE handle, PAL_STREAM_ATTR* attr) {
     int fd = handle->file.fd;
     struct stat stat_buf;
 
-    int ret = ocall_fstat(fd, &stat_buf);
+    /* the size must include the buffered writes (this is also used for directories) */
+    int ret = IS_HANDLE_TYPE(handle, file) ? file_flush_buffer(handle) : 0;
+    if (ret < 0)
+        return ret;
+
+    ret = ocall_fstat(fd, &stat_buf);
     if (IS_ERR(ret))
         return unix_to_pal_error(ERRNO(ret));
 
@@ -116,8 +116,8 @@ static PAL_HANDLE setup_dummy_file_handle (const char * name)
     handle->file.realpath = path;
 
     handle->file.total  = 0;
-    handle->file.offset = 0;
     handle->file.stubs  = NULL;
+    file_init_buffer(handle);
 
     return handle;
 }
@@ -345,6 +345,13 @@ void pal_linux_main(char * uptr_args, uint64_t args_size,
             SGX_DBG(DBG_E, "Failed to initialize child process: %d\n", rv);
             ocall_exit(rv, /*is_exitgroup=*/true);
         }
+    } else {
+        /* the first process creates the key of all the pipes; children
+           receive it in init_child_process() */
+        if ((rv = _DkRandomBitsRead(&pipe_master_key, sizeof(pipe_master_key))) < 0) {
+            SGX_DBG(DBG_E, "Failed to create the pipe key: %d\n", rv);
+            ocall_exit(rv, /*is_exitgroup=*/true);
+        }
     }
 
     linux_state.uid = pal_sec.uid;
@@ -413,6 +420,11 @@ void pal_linux_main(char * uptr_args, uint64_t args_size,
         ocall_exit(rv, true);
     }
 
+    if ((rv = init_lazy_trusted_mmap()) < 0) {
+        SGX_DBG(DBG_E, "Failed to set up lazy mappings of trusted files: %d\n", rv);
+        ocall_exit(rv, true);
+    }
+
 #if PRINT_ENCLAVE_STAT == 1
     printf("                >>>>>>>> "
            "Enclave loading time =      %10ld milliseconds\n",
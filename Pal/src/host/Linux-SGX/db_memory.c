@@ -86,6 +86,9 @@ int _DkVirtualMemoryAlloc (void ** paddr, uint64_t size, int alloc_type, int pro
         return -PAL_ERROR_INVAL; // `addr` was unaligned.
     }
 
+    if (addr)
+        release_lazy_trusted_maps(mem, size);
+
     memset(mem, 0, size);
 
     if (alloc_type & PAL_ALLOC_INTERNAL) {
@@ -106,6 +109,7 @@ int _DkVirtualMemoryFree (void * addr, uint64_t size)
 {
 
     if (sgx_is_completely_within_enclave(addr, size)) {
+        release_lazy_trusted_maps(addr, size);
         free_pages(addr, size);
     } else {
         /* Possible to have untrusted mapping. Simply unmap
@@ -138,3 +142,7 @@ unsigned long _DkMemoryAvailableQuota (void)
     return (pal_sec.heap_max - pal_sec.heap_min) -
         atomic_read(&alloced_pages) * pagesz;
 }
+
+/* Enclaves cannot share memory with each other, so "shm:" streams are not
+ * supported and opening one fails with PAL_ERROR_NOTSUPPORT. */
+struct handle_ops shm_ops;
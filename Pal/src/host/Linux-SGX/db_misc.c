@@ -33,12 +33,26 @@
 #include "pal_linux_defs.h"
 #include "pal_security.h"
 
-unsigned long _DkSystemTimeQuery(void) {
-    unsigned long microsec;
-    int ret = ocall_gettime(&microsec);
+unsigned long _DkSystemTimeQueryNs(void) {
+    unsigned long nanosec;
+    int ret = ocall_gettime(&nanosec);
     if (ret)
+        return 0;
+    return nanosec;
+}
+
+unsigned long _DkSystemTimeQuery(void) {
+    unsigned long nanosec = _DkSystemTimeQueryNs();
+    if (!nanosec)
         return -PAL_ERROR_DENIED;
-    return microsec;
+    return nanosec / 1000;
+}
+
+int _DkSystemTimeCalibrate(PAL_TSC_CALIBRATION* calib) {
+    /* RDTSC is illegal inside an SGX1 enclave, and the host could not be
+     * trusted with the mapping anyway */
+    __UNUSED(calib);
+    return -PAL_ERROR_NOTSUPPORT;
 }
 
 size_t _DkRandomBitsRead(void* buffer, size_t size) {
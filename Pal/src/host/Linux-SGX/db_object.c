@@ -43,6 +43,11 @@ static int _DkObjectWaitOne(PAL_HANDLE handle, int64_t timeout_us) {
     /* only for all these handle which has a file descriptor, or
        a eventfd. events and semaphores will skip this part */
     if (HANDLE_HDR(handle)->flags & HAS_FDS) {
+        /* an encrypted stream may hold plaintext the host can't see */
+        struct secure_stream* secure = _DkStreamSecureHandle(handle);
+        if (secure && _DkStreamSecurePending(secure))
+            return 0;
+
         struct pollfd fds[MAX_FDS];
         int off[MAX_FDS];
         int nfds = 0;
@@ -133,15 +138,17 @@ int _DkObjectsWaitAny(int count, PAL_HANDLE* handleArray, int64_t timeout_us,
         if (!(HANDLE_HDR(hdl)->flags & HAS_FDS))
             return -PAL_ERROR_NOTSUPPORT;
 
-        /* eliminate repeated entries */
-        for (j = 0 ; j < i ; j++)
-            if (hdl == handleArray[j])
-                break;
-        if (j == i) {
-            for (j = 0 ; j < MAX_FDS ; j++)
-                if (HANDLE_HDR(hdl)->flags & (RFD(j)|WFD(j)))
-                    maxfds++;
+        struct secure_stream* secure = _DkStreamSecureHandle(hdl);
+        if (secure && _DkStreamSecurePending(secure)) {
+            *polled = hdl;
+            return 0;
         }
+
+        /* a repeated entry is polled twice, which is cheaper than
+           searching the array for it */
+        for (j = 0 ; j < MAX_FDS ; j++)
+            if (HANDLE_HDR(hdl)->flags & (RFD(j)|WFD(j)))
+                maxfds++;
     }
 
     struct pollfd * fds = __alloca(sizeof(struct pollfd) * maxfds);
@@ -153,12 +160,6 @@ int _DkObjectsWaitAny(int count, PAL_HANDLE* handleArray, int64_t timeout_us,
         if (!hdl)
             continue;
 
-        for (j = 0 ; j < i ; j++)
-            if (hdl == handleArray[j])
-                break;
-        if (j < i)
-            continue;
-
         for (j = 0 ; j < MAX_FDS ; j++) {
             int events = 0;
 
@@ -223,3 +224,115 @@ int _DkObjectsWaitAny(int count, PAL_HANDLE* handleArray, int64_t timeout_us,
     *polled = polled_hdl;
     return polled_hdl ? 0 : -PAL_ERROR_TRYAGAIN;
 }
+
+/* _DkStreamsWaitEvents for internal use. All the streams are polled with a
+   single poll OCALL, and the events of every stream are returned. */
+int _DkStreamsWaitEvents(size_t count, PAL_HANDLE* handle_array, PAL_FLG* events,
+                         PAL_FLG* ret_events, int64_t timeout_us) {
+    size_t maxfds = 0, nfds = 0;
+    bool ready = false;
+    int ret;
+
+    for (size_t i = 0 ; i < count ; i++) {
+        PAL_HANDLE hdl = handle_array[i];
+
+        ret_events[i] = 0;
+        if (!hdl || !events[i])
+            continue;
+
+        for (int j = 0 ; j < MAX_FDS ; j++)
+            if (HANDLE_HDR(hdl)->flags & (RFD(j)|WFD(j)))
+                maxfds++;
+    }
+
+    if (!maxfds)
+        return -PAL_ERROR_TRYAGAIN;
+
+    /* the pollfds, followed by the handle and fd of each, as i * MAX_FDS + j */
+    struct pollfd* fds = malloc((sizeof(struct pollfd) + sizeof(size_t)) * maxfds);
+    if (!fds)
+        return -PAL_ERROR_NOMEM;
+    size_t* offs = (size_t*)&fds[maxfds];
+
+    for (size_t i = 0 ; i < count ; i++) {
+        PAL_HANDLE hdl = handle_array[i];
+
+        /* synchronous objects (without fds) are never ready */
+        if (!hdl || !events[i] || !(HANDLE_HDR(hdl)->flags & HAS_FDS))
+            continue;
+
+        /* an encrypted stream may hold plaintext the host can't see */
+        struct secure_stream* secure = _DkStreamSecureHandle(hdl);
+        if (secure && (events[i] & PAL_WAIT_READ) && _DkStreamSecurePending(secure)) {
+            ret_events[i] |= PAL_WAIT_READ;
+            ready = true;
+        }
+
+        for (int j = 0 ; j < MAX_FDS ; j++) {
+            int fd_events = 0;
+
+            if (!(HANDLE_HDR(hdl)->flags & (RFD(j)|WFD(j))) ||
+                hdl->generic.fds[j] == PAL_IDX_POISON)
+                continue;
+
+            /* the error of an fd stays until the handle is closed, but
+             * data may still be left to read from it */
+            if (HANDLE_HDR(hdl)->flags & ERROR(j)) {
+                ret_events[i] |= PAL_WAIT_ERROR;
+                ready = true;
+            }
+
+            if ((HANDLE_HDR(hdl)->flags & RFD(j)) && (events[i] & PAL_WAIT_READ))
+                fd_events |= POLLIN;
+            if ((HANDLE_HDR(hdl)->flags & WFD(j)) && (events[i] & PAL_WAIT_WRITE) &&
+                !(HANDLE_HDR(hdl)->flags & ERROR(j)))
+                fd_events |= POLLOUT;
+
+            if (fd_events) {
+                fds[nfds].fd = hdl->generic.fds[j];
+                fds[nfds].events = fd_events|POLLHUP|POLLERR;
+                fds[nfds].revents = 0;
+                offs[nfds] = i * MAX_FDS + j;
+                nfds++;
+            }
+        }
+    }
+
+    ret = nfds ? ocall_poll(fds, nfds, ready ? 0 : timeout_us) : 0;
+    if (IS_ERR(ret)) {
+        ret = unix_to_pal_error(ERRNO(ret));
+        goto out;
+    }
+
+    for (size_t k = 0 ; k < nfds ; k++) {
+        if (!fds[k].revents)
+            continue;
+
+        size_t i = offs[k] / MAX_FDS;
+        int j = offs[k] % MAX_FDS;
+        PAL_HANDLE hdl = handle_array[i];
+
+        if (fds[k].revents & POLLIN)
+            ret_events[i] |= PAL_WAIT_READ;
+        if (fds[k].revents & POLLOUT) {
+            HANDLE_HDR(hdl)->flags |= WRITABLE(j);
+            ret_events[i] |= PAL_WAIT_WRITE;
+        }
+        if (fds[k].revents & (POLLERR|POLLNVAL)) {
+            HANDLE_HDR(hdl)->flags |= ERROR(j);
+            ret_events[i] |= PAL_WAIT_ERROR;
+        }
+        /* a hang-up is not kept: the fd is polled again, for the data the
+         * peer left before closing its end */
+        if (fds[k].revents & POLLHUP)
+            ret_events[i] |= PAL_WAIT_ERROR;
+
+        if (ret_events[i])
+            ready = true;
+    }
+
+    ret = ready ? 0 : -PAL_ERROR_TRYAGAIN;
+out:
+    free(fds);
+    return ret;
+}
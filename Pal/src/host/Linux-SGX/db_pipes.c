@@ -76,6 +76,7 @@ static int pipe_listen(PAL_HANDLE* handle, PAL_NUM pipeid, int options) {
     hdl->pipe.fd          = ret;
     hdl->pipe.pipeid      = pipeid;
     hdl->pipe.nonblocking = options & PAL_OPTION_NONBLOCK ? PAL_TRUE : PAL_FALSE;
+    hdl->pipe.secure      = NULL;
     *handle               = hdl;
     return 0;
 }
@@ -92,12 +93,21 @@ static int pipe_waitforclient(PAL_HANDLE handle, PAL_HANDLE* client) {
     if (IS_ERR(ret))
         return unix_to_pal_error(ERRNO(ret));
 
+    int fd = ret;
+    struct secure_stream* secure;
+    ret = _DkStreamSecureServer(fd, &secure);
+    if (ret < 0) {
+        ocall_close(fd);
+        return ret;
+    }
+
     PAL_HANDLE clnt = malloc(HANDLE_SIZE(pipe));
     SET_HANDLE_TYPE(clnt, pipecli);
     HANDLE_HDR(clnt)->flags |= RFD(0) | WFD(0) | WRITABLE(0);
-    clnt->pipe.fd          = ret;
+    clnt->pipe.fd          = fd;
     clnt->pipe.nonblocking = PAL_FALSE;
     clnt->pipe.pipeid      = handle->pipe.pipeid;
+    clnt->pipe.secure      = secure;
     *client                = clnt;
 
     return 0;
@@ -116,12 +126,23 @@ static int pipe_connect(PAL_HANDLE* handle, PAL_NUM pipeid, int options) {
     if (IS_ERR(ret))
         return unix_to_pal_error(ERRNO(ret));
 
+    /* the server answers the handshake in accept; the first read or write
+       on this end waits for the answer */
+    int fd = ret;
+    struct secure_stream* secure;
+    ret = _DkStreamSecureClient(fd, &secure);
+    if (ret < 0) {
+        ocall_close(fd);
+        return ret;
+    }
+
     PAL_HANDLE hdl = malloc(HANDLE_SIZE(pipe));
     SET_HANDLE_TYPE(hdl, pipe);
     HANDLE_HDR(hdl)->flags |= RFD(0) | WFD(0) | WRITABLE(0);
-    hdl->pipe.fd          = ret;
+    hdl->pipe.fd          = fd;
     hdl->pipe.pipeid      = pipeid;
     hdl->pipe.nonblocking = (options & PAL_OPTION_NONBLOCK) ? PAL_TRUE : PAL_FALSE;
+    hdl->pipe.secure      = secure;
     *handle               = hdl;
 
     return 0;
@@ -137,12 +158,24 @@ static int pipe_private(PAL_HANDLE* handle, int options) {
     if (IS_ERR(ret))
         return unix_to_pal_error(ERRNO(ret));
 
+    /* both ends are here, so any fresh key will do */
+    PAL_SESSION_KEY key;
+    struct secure_stream* secure;
+    if ((ret = _DkRandomBitsRead(&key, sizeof(key))) < 0 ||
+        (ret = _DkStreamSecureInit(&key, SECURE_STREAM_LOOPBACK, &secure)) < 0) {
+        ocall_close(fds[0]);
+        ocall_close(fds[1]);
+        return ret;
+    }
+    memset(key, 0, sizeof(key));
+
     PAL_HANDLE hdl = malloc(HANDLE_SIZE(pipeprv));
     SET_HANDLE_TYPE(hdl, pipeprv);
     HANDLE_HDR(hdl)->flags |= RFD(0) | WFD(1) | WRITABLE(1);
     hdl->pipeprv.fds[0]      = fds[0];
     hdl->pipeprv.fds[1]      = fds[1];
     hdl->pipeprv.nonblocking = (options & PAL_OPTION_NONBLOCK) ? PAL_TRUE : PAL_FALSE;
+    hdl->pipeprv.secure      = secure;
     *handle                  = hdl;
     return 0;
 }
@@ -187,11 +220,19 @@ static int64_t pipe_read(PAL_HANDLE handle, uint64_t offset, uint64_t len, void*
     if (len >= (1ULL << (sizeof(unsigned int) * 8)))
         return -PAL_ERROR_INVAL;
 
-    int fd    = IS_HANDLE_TYPE(handle, pipeprv) ? handle->pipeprv.fds[0] : handle->pipe.fd;
-    int bytes = ocall_sock_recv(fd, buffer, len, NULL, NULL);
+    int fd = IS_HANDLE_TYPE(handle, pipeprv) ? handle->pipeprv.fds[0] : handle->pipe.fd;
+    struct secure_stream* secure = _DkStreamSecureHandle(handle);
+    int64_t bytes;
 
-    if (IS_ERR(bytes))
-        return unix_to_pal_error(ERRNO(bytes));
+    if (secure) {
+        bytes = _DkStreamSecureRead(secure, fd, buffer, len);
+        if (bytes < 0)
+            return bytes;
+    } else {
+        bytes = ocall_sock_recv(fd, buffer, len, NULL, NULL);
+        if (IS_ERR(bytes))
+            return unix_to_pal_error(ERRNO(bytes));
+    }
 
     if (!bytes)
         return -PAL_ERROR_ENDOFSTREAM;
@@ -211,13 +252,21 @@ static int64_t pipe_write(PAL_HANDLE handle, uint64_t offset, uint64_t len, cons
     if (len >= (1ULL << (sizeof(unsigned int) * 8)))
         return -PAL_ERROR_INVAL;
 
-    int fd    = IS_HANDLE_TYPE(handle, pipeprv) ? handle->pipeprv.fds[1] : handle->pipe.fd;
-    int bytes = ocall_sock_send(fd, buffer, len, NULL, 0);
+    int fd = IS_HANDLE_TYPE(handle, pipeprv) ? handle->pipeprv.fds[1] : handle->pipe.fd;
+    struct secure_stream* secure = _DkStreamSecureHandle(handle);
+    int64_t bytes;
+
+    if (secure) {
+        bytes = _DkStreamSecureWrite(secure, fd, buffer, len);
+    } else {
+        bytes = ocall_sock_send(fd, buffer, len, NULL, 0);
+        if (IS_ERR(bytes))
+            bytes = unix_to_pal_error(ERRNO(bytes));
+    }
 
     PAL_FLG writable = IS_HANDLE_TYPE(handle, pipeprv) ? WRITABLE(1) : WRITABLE(0);
 
-    if (IS_ERR(bytes)) {
-        bytes = unix_to_pal_error(ERRNO(bytes));
+    if (bytes < 0) {
         if (bytes == -PAL_ERROR_TRYAGAIN)
             HANDLE_HDR(handle)->flags &= ~writable;
         return bytes;
@@ -233,6 +282,15 @@ static int64_t pipe_write(PAL_HANDLE handle, uint64_t offset, uint64_t len, cons
 
 /* 'close' operation of pipe stream. */
 static int pipe_close(PAL_HANDLE handle) {
+    struct secure_stream* secure = _DkStreamSecureHandle(handle);
+    if (secure) {
+        _DkStreamSecureFree(secure);
+        if (IS_HANDLE_TYPE(handle, pipeprv))
+            handle->pipeprv.secure = NULL;
+        else
+            handle->pipe.secure = NULL;
+    }
+
     if (IS_HANDLE_TYPE(handle, pipeprv)) {
         if (handle->pipeprv.fds[0] != PAL_IDX_POISON) {
             ocall_close(handle->pipeprv.fds[0]);
@@ -341,6 +399,10 @@ static int pipe_attrquerybyhdl(PAL_HANDLE handle, PAL_STREAM_ATTR* attr) {
 
     attr->readable = (ret == 1 && pfd.revents == POLLIN);
 
+    struct secure_stream* secure = _DkStreamSecureHandle(handle);
+    if (secure && _DkStreamSecurePending(secure))
+        attr->readable = PAL_TRUE;
+
     attr->disconnected = flags & ERROR(0);
     attr->nonblocking =
         IS_HANDLE_TYPE(handle, pipeprv) ? handle->pipeprv.nonblocking : handle->pipe.nonblocking;
@@ -430,3 +492,7 @@ struct handle_ops pipeprv_ops = {
     .attrquerybyhdl = &pipe_attrquerybyhdl,
     .attrsetbyhdl   = &pipe_attrsetbyhdl,
 };
+
+/* Enclaves cannot share memory with each other, so "ring:" streams are not
+ * supported and opening one fails with PAL_ERROR_NOTSUPPORT. */
+struct handle_ops ring_ops;
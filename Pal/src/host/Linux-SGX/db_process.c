@@ -143,7 +143,7 @@ int register_trusted_child(const char * uri, const char * mr_enclave_str)
  *
  *       See the implementation in _DkStreamKeyExchange().
  *       When initializing an RPC stream, both ends of the stream needs to use
- *       Diffie-Hellman to exchange a session key. The key will be used to both identify
+ *       (X25519 elliptic-curve) Diffie-Hellman to exchange a session key. The key will be used to both identify
  *       the connection (to prevent man-in-the-middle attack) and for future encryption.
  *
  * (2) Both the parent and child enclaves need to be proven by the Intel CPU.
@@ -181,6 +181,11 @@ int register_trusted_child(const char * uri, const char * mr_enclave_str)
  *       the unique enclave ID (a 64-bit integer) using AES-CMAC with the session key.
  *       Because both the enclave ID and the session key are randomly created for each
  *       enclave, no report can be reused even from an enclave with the same mr_enclave.
+ *
+ * Once both sides are proven, everything else on the stream goes through the AES-GCM
+ * record layer keyed by the session key (see enclave_stream.c). The first record carries
+ * pipe_master_key from the parent to the child, so the child can open pipes to the other
+ * processes of the application.
  */
 
 struct proc_data {
@@ -271,6 +276,7 @@ int _DkProcessCreate (PAL_HANDLE * handle, const char * uri, const char ** args)
     child->process.cargo      = proc_fds[2];
     child->process.pid = child_pid;
     child->process.nonblocking = PAL_FALSE;
+    child->process.secure = NULL;
 
     ret = _DkStreamKeyExchange(child, &child->process.session_key);
     if (ret < 0)
@@ -286,10 +292,32 @@ int _DkProcessCreate (PAL_HANDLE * handle, const char * uri, const char ** args)
     if (ret < 0)
         goto failed;
 
+    struct secure_stream* secure;
+    ret = _DkStreamSecureInit(&child->process.session_key, SECURE_STREAM_CLIENT, &secure);
+    if (ret < 0)
+        goto failed;
+    child->process.secure = secure;
+
+    /* the child opens pipes to the other processes with the same key */
+    for (uint64_t bytes = 0; bytes < sizeof(pipe_master_key); bytes += ret) {
+        ret = _DkStreamSecureWrite(secure, child->process.stream_out,
+                                   (void*)&pipe_master_key + bytes,
+                                   sizeof(pipe_master_key) - bytes);
+        if (ret < 0) {
+            if (ret == -PAL_ERROR_INTERRUPTED || ret == -PAL_ERROR_TRYAGAIN) {
+                ret = 0;
+                continue;
+            }
+            goto failed;
+        }
+    }
+
     *handle = child;
     return 0;
 
 failed:
+    if (child->process.secure)
+        _DkStreamSecureFree(child->process.secure);
     free(child);
     return ret;
 }
@@ -321,6 +349,7 @@ int init_child_process (PAL_HANDLE * parent_handle)
     parent->process.cargo      = pal_sec.proc_fds[2];
     parent->process.pid        = pal_sec.ppid;
     parent->process.nonblocking = PAL_FALSE;
+    parent->process.secure     = NULL;
 
     int ret = _DkStreamKeyExchange(parent, &parent->process.session_key);
     if (ret < 0)
@@ -336,6 +365,27 @@ int init_child_process (PAL_HANDLE * parent_handle)
     if (ret < 0)
         return ret;
 
+    struct secure_stream* secure;
+    ret = _DkStreamSecureInit(&parent->process.session_key, SECURE_STREAM_SERVER, &secure);
+    if (ret < 0)
+        return ret;
+    parent->process.secure = secure;
+
+    for (uint64_t bytes = 0; bytes < sizeof(pipe_master_key); bytes += ret) {
+        ret = _DkStreamSecureRead(secure, parent->process.stream_in,
+                                  (void*)&pipe_master_key + bytes,
+                                  sizeof(pipe_master_key) - bytes);
+        if (ret < 0) {
+            if (ret == -PAL_ERROR_INTERRUPTED || ret == -PAL_ERROR_TRYAGAIN) {
+                ret = 0;
+                continue;
+            }
+            return ret;
+        }
+        if (!ret)
+            return -PAL_ERROR_DENIED;
+    }
+
     *parent_handle = parent;
     return 0;
 }
@@ -349,6 +399,7 @@ noreturn void _DkProcessExit (int exitcode)
 #endif
     if (exitcode)
         SGX_DBG(DBG_I, "DkProcessExit: Returning exit code %d\n", exitcode);
+    file_flush_buffers();
     ocall_exit(exitcode, /*is_exitgroup=*/true);
     while (true) {
         /* nothing */;
@@ -364,6 +415,10 @@ static int64_t proc_read (PAL_HANDLE handle, uint64_t offset, uint64_t count,
     if (count >= (1ULL << (sizeof(unsigned int) * 8)))
         return -PAL_ERROR_INVAL;
 
+    if (handle->process.secure)
+        return _DkStreamSecureRead(handle->process.secure, handle->process.stream_in, buffer,
+                                   count);
+
     int bytes = ocall_read(handle->process.stream_in, buffer, count);
     return IS_ERR(bytes) ? unix_to_pal_error(ERRNO(bytes)) : bytes;
 }
@@ -377,10 +432,17 @@ static int64_t proc_write (PAL_HANDLE handle, uint64_t offset, uint64_t count,
     if (count >= (1ULL << (sizeof(unsigned int) * 8)))
         return -PAL_ERROR_INVAL;
 
-    int bytes = ocall_write(handle->process.stream_out, buffer, count);
+    int64_t bytes;
+    if (handle->process.secure) {
+        bytes = _DkStreamSecureWrite(handle->process.secure, handle->process.stream_out, buffer,
+                                     count);
+    } else {
+        bytes = ocall_write(handle->process.stream_out, buffer, count);
+        if (IS_ERR(bytes))
+            bytes = unix_to_pal_error(ERRNO(bytes));
+    }
 
-    if (IS_ERR(bytes)) {
-        bytes = unix_to_pal_error(ERRNO(bytes));
+    if (bytes < 0) {
         if (bytes == -PAL_ERROR_TRYAGAIN)
             HANDLE_HDR(handle)->flags &= ~WRITABLE(1);
         return bytes;
@@ -411,6 +473,11 @@ static int proc_close (PAL_HANDLE handle)
         handle->process.cargo = PAL_IDX_POISON;
     }
 
+    if (handle->process.secure) {
+        _DkStreamSecureFree(handle->process.secure);
+        handle->process.secure = NULL;
+    }
+
     return 0;
 }
 
@@ -462,6 +529,8 @@ static int proc_attrquerybyhdl (PAL_HANDLE handle, PAL_STREAM_ATTR * attr)
     attr->pending_size = ret;
     attr->disconnected = HANDLE_HDR(handle)->flags & (ERROR(0)|ERROR(1));
     attr->readable = (attr->pending_size > 0);
+    if (handle->process.secure && _DkStreamSecurePending(handle->process.secure))
+        attr->readable = PAL_TRUE;
     attr->writable = HANDLE_HDR(handle)->flags & WRITABLE(1);
     attr->nonblocking = handle->process.nonblocking;
     return 0;
@@ -94,6 +94,8 @@ int handle_serialize(PAL_HANDLE handle, void** data) {
     const void* d1;
     const void* d2;
     int dsz1 = 0, dsz2 = 0;
+    struct secure_stream* secure;
+    int ret;
 
     // ~ Check cargo PAL_HANDLE - is allowed to be sent (White List checking
     // of cargo type)
@@ -101,6 +103,9 @@ int handle_serialize(PAL_HANDLE handle, void** data) {
     // Channel between parent and child
     switch (PAL_GET_TYPE(handle)) {
         case pal_type_file:
+            /* the receiver must see the buffered writes */
+            if ((ret = file_flush_buffer(handle)) < 0)
+                return ret;
             d1   = handle->file.realpath;
             dsz1 = strlen(handle->file.realpath) + 1;
             break;
@@ -108,6 +113,17 @@ int handle_serialize(PAL_HANDLE handle, void** data) {
         case pal_type_pipesrv:
         case pal_type_pipecli:
         case pal_type_pipeprv:
+        case pal_type_process:
+            /* the keys of an encrypted stream go along with the handle */
+            secure = _DkStreamSecureHandle(handle);
+            if (secure) {
+                dsz1 = _DkStreamSecureStateSize();
+                void* state = __alloca(dsz1);
+                ret = _DkStreamSecureSerialize(secure, handle->generic.fds[0], state);
+                if (ret < 0)
+                    return ret;
+                d1 = state;
+            }
             break;
         case pal_type_dev:
             if (handle->dev.realpath) {
@@ -135,7 +151,6 @@ int handle_serialize(PAL_HANDLE handle, void** data) {
             }
             break;
         case pal_type_gipc:
-        case pal_type_process:
             break;
         default:
             return -PAL_ERROR_INVAL;
@@ -177,14 +192,35 @@ int handle_deserialize(PAL_HANDLE* handle, const void* data, int size) {
             memcpy((void*)hdl + hdlsz, data, l);
             hdl->file.realpath = (PAL_STR)hdl + hdlsz;
             hdl->file.stubs    = (PAL_PTR)NULL;
+            file_init_buffer(hdl);
             break;
         }
         case pal_type_pipe:
         case pal_type_pipesrv:
         case pal_type_pipecli:
         case pal_type_pipeprv:
+        case pal_type_process: {
+            PAL_PTR* secure;
+            if (PAL_GET_TYPE(hdl_data) == pal_type_pipeprv)
+                secure = &hdl_data->pipeprv.secure;
+            else if (PAL_GET_TYPE(hdl_data) == pal_type_process)
+                secure = &hdl_data->process.secure;
+            else
+                secure = &hdl_data->pipe.secure;
+
+            if (*secure) {
+                if ((unsigned int)size < _DkStreamSecureStateSize())
+                    return -PAL_ERROR_DENIED;
+                int err = _DkStreamSecureDeserialize(data, (struct secure_stream**)secure);
+                if (err < 0)
+                    return err;
+            }
+
             hdl = malloc_copy(hdl_data, hdlsz);
+            if (!hdl && *secure)
+                _DkStreamSecureFree(*secure);
             break;
+        }
         case pal_type_dev: {
             int l = hdl_data->dev.realpath ? strlen((const char*)data) + 1 : 0;
             hdl   = malloc(hdlsz + l);
@@ -233,7 +269,6 @@ int handle_deserialize(PAL_HANDLE* handle, const void* data, int size) {
             break;
         }
         case pal_type_gipc:
-        case pal_type_process:
             hdl = malloc_copy(hdl_data, hdlsz);
             break;
         default:
@@ -262,6 +297,26 @@ int _DkSendHandle(PAL_HANDLE hdl, PAL_HANDLE cargo) {
     if (ret < 0)
         return ret;
 
+    /* the cargo socket is not encrypted, and the handle may carry keys */
+    if (hdl->process.secure) {
+        void* sealed = malloc(_DkStreamSecureSealSize(ret));
+        if (!sealed) {
+            free(hdl_data);
+            return -PAL_ERROR_NOMEM;
+        }
+
+        int size = ret;
+        ret = _DkStreamSecureSeal(hdl->process.secure, hdl_data, size, sealed);
+        free(hdl_data);
+        if (ret < 0) {
+            free(sealed);
+            return ret;
+        }
+
+        hdl_data = sealed;
+        ret = _DkStreamSecureSealSize(size);
+    }
+
     hdl_hdr.fds       = 0;
     hdl_hdr.data_size = ret;
     unsigned int fds[MAX_FDS];
@@ -345,8 +400,15 @@ int _DkReceiveHandle(PAL_HANDLE hdl, PAL_HANDLE* cargo) {
     if (IS_ERR(ret))
         return unix_to_pal_error(ERRNO(ret));
 
+    int size = hdl_hdr.data_size;
+    if (hdl->process.secure) {
+        size = _DkStreamSecureUnseal(hdl->process.secure, buffer, size, &buffer);
+        if (size < 0)
+            return size;
+    }
+
     PAL_HANDLE handle = NULL;
-    ret               = handle_deserialize(&handle, buffer, hdl_hdr.data_size);
+    ret               = handle_deserialize(&handle, buffer, size);
     if (ret < 0)
         return ret;
 
@@ -8,8 +8,11 @@
 #include <api.h>
 #include <list.h>
 #include <stdbool.h>
+#include <asm/stat.h>
 
 #include "enclave_pages.h"
+#include "trusted_file_map.h"
+#include "trusted_file_table.h"
 
 static const size_t URI_FILE_PREFIX_LEN = static_strlen("file:");
 
@@ -214,10 +217,10 @@ struct trusted_file {
     LIST_TYPE(trusted_file) list;
     int64_t index;
     uint64_t size;
-    size_t uri_len;
-    char uri[URI_MAX];
     sgx_checksum_t checksum;
     sgx_stub_t * stubs;
+    size_t uri_len;
+    char uri[];
 };
 
 DEFINE_LISTP(trusted_file);
@@ -225,6 +228,9 @@ static LISTP_TYPE(trusted_file) trusted_file_list = LISTP_INIT;
 static struct spinlock trusted_file_lock = LOCK_INIT;
 static int trusted_file_indexes = 0;
 static bool allow_file_creation = 0;
+/* sorted table of sgx.trusted_files, if the manifest has one; its files are
+   added to trusted_file_list when they are first opened */
+static void* trusted_file_table = NULL;
 static int file_check_policy = FILE_CHECK_POLICY_STRICT;
 
 /* Assumes `path` is normalized */
@@ -250,6 +256,51 @@ static bool path_is_equal_or_subpath(const struct trusted_file* tf,
     return false;
 }
 
+/*
+ * 'register_table_file' adds the file to the trusted file list from
+ * trusted_file_table, when the file is opened for the first time. 'tfptr'
+ * is left untouched if the table does not list the file.
+ */
+static int register_table_file (const char * uri, size_t uri_len,
+                                 struct trusted_file ** tfptr)
+{
+    const struct trusted_file_table_entry * e =
+        trusted_file_table_lookup(trusted_file_table, uri, uri_len);
+    if (!e)
+        return 0;
+
+    struct trusted_file * tf, * new = malloc(sizeof(struct trusted_file) + uri_len + 1);
+    if (!new)
+        return -PAL_ERROR_NOMEM;
+
+    INIT_LIST_HEAD(new, list);
+    new->uri_len = uri_len;
+    memcpy(new->uri, uri, uri_len + 1);
+    new->size = e->size;
+    memcpy(&new->checksum, e->checksum, sizeof(sgx_checksum_t));
+    new->stubs = NULL;
+
+    _DkSpinLock(&trusted_file_lock);
+
+    /* another thread may have opened the file in the meantime */
+    LISTP_FOR_EACH_ENTRY(tf, &trusted_file_list, list) {
+        if (tf->index && tf->uri_len == uri_len && !memcmp(tf->uri, uri, uri_len)) {
+            _DkSpinUnlock(&trusted_file_lock);
+            free(new);
+            *tfptr = tf;
+            return 0;
+        }
+    }
+
+    new->index = (++trusted_file_indexes);
+    LISTP_ADD_TAIL(new, &trusted_file_list, list);
+    _DkSpinUnlock(&trusted_file_lock);
+
+    SGX_DBG(DBG_S, "trusted: [%ld] %s (from table)\n", new->index, new->uri);
+    *tfptr = new;
+    return 0;
+}
+
 /*
  * 'load_trusted_file' checks if the file to be opened is trusted
  * or allowed for unauthenticated access, according to the manifest.
@@ -328,6 +379,12 @@ int load_trusted_file (PAL_HANDLE file, sgx_stub_t ** stubptr,
 
     _DkSpinUnlock(&trusted_file_lock);
 
+    if ((!tf || !tf->index) && trusted_file_table) {
+        ret = register_table_file(normpath, len, &tf);
+        if (ret < 0)
+            return ret;
+    }
+
     if (!tf || !tf->index) {
         if (!tf) {
             if (get_file_check_policy() != FILE_CHECK_POLICY_ALLOW_ALL_BUT_LOG)
@@ -626,6 +683,261 @@ failed:
     return -PAL_ERROR_DENIED;
 }
 
+/*
+ * Lazy mappings of trusted files (see trusted_file_map.h). The host denies
+ * access to the reserved pages, so the first access to each chunk faults, and
+ * the exception handler copies the chunk in from an untrusted mapping of the
+ * file and verifies it against its stub, as file_map() does for the whole
+ * range otherwise. SGX1 does not report fault addresses to the enclave, so the
+ * handler asks the host; a wrong address can only make the enclave fill the
+ * wrong chunk, or fault again.
+ */
+DEFINE_LIST(lazy_trusted_map);
+struct lazy_trusted_map {
+    LIST_TYPE(lazy_trusted_map) list;
+    const char *        path;
+    sgx_stub_t *        stubs;
+    const void *        umem;       /* untrusted mapping of the chunks */
+    uint64_t            umem_start, umem_end;
+    struct trusted_file_map map;    /* must be last */
+};
+DEFINE_LISTP(lazy_trusted_map);
+static LISTP_TYPE(lazy_trusted_map) lazy_trusted_map_list = LISTP_INIT;
+static struct spinlock lazy_trusted_map_lock = LOCK_INIT;
+
+/* mappings of at least this size are lazy; 0 if disabled */
+static uint64_t lazy_trusted_mmap_size;
+
+/* the host maps all enclave pages with these */
+#define ENCLAVE_HOST_PROT   (PROT_READ|PROT_WRITE|PROT_EXEC)
+
+/* fills are serialized by lazy_trusted_map_lock */
+static uint8_t lazy_trusted_map_staging[TRUSTED_STUB_SIZE];
+
+/* Verifies the chunk in the enclave before the host makes its pages
+ * accessible, so that other threads never read unverified content */
+static int lazy_trusted_map_fill (void * arg, uint64_t idx, uintptr_t addr,
+                                  uint64_t size, uint64_t file_offset)
+{
+    struct lazy_trusted_map * lazy = arg;
+    uint64_t total = lazy->map.file_size;
+    __UNUSED(idx);
+
+    uint64_t chunk_start = ALIGN_DOWN(file_offset, TRUSTED_STUB_SIZE);
+    uint64_t chunk_end   = MIN(chunk_start + TRUSTED_STUB_SIZE, total);
+    uint64_t copy_size   = MIN(chunk_end - file_offset, size);
+
+    int ret = copy_and_verify_trusted_file(lazy->path,
+                                           lazy->umem + (chunk_start - lazy->umem_start),
+                                           chunk_start, chunk_end,
+                                           lazy_trusted_map_staging,
+                                           file_offset, copy_size, lazy->stubs, total);
+    if (ret < 0)
+        return ret;
+
+    ret = ocall_mprotect((void *) addr, size, ENCLAVE_HOST_PROT);
+    if (IS_ERR(ret))
+        return unix_to_pal_error(ERRNO(ret));
+
+    memcpy((void *) addr, lazy_trusted_map_staging, copy_size);
+    memset((void *) addr + copy_size, 0, size - copy_size);
+    return 0;
+}
+
+static void lazy_trusted_map_drop (void * arg, uint64_t idx, uintptr_t addr,
+                                   uint64_t size)
+{
+    __UNUSED(arg);
+    __UNUSED(idx);
+    ocall_mprotect((void *) addr, size, ENCLAVE_HOST_PROT);
+}
+
+bool lazy_trusted_mmap (uint64_t size)
+{
+    return lazy_trusted_mmap_size && size >= lazy_trusted_mmap_size;
+}
+
+int map_trusted_file_lazily (const char * path, int fd, sgx_stub_t * stubs,
+                             uint64_t total, void * mem, uint64_t offset,
+                             uint64_t size)
+{
+    uintptr_t start = (uintptr_t) mem;
+    uintptr_t end = start + ALLOC_ALIGNUP(size);
+    uint64_t umem_start = ALIGN_DOWN(offset, TRUSTED_STUB_SIZE);
+    uint64_t umem_end = ALIGN_UP(MIN(offset + size, total), TRUSTED_STUB_SIZE);
+    size_t map_size = trusted_file_map_size(start, end, offset, total,
+                                            TRUSTED_STUB_SIZE);
+    size_t path_len = strlen(path);
+    void * umem;
+    int ret;
+
+    struct lazy_trusted_map * lazy =
+        malloc(offsetof(struct lazy_trusted_map, map) + map_size + path_len + 1);
+    if (!lazy)
+        return -PAL_ERROR_NOMEM;
+
+    ret = ocall_map_untrusted(fd, umem_start, umem_end - umem_start, PROT_READ,
+                              &umem);
+    if (IS_ERR(ret)) {
+        free(lazy);
+        return unix_to_pal_error(ERRNO(ret));
+    }
+
+    ret = ocall_mprotect(mem, end - start, PROT_NONE);
+    if (IS_ERR(ret)) {
+        ocall_unmap_untrusted(umem, umem_end - umem_start);
+        free(lazy);
+        return unix_to_pal_error(ERRNO(ret));
+    }
+
+    char * path_copy = (char *) &lazy->map + map_size;
+    memcpy(path_copy, path, path_len + 1);
+
+    INIT_LIST_HEAD(lazy, list);
+    lazy->path       = path_copy;
+    lazy->stubs      = stubs;
+    lazy->umem       = umem;
+    lazy->umem_start = umem_start;
+    lazy->umem_end   = umem_end;
+    trusted_file_map_init(&lazy->map, start, end, offset, total,
+                          TRUSTED_STUB_SIZE);
+
+    _DkSpinLock(&lazy_trusted_map_lock);
+    LISTP_ADD(lazy, &lazy_trusted_map_list, list);
+    _DkSpinUnlock(&lazy_trusted_map_lock);
+    return 0;
+}
+
+bool handle_lazy_trusted_map_fault (void)
+{
+    if (LISTP_EMPTY(&lazy_trusted_map_list))
+        return false;
+
+    void * addr;
+    if (IS_ERR(ocall_get_fault_addr(&addr)))
+        return false;
+
+    struct lazy_trusted_map * lazy;
+    bool handled = false;
+
+    _DkSpinLock(&lazy_trusted_map_lock);
+    LISTP_FOR_EACH_ENTRY(lazy, &lazy_trusted_map_list, list)
+        if (trusted_file_map_contains(&lazy->map, (uintptr_t) addr)) {
+            /* a filled chunk was filled by another thread meanwhile */
+            handled = trusted_file_map_fault(&lazy->map, (uintptr_t) addr,
+                                             lazy_trusted_map_fill, lazy) >= 0;
+            break;
+        }
+    _DkSpinUnlock(&lazy_trusted_map_lock);
+
+    return handled;
+}
+
+void release_lazy_trusted_maps (void * addr, uint64_t size)
+{
+    if (LISTP_EMPTY(&lazy_trusted_map_list))
+        return;
+
+    uintptr_t start = (uintptr_t) addr, end = start + size;
+    struct lazy_trusted_map * lazy, * tmp;
+
+    _DkSpinLock(&lazy_trusted_map_lock);
+    LISTP_FOR_EACH_ENTRY_SAFE(lazy, tmp, &lazy_trusted_map_list, list) {
+        if (start >= lazy->map.end || end <= lazy->map.start)
+            continue;
+
+        int ret = trusted_file_map_release(&lazy->map, start, end,
+                                           lazy_trusted_map_fill,
+                                           lazy_trusted_map_drop, lazy);
+        if (ret < 0)
+            SGX_DBG(DBG_E, "Cannot fill the rest of a mapping of %s: %d\n",
+                    lazy->path, ret);
+
+        if (!lazy->map.pending) {
+            LISTP_DEL(lazy, &lazy_trusted_map_list, list);
+            ocall_unmap_untrusted(lazy->umem, lazy->umem_end - lazy->umem_start);
+            free(lazy);
+        }
+    }
+    _DkSpinUnlock(&lazy_trusted_map_lock);
+}
+
+/* Parses a size, with a K/M/G suffix, as in the manifest */
+static uint64_t parse_size (const char * str)
+{
+    char * end;
+    uint64_t size = strtol(str, &end, 0);
+
+    if (*end == 'G' || *end == 'g')
+        size *= 1024 * 1024 * 1024;
+    else if (*end == 'M' || *end == 'm')
+        size *= 1024 * 1024;
+    else if (*end == 'K' || *end == 'k')
+        size *= 1024;
+
+    return size;
+}
+
+int init_lazy_trusted_mmap (void)
+{
+    char cfgbuf[CONFIG_MAX];
+    ssize_t ret = get_config(pal_state.root_config, "sgx.lazy_trusted_mmap",
+                             cfgbuf, CONFIG_MAX);
+
+    if (ret <= 0 || !atoi(cfgbuf))
+        return 0;
+
+    lazy_trusted_mmap_size = 4 * 1024 * 1024;
+
+    ret = get_config(pal_state.root_config, "sgx.lazy_trusted_mmap_min_size",
+                     cfgbuf, CONFIG_MAX);
+    if (ret > 0) {
+        uint64_t min_size = parse_size(cfgbuf);
+        lazy_trusted_mmap_size = MAX(min_size, TRUSTED_STUB_SIZE);
+    }
+
+    SGX_DBG(DBG_S, "Lazy mappings of trusted files of at least %lu bytes\n",
+            lazy_trusted_mmap_size);
+    return 0;
+}
+
+/* Parses a SHA256 checksum, written by pal-sgx-sign in lowercase hex */
+static int parse_checksum (const char * checksum_str, sgx_checksum_t * checksum)
+{
+    size_t nbytes = 0;
+    for (; nbytes < sizeof(sgx_checksum_t) ; nbytes++) {
+        char byte1 = checksum_str[nbytes * 2];
+        char byte2 = checksum_str[nbytes * 2 + 1];
+        unsigned char val = 0;
+
+        if (byte1 == 0 || byte2 == 0) {
+            break;
+        }
+        if (!(byte1 >= '0' && byte1 <= '9') &&
+            !(byte1 >= 'a' && byte1 <= 'f')) {
+            break;
+        }
+        if (!(byte2 >= '0' && byte2 <= '9') &&
+            !(byte2 >= 'a' && byte2 <= 'f')) {
+            break;
+        }
+
+        if (byte1 >= '0' && byte1 <= '9')
+            val = byte1 - '0';
+        if (byte1 >= 'a' && byte1 <= 'f')
+            val = byte1 - 'a' + 10;
+        val *= 16;
+        if (byte2 >= '0' && byte2 <= '9')
+            val += byte2 - '0';
+        if (byte2 >= 'a' && byte2 <= 'f')
+            val += byte2 - 'a' + 10;
+
+        checksum->bytes[nbytes] = val;
+    }
+
+    return nbytes < sizeof(sgx_checksum_t) ? -PAL_ERROR_INVAL : 0;
+}
+
 static int register_trusted_file (const char * uri, const char * checksum_str)
 {
     struct trusted_file * tf = NULL, * new;
@@ -642,7 +954,7 @@ static int register_trusted_file (const char * uri, const char * checksum_str)
     }
     _DkSpinUnlock(&trusted_file_lock);
 
-    new = malloc(sizeof(struct trusted_file));
+    new = malloc(sizeof(struct trusted_file) + uri_len + 1);
     if (!new)
         return -PAL_ERROR_NOMEM;
 
@@ -658,44 +970,17 @@ static int register_trusted_file (const char * uri, const char * checksum_str)
         if (!ret)
             new->size = attr.pending_size;
 
-        char checksum_text[sizeof(sgx_checksum_t) * 2 + 1] = "\0";
-        size_t nbytes = 0;
-        for (; nbytes < sizeof(sgx_checksum_t) ; nbytes++) {
-            char byte1 = checksum_str[nbytes * 2];
-            char byte2 = checksum_str[nbytes * 2 + 1];
-            unsigned char val = 0;
-
-            if (byte1 == 0 || byte2 == 0) {
-                break;
-            }
-            if (!(byte1 >= '0' && byte1 <= '9') &&
-                !(byte1 >= 'a' && byte1 <= 'f')) {
-                break;
-            }
-            if (!(byte2 >= '0' && byte2 <= '9') &&
-                !(byte2 >= 'a' && byte2 <= 'f')) {
-                break;
-            }
-
-            if (byte1 >= '0' && byte1 <= '9')
-                val = byte1 - '0';
-            if (byte1 >= 'a' && byte1 <= 'f')
-                val = byte1 - 'a' + 10;
-            val *= 16;
-            if (byte2 >= '0' && byte2 <= '9')
-                val += byte2 - '0';
-            if (byte2 >= 'a' && byte2 <= 'f')
-                val += byte2 - 'a' + 10;
-
-            new->checksum.bytes[nbytes] = val;
-            snprintf(checksum_text + nbytes * 2, 3, "%02x", val);
-        }
-
-        if (nbytes < sizeof(sgx_checksum_t)) {
+        ret = parse_checksum(checksum_str, &new->checksum);
+        if (ret < 0) {
             free(new);
-            return -PAL_ERROR_INVAL;
+            return ret;
         }
 
+        char checksum_text[sizeof(sgx_checksum_t) * 2 + 1];
+        for (size_t i = 0 ; i < sizeof(sgx_checksum_t) ; i++)
+            snprintf(checksum_text + i * 2, 3, "%02x",
+                     (unsigned char) new->checksum.bytes[i]);
+
         new->index = (++trusted_file_indexes);
         SGX_DBG(DBG_S, "trusted: [%ld] %s %s\n", new->index,
                 checksum_text, new->uri);
@@ -757,6 +1042,90 @@ static int init_trusted_file (const char * key, const char * uri)
     return register_trusted_file(normpath, checksum);
 }
 
+/*
+ * 'init_trusted_file_table' copies the trusted file table, written by
+ * pal-sgx-sign next to the signed manifest, into the enclave. The table
+ * is checked against the checksum in the manifest, which is part of the
+ * enclave measurement.
+ */
+static int init_trusted_file_table (const char * checksum_str)
+{
+    sgx_checksum_t checksum, hash;
+    char path[URI_MAX];
+    struct stat stat;
+    void * table = NULL, * umem;
+    int fd, ret;
+
+    ret = parse_checksum(checksum_str, &checksum);
+    if (ret < 0)
+        return ret;
+
+    if (!strstartswith_static(pal_sec.manifest_name, "file:"))
+        return -PAL_ERROR_INVAL;
+
+    ret = snprintf(path, sizeof(path), "%s" TRUSTED_FILE_TABLE_SUFFIX,
+                   pal_sec.manifest_name + URI_FILE_PREFIX_LEN);
+    if (ret < 0 || (size_t) ret >= sizeof(path))
+        return -PAL_ERROR_TOOLONG;
+
+    fd = ocall_open(path, 0, 0);
+    if (IS_ERR(fd)) {
+        SGX_DBG(DBG_E, "Cannot open trusted file table %s\n", path);
+        return unix_to_pal_error(ERRNO(fd));
+    }
+
+    ret = ocall_fstat(fd, &stat);
+    if (IS_ERR(ret)) {
+        ret = unix_to_pal_error(ERRNO(ret));
+        goto out;
+    }
+
+    size_t size = stat.st_size;
+    if (size < sizeof(struct trusted_file_table_hdr)) {
+        ret = -PAL_ERROR_DENIED;
+        goto out;
+    }
+
+    table = malloc(size);
+    if (!table) {
+        ret = -PAL_ERROR_NOMEM;
+        goto out;
+    }
+
+    ret = ocall_map_untrusted(fd, 0, size, PROT_READ, &umem);
+    if (IS_ERR(ret)) {
+        ret = unix_to_pal_error(ERRNO(ret));
+        goto out;
+    }
+
+    /* copy the table into the enclave before checking it */
+    memcpy(table, umem, size);
+    ocall_unmap_untrusted(umem, size);
+
+    LIB_SHA256_CONTEXT sha;
+    if ((ret = lib_SHA256Init(&sha)) < 0 ||
+        (ret = lib_SHA256Update(&sha, table, size)) < 0 ||
+        (ret = lib_SHA256Final(&sha, (uint8_t *) hash.bytes)) < 0)
+        goto out;
+
+    if (memcmp(&hash, &checksum, sizeof(sgx_checksum_t)) ||
+        !trusted_file_table_valid(table, size)) {
+        SGX_DBG(DBG_E, "Trusted file table %s does not match the manifest\n", path);
+        ret = -PAL_ERROR_DENIED;
+        goto out;
+    }
+
+    SGX_DBG(DBG_S, "trusted file table: %u files\n",
+            ((struct trusted_file_table_hdr *) table)->nentries);
+    trusted_file_table = table;
+    table = NULL;
+    ret = 0;
+out:
+    free(table);
+    ocall_close(fd);
+    return ret;
+}
+
 int init_trusted_files (void) {
     struct config_store* store = pal_state.root_config;
     char* cfgbuf = NULL;
@@ -800,6 +1169,16 @@ int init_trusted_files (void) {
         }
     }
 
+    /* With a trusted file table, the manifest has no checksums for
+       sgx.trusted_files; they are looked up in the table when opened */
+    len = get_config(store, "sgx.trusted_files_table_checksum", cfgbuf, CONFIG_MAX);
+    if (len > 0) {
+        ret = init_trusted_file_table(cfgbuf);
+        if (ret < 0)
+            goto out;
+        goto no_trusted;
+    }
+
     cfgsize = get_config_entries_size(store, "sgx.trusted_files");
     if (cfgsize <= 0)
         goto no_trusted;
@@ -1083,38 +1462,30 @@ int init_enclave (void)
 }
 
 int _DkStreamKeyExchange(PAL_HANDLE stream, PAL_SESSION_KEY* key) {
-    uint8_t pub[DH_SIZE]   __attribute__((aligned(DH_SIZE)));
-    uint8_t agree[DH_SIZE] __attribute__((aligned(DH_SIZE)));
+    uint8_t pub[ECDH_SIZE];
+    uint8_t agree[ECDH_SIZE];
     PAL_NUM pubsz, agreesz;
-    LIB_DH_CONTEXT context;
+    LIB_ECDH_CONTEXT context;
     int64_t bytes;
     int64_t ret;
 
-    ret = lib_DhInit(&context);
+    /* X25519 costs a fraction of a 2048-bit finite-field DH and this runs
+     * on every process creation, in both the parent and the child. */
+    ret = lib_EcdhInit(&context);
     if (ret < 0) {
-        SGX_DBG(DBG_E, "Key Exchange: DH Init failed: %ld\n", ret);
+        SGX_DBG(DBG_E, "Key Exchange: ECDH Init failed: %ld\n", ret);
         goto out_no_final;
     }
 
     pubsz = sizeof pub;
-    ret = lib_DhCreatePublic(&context, pub, &pubsz);
+    ret = lib_EcdhCreatePublic(&context, pub, &pubsz);
     if (ret < 0) {
-        SGX_DBG(DBG_E, "Key Exchange: DH CreatePublic failed: %ld\n", ret);
+        SGX_DBG(DBG_E, "Key Exchange: ECDH CreatePublic failed: %ld\n", ret);
         goto out;
     }
 
-    assert(pubsz > 0 && pubsz <= DH_SIZE);
-    if (pubsz < DH_SIZE) {
-        /* Insert leading zero bytes if necessary. These values are big-
-         * endian, so we either need to know the length of the bignum or
-         * zero-pad at the beginning instead of the end. This code chooses
-         * to do the latter. */
-        memmove(pub + (DH_SIZE - pubsz), pub, pubsz);
-        memset(pub, 0, DH_SIZE - pubsz);
-    }
-
-    for (bytes = 0, ret = 0; bytes < DH_SIZE; bytes += ret) {
-        ret = _DkStreamWrite(stream, 0, DH_SIZE - bytes, pub + bytes, NULL, 0);
+    for (bytes = 0, ret = 0; bytes < ECDH_SIZE; bytes += ret) {
+        ret = _DkStreamWrite(stream, 0, ECDH_SIZE - bytes, pub + bytes, NULL, 0);
         if (ret < 0) {
             if (ret == -PAL_ERROR_INTERRUPTED || ret == -PAL_ERROR_TRYAGAIN) {
                 ret = 0;
@@ -1125,8 +1496,8 @@ int _DkStreamKeyExchange(PAL_HANDLE stream, PAL_SESSION_KEY* key) {
         }
     }
 
-    for (bytes = 0, ret = 0 ; bytes < DH_SIZE ; bytes += ret) {
-        ret = _DkStreamRead(stream, 0, DH_SIZE - bytes, pub + bytes, NULL, 0);
+    for (bytes = 0, ret = 0 ; bytes < ECDH_SIZE ; bytes += ret) {
+        ret = _DkStreamRead(stream, 0, ECDH_SIZE - bytes, pub + bytes, NULL, 0);
         if (ret < 0) {
             if (ret == -PAL_ERROR_INTERRUPTED || ret == -PAL_ERROR_TRYAGAIN) {
                 ret = 0;
@@ -1138,16 +1509,14 @@ int _DkStreamKeyExchange(PAL_HANDLE stream, PAL_SESSION_KEY* key) {
     }
 
     agreesz = sizeof agree;
-    ret = lib_DhCalcSecret(&context, pub, DH_SIZE, agree, &agreesz);
+    ret = lib_EcdhCalcSecret(&context, pub, ECDH_SIZE, agree, &agreesz);
     if (ret < 0) {
-        SGX_DBG(DBG_E, "Key Exchange: DH CalcSecret failed: %ld\n", ret);
+        SGX_DBG(DBG_E, "Key Exchange: ECDH CalcSecret failed: %ld\n", ret);
         goto out;
     }
 
-    assert(agreesz > 0 && agreesz <= sizeof agree);
-
     /*
-     * Using SHA256 as a KDF to convert the 128-byte DH secret to a 256-bit AES key.
+     * Using SHA256 as a KDF to convert the 32-byte ECDH secret to a 256-bit AES key.
      * According to the NIST recommendation:
      * https://nvlpubs.nist.gov/nistpubs/SpecialPublications/NIST.SP.800-56Cr1.pdf,
      * a key derivation function (KDF) can be a secure hash function (e.g., SHA-256),
@@ -1165,7 +1534,8 @@ int _DkStreamKeyExchange(PAL_HANDLE stream, PAL_SESSION_KEY* key) {
     SGX_DBG(DBG_S, "Key exchange succeeded: %s\n", ALLOCA_BYTES2HEXSTR(*key));
     ret = 0;
 out:
-    lib_DhFinal(&context);
+    lib_EcdhFinal(&context);
+    memset(agree, 0, sizeof(agree));
 out_no_final:
     return ret;
 }
@@ -310,6 +310,100 @@ out:
     return retval;
 }
 
+int ocall_pread (int fd, void * buf, unsigned int count, uint64_t offset)
+{
+    int retval = 0;
+    void * obuf = NULL;
+    ms_ocall_pread_t * ms;
+
+    if (count > PRESET_PAGESIZE) {
+        retval = ocall_alloc_untrusted(ALLOC_ALIGNUP(count), &obuf);
+        if (IS_ERR(retval))
+            return retval;
+    }
+
+    ms = sgx_alloc_on_ustack(sizeof(*ms));
+    if (!ms) {
+        retval = -EPERM;
+        goto out;
+    }
+
+    ms->ms_fd = fd;
+    ms->ms_count = count;
+    ms->ms_offset = offset;
+    if (obuf)
+        ms->ms_buf = obuf;
+    else
+        ms->ms_buf = sgx_alloc_on_ustack(count);
+
+    if (!ms->ms_buf) {
+        retval = -EPERM;
+        goto out;
+    }
+
+    retval = sgx_ocall(OCALL_PREAD, ms);
+
+    if (retval > 0) {
+        if (!sgx_copy_to_enclave(buf, count, ms->ms_buf, retval)) {
+            retval = -EPERM;
+            goto out;
+        }
+    }
+
+out:
+    sgx_reset_ustack();
+    if (obuf)
+        ocall_unmap_untrusted(obuf, ALLOC_ALIGNUP(count));
+    return retval;
+}
+
+int ocall_pwrite (int fd, const void * buf, unsigned int count, uint64_t offset)
+{
+    int retval = 0;
+    void * obuf = NULL;
+    ms_ocall_pwrite_t * ms;
+
+    if (sgx_is_completely_outside_enclave(buf, count)) {
+        obuf = (void*)buf;
+    } else if (sgx_is_completely_within_enclave(buf, count)) {
+        if (count > PRESET_PAGESIZE) {
+            retval = ocall_alloc_untrusted(ALLOC_ALIGNUP(count), &obuf);
+            if (IS_ERR(retval))
+                return retval;
+            memcpy(obuf, buf, count);
+        }
+    } else {
+        return -EPERM;
+    }
+
+    ms = sgx_alloc_on_ustack(sizeof(*ms));
+    if (!ms) {
+        retval = -EPERM;
+        goto out;
+    }
+
+    ms->ms_fd = fd;
+    ms->ms_count = count;
+    ms->ms_offset = offset;
+    if (obuf)
+        ms->ms_buf = obuf;
+    else
+        ms->ms_buf = sgx_copy_to_ustack(buf, count);
+
+    if (!ms->ms_buf) {
+        retval = -EPERM;
+        goto out;
+    }
+
+    retval = sgx_ocall(OCALL_PWRITE, ms);
+
+out:
+    sgx_reset_ustack();
+    if (obuf && obuf != buf)
+        ocall_unmap_untrusted(obuf, ALLOC_ALIGNUP(count));
+    return retval;
+}
+
 int ocall_fstat (int fd, struct stat * buf)
 {
     int retval = 0;
@@ -866,6 +960,175 @@ out:
     return retval;
 }
 
+/* Lay out a copy of a batch of messages in untrusted memory: the headers, and
+ * for each message its iovec, address and data. The copy is on the untrusted
+ * stack if it is small, and on the untrusted heap otherwise (in *obuf). */
+static struct mmsghdr * sock_batch_alloc (const struct mmsghdr * msgs, unsigned int count,
+                                          bool copy_data, void ** obuf, uint64_t * obuf_size)
+{
+    uint64_t size = count * (sizeof(struct mmsghdr) + sizeof(struct iovec));
+
+    for (unsigned int i = 0; i < count; i++) {
+        const struct msghdr * hdr = &msgs[i].msg_hdr;
+        if (hdr->msg_iovlen != 1 || hdr->msg_control ||
+            hdr->msg_namelen > sizeof(struct sockaddr))
+            return NULL;
+        size += hdr->msg_iov[0].iov_len + hdr->msg_namelen;
+    }
+
+    char * ptr;
+    if (size > PRESET_PAGESIZE) {
+        *obuf_size = ALLOC_ALIGNUP(size);
+        if (IS_ERR(ocall_alloc_untrusted(*obuf_size, obuf)))
+            return NULL;
+        ptr = *obuf;
+    } else {
+        ptr = sgx_alloc_on_ustack(size);
+        if (!ptr)
+            return NULL;
+    }
+
+    struct mmsghdr * umsgs = (struct mmsghdr *) ptr;
+    struct iovec * uiovs = (struct iovec *) (umsgs + count);
+    ptr = (char *) (uiovs + count);
+
+    for (unsigned int i = 0; i < count; i++) {
+        const struct msghdr * hdr = &msgs[i].msg_hdr;
+        struct msghdr * uhdr = &umsgs[i].msg_hdr;
+
+        memset(&umsgs[i], 0, sizeof(umsgs[i]));
+        uhdr->msg_iov = &uiovs[i];
+        uhdr->msg_iovlen = 1;
+        uiovs[i].iov_base = ptr;
+        uiovs[i].iov_len = hdr->msg_iov[0].iov_len;
+        if (copy_data)
+            memcpy(ptr, hdr->msg_iov[0].iov_base, uiovs[i].iov_len);
+        ptr += uiovs[i].iov_len;
+
+        if (hdr->msg_name) {
+            uhdr->msg_name = ptr;
+            uhdr->msg_namelen = hdr->msg_namelen;
+            if (copy_data)
+                memcpy(ptr, hdr->msg_name, hdr->msg_namelen);
+            ptr += hdr->msg_namelen;
+        }
+    }
+
+    return umsgs;
+}
+
+int ocall_sock_recv_batch (int sockfd, struct mmsghdr * msgs, unsigned int count)
+{
+    int retval = 0;
+    void * obuf = NULL;
+    uint64_t obuf_size = 0;
+    ms_ocall_sock_recv_batch_t * ms;
+
+    ms = sgx_alloc_on_ustack(sizeof(*ms));
+    if (!ms)
+        return -EPERM;
+
+    struct mmsghdr * umsgs = sock_batch_alloc(msgs, count, /*copy_data=*/false, &obuf,
+                                              &obuf_size);
+    if (!umsgs) {
+        retval = -EPERM;
+        goto out;
+    }
+
+    ms->ms_sockfd = sockfd;
+    ms->ms_msgs = umsgs;
+    ms->ms_count = count;
+
+    retval = sgx_ocall(OCALL_SOCK_RECV_BATCH, ms);
+    if (retval < 0)
+        goto out;
+
+    if ((unsigned int) retval > count) {
+        retval = -EPERM;
+        goto out;
+    }
+
+    /* copy back through the layout of sock_batch_alloc(), not through the
+     * pointers in untrusted memory, and check the lengths from the host */
+    struct iovec * uiovs = (struct iovec *) (umsgs + count);
+    char * ptr = (char *) (uiovs + count);
+
+    for (int i = 0; i < retval; i++) {
+        struct msghdr * hdr = &msgs[i].msg_hdr;
+        unsigned int len = umsgs[i].msg_len;
+        unsigned int namelen = umsgs[i].msg_hdr.msg_namelen;
+        uint64_t size = hdr->msg_iov[0].iov_len;
+
+        if (len && !sgx_copy_to_enclave(hdr->msg_iov[0].iov_base, size, ptr, len)) {
+            retval = -EPERM;
+            goto out;
+        }
+        msgs[i].msg_len = len;
+        ptr += size;
+
+        if (hdr->msg_name) {
+            if (namelen > hdr->msg_namelen)
+                namelen = hdr->msg_namelen;
+            memcpy(hdr->msg_name, ptr, namelen);
+            hdr->msg_namelen = namelen;
+            ptr += hdr->msg_namelen;
+        }
+    }
+
+out:
+    sgx_reset_ustack();
+    if (obuf)
+        ocall_unmap_untrusted(obuf, obuf_size);
+    return retval;
+}
+
+int ocall_sock_send_batch (int sockfd, struct mmsghdr * msgs, unsigned int count)
+{
+    int retval = 0;
+    void * obuf = NULL;
+    uint64_t obuf_size = 0;
+    ms_ocall_sock_send_batch_t * ms;
+
+    ms = sgx_alloc_on_ustack(sizeof(*ms));
+    if (!ms)
+        return -EPERM;
+
+    struct mmsghdr * umsgs = sock_batch_alloc(msgs, count, /*copy_data=*/true, &obuf,
+                                              &obuf_size);
+    if (!umsgs) {
+        retval = -EPERM;
+        goto out;
+    }
+
+    ms->ms_sockfd = sockfd;
+    ms->ms_msgs = umsgs;
+    ms->ms_count = count;
+
+    retval = sgx_ocall(OCALL_SOCK_SEND_BATCH, ms);
+    if (retval < 0)
+        goto out;
+
+    if ((unsigned int) retval > count) {
+        retval = -EPERM;
+        goto out;
+    }
+
+    for (int i = 0; i < retval; i++) {
+        unsigned int len = umsgs[i].msg_len;
+        if (len > msgs[i].msg_hdr.msg_iov[0].iov_len) {
+            retval = -EPERM;
+            goto out;
+        }
+        msgs[i].msg_len = len;
+    }
+
+out:
+    sgx_reset_ustack();
+    if (obuf)
+        ocall_unmap_untrusted(obuf, obuf_size);
+    return retval;
+}
+
 int ocall_sock_recv_fd (int sockfd, void * buf, unsigned int count,
                         unsigned int * fds, unsigned int * nfds)
 {
@@ -997,7 +1260,7 @@ int ocall_sock_shutdown (int sockfd, int how)
     return retval;
 }
 
-int ocall_gettime (unsigned long * microsec)
+int ocall_gettime (unsigned long * nanosec)
 {
     int retval = 0;
     ms_ocall_gettime_t * ms;
@@ -1012,7 +1275,7 @@ int ocall_gettime (unsigned long * microsec)
         retval = sgx_ocall(OCALL_GETTIME, ms);
     } while(retval == -EINTR);
     if (!retval)
-        *microsec = ms->ms_microsec;
+        *nanosec = ms->ms_nanosec;
 
     sgx_reset_ustack();
     return retval;
@@ -1243,3 +1506,48 @@ reset:
 out:
     return retval;
 }
+
+int ocall_mprotect (void * addr, uint64_t size, int prot)
+{
+    int retval = 0;
+    ms_ocall_mprotect_t * ms;
+
+    if (!sgx_is_completely_within_enclave(addr, size)) {
+        sgx_reset_ustack();
+        return -EINVAL;
+    }
+
+    ms = sgx_alloc_on_ustack(sizeof(*ms));
+    if (!ms) {
+        sgx_reset_ustack();
+        return -EPERM;
+    }
+
+    ms->ms_addr = addr;
+    ms->ms_size = size;
+    ms->ms_prot = prot;
+
+    retval = sgx_ocall(OCALL_MPROTECT, ms);
+
+    sgx_reset_ustack();
+    return retval;
+}
+
+int ocall_get_fault_addr (void ** addr)
+{
+    int retval = 0;
+    ms_ocall_get_fault_addr_t * ms;
+
+    ms = sgx_alloc_on_ustack(sizeof(*ms));
+    if (!ms) {
+        sgx_reset_ustack();
+        return -EPERM;
+    }
+
+    retval = sgx_ocall(OCALL_GET_FAULT_ADDR, ms);
+    if (!retval)
+        *addr = ms->ms_addr;
+
+    sgx_reset_ustack();
+    return retval;
+}
@@ -31,6 +31,10 @@ int ocall_read (int fd, void * buf, unsigned int count);
 
 int ocall_write (int fd, const void * buf, unsigned int count);
 
+int ocall_pread (int fd, void * buf, unsigned int count, uint64_t offset);
+
+int ocall_pwrite (int fd, const void * buf, unsigned int count, uint64_t offset);
+
 int ocall_fstat (int fd, struct stat * buf);
 
 int ocall_stat (const char * path, struct stat * buf);
@@ -69,6 +73,12 @@ int ocall_sock_recv (int sockfd, void * buf, unsigned int count,
 int ocall_sock_send (int sockfd, const void * buf, unsigned int count,
                      const struct sockaddr * addr, unsigned int addrlen);
 
+/* Each message of these must have a single iovec. Receiving waits for the
+ * first message only, as recvmmsg() with MSG_WAITFORONE. */
+int ocall_sock_recv_batch (int sockfd, struct mmsghdr * msgs, unsigned int count);
+
+int ocall_sock_send_batch (int sockfd, struct mmsghdr * msgs, unsigned int count);
+
 int ocall_sock_recv_fd (int sockfd, void * buf, unsigned int count,
                         unsigned int * fds, unsigned int * nfds);
 
@@ -87,7 +97,7 @@ int ocall_create_process(const char* uri, int nargs, const char** args, int proc
 
 int ocall_futex(int* uaddr, int op, int val, int64_t timeout_us);
 
-int ocall_gettime (unsigned long * microsec);
+int ocall_gettime (unsigned long * nanosec);
 
 int ocall_sleep (unsigned long * microsec);
 
@@ -104,3 +114,9 @@ int ocall_load_debug (const char * command);
 int ocall_get_attestation(const sgx_spid_t* spid, const char* subkey, bool linkable,
                           const sgx_report_t* report, const sgx_quote_nonce_t* nonce,
                           sgx_attestation_t* attestation);
+
+int ocall_mprotect (void * addr, uint64_t size, int prot);
+
+/* Address of the last memory fault of this thread, as told by the host;
+   untrusted, like the fault itself */
+int ocall_get_fault_addr (void ** addr);
@@ -0,0 +1,752 @@
+/* Copyright (C) 2014 Stony Brook University
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * enclave_stream.c
+ *
+ * This file contains the record layer which encrypts process and pipe
+ * streams between enclaves. Everything written on such a stream is cut into
+ * records of at most SECURE_RECORD_SIZE bytes, and each record is sealed
+ * with AES-GCM:
+ *
+ *   [ header (size, flags, writer, seq) | ciphertext | tag ]
+ *
+ * The header is authenticated as additional data. Each direction of a
+ * stream has its own key. The IV of a record is derived from (flags,
+ * writer, seq), where the writer is a random number picked by each copy of
+ * the handle, because a handle sent to another process keeps writing with
+ * the same key. A reader keeps the last sequence number of every writer it
+ * has seen: the records of one writer must come in order without gaps, and
+ * a writer it doesn't know yet must start at sequence number 0, so the host
+ * can neither replay, reorder nor drop records by switching writers.
+ *
+ * Once a handle has been sent to another process, both copies may read
+ * from the same stream, and each sees only some of the records of a writer.
+ * They then only require the sequence numbers of a writer to increase, and
+ * accept writers they don't know at any sequence number; the copy starts
+ * with the writers the original had seen, so their old records are still
+ * refused.
+ *
+ * Process streams take their keys from the session key of the parent/child
+ * handshake (see db_process.c). Pipes are opened between any two enclaves
+ * of the application, so they take their keys from pipe_master_key, which
+ * the first process creates and every process hands down to its children
+ * over the encrypted process stream, and from two nonces exchanged when the
+ * pipe is connected. The client sends its nonce in connect and the server
+ * answers in accept, so neither side blocks on the other (the LibOS
+ * connects and accepts a pipe in the same thread); the client reads the
+ * answer on its first read or write.
+ *
+ * Writes seal up to SECURE_BATCH_RECORDS records straight into a buffer in
+ * untrusted memory and send them with one OCALL, which saves the copy (and
+ * the allocation of an untrusted buffer) of a plain ocall_write(). Reads
+ * fetch exactly one record at a time, so a handle never holds the beginning
+ * of a record that another copy of it is going to read.
+ */
+
+#include "api.h"
+#include "pal.h"
+#include "pal_crypto.h"
+#include "pal_debug.h"
+#include "pal_error.h"
+#include "pal_internal.h"
+#include "pal_linux.h"
+#include "pal_linux_error.h"
+#include "pal_security.h"
+
+#include <asm/poll.h>
+
+#define SECURE_RECORD_SIZE      (64 * 1024)
+#define SECURE_BATCH_RECORDS    4
+#define SECURE_NONCE_SIZE       32
+#define SECURE_STATE_PEERS      16
+
+#define SECURE_RECORD_CARGO     0x1
+
+struct secure_record_header {
+    uint32_t size;
+    uint32_t flags;
+    uint64_t writer;
+    uint64_t seq;
+} __attribute__((packed));
+
+#define SECURE_RECORD_OVERHEAD  (sizeof(struct secure_record_header) + AES_GCM_TAG_SIZE)
+#define SECURE_BATCH_SIZE       (SECURE_BATCH_RECORDS * (SECURE_RECORD_SIZE + SECURE_RECORD_OVERHEAD))
+
+/* The last record received from one writer. */
+struct secure_peer {
+    uint64_t writer, seq;
+};
+
+struct secure_stream {
+    PAL_SESSION_KEY send_key, recv_key;
+    LIB_AESGCM_CONTEXT send_ctx, recv_ctx;
+
+    /* sending side; send_buf is in untrusted memory */
+    PAL_LOCK send_lock;
+    uint64_t writer;
+    uint64_t send_seq, cargo_seq;
+    void* send_buf;
+
+    /* receiving side; recv_buf holds one record, decrypted in place */
+    PAL_LOCK recv_lock;
+    struct secure_peer* peers;      /* every writer seen, in order of appearance */
+    uint32_t npeers, peers_size;
+    bool shared;                    /* another copy of the handle reads the stream */
+    uint8_t* recv_buf;
+    uint32_t recv_size, recv_len;   /* bytes allocated, bytes of the record received */
+    uint32_t plain_pos, plain_end;  /* plaintext not consumed yet */
+
+    /* client side of a pipe: bytes of the server nonce still to read */
+    uint32_t handshake;
+    uint8_t nonce[2][SECURE_NONCE_SIZE];
+};
+
+/* What a handle sent to another process carries (sealed, see _DkSendHandle). */
+struct secure_stream_state {
+    PAL_SESSION_KEY send_key, recv_key;
+    uint32_t npeers;
+    struct secure_peer peers[SECURE_STATE_PEERS];  /* the most recent writers */
+};
+
+PAL_SESSION_KEY pipe_master_key;
+
+static int derive_key(const uint8_t* secret, size_t secret_size, const char* label,
+                      const void* extra, size_t extra_size, PAL_SESSION_KEY* key) {
+    LIB_SHA256_CONTEXT sha;
+    int ret;
+
+    if ((ret = lib_SHA256Init(&sha)) < 0 ||
+        (ret = lib_SHA256Update(&sha, (const uint8_t*)label, strlen(label))) < 0 ||
+        (ret = lib_SHA256Update(&sha, secret, secret_size)) < 0 ||
+        (extra_size && (ret = lib_SHA256Update(&sha, extra, extra_size)) < 0) ||
+        (ret = lib_SHA256Final(&sha, (uint8_t*)key)) < 0)
+        return ret;
+    return 0;
+}
+
+static int record_iv(const struct secure_record_header* hdr, uint8_t iv[AES_GCM_IV_SIZE]) {
+    uint8_t hash[SHA256_DIGEST_LEN];
+    LIB_SHA256_CONTEXT sha;
+    int ret;
+
+    /* (flags, writer, seq) never repeats under one key */
+    if ((ret = lib_SHA256Init(&sha)) < 0 ||
+        (ret = lib_SHA256Update(&sha, (const uint8_t*)&hdr->flags,
+                                sizeof(*hdr) - sizeof(hdr->size))) < 0 ||
+        (ret = lib_SHA256Final(&sha, hash)) < 0)
+        return ret;
+
+    memcpy(iv, hash, AES_GCM_IV_SIZE);
+    return 0;
+}
+
+static int new_writer(struct secure_stream* stream) {
+    int ret = _DkRandomBitsRead(&stream->writer, sizeof(stream->writer));
+    if (ret < 0)
+        return ret;
+    stream->send_seq  = 0;
+    stream->cargo_seq = 0;
+    return 0;
+}
+
+static int setup_keys(struct secure_stream* stream) {
+    int ret = lib_AESGCMInit(&stream->send_ctx, stream->send_key, sizeof(stream->send_key));
+    if (ret < 0)
+        return ret;
+
+    ret = lib_AESGCMInit(&stream->recv_ctx, stream->recv_key, sizeof(stream->recv_key));
+    if (ret < 0) {
+        lib_AESGCMFinal(&stream->send_ctx);
+        return ret;
+    }
+    return 0;
+}
+
+/* Each side sends with the key the other side receives with. */
+static int derive_stream_keys(struct secure_stream* stream, const uint8_t* secret,
+                              size_t secret_size, int role) {
+    const char* labels[2] = { "graphene stream client", "graphene stream server" };
+    int ret;
+
+    if (role == SECURE_STREAM_LOOPBACK) {
+        ret = derive_key(secret, secret_size, labels[0], NULL, 0, &stream->send_key);
+        if (ret < 0)
+            return ret;
+        memcpy(stream->recv_key, stream->send_key, sizeof(stream->recv_key));
+        return setup_keys(stream);
+    }
+
+    bool client = role == SECURE_STREAM_CLIENT;
+    ret = derive_key(secret, secret_size, labels[client ? 0 : 1], NULL, 0, &stream->send_key);
+    if (ret < 0)
+        return ret;
+    ret = derive_key(secret, secret_size, labels[client ? 1 : 0], NULL, 0, &stream->recv_key);
+    if (ret < 0)
+        return ret;
+    return setup_keys(stream);
+}
+
+static struct secure_stream* alloc_secure_stream(void) {
+    struct secure_stream* stream = malloc(sizeof(*stream));
+    if (!stream)
+        return NULL;
+
+    memset(stream, 0, sizeof(*stream));
+    if (new_writer(stream) < 0) {
+        free(stream);
+        return NULL;
+    }
+    return stream;
+}
+
+int _DkStreamSecureInit(const PAL_SESSION_KEY* key, int role, struct secure_stream** stream) {
+    struct secure_stream* new = alloc_secure_stream();
+    if (!new)
+        return -PAL_ERROR_NOMEM;
+
+    int ret = derive_stream_keys(new, *key, sizeof(*key), role);
+    if (ret < 0) {
+        free(new);
+        return ret;
+    }
+
+    *stream = new;
+    return 0;
+}
+
+static int pipe_keys(struct secure_stream* stream, int role) {
+    PAL_SESSION_KEY secret;
+    int ret = derive_key(pipe_master_key, sizeof(pipe_master_key), "graphene pipe",
+                         stream->nonce, sizeof(stream->nonce), &secret);
+    if (ret < 0)
+        return ret;
+
+    ret = derive_stream_keys(stream, secret, sizeof(secret), role);
+    memset(secret, 0, sizeof(secret));
+    return ret;
+}
+
+static int write_all(int fd, const void* buffer, uint32_t size) {
+    uint32_t bytes = 0;
+
+    while (bytes < size) {
+        int ret = ocall_write(fd, buffer + bytes, size - bytes);
+        if (IS_ERR(ret)) {
+            ret = unix_to_pal_error(ERRNO(ret));
+            if (ret == -PAL_ERROR_INTERRUPTED)
+                continue;
+            if (ret == -PAL_ERROR_TRYAGAIN) {
+                /* a record can't be left half-sent */
+                struct pollfd pfd = { .fd = fd, .events = POLLOUT, .revents = 0 };
+                ocall_poll(&pfd, 1, -1);
+                continue;
+            }
+            return ret;
+        }
+        bytes += ret;
+    }
+    return 0;
+}
+
+int _DkStreamSecureClient(int fd, struct secure_stream** stream) {
+    struct secure_stream* new = alloc_secure_stream();
+    if (!new)
+        return -PAL_ERROR_NOMEM;
+
+    int ret = _DkRandomBitsRead(new->nonce[0], SECURE_NONCE_SIZE);
+    if (ret < 0)
+        goto failed;
+
+    ret = write_all(fd, new->nonce[0], SECURE_NONCE_SIZE);
+    if (ret < 0)
+        goto failed;
+
+    new->handshake = SECURE_NONCE_SIZE;
+    *stream = new;
+    return 0;
+
+failed:
+    free(new);
+    return ret;
+}
+
+int _DkStreamSecureServer(int fd, struct secure_stream** stream) {
+    struct secure_stream* new = alloc_secure_stream();
+    if (!new)
+        return -PAL_ERROR_NOMEM;
+
+    int ret;
+    for (uint32_t bytes = 0; bytes < SECURE_NONCE_SIZE; bytes += ret) {
+        ret = ocall_read(fd, new->nonce[0] + bytes, SECURE_NONCE_SIZE - bytes);
+        if (IS_ERR(ret)) {
+            ret = unix_to_pal_error(ERRNO(ret));
+            if (ret == -PAL_ERROR_INTERRUPTED) {
+                ret = 0;
+                continue;
+            }
+            goto failed;
+        }
+        if (!ret) {
+            ret = -PAL_ERROR_DENIED;
+            goto failed;
+        }
+    }
+
+    ret = _DkRandomBitsRead(new->nonce[1], SECURE_NONCE_SIZE);
+    if (ret < 0)
+        goto failed;
+
+    ret = write_all(fd, new->nonce[1], SECURE_NONCE_SIZE);
+    if (ret < 0)
+        goto failed;
+
+    ret = pipe_keys(new, SECURE_STREAM_SERVER);
+    if (ret < 0)
+        goto failed;
+
+    *stream = new;
+    return 0;
+
+failed:
+    free(new);
+    return ret;
+}
+
+/* Read the rest of the server nonce. Called with recv_lock held. */
+static int finish_handshake(struct secure_stream* stream, int fd) {
+    while (stream->handshake) {
+        uint32_t off = SECURE_NONCE_SIZE - stream->handshake;
+        int ret = ocall_read(fd, stream->nonce[1] + off, stream->handshake);
+        if (IS_ERR(ret)) {
+            ret = unix_to_pal_error(ERRNO(ret));
+            if (ret == -PAL_ERROR_INTERRUPTED)
+                continue;
+            return ret;
+        }
+        if (!ret)
+            return -PAL_ERROR_DENIED;
+        stream->handshake -= ret;
+    }
+
+    return pipe_keys(stream, SECURE_STREAM_CLIENT);
+}
+
+int _DkStreamSecureFinish(struct secure_stream* stream, int fd) {
+    if (!stream->handshake)
+        return 0;
+
+    _DkInternalLock(&stream->recv_lock);
+    _DkInternalLock(&stream->send_lock);
+    int ret = stream->handshake ? finish_handshake(stream, fd) : 0;
+    _DkInternalUnlock(&stream->send_lock);
+    _DkInternalUnlock(&stream->recv_lock);
+    return ret;
+}
+
+static int seal_record(struct secure_stream* stream, uint32_t flags, uint64_t seq,
+                       const void* data, uint32_t size, void* record) {
+    struct secure_record_header hdr = {
+        .size = size, .flags = flags, .writer = stream->writer, .seq = seq,
+    };
+    uint8_t iv[AES_GCM_IV_SIZE];
+
+    int ret = record_iv(&hdr, iv);
+    if (ret < 0)
+        return ret;
+
+    memcpy(record, &hdr, sizeof(hdr));
+    return lib_AESGCMEncrypt(&stream->send_ctx, iv, (uint8_t*)&hdr, sizeof(hdr), data, size,
+                             record + sizeof(hdr), record + sizeof(hdr) + size);
+}
+
+/* Verifies the record in record[] and decrypts it into plain[], which may
+ * be the ciphertext itself. */
+static int open_record(struct secure_stream* stream, const struct secure_record_header* hdr,
+                       const uint8_t* ciphertext, void* plain) {
+    uint8_t iv[AES_GCM_IV_SIZE];
+
+    int ret = record_iv(hdr, iv);
+    if (ret < 0)
+        return ret;
+
+    ret = lib_AESGCMDecrypt(&stream->recv_ctx, iv, (const uint8_t*)hdr, sizeof(*hdr),
+                            ciphertext, hdr->size, plain, ciphertext + hdr->size);
+    if (ret < 0) {
+        SGX_DBG(DBG_E, "Secure stream: corrupted record (writer %016lx, seq %lu)\n",
+                hdr->writer, hdr->seq);
+        return -PAL_ERROR_DENIED;
+    }
+    return 0;
+}
+
+int64_t _DkStreamSecureWrite(struct secure_stream* stream, int fd, const void* buffer,
+                             uint64_t count) {
+    int64_t ret = 0;
+
+    if (!count)
+        return 0;
+
+    _DkInternalLock(&stream->send_lock);
+
+    if (stream->handshake) {
+        _DkInternalUnlock(&stream->send_lock);
+        ret = _DkStreamSecureFinish(stream, fd);
+        if (ret < 0)
+            return ret;
+        _DkInternalLock(&stream->send_lock);
+    }
+
+    if (!stream->send_buf) {
+        ret = ocall_alloc_untrusted(ALLOC_ALIGNUP(SECURE_BATCH_SIZE), &stream->send_buf);
+        if (IS_ERR(ret)) {
+            stream->send_buf = NULL;
+            ret = unix_to_pal_error(ERRNO(ret));
+            goto out;
+        }
+    }
+
+    uint64_t written = 0;
+    while (written < count) {
+        uint32_t nrecords = 0, batch = 0;
+        uint64_t plain = 0;
+
+        /* seal a batch of records straight into untrusted memory */
+        while (nrecords < SECURE_BATCH_RECORDS && written + plain < count) {
+            uint32_t size = count - written - plain;
+            if (size > SECURE_RECORD_SIZE)
+                size = SECURE_RECORD_SIZE;
+
+            ret = seal_record(stream, 0, stream->send_seq + nrecords, buffer + written + plain,
+                              size, stream->send_buf + batch);
+            if (ret < 0)
+                goto out;
+
+            batch += size + SECURE_RECORD_OVERHEAD;
+            plain += size;
+            nrecords++;
+        }
+
+        int bytes = ocall_write(fd, stream->send_buf, batch);
+        if (IS_ERR(bytes)) {
+            /* Nothing went out, but the sequence numbers were used to seal
+             * this data; continue as a new writer rather than reuse them. */
+            int err = new_writer(stream);
+            ret = err < 0 ? err : unix_to_pal_error(ERRNO(bytes));
+            if (written)
+                ret = written;
+            goto out;
+        }
+
+        stream->send_seq += nrecords;
+
+        if ((uint32_t)bytes < batch) {
+            ret = write_all(fd, stream->send_buf + bytes, batch - bytes);
+            if (ret < 0)
+                goto out;
+        }
+
+        written += plain;
+    }
+
+    ret = written;
+out:
+    _DkInternalUnlock(&stream->send_lock);
+    return ret;
+}
+
+/* Read from fd until recv_buf holds want bytes. Returns 0 at the end of the
+ * stream, if no bytes have been received at all. */
+static int64_t fill_record(struct secure_stream* stream, int fd, uint32_t want) {
+    while (stream->recv_len < want) {
+        int ret = ocall_read(fd, stream->recv_buf + stream->recv_len, want - stream->recv_len);
+        if (IS_ERR(ret)) {
+            ret = unix_to_pal_error(ERRNO(ret));
+            /* only give up in the middle of a record if there is no data */
+            if (ret == -PAL_ERROR_INTERRUPTED && stream->recv_len)
+                continue;
+            return ret;
+        }
+        if (!ret) {
+            if (stream->recv_len) {
+                SGX_DBG(DBG_E, "Secure stream: truncated record\n");
+                return -PAL_ERROR_DENIED;
+            }
+            return 0;
+        }
+        stream->recv_len += ret;
+    }
+    return want;
+}
+
+/* Checks the writer and sequence number of a record before it is opened,
+ * and makes room for a new writer. Returns the index of the writer in
+ * stream->peers, which is stream->npeers for a new one. Called with
+ * recv_lock held. */
+static int check_record_seq(struct secure_stream* stream, const struct secure_record_header* hdr,
+                            uint32_t* index) {
+    uint32_t i;
+
+    for (i = 0; i < stream->npeers; i++)
+        if (stream->peers[i].writer == hdr->writer)
+            break;
+
+    if (i < stream->npeers) {
+        uint64_t last = stream->peers[i].seq;
+        if (stream->shared ? hdr->seq <= last : hdr->seq != last + 1) {
+            SGX_DBG(DBG_E, "Secure stream: writer %016lx sent seq %lu after %lu\n",
+                    hdr->writer, hdr->seq, last);
+            return -PAL_ERROR_DENIED;
+        }
+        *index = i;
+        return 0;
+    }
+
+    if (!stream->shared && hdr->seq) {
+        SGX_DBG(DBG_E, "Secure stream: new writer %016lx starts at seq %lu\n",
+                hdr->writer, hdr->seq);
+        return -PAL_ERROR_DENIED;
+    }
+
+    if (stream->npeers == stream->peers_size) {
+        uint32_t size = stream->peers_size ? stream->peers_size * 2 : 4;
+        struct secure_peer* peers = malloc(size * sizeof(*peers));
+        if (!peers)
+            return -PAL_ERROR_NOMEM;
+        if (stream->peers) {
+            memcpy(peers, stream->peers, stream->npeers * sizeof(*peers));
+            free(stream->peers);
+        }
+        stream->peers      = peers;
+        stream->peers_size = size;
+    }
+
+    *index = stream->npeers;
+    return 0;
+}
+
+int64_t _DkStreamSecureRead(struct secure_stream* stream, int fd, void* buffer, uint64_t count) {
+    int64_t ret;
+
+    if (!count)
+        return 0;
+
+    _DkInternalLock(&stream->recv_lock);
+
+    if (stream->handshake) {
+        _DkInternalLock(&stream->send_lock);
+        ret = stream->handshake ? finish_handshake(stream, fd) : 0;
+        _DkInternalUnlock(&stream->send_lock);
+        if (ret < 0)
+            goto out;
+    }
+
+    if (stream->plain_pos == stream->plain_end) {
+        if (!stream->recv_buf) {
+            stream->recv_size = SECURE_RECORD_SIZE + SECURE_RECORD_OVERHEAD;
+            stream->recv_buf  = malloc(stream->recv_size);
+            if (!stream->recv_buf) {
+                ret = -PAL_ERROR_NOMEM;
+                goto out;
+            }
+        }
+
+        struct secure_record_header* hdr = (void*)stream->recv_buf;
+        ret = fill_record(stream, fd, sizeof(*hdr));
+        if (ret <= 0)
+            goto out;
+
+        if (hdr->size > SECURE_RECORD_SIZE || hdr->flags) {
+            SGX_DBG(DBG_E, "Secure stream: bad record header\n");
+            ret = -PAL_ERROR_DENIED;
+            goto out;
+        }
+
+        ret = fill_record(stream, fd, hdr->size + SECURE_RECORD_OVERHEAD);
+        if (ret < 0)
+            goto out;
+
+        uint32_t peer;
+        ret = check_record_seq(stream, hdr, &peer);
+        if (ret < 0)
+            goto out;
+
+        uint8_t* ciphertext = stream->recv_buf + sizeof(*hdr);
+        uint32_t size = hdr->size;
+
+        /* decrypt directly into the caller's buffer if the record fits */
+        bool direct = count >= size;
+        ret = open_record(stream, hdr, ciphertext, direct ? buffer : ciphertext);
+        if (ret < 0)
+            goto out;
+
+        if (peer == stream->npeers) {
+            stream->peers[peer].writer = hdr->writer;
+            stream->npeers++;
+        }
+        stream->peers[peer].seq = hdr->seq;
+        stream->recv_len = 0;
+
+        if (direct) {
+            ret = size;
+            goto out;
+        }
+
+        stream->plain_pos = sizeof(*hdr);
+        stream->plain_end = sizeof(*hdr) + size;
+    }
+
+    uint32_t bytes = stream->plain_end - stream->plain_pos;
+    if (bytes > count)
+        bytes = count;
+
+    memcpy(buffer, stream->recv_buf + stream->plain_pos, bytes);
+    stream->plain_pos += bytes;
+    ret = bytes;
+out:
+    _DkInternalUnlock(&stream->recv_lock);
+    return ret;
+}
+
+struct secure_stream* _DkStreamSecureHandle(PAL_HANDLE handle) {
+    switch (PAL_GET_TYPE(handle)) {
+        case pal_type_pipe:
+        case pal_type_pipecli:
+            return handle->pipe.secure;
+        case pal_type_pipeprv:
+            return handle->pipeprv.secure;
+        case pal_type_process:
+            return handle->process.secure;
+        default:
+            return NULL;
+    }
+}
+
+bool _DkStreamSecurePending(struct secure_stream* stream) {
+    return stream->plain_pos != stream->plain_end;
+}
+
+uint32_t _DkStreamSecureSealSize(uint32_t size) {
+    return size + SECURE_RECORD_OVERHEAD;
+}
+
+int _DkStreamSecureSeal(struct secure_stream* stream, const void* data, uint32_t size,
+                        void* sealed) {
+    _DkInternalLock(&stream->send_lock);
+    int ret = seal_record(stream, SECURE_RECORD_CARGO, stream->cargo_seq++, data, size, sealed);
+    _DkInternalUnlock(&stream->send_lock);
+    return ret;
+}
+
+int _DkStreamSecureUnseal(struct secure_stream* stream, void* sealed, uint32_t size,
+                          void** data) {
+    struct secure_record_header hdr;
+
+    if (size < SECURE_RECORD_OVERHEAD)
+        return -PAL_ERROR_DENIED;
+
+    memcpy(&hdr, sealed, sizeof(hdr));
+    if (hdr.flags != SECURE_RECORD_CARGO || hdr.size != size - SECURE_RECORD_OVERHEAD)
+        return -PAL_ERROR_DENIED;
+
+    uint8_t* ciphertext = sealed + sizeof(hdr);
+    int ret = open_record(stream, &hdr, ciphertext, ciphertext);
+    if (ret < 0)
+        return ret;
+
+    *data = ciphertext;
+    return hdr.size;
+}
+
+uint32_t _DkStreamSecureStateSize(void) {
+    return sizeof(struct secure_stream_state);
+}
+
+/* A handle is only sent once its handshake is over: if the copies of the
+ * handle both waited for the server nonce, only one of them would get it. */
+int _DkStreamSecureSerialize(struct secure_stream* stream, int fd, void* data) {
+    int ret = _DkStreamSecureFinish(stream, fd);
+    if (ret < 0)
+        return ret;
+
+    struct secure_stream_state* state = data;
+    memcpy(state->send_key, stream->send_key, sizeof(state->send_key));
+    memcpy(state->recv_key, stream->recv_key, sizeof(state->recv_key));
+
+    _DkInternalLock(&stream->recv_lock);
+    stream->shared = true;
+    uint32_t first = stream->npeers > SECURE_STATE_PEERS ? stream->npeers - SECURE_STATE_PEERS : 0;
+    state->npeers = stream->npeers - first;
+    memcpy(state->peers, stream->peers + first, state->npeers * sizeof(state->peers[0]));
+    _DkInternalUnlock(&stream->recv_lock);
+    return 0;
+}
+
+/* Buffered plaintext stays with the original handle, as if it had already
+ * been read. The new copy writes as a new writer. */
+int _DkStreamSecureDeserialize(const void* data, struct secure_stream** stream) {
+    const struct secure_stream_state* state = data;
+
+    struct secure_stream* new = alloc_secure_stream();
+    if (!new)
+        return -PAL_ERROR_NOMEM;
+
+    memcpy(new->send_key, state->send_key, sizeof(new->send_key));
+    memcpy(new->recv_key, state->recv_key, sizeof(new->recv_key));
+    new->shared = true;
+
+    if (state->npeers > SECURE_STATE_PEERS) {
+        free(new);
+        return -PAL_ERROR_DENIED;
+    }
+
+    if (state->npeers) {
+        new->peers = malloc(state->npeers * sizeof(*new->peers));
+        if (!new->peers) {
+            free(new);
+            return -PAL_ERROR_NOMEM;
+        }
+        memcpy(new->peers, state->peers, state->npeers * sizeof(*new->peers));
+        new->npeers = new->peers_size = state->npeers;
+    }
+
+    int ret = setup_keys(new);
+    if (ret < 0) {
+        free(new->peers);
+        free(new);
+        return ret;
+    }
+
+    *stream = new;
+    return 0;
+}
+
+void _DkStreamSecureFree(struct secure_stream* stream) {
+    if (stream->send_buf)
+        ocall_unmap_untrusted(stream->send_buf, ALLOC_ALIGNUP(SECURE_BATCH_SIZE));
+    if (stream->recv_buf)
+        free(stream->recv_buf);
+    if (stream->peers)
+        free(stream->peers);
+
+    if (!stream->handshake) {
+        lib_AESGCMFinal(&stream->send_ctx);
+        lib_AESGCMFinal(&stream->recv_ctx);
+    }
+
+    memset(stream, 0, sizeof(*stream));
+    free(stream);
+}
@@ -30,6 +30,8 @@ enum {
     OCALL_CLOSE,
     OCALL_READ,
     OCALL_WRITE,
+    OCALL_PREAD,
+    OCALL_PWRITE,
     OCALL_FSTAT,
     OCALL_FIONREAD,
     OCALL_FSETNONBLOCK,
@@ -48,6 +50,8 @@ enum {
     OCALL_SOCK_CONNECT,
     OCALL_SOCK_RECV,
     OCALL_SOCK_SEND,
+    OCALL_SOCK_RECV_BATCH,
+    OCALL_SOCK_SEND_BATCH,
     OCALL_SOCK_RECV_FD,
     OCALL_SOCK_SEND_FD,
     OCALL_SOCK_SETOPT,
@@ -59,6 +63,8 @@ enum {
     OCALL_DELETE,
     OCALL_LOAD_DEBUG,
     OCALL_GET_ATTESTATION,
+    OCALL_MPROTECT,
+    OCALL_GET_FAULT_ADDR,
     OCALL_NR,
 };
 
@@ -118,6 +124,20 @@ typedef struct {
     unsigned int ms_count;
 } ms_ocall_write_t;
 
+typedef struct {
+    int ms_fd;
+    void * ms_buf;
+    unsigned int ms_count;
+    uint64_t ms_offset;
+} ms_ocall_pread_t;
+
+typedef struct {
+    int ms_fd;
+    const void * ms_buf;
+    unsigned int ms_count;
+    uint64_t ms_offset;
+} ms_ocall_pwrite_t;
+
 typedef struct {
     int ms_fd;
     struct stat ms_stat;
@@ -221,6 +241,18 @@ typedef struct {
     unsigned int ms_addrlen;
 } ms_ocall_sock_send_t;
 
+typedef struct {
+    PAL_IDX ms_sockfd;
+    struct mmsghdr * ms_msgs;
+    unsigned int ms_count;
+} ms_ocall_sock_recv_batch_t;
+
+typedef struct {
+    PAL_IDX ms_sockfd;
+    struct mmsghdr * ms_msgs;
+    unsigned int ms_count;
+} ms_ocall_sock_send_batch_t;
+
 typedef struct {
     int ms_sockfd;
     void * ms_buf;
@@ -251,7 +283,7 @@ typedef struct {
 } ms_ocall_sock_shutdown_t;
 
 typedef struct {
-    unsigned long ms_microsec;
+    unsigned long ms_nanosec;
 } ms_ocall_gettime_t;
 
 typedef struct {
@@ -286,4 +318,14 @@ typedef struct {
     sgx_attestation_t ms_attestation;
 } ms_ocall_get_attestation_t;
 
+typedef struct {
+    void * ms_addr;
+    uint64_t ms_size;
+    int ms_prot;
+} ms_ocall_mprotect_t;
+
+typedef struct {
+    void * ms_addr;
+} ms_ocall_get_fault_addr_t;
+
 #pragma pack(pop)
@@ -79,6 +79,7 @@ struct pal_handle_thread {
 /* RPC streams are encrypted with 256-bit AES keys */
 typedef uint8_t PAL_SESSION_KEY[32];
 
+DEFINE_LIST(pal_handle);
 typedef struct pal_handle
 {
     /*
@@ -96,7 +97,9 @@ typedef struct pal_handle
             PAL_IDX fd;
             PAL_STR realpath;
             PAL_NUM total;
-            PAL_NUM offset;
+            PAL_PTR buffer;         /* struct file_buffer, NULL if unbuffered */
+            PAL_LOCK buffer_lock;
+            LIST_TYPE(pal_handle) buffered; /* on the list of buffered files */
             /* below fields are used only for trusted files */
             PAL_PTR stubs;    /* contains hashes of file chunks */
             PAL_PTR umem;     /* valid only when stubs != NULL */
@@ -106,11 +109,13 @@ typedef struct pal_handle
             PAL_IDX fd;
             PAL_NUM pipeid;
             PAL_BOL nonblocking;
+            PAL_PTR secure;
         } pipe;
 
         struct {
             PAL_IDX fds[MAX_FDS];
             PAL_BOL nonblocking;
+            PAL_PTR secure;
         } pipeprv;
 
         struct {
@@ -154,6 +159,7 @@ typedef struct pal_handle
             PAL_IDX pid;
             PAL_BOL nonblocking;
             PAL_SESSION_KEY session_key;
+            PAL_PTR secure;
         } process;
 
         struct {
@@ -180,6 +186,7 @@ typedef struct pal_handle
         };
     };
 } * PAL_HANDLE;
+DEFINE_LISTP(pal_handle);
 
 #define RFD(n)          (1 << (MAX_FDS*0 + (n)))
 #define WFD(n)          (1 << (MAX_FDS*1 + (n)))
@@ -142,12 +142,62 @@ int copy_and_verify_trusted_file (const char * path, const void * umem,
                     void * buffer, uint64_t offset, uint64_t size,
                     sgx_stub_t * stubs, uint64_t total_size);
 
+int init_lazy_trusted_mmap (void);
+bool lazy_trusted_mmap (uint64_t size);
+int map_trusted_file_lazily (const char * path, int fd, sgx_stub_t * stubs,
+                             uint64_t total, void * mem, uint64_t offset,
+                             uint64_t size);
+bool handle_lazy_trusted_map_fault (void);
+void release_lazy_trusted_maps (void * addr, uint64_t size);
+
+/* set up the buffering of an allowed "file:" handle as configured in the
+   manifest, and write out its buffered writes (see file_buffer.h) */
+void file_init_buffer (PAL_HANDLE handle);
+int file_flush_buffer (PAL_HANDLE handle);
+
+/* write out the buffered writes of all file handles, at exit */
+void file_flush_buffers (void);
+
 int init_trusted_children (void);
 int register_trusted_child (const char * uri, const char * mr_enclave_str);
 
 /* exchange and establish a 256-bit session key */
 int _DkStreamKeyExchange(PAL_HANDLE stream, PAL_SESSION_KEY* key);
 
+/*
+ * Record layer for process and pipe streams (enclave_stream.c). A stream is
+ * encrypted once its handle has a struct secure_stream; _DkStreamSecureRead()
+ * and _DkStreamSecureWrite() then replace the plain reads and writes on the
+ * file descriptor.
+ */
+struct secure_stream;
+
+#define SECURE_STREAM_CLIENT    0
+#define SECURE_STREAM_SERVER    1
+#define SECURE_STREAM_LOOPBACK  2   /* both ends in this enclave */
+
+/* key of all the pipes of the application, created by the first process */
+extern PAL_SESSION_KEY pipe_master_key;
+
+int _DkStreamSecureInit(const PAL_SESSION_KEY* key, int role, struct secure_stream** stream);
+int _DkStreamSecureClient(int fd, struct secure_stream** stream);
+int _DkStreamSecureServer(int fd, struct secure_stream** stream);
+int _DkStreamSecureFinish(struct secure_stream* stream, int fd);
+int64_t _DkStreamSecureRead(struct secure_stream* stream, int fd, void* buffer, uint64_t count);
+int64_t _DkStreamSecureWrite(struct secure_stream* stream, int fd, const void* buffer,
+                             uint64_t count);
+struct secure_stream* _DkStreamSecureHandle(PAL_HANDLE handle);
+bool _DkStreamSecurePending(struct secure_stream* stream);
+uint32_t _DkStreamSecureSealSize(uint32_t size);
+int _DkStreamSecureSeal(struct secure_stream* stream, const void* data, uint32_t size,
+                        void* sealed);
+int _DkStreamSecureUnseal(struct secure_stream* stream, void* sealed, uint32_t size,
+                          void** data);
+uint32_t _DkStreamSecureStateSize(void);
+int _DkStreamSecureSerialize(struct secure_stream* stream, int fd, void* data);
+int _DkStreamSecureDeserialize(const void* data, struct secure_stream** stream);
+void _DkStreamSecureFree(struct secure_stream* stream);
+
 typedef uint8_t sgx_sign_data_t[48];
 
 /* enclave state used for generating report */
@@ -145,6 +145,24 @@ static int sgx_ocall_write(void * pms)
     return ret;
 }
 
+static int sgx_ocall_pread(void * pms)
+{
+    ms_ocall_pread_t * ms = (ms_ocall_pread_t *) pms;
+    int ret;
+    ODEBUG(OCALL_PREAD, ms);
+    ret = INLINE_SYSCALL(pread64, 4, ms->ms_fd, ms->ms_buf, ms->ms_count, ms->ms_offset);
+    return ret;
+}
+
+static int sgx_ocall_pwrite(void * pms)
+{
+    ms_ocall_pwrite_t * ms = (ms_ocall_pwrite_t *) pms;
+    int ret;
+    ODEBUG(OCALL_PWRITE, ms);
+    ret = INLINE_SYSCALL(pwrite64, 4, ms->ms_fd, ms->ms_buf, ms->ms_count, ms->ms_offset);
+    return ret;
+}
+
 static int sgx_ocall_fstat(void * pms)
 {
     ms_ocall_fstat_t * ms = (ms_ocall_fstat_t *) pms;
@@ -479,6 +497,24 @@ static int sgx_ocall_sock_send(void * pms)
     return ret;
 }
 
+static int sgx_ocall_sock_recv_batch(void * pms)
+{
+    ms_ocall_sock_recv_batch_t * ms = (ms_ocall_sock_recv_batch_t *) pms;
+    ODEBUG(OCALL_SOCK_RECV_BATCH, ms);
+
+    return INLINE_SYSCALL(recvmmsg, 5, ms->ms_sockfd, ms->ms_msgs, ms->ms_count,
+                          MSG_WAITFORONE, NULL);
+}
+
+static int sgx_ocall_sock_send_batch(void * pms)
+{
+    ms_ocall_sock_send_batch_t * ms = (ms_ocall_sock_send_batch_t *) pms;
+    ODEBUG(OCALL_SOCK_SEND_BATCH, ms);
+
+    return INLINE_SYSCALL(sendmmsg, 4, ms->ms_sockfd, ms->ms_msgs, ms->ms_count,
+                          MSG_NOSIGNAL);
+}
+
 static int sgx_ocall_sock_recv_fd(void * pms)
 {
     ms_ocall_sock_recv_fd_t * ms = (ms_ocall_sock_recv_fd_t *) pms;
@@ -599,9 +635,9 @@ static int sgx_ocall_gettime(void * pms)
 {
     ms_ocall_gettime_t * ms = (ms_ocall_gettime_t *) pms;
     ODEBUG(OCALL_GETTIME, ms);
-    struct timeval tv;
-    INLINE_SYSCALL(gettimeofday, 2, &tv, NULL);
-    ms->ms_microsec = tv.tv_sec * 1000000UL + tv.tv_usec;
+    struct timespec ts;
+    INLINE_SYSCALL(clock_gettime, 2, CLOCK_REALTIME, &ts);
+    ms->ms_nanosec = ts.tv_sec * 1000000000UL + ts.tv_nsec;
     return 0;
 }
 
@@ -687,6 +723,21 @@ static int sgx_ocall_get_attestation(void* pms) {
                                    &ms->ms_nonce, &ms->ms_attestation);
 }
 
+static int sgx_ocall_mprotect(void * pms)
+{
+    ms_ocall_mprotect_t * ms = (ms_ocall_mprotect_t *) pms;
+    ODEBUG(OCALL_MPROTECT, ms);
+    return INLINE_SYSCALL(mprotect, 3, ms->ms_addr, ms->ms_size, ms->ms_prot);
+}
+
+static int sgx_ocall_get_fault_addr(void * pms)
+{
+    ms_ocall_get_fault_addr_t * ms = (ms_ocall_get_fault_addr_t *) pms;
+    ODEBUG(OCALL_GET_FAULT_ADDR, ms);
+    ms->ms_addr = last_fault_addr;
+    return 0;
+}
+
 sgx_ocall_fn_t ocall_table[OCALL_NR] = {
         [OCALL_EXIT]            = sgx_ocall_exit,
         [OCALL_PRINT_STRING]    = sgx_ocall_print_string,
@@ -698,6 +749,8 @@ sgx_ocall_fn_t ocall_table[OCALL_NR] = {
         [OCALL_CLOSE]           = sgx_ocall_close,
         [OCALL_READ]            = sgx_ocall_read,
         [OCALL_WRITE]           = sgx_ocall_write,
+        [OCALL_PREAD]           = sgx_ocall_pread,
+        [OCALL_PWRITE]          = sgx_ocall_pwrite,
         [OCALL_FSTAT]           = sgx_ocall_fstat,
         [OCALL_FIONREAD]        = sgx_ocall_fionread,
         [OCALL_FSETNONBLOCK]    = sgx_ocall_fsetnonblock,
@@ -716,6 +769,8 @@ sgx_ocall_fn_t ocall_table[OCALL_NR] = {
         [OCALL_SOCK_CONNECT]    = sgx_ocall_sock_connect,
         [OCALL_SOCK_RECV]       = sgx_ocall_sock_recv,
         [OCALL_SOCK_SEND]       = sgx_ocall_sock_send,
+        [OCALL_SOCK_RECV_BATCH] = sgx_ocall_sock_recv_batch,
+        [OCALL_SOCK_SEND_BATCH] = sgx_ocall_sock_send_batch,
         [OCALL_SOCK_RECV_FD]    = sgx_ocall_sock_recv_fd,
         [OCALL_SOCK_SEND_FD]    = sgx_ocall_sock_send_fd,
         [OCALL_SOCK_SETOPT]     = sgx_ocall_sock_setopt,
@@ -727,6 +782,8 @@ sgx_ocall_fn_t ocall_table[OCALL_NR] = {
         [OCALL_DELETE]          = sgx_ocall_delete,
         [OCALL_LOAD_DEBUG]      = sgx_ocall_load_debug,
         [OCALL_GET_ATTESTATION] = sgx_ocall_get_attestation,
+        [OCALL_MPROTECT]        = sgx_ocall_mprotect,
+        [OCALL_GET_FAULT_ADDR]  = sgx_ocall_get_fault_addr,
     };
 
 #define EDEBUG(code, ms) do {} while (0)
@@ -208,11 +208,11 @@ static void _DkTerminateSighandler (int signum, siginfo_t * info,
     }
 }
 
+__thread void * last_fault_addr;
+
 static void _DkResumeSighandler (int signum, siginfo_t * info,
                                  struct ucontext * uc)
 {
-    __UNUSED(info);
-
     unsigned long rip = uc->uc_mcontext.gregs[REG_RIP];
 
     if (rip != (unsigned long) async_exit_pointer) {
@@ -236,6 +236,9 @@ static void _DkResumeSighandler (int signum, siginfo_t * info,
         INLINE_SYSCALL(exit, 1, 1);
     }
 
+    if (signum == SIGSEGV || signum == SIGBUS)
+        last_fault_addr = info->si_addr;
+
     int event = get_event_num(signum);
     sgx_raise(event);
 }
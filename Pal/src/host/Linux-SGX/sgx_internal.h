@@ -134,6 +134,10 @@ extern __thread sgx_arch_tcs_t * current_tcs
 extern __thread unsigned long debug_register
             __attribute__((tls_model ("initial-exec")));
 
+/* address of the last SIGSEGV/SIGBUS in the enclave, for OCALL_GET_FAULT_ADDR */
+extern __thread void * last_fault_addr
+            __attribute__((tls_model ("initial-exec")));
+
 uint64_t sgx_edbgrd (void * addr);
 void sgx_edbgwr (void * addr, uint64_t data);
 
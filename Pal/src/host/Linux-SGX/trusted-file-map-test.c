@@ -0,0 +1,220 @@
+/* Copyright (C) 2014 Stony Brook University
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * Test of the chunk tracking of lazy trusted file mappings
+ * (trusted_file_map.c). It maps a generated file into a buffer which stands in
+ * for the enclave pages, fills chunks on simulated faults and checks them
+ * against per-chunk checksums the way the enclave checks the stubs, then
+ * releases ranges as munmap() and mmap(MAP_FIXED) do. It runs on the host,
+ * outside of Graphene:
+ *
+ *   gcc -O2 -fno-builtin -I. -I../../../lib trusted-file-map-test.c trusted_file_map.c \
+ *       -o trusted-file-map-test
+ *   ./trusted-file-map-test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trusted_file_map.h"
+
+#define PAGE  4096UL
+#define CHUNK (PAGE * 4)
+
+static unsigned char* file;
+static uint64_t file_size;
+static uint32_t* checksums;     /* of each chunk of the file */
+
+struct test_map {
+    unsigned char* mem;         /* stands in for the enclave pages */
+    int fills, drops;
+    int corrupt;                /* chunk of the file to corrupt, or -1 */
+};
+
+static void check(int ok, const char* what) {
+    if (!ok) {
+        printf("%s failed\n", what);
+        exit(1);
+    }
+}
+
+static uint32_t checksum(const unsigned char* data, uint64_t size) {
+    uint32_t sum = 2166136261u;
+    for (uint64_t i = 0; i < size; i++)
+        sum = (sum ^ data[i]) * 16777619u;
+    return sum;
+}
+
+/* Checks the whole file chunk and copies the mapped part of it, as
+ * copy_and_verify_trusted_file() does in the enclave */
+static int fill(void* arg, uint64_t idx, uintptr_t addr, uint64_t size, uint64_t file_offset) {
+    struct test_map* t = arg;
+    (void)idx;
+
+    uint64_t chunk = file_offset / CHUNK;
+    uint64_t chunk_start = chunk * CHUNK;
+    uint64_t chunk_size = file_size - chunk_start < CHUNK ? file_size - chunk_start : CHUNK;
+
+    unsigned char copy[CHUNK];
+    memcpy(copy, file + chunk_start, chunk_size);
+    if ((int)chunk == t->corrupt)
+        copy[0] ^= 1;
+    if (checksum(copy, chunk_size) != checksums[chunk])
+        return -1;
+
+    uint64_t copy_size = chunk_start + chunk_size - file_offset;
+    if (copy_size > size)
+        copy_size = size;
+    memcpy((void*)addr, copy + (file_offset - chunk_start), copy_size);
+    memset((void*)addr + copy_size, 0, size - copy_size);
+    t->fills++;
+    return 0;
+}
+
+static void drop(void* arg, uint64_t idx, uintptr_t addr, uint64_t size) {
+    struct test_map* t = arg;
+    (void)idx;
+    memset((void*)addr, 0xdd, size);
+    t->drops++;
+}
+
+static struct trusted_file_map* new_map(struct test_map* t, uint64_t offset, uint64_t size) {
+    t->mem = malloc(size);
+    check(!!t->mem, "malloc");
+    memset(t->mem, 0xee, size);
+    t->fills = t->drops = 0;
+    t->corrupt = -1;
+
+    uintptr_t start = (uintptr_t)t->mem;
+    struct trusted_file_map* map = malloc(trusted_file_map_size(start, start + size, offset,
+                                                                file_size, CHUNK));
+    check(!!map, "malloc");
+    trusted_file_map_init(map, start, start + size, offset, file_size, CHUNK);
+    return map;
+}
+
+/* The mapped bytes at [from, to) of the map match the file (zeroes past its end) */
+static int matches(struct test_map* t, struct trusted_file_map* map, uint64_t from, uint64_t to) {
+    for (uint64_t i = from; i < to; i++) {
+        uint64_t off = map->offset + i;
+        unsigned char expected = off < file_size ? file[off] : 0;
+        if (t->mem[i] != expected)
+            return 0;
+    }
+    return 1;
+}
+
+int main(void) {
+    file_size = CHUNK * 10 + 1000;
+    file = malloc(file_size);
+    checksums = malloc(sizeof(uint32_t) * 11);
+    check(file && checksums, "malloc");
+    for (uint64_t i = 0; i < file_size; i++)
+        file[i] = (unsigned char)(i * 7 + i / 251);
+    for (uint64_t c = 0; c * CHUNK < file_size; c++)
+        checksums[c] = checksum(file + c * CHUNK,
+                                file_size - c * CHUNK < CHUNK ? file_size - c * CHUNK : CHUNK);
+
+    struct test_map t;
+
+    /* mapping of the whole file: one chunk per fault, nothing else touched */
+    uint64_t size = CHUNK * 11;
+    struct trusted_file_map* map = new_map(&t, 0, size);
+    check(map->nchunks == 11 && map->pending == 11, "chunk count of whole file");
+
+    check(trusted_file_map_fault(map, map->start + CHUNK * 3 + 5, fill, &t) == 1, "first fault");
+    check(trusted_file_map_filled(map, 3) && map->pending == 10, "bitmap after fault");
+    check(matches(&t, map, CHUNK * 3, CHUNK * 4), "content of faulted chunk");
+    check(t.mem[CHUNK * 2] == 0xee && t.mem[CHUNK * 4] == 0xee, "neighbours untouched");
+    check(trusted_file_map_fault(map, map->start + CHUNK * 4 - 1, fill, &t) == 0,
+          "fault on filled chunk");
+    check(trusted_file_map_fault(map, map->end, fill, &t) == 0, "fault outside of map");
+    check(t.fills == 1, "fill count");
+
+    /* last chunk: partial file chunk, zeroes up to the end of the mapping */
+    check(trusted_file_map_fault(map, map->end - 1, fill, &t) == 1, "fault past end of file");
+    check(matches(&t, map, CHUNK * 10, size), "content of last chunk");
+
+    /* a chunk which does not verify stays unfilled */
+    t.corrupt = 7;
+    check(trusted_file_map_fault(map, map->start + CHUNK * 7, fill, &t) < 0, "corrupt chunk");
+    check(!trusted_file_map_filled(map, 7), "corrupt chunk unfilled");
+    t.corrupt = -1;
+    check(trusted_file_map_fault(map, map->start + CHUNK * 7, fill, &t) == 1, "retry chunk");
+
+    for (uint64_t c = 0; c < 11; c++)
+        trusted_file_map_fault(map, map->start + CHUNK * c, fill, &t);
+    check(map->pending == 0 && matches(&t, map, 0, size), "all chunks filled");
+    check(t.fills == 11, "every chunk filled once");
+    free(map);
+    free(t.mem);
+
+    /* mapping at an offset inside of a chunk, shorter than the file */
+    uint64_t offset = CHUNK * 2 + PAGE;
+    size = CHUNK * 3;
+    map = new_map(&t, offset, size);
+    check(map->first_chunk == 2 && map->nchunks == 4, "chunk count of unaligned map");
+
+    uintptr_t addr;
+    uint64_t chunk_size, file_offset;
+    trusted_file_map_chunk(map, 0, &addr, &chunk_size, &file_offset);
+    check(addr == map->start && chunk_size == CHUNK - PAGE && file_offset == offset,
+          "first partial chunk");
+    trusted_file_map_chunk(map, 3, &addr, &chunk_size, &file_offset);
+    check(addr == map->start + CHUNK * 3 - PAGE && chunk_size == PAGE &&
+          file_offset == CHUNK * 5, "last partial chunk");
+
+    check(trusted_file_map_fault(map, map->start, fill, &t) == 1, "fault on first chunk");
+    check(matches(&t, map, 0, CHUNK - PAGE), "content of first chunk");
+    check(trusted_file_map_fault(map, map->end - 1, fill, &t) == 1, "fault on last chunk");
+    check(matches(&t, map, size - PAGE, size), "content of last chunk");
+
+    /* release from the middle of chunk 1 to the middle of chunk 2: both are
+       only partly released, so they get filled */
+    check(trusted_file_map_release(map, map->start + CHUNK, map->start + CHUNK * 2,
+                                   fill, drop, &t) == 0, "partial release");
+    check(t.drops == 0 && map->pending == 0, "partly released chunks filled");
+    check(matches(&t, map, 0, size), "content after partial release");
+    free(map);
+    free(t.mem);
+
+    /* munmap() of a whole range drops the chunks without reading them */
+    size = CHUNK * 8;
+    map = new_map(&t, 0, size);
+    check(trusted_file_map_release(map, map->start + CHUNK * 2, map->start + CHUNK * 5 + PAGE,
+                                   fill, drop, &t) == 0, "release");
+    check(t.drops == 3 && t.fills == 1 && map->pending == 4, "dropped and filled chunks");
+    check(matches(&t, map, CHUNK * 5, CHUNK * 6), "content of partly released chunk");
+    check(trusted_file_map_fault(map, map->start + CHUNK * 3, fill, &t) == 0,
+          "fault on dropped chunk");
+    check(trusted_file_map_release(map, map->start, map->end, fill, drop, &t) == 0 &&
+          map->pending == 0 && t.drops == 7, "release of whole map");
+    free(map);
+    free(t.mem);
+
+    /* mapping entirely past the end of the file */
+    size = CHUNK;
+    map = new_map(&t, CHUNK * 12, size);
+    check(map->nchunks == 0 && map->pending == 0, "map past end of file");
+    check(trusted_file_map_fault(map, map->start, fill, &t) == 0, "fault past end of file");
+    free(map);
+    free(t.mem);
+
+    printf("All tests passed\n");
+    return 0;
+}
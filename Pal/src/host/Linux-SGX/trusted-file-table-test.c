@@ -0,0 +1,188 @@
+/* Copyright (C) 2014 Stony Brook University
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * Test of the trusted file table (trusted_file_table.c). It builds a table of
+ * N files the way pal-sgx-sign does, checks that every file is found and
+ * that malformed tables are rejected, and times the lookups. Given a table
+ * written by pal-sgx-sign (<manifest.sgx>.trusted_files), it checks that
+ * table instead. It runs on the host, outside of Graphene:
+ *
+ *   gcc -O2 -fno-builtin -I. -I../../../lib trusted-file-table-test.c trusted_file_table.c \
+ *       -o trusted-file-table-test
+ *   ./trusted-file-table-test [entries | table]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "trusted_file_table.h"
+
+static double now_usec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000.0 + ts.tv_nsec / 1000.0;
+}
+
+static void check(int ok, const char* what) {
+    if (!ok) {
+        printf("%s failed\n", what);
+        exit(1);
+    }
+}
+
+static int compare_str(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static void* build_table(char** uris, unsigned int n, size_t* size) {
+    size_t uris_size = 0;
+    for (unsigned int i = 0; i < n; i++)
+        uris_size += strlen(uris[i]) + 1;
+
+    struct trusted_file_table_hdr hdr;
+    memcpy(hdr.magic, TRUSTED_FILE_TABLE_MAGIC, TRUSTED_FILE_TABLE_MAGIC_LEN);
+    hdr.nentries  = n;
+    hdr.uris_size = uris_size;
+
+    *size = sizeof(hdr) + sizeof(struct trusted_file_table_entry) * n + uris_size;
+    char* table = malloc(*size);
+    check(!!table, "malloc");
+    memcpy(table, &hdr, sizeof(hdr));
+
+    struct trusted_file_table_entry* entries = (void*)(table + sizeof(hdr));
+    char* strings = (char*)&entries[n];
+    uint32_t offset = 0;
+
+    for (unsigned int i = 0; i < n; i++) {
+        entries[i].uri_offset = offset;
+        entries[i].uri_len    = strlen(uris[i]);
+        entries[i].size       = i;
+        memset(entries[i].checksum, i & 0xff, sizeof(entries[i].checksum));
+        memcpy(strings + offset, uris[i], entries[i].uri_len + 1);
+        offset += entries[i].uri_len + 1;
+    }
+
+    return table;
+}
+
+static void check_table_file(const char* path) {
+    FILE* f = fopen(path, "rb");
+    check(!!f, "fopen");
+    fseek(f, 0, SEEK_END);
+    size_t size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    void* table = malloc(size);
+    check(table && fread(table, 1, size, f) == size, "fread");
+    fclose(f);
+
+    check(trusted_file_table_valid(table, size), "trusted_file_table_valid");
+
+    const struct trusted_file_table_hdr* hdr = table;
+    const struct trusted_file_table_entry* entries = table + sizeof(*hdr);
+
+    for (uint32_t i = 0; i < hdr->nentries; i++) {
+        const char* uri = trusted_file_table_uri(table, &entries[i]);
+        check(trusted_file_table_lookup(table, uri, strlen(uri)) == &entries[i],
+              "lookup of a listed file");
+        printf("%10lu %s\n", (unsigned long)entries[i].size, uri);
+    }
+
+    printf("%u files OK\n", hdr->nentries);
+    free(table);
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && (argv[1][0] < '0' || argv[1][0] > '9')) {
+        check_table_file(argv[1]);
+        return 0;
+    }
+
+    unsigned int n = argc > 1 ? atoi(argv[1]) : 10000;
+    check(n > 0, "entries");
+
+    /* "file:/usr/lib/libN.so" and a prefix of each, "file:/usr/lib/libN" */
+    char** uris = malloc(sizeof(char*) * n);
+    check(!!uris, "malloc");
+    for (unsigned int i = 0; i < n; i++) {
+        uris[i] = malloc(64);
+        check(!!uris[i], "malloc");
+        snprintf(uris[i], 64, i % 2 ? "file:/usr/lib/lib%u" : "file:/usr/lib/lib%u.so", i / 2);
+    }
+    qsort(uris, n, sizeof(char*), compare_str);
+
+    size_t size;
+    void* table = build_table(uris, n, &size);
+    check(trusted_file_table_valid(table, size), "trusted_file_table_valid");
+
+    double start = now_usec();
+    for (unsigned int i = 0; i < n; i++) {
+        const struct trusted_file_table_entry* e =
+            trusted_file_table_lookup(table, uris[i], strlen(uris[i]));
+        check(e && !strcmp(trusted_file_table_uri(table, e), uris[i]), "lookup");
+    }
+    double lookup = now_usec() - start;
+
+    check(!trusted_file_table_lookup(table, "file:/usr/lib/lib", 17), "lookup of a prefix");
+    check(!trusted_file_table_lookup(table, "file:/usr/lib/lib0.sox", 22), "lookup of a longer URI");
+    check(!trusted_file_table_lookup(table, "file:", 5), "lookup of an empty path");
+
+    /* what register_trusted_file() did for every file at startup */
+    unsigned int duplicates = 0;
+    start = now_usec();
+    for (unsigned int i = 0; i < n; i++)
+        for (unsigned int j = 0; j < i; j++)
+            if (!strcmp(uris[j], uris[i])) {
+                duplicates++;
+                break;
+            }
+    double scan = now_usec() - start;
+    check(!duplicates, "duplicate scan");
+
+    /* malformed tables */
+    check(!trusted_file_table_valid(table, size - 1), "truncated table");
+    check(!trusted_file_table_valid(table, sizeof(struct trusted_file_table_hdr) - 1),
+          "truncated header");
+
+    struct trusted_file_table_entry* entries = table + sizeof(struct trusted_file_table_hdr);
+    if (n > 1) {
+        struct trusted_file_table_entry tmp = entries[0];
+        entries[0] = entries[1];
+        entries[1] = tmp;
+        check(!trusted_file_table_valid(table, size), "unsorted table");
+        entries[1] = entries[0];
+        entries[0] = tmp;
+        check(trusted_file_table_valid(table, size), "restored table");
+    }
+
+    entries[n - 1].uri_len += 1;
+    check(!trusted_file_table_valid(table, size), "URI out of bounds");
+    entries[n - 1].uri_len -= 1;
+
+    ((char*)table)[0] ^= 1;
+    check(!trusted_file_table_valid(table, size), "bad magic");
+
+    printf("%u files, %lu bytes: %.3f us per lookup, %.0f us for a startup duplicate scan\n",
+           n, (unsigned long)size, lookup / n, scan);
+
+    free(table);
+    for (unsigned int i = 0; i < n; i++)
+        free(uris[i]);
+    free(uris);
+    return 0;
+}
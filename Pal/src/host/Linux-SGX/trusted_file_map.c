@@ -0,0 +1,144 @@
+/* Copyright (C) 2014 Stony Brook University
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * trusted_file_map.c
+ *
+ * Chunk tracking of lazy trusted file mappings (see trusted_file_map.h).
+ * This file only depends on memset(), so it is also built on the host by
+ * trusted-file-map-test.c.
+ */
+
+#include <api.h>
+
+#include "trusted_file_map.h"
+
+/* File chunks touched by [start, end) at 'offset'; the last one also holds
+ * the mapped pages past the end of the file */
+static uint64_t count_chunks(uintptr_t start, uintptr_t end, uint64_t offset,
+                             uint64_t file_size, uint64_t chunk_size) {
+    uint64_t file_end = offset + (end - start);
+    if (file_end > file_size)
+        file_end = file_size;
+    if (file_end <= offset)
+        return 0;
+    return (file_end + chunk_size - 1) / chunk_size - offset / chunk_size;
+}
+
+size_t trusted_file_map_size(uintptr_t start, uintptr_t end, uint64_t offset,
+                             uint64_t file_size, uint64_t chunk_size) {
+    uint64_t nchunks = count_chunks(start, end, offset, file_size, chunk_size);
+    return sizeof(struct trusted_file_map) + sizeof(uint64_t) * ((nchunks + 63) / 64);
+}
+
+void trusted_file_map_init(struct trusted_file_map* map, uintptr_t start, uintptr_t end,
+                           uint64_t offset, uint64_t file_size, uint64_t chunk_size) {
+    map->start       = start;
+    map->end         = end;
+    map->offset      = offset;
+    map->file_size   = file_size;
+    map->chunk_size  = chunk_size;
+    map->first_chunk = offset / chunk_size;
+    map->nchunks     = count_chunks(start, end, offset, file_size, chunk_size);
+    map->pending     = map->nchunks;
+    memset(map->bitmap, 0, sizeof(uint64_t) * ((map->nchunks + 63) / 64));
+}
+
+void trusted_file_map_chunk(const struct trusted_file_map* map, uint64_t idx,
+                            uintptr_t* addr, uint64_t* size, uint64_t* file_offset) {
+    uint64_t chunk_start = (map->first_chunk + idx) * map->chunk_size;
+    uint64_t chunk_end   = chunk_start + map->chunk_size;
+
+    if (chunk_start < map->offset)
+        chunk_start = map->offset;
+
+    uintptr_t chunk_addr = map->start + (chunk_start - map->offset);
+    uintptr_t chunk_addr_end = map->start + (chunk_end - map->offset);
+
+    /* the last chunk runs to the end of the mapping */
+    if (idx == map->nchunks - 1 || chunk_addr_end > map->end)
+        chunk_addr_end = map->end;
+
+    *addr        = chunk_addr;
+    *size        = chunk_addr_end - chunk_addr;
+    *file_offset = chunk_start;
+}
+
+/* Chunk holding 'addr', which must be within the map */
+static uint64_t chunk_of(const struct trusted_file_map* map, uintptr_t addr) {
+    uint64_t idx = (map->offset + (addr - map->start)) / map->chunk_size - map->first_chunk;
+    return idx < map->nchunks ? idx : map->nchunks - 1;
+}
+
+static void set_filled(struct trusted_file_map* map, uint64_t idx) {
+    map->bitmap[idx / 64] |= 1ULL << (idx % 64);
+    map->pending--;
+}
+
+int trusted_file_map_fault(struct trusted_file_map* map, uintptr_t addr,
+                           trusted_file_map_fill_t fill, void* arg) {
+    if (!trusted_file_map_contains(map, addr) || !map->nchunks)
+        return 0;
+
+    uint64_t idx = chunk_of(map, addr);
+    if (trusted_file_map_filled(map, idx))
+        return 0;
+
+    uintptr_t chunk_addr;
+    uint64_t chunk_size, file_offset;
+    trusted_file_map_chunk(map, idx, &chunk_addr, &chunk_size, &file_offset);
+
+    int ret = fill(arg, idx, chunk_addr, chunk_size, file_offset);
+    if (ret < 0)
+        return ret;
+
+    set_filled(map, idx);
+    return 1;
+}
+
+int trusted_file_map_release(struct trusted_file_map* map, uintptr_t start, uintptr_t end,
+                             trusted_file_map_fill_t fill, trusted_file_map_drop_t drop,
+                             void* arg) {
+    if (start < map->start)
+        start = map->start;
+    if (end > map->end)
+        end = map->end;
+    if (start >= end || !map->nchunks)
+        return 0;
+
+    uint64_t last = chunk_of(map, end - 1);
+
+    for (uint64_t idx = chunk_of(map, start); idx <= last && map->pending; idx++) {
+        if (trusted_file_map_filled(map, idx))
+            continue;
+
+        uintptr_t chunk_addr;
+        uint64_t chunk_size, file_offset;
+        trusted_file_map_chunk(map, idx, &chunk_addr, &chunk_size, &file_offset);
+
+        if (chunk_addr >= start && chunk_addr + chunk_size <= end) {
+            drop(arg, idx, chunk_addr, chunk_size);
+        } else {
+            int ret = fill(arg, idx, chunk_addr, chunk_size, file_offset);
+            if (ret < 0)
+                return ret;
+        }
+
+        set_filled(map, idx);
+    }
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+/* Copyright (C) 2014 Stony Brook University
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * trusted_file_map.h
+ *
+ * Chunk tracking of lazy trusted file mappings. When the manifest sets
+ * "sgx.lazy_trusted_mmap = 1", file_map() only reserves the enclave pages of a
+ * large mapping of a trusted file and has the host deny access to them. The
+ * first access to a page faults, and the exception handler copies in and
+ * verifies the file chunk (TRUSTED_STUB_SIZE bytes of the file) holding the
+ * page, and lets the host map it again. A bitmap records which chunks of the
+ * mapping are filled.
+ *
+ * A chunk of the mapping is the part of a file chunk which lies within the
+ * mapping; the first and the last one may be shorter than a file chunk.
+ * Mapped pages past the end of the file belong to the last chunk.
+ *
+ * The functions here do not lock; the caller serializes the calls on one map.
+ */
+
+#ifndef TRUSTED_FILE_MAP_H
+#define TRUSTED_FILE_MAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct trusted_file_map {
+    uintptr_t start, end;       /* mapped enclave range */
+    uint64_t  offset;           /* file offset at start */
+    uint64_t  file_size;
+    uint64_t  chunk_size;       /* TRUSTED_STUB_SIZE in the enclave */
+    uint64_t  first_chunk;      /* file chunk holding offset */
+    uint64_t  nchunks;
+    uint64_t  pending;          /* chunks not filled yet */
+    uint64_t  bitmap[];         /* a set bit marks a filled chunk */
+};
+
+/* Fills chunk 'idx' at [addr, addr + size) from the file at 'file_offset',
+ * and zeroes the part past the end of the file. Returns 0, or a negative error
+ * if the content cannot be verified. */
+typedef int (*trusted_file_map_fill_t)(void* arg, uint64_t idx, uintptr_t addr, uint64_t size,
+                                       uint64_t file_offset);
+
+/* Gives back [addr, addr + size) of chunk 'idx' without filling it, because
+ * the pages are unmapped or mapped over. */
+typedef void (*trusted_file_map_drop_t)(void* arg, uint64_t idx, uintptr_t addr, uint64_t size);
+
+/* Bytes needed for a map of [start, end) at 'offset' of the file */
+size_t trusted_file_map_size(uintptr_t start, uintptr_t end, uint64_t offset,
+                             uint64_t file_size, uint64_t chunk_size);
+
+/* Sets up a map in memory of trusted_file_map_size() bytes. The range and the
+ * offset must be page-aligned, and the file must reach into the range. */
+void trusted_file_map_init(struct trusted_file_map* map, uintptr_t start, uintptr_t end,
+                           uint64_t offset, uint64_t file_size, uint64_t chunk_size);
+
+static inline bool trusted_file_map_contains(const struct trusted_file_map* map,
+                                             uintptr_t addr) {
+    return addr >= map->start && addr < map->end;
+}
+
+static inline bool trusted_file_map_filled(const struct trusted_file_map* map, uint64_t idx) {
+    return map->bitmap[idx / 64] & (1ULL << (idx % 64));
+}
+
+/* Enclave range and file offset of chunk 'idx' */
+void trusted_file_map_chunk(const struct trusted_file_map* map, uint64_t idx,
+                            uintptr_t* addr, uint64_t* size, uint64_t* file_offset);
+
+/* Fills the chunk holding 'addr' if it is not filled yet. Returns 1 if it
+ * filled the chunk, 0 if 'addr' is outside of the map or its chunk is already
+ * filled, or the error of 'fill' (the chunk is then left unfilled). */
+int trusted_file_map_fault(struct trusted_file_map* map, uintptr_t addr,
+                           trusted_file_map_fill_t fill, void* arg);
+
+/* Takes [start, end) out of the map, before the pages are unmapped or mapped
+ * over. Unfilled chunks inside of the range are dropped; unfilled chunks
+ * which are only partly inside are filled, since the rest of them stays
+ * mapped. Returns 0 or the first error of 'fill'. Once 'pending' is 0, the
+ * map has no work left and can be freed. */
+int trusted_file_map_release(struct trusted_file_map* map, uintptr_t start, uintptr_t end,
+                             trusted_file_map_fill_t fill, trusted_file_map_drop_t drop,
+                             void* arg);
+
+#endif /* TRUSTED_FILE_MAP_H */
@@ -0,0 +1,90 @@
+/* Copyright (C) 2014 Stony Brook University
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * trusted_file_table.c
+ *
+ * Validation and lookup of the trusted file table (see trusted_file_table.h).
+ * This file only depends on memcmp(), so it is also built on the host by
+ * trusted-file-table-test.c.
+ */
+
+#include <api.h>
+
+#include "trusted_file_table.h"
+
+/* Orders URIs as pal-sgx-sign sorts them: bytewise, and a prefix first */
+static int compare_uri(const char* a, size_t a_len, const char* b, size_t b_len) {
+    int cmp = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    if (cmp)
+        return cmp;
+    return a_len < b_len ? -1 : a_len > b_len;
+}
+
+bool trusted_file_table_valid(const void* table, size_t size) {
+    const struct trusted_file_table_hdr* hdr = table;
+    const struct trusted_file_table_entry* entries = table + sizeof(*hdr);
+
+    if (size < sizeof(*hdr) ||
+        memcmp(hdr->magic, TRUSTED_FILE_TABLE_MAGIC, TRUSTED_FILE_TABLE_MAGIC_LEN))
+        return false;
+
+    /* nentries and uris_size are 32-bit, so this cannot overflow */
+    if (size != sizeof(*hdr) + sizeof(entries[0]) * (uint64_t)hdr->nentries + hdr->uris_size)
+        return false;
+
+    const char* uris = (const char*)&entries[hdr->nentries];
+
+    for (uint32_t i = 0; i < hdr->nentries; i++) {
+        const struct trusted_file_table_entry* e = &entries[i];
+
+        if (e->uri_offset >= hdr->uris_size ||
+            e->uri_len >= hdr->uris_size - e->uri_offset ||
+            uris[e->uri_offset + e->uri_len] != '\0')
+            return false;
+
+        /* duplicates would make the lookup ambiguous, so the order is strict */
+        if (i && compare_uri(uris + entries[i - 1].uri_offset, entries[i - 1].uri_len,
+                             uris + e->uri_offset, e->uri_len) >= 0)
+            return false;
+    }
+
+    return true;
+}
+
+const struct trusted_file_table_entry* trusted_file_table_lookup(const void* table,
+                                                                 const char* uri,
+                                                                 size_t uri_len) {
+    const struct trusted_file_table_hdr* hdr = table;
+    const struct trusted_file_table_entry* entries = table + sizeof(*hdr);
+    const char* uris = (const char*)&entries[hdr->nentries];
+    uint32_t lo = 0, hi = hdr->nentries;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const struct trusted_file_table_entry* e = &entries[mid];
+        int cmp = compare_uri(uri, uri_len, uris + e->uri_offset, e->uri_len);
+
+        if (!cmp)
+            return e;
+        if (cmp < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+
+    return NULL;
+}
@@ -0,0 +1,73 @@
+/* Copyright (C) 2014 Stony Brook University
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * trusted_file_table.h
+ *
+ * Layout of the trusted file table written by pal-sgx-sign when the manifest
+ * sets "sgx.trusted_files_table = 1". The table replaces the
+ * "sgx.trusted_checksum.*" entries of sgx.trusted_files: it lists the
+ * normalized URI, size and SHA256 checksum of every trusted file, sorted by
+ * URI, so the enclave can look a file up when it is opened instead of
+ * registering (and stat'ing) all the files at startup.
+ *
+ * The table is a header, followed by the entries, followed by the URIs (each
+ * terminated by '\0'). All integers are little-endian.
+ */
+
+#ifndef TRUSTED_FILE_TABLE_H
+#define TRUSTED_FILE_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRUSTED_FILE_TABLE_MAGIC     "GTFTBL01"
+#define TRUSTED_FILE_TABLE_MAGIC_LEN 8
+
+/* The table sits next to the signed manifest, as <manifest.sgx> + this */
+#define TRUSTED_FILE_TABLE_SUFFIX    ".trusted_files"
+
+struct trusted_file_table_hdr {
+    char     magic[TRUSTED_FILE_TABLE_MAGIC_LEN];
+    uint32_t nentries;
+    uint32_t uris_size;             /* bytes of URIs after the entries */
+};
+
+struct trusted_file_table_entry {
+    uint32_t uri_offset;            /* from the start of the URIs */
+    uint32_t uri_len;               /* without the ending '\0' */
+    uint64_t size;
+    uint8_t  checksum[32];          /* SHA256 of the file */
+};
+
+/* Checks the bounds of all entries and that they are sorted by URI, so the
+ * table can be searched. Returns false if the table is malformed. */
+bool trusted_file_table_valid(const void* table, size_t size);
+
+/* Binary search of a normalized URI; the table must be valid. Returns NULL if
+ * the URI is not in the table. */
+const struct trusted_file_table_entry* trusted_file_table_lookup(const void* table,
+                                                                 const char* uri,
+                                                                 size_t uri_len);
+
+static inline const char* trusted_file_table_uri(const void* table,
+                                                 const struct trusted_file_table_entry* e) {
+    const struct trusted_file_table_hdr* hdr = table;
+    return (const char*)table + sizeof(*hdr) + sizeof(*e) * hdr->nentries + e->uri_offset;
+}
+
+#endif /* TRUSTED_FILE_TABLE_H */
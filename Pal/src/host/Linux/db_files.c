@@ -30,6 +30,7 @@
 #include "pal_debug.h"
 #include "pal_error.h"
 #include "api.h"
+#include "file_buffer.h"
 
 #include <linux/types.h>
 typedef __kernel_pid_t pid_t;
@@ -58,64 +59,144 @@ static int file_open (PAL_HANDLE * handle, const char * type, const char * uri,
     SET_HANDLE_TYPE(hdl, file);
     HANDLE_HDR(hdl)->flags |= RFD(0)|WFD(0)|WRITABLE(0);
     hdl->file.fd = ret;
-    hdl->file.offset = 0;
     hdl->file.map_start = NULL;
     char * path = (void *) hdl + HANDLE_SIZE(file);
     memcpy(path, uri, len + 1);
     hdl->file.realpath = (PAL_STR) path;
+    file_init_buffer(hdl);
     *handle = hdl;
     return 0;
 }
 
-#ifndef SEEK_SET
-# define SEEK_SET 0
-#endif
+/* positional read and write on the host, for file_read(), file_write() and
+   the file buffer; files which cannot seek (e.g., FIFOs) are read and written
+   at their position */
+static int64_t file_pread (void * arg, uint64_t offset, void * buffer,
+                           uint64_t count)
+{
+    PAL_HANDLE handle = arg;
+    int fd = handle->file.fd;
 
-/* 'read' operation for file streams. */
-static int64_t file_read (PAL_HANDLE handle, uint64_t offset, uint64_t count,
-                          void * buffer)
+    int64_t ret = INLINE_SYSCALL(pread64, 4, fd, buffer, count, offset);
+
+    if (IS_ERR(ret) && ERRNO(ret) == ESPIPE)
+        ret = INLINE_SYSCALL(read, 3, fd, buffer, count);
+
+    return IS_ERR(ret) ? unix_to_pal_error(ERRNO(ret)) : ret;
+}
+
+static int64_t file_pwrite (void * arg, uint64_t offset, const void * buffer,
+                            uint64_t count)
 {
+    PAL_HANDLE handle = arg;
     int fd = handle->file.fd;
-    int64_t ret;
 
-    if (handle->file.offset != offset) {
-        ret = INLINE_SYSCALL(lseek, 3, fd, offset, SEEK_SET);
-        if (IS_ERR(ret))
-            return -PAL_ERROR_DENIED;
+    int64_t ret = INLINE_SYSCALL(pwrite64, 4, fd, buffer, count, offset);
+
+    if (IS_ERR(ret) && ERRNO(ret) == ESPIPE)
+        ret = INLINE_SYSCALL(write, 3, fd, buffer, count);
+
+    return IS_ERR(ret) ? unix_to_pal_error(ERRNO(ret)) : ret;
+}
+
+static const struct file_buffer_ops file_buffer_ops = {
+    .read  = &file_pread,
+    .write = &file_pwrite,
+};
+
+/* the buffered file handles, for their writes to be written out at exit */
+static LISTP_TYPE(pal_handle) buffered_files = LISTP_INIT;
+static PAL_LOCK buffered_files_lock = LOCK_INIT;
+
+/* Only regular files are buffered: devices, FIFOs and sockets must be read
+   and written when asked. So must the files of /proc and /sys, which are
+   regular but are views of the kernel (e.g., /proc/self/mem). */
+static bool file_can_buffer (PAL_HANDLE handle)
+{
+    if (strstartswith_static(handle->file.realpath, "/proc/") ||
+        strstartswith_static(handle->file.realpath, "/sys/"))
+        return false;
+
+    struct stat stat_buf;
+    int ret = INLINE_SYSCALL(fstat, 2, handle->file.fd, &stat_buf);
+    return !IS_ERR(ret) && S_ISREG(stat_buf.st_mode);
+}
 
-        handle->file.offset = offset;
+void file_init_buffer (PAL_HANDLE handle)
+{
+    handle->file.buffer =
+        file_can_buffer(handle) ?
+        file_buffer_create(pal_state.file_read_ahead,
+                           pal_state.file_write_behind) : NULL;
+    INIT_LOCK(&handle->file.buffer_lock);
+    INIT_LIST_HEAD(handle, file.buffered);
+
+    if (handle->file.buffer) {
+        _DkInternalLock(&buffered_files_lock);
+        LISTP_ADD(handle, &buffered_files, file.buffered);
+        _DkInternalUnlock(&buffered_files_lock);
     }
+}
 
-    ret = INLINE_SYSCALL(read, 3, fd, buffer, count);
+static void file_destroy_buffer (PAL_HANDLE handle)
+{
+    if (!handle->file.buffer)
+        return;
 
-    if (IS_ERR(ret))
-        return unix_to_pal_error(ERRNO(ret));
+    _DkInternalLock(&buffered_files_lock);
+    LISTP_DEL_INIT(handle, &buffered_files, file.buffered);
+    _DkInternalUnlock(&buffered_files_lock);
 
-    handle->file.offset = offset + ret;
-    return ret;
+    file_buffer_destroy(handle->file.buffer);
+    handle->file.buffer = NULL;
 }
 
-/* 'write' operation for file streams. */
-static int64_t file_write (PAL_HANDLE handle, uint64_t offset, uint64_t count,
-                           const void * buffer)
+void file_flush_buffers (void)
 {
-    int fd = handle->file.fd;
-    int64_t ret;
+    PAL_HANDLE handle;
 
-    if (handle->file.offset != offset) {
-        ret = INLINE_SYSCALL(lseek, 3, fd, offset, SEEK_SET);
-        if (IS_ERR(ret))
-            return -PAL_ERROR_DENIED;
+    _DkInternalLock(&buffered_files_lock);
+    LISTP_FOR_EACH_ENTRY(handle, &buffered_files, file.buffered)
+        file_flush_buffer(handle);
+    _DkInternalUnlock(&buffered_files_lock);
+}
 
-        handle->file.offset = offset;
-    }
+int file_flush_buffer (PAL_HANDLE handle)
+{
+    if (!handle->file.buffer)
+        return 0;
 
-    ret = INLINE_SYSCALL(write, 3, fd, buffer, count);
+    _DkInternalLock(&handle->file.buffer_lock);
+    int ret = file_buffer_flush(handle->file.buffer, &file_buffer_ops, handle);
+    _DkInternalUnlock(&handle->file.buffer_lock);
+    return ret;
+}
 
-    if (IS_ERR(ret))
-        return unix_to_pal_error(ERRNO(ret));
+/* 'read' operation for file streams. */
+static int64_t file_read (PAL_HANDLE handle, uint64_t offset, uint64_t count,
+                          void * buffer)
+{
+    if (!handle->file.buffer)
+        return file_pread(handle, offset, buffer, count);
+
+    _DkInternalLock(&handle->file.buffer_lock);
+    int64_t ret = file_buffer_read(handle->file.buffer, &file_buffer_ops,
+                                   handle, offset, buffer, count);
+    _DkInternalUnlock(&handle->file.buffer_lock);
+    return ret;
+}
+
+/* 'write' operation for file streams. */
+static int64_t file_write (PAL_HANDLE handle, uint64_t offset, uint64_t count,
+                           const void * buffer)
+{
+    if (!handle->file.buffer)
+        return file_pwrite(handle, offset, buffer, count);
 
-    handle->file.offset = offset + ret;
+    _DkInternalLock(&handle->file.buffer_lock);
+    int64_t ret = file_buffer_write(handle->file.buffer, &file_buffer_ops,
+                                    handle, offset, buffer, count);
+    _DkInternalUnlock(&handle->file.buffer_lock);
     return ret;
 }
 
@@ -125,6 +206,10 @@ static int file_close (PAL_HANDLE handle)
 {
     int fd = handle->file.fd;
 
+    /* an error of the deferred writes is returned by close, as by NFS */
+    int flush_ret = file_flush_buffer(handle);
+    file_destroy_buffer(handle);
+
     int ret = INLINE_SYSCALL(close, 1, fd);
 
     /* initial realpath is part of handle object and will be freed with it */
@@ -133,7 +218,9 @@ static int file_close (PAL_HANDLE handle)
         free((void *) handle->file.realpath);
     }
 
-    return IS_ERR(ret) ? unix_to_pal_error(ERRNO(ret)) : 0;
+    if (IS_ERR(ret))
+        return unix_to_pal_error(ERRNO(ret));
+    return flush_ret;
 }
 
 /* 'delete' operation for file streams. It will actually delete
@@ -153,6 +240,9 @@ static int file_map (PAL_HANDLE handle, void ** addr, int prot,
 {
     int fd = handle->file.fd;
     void * mem = *addr;
+    int ret = file_flush_buffer(handle);
+    if (ret < 0)
+        return ret;
     /*
      * work around for fork emulation
      * the first exec image to be loaded has to be at same address
@@ -180,7 +270,11 @@ static int file_map (PAL_HANDLE handle, void ** addr, int prot,
 /* 'setlength' operation for file stream. */
 static int64_t file_setlength (PAL_HANDLE handle, uint64_t length)
 {
-    int ret = INLINE_SYSCALL(ftruncate, 2, handle->file.fd, length);
+    int ret = file_flush_buffer(handle);
+    if (ret < 0)
+        return ret;
+
+    ret = INLINE_SYSCALL(ftruncate, 2, handle->file.fd, length);
 
     if (IS_ERR(ret))
         return (ERRNO(ret) == EINVAL || ERRNO(ret) == EBADF) ?
@@ -192,7 +286,11 @@ static int64_t file_setlength (PAL_HANDLE handle, uint64_t length)
 /* 'flush' operation for file stream. */
 static int file_flush (PAL_HANDLE handle)
 {
-    int ret = INLINE_SYSCALL(fsync, 1, handle->file.fd);
+    int ret = file_flush_buffer(handle);
+    if (ret < 0)
+        return ret;
+
+    ret = INLINE_SYSCALL(fsync, 1, handle->file.fd);
 
     if (IS_ERR(ret))
         return (ERRNO(ret) == EINVAL || ERRNO(ret) == EBADF) ?
@@ -257,7 +355,13 @@ static int file_attrquerybyhdl (PAL_HANDLE handle,
     int fd = handle->generic.fds[0];
     struct stat stat_buf;
 
-    int ret = INLINE_SYSCALL(fstat, 2, fd, &stat_buf);
+    /* the size must include the buffered writes (this is also used for
+       directories) */
+    int ret = IS_HANDLE_TYPE(handle, file) ? file_flush_buffer(handle) : 0;
+    if (ret < 0)
+        return ret;
+
+    ret = INLINE_SYSCALL(fstat, 2, fd, &stat_buf);
 
     if (IS_ERR(ret))
         return unix_to_pal_error(ERRNO(ret));
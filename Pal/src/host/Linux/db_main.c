@@ -291,7 +291,6 @@ void pal_linux_main (void * args)
     SET_HANDLE_TYPE(file, file);
     HANDLE_HDR(file)->flags |= RFD(0)|WFD(0)|WRITABLE(0);
     file->file.fd = fd;
-    file->file.offset = 0;
     file->file.map_start = NULL;
 
     char * path = (void *) file + HANDLE_SIZE(file);
@@ -301,6 +300,7 @@ void pal_linux_main (void * args)
         goto done_init;
     }
     file->file.realpath = path;
+    file_init_buffer(file);
 
     if (!check_elf_object(file)) {
         exec = file;
@@ -63,7 +63,7 @@ unsigned long _DkSystemTimeQueryEarly (void)
 #endif
 }
 
-unsigned long _DkSystemTimeQuery (void)
+unsigned long _DkSystemTimeQueryNs (void)
 {
 #if USE_CLOCK_GETTIME == 1
     struct timespec time;
@@ -83,8 +83,8 @@ unsigned long _DkSystemTimeQuery (void)
     if (IS_ERR(ret))
         return 0;
 
-    /* in microseconds */
-    return 1000000ULL * time.tv_sec + time.tv_nsec / 1000;
+    /* in nanoseconds */
+    return 1000000000ULL * time.tv_sec + time.tv_nsec;
 #else
     struct timeval time;
     int ret;
@@ -107,11 +107,167 @@ unsigned long _DkSystemTimeQuery (void)
     if (IS_ERR(ret))
         return 0;
 
-    /* in microseconds */
-    return 1000000ULL * time.tv_sec + time.tv_usec;
+    /* in nanoseconds */
+    return 1000000000ULL * time.tv_sec + time.tv_usec * 1000;
 #endif
 }
 
+unsigned long _DkSystemTimeQuery (void)
+{
+    /* in microseconds */
+    return _DkSystemTimeQueryNs() / 1000;
+}
+
+/*
+ * TSC calibration: the TSC is read right before and after the host clock,
+ * and the rate is measured over the whole time since the first calibration,
+ * so it gets more precise with every call. The first call busy-waits for
+ * TSC_CALIBRATION_MIN_NS to get a first rate.
+ */
+#define TSC_CALIBRATION_MIN_NS  1000000ULL
+#define TSC_SAMPLE_TRIES        3
+
+static PAL_LOCK tsc_lock = LOCK_INIT;
+
+static struct {
+    bool checked, usable;
+    uint64_t first_tsc, first_ns;
+    uint64_t mult;
+    uint64_t last_ns;
+} tsc_state;
+
+static inline uint64_t rdtsc (void)
+{
+    uint32_t lo, hi;
+    __asm__ volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t) hi << 32) | lo;
+}
+
+static bool tsc_is_invariant (void)
+{
+    unsigned int values[4];
+
+    cpuid(0x80000000, 0, values);
+    if (values[PAL_CPUID_WORD_EAX] < 0x80000007)
+        return false;
+
+    /* CPUID.80000007H:EDX[8] is the invariant TSC */
+    cpuid(0x80000007, 0, values);
+    return !!(values[PAL_CPUID_WORD_EDX] & (1U << 8));
+}
+
+/* Keeps the pair of TSC and host time read closest together */
+static int sample_tsc (uint64_t * tsc, uint64_t * ns)
+{
+    uint64_t best = (uint64_t) -1;
+
+    for (int i = 0 ; i < TSC_SAMPLE_TRIES ; i++) {
+        uint64_t start = rdtsc();
+        uint64_t time = _DkSystemTimeQueryNs();
+        uint64_t end = rdtsc();
+
+        if (!time)
+            return -PAL_ERROR_DENIED;
+
+        if (end - start < best) {
+            best = end - start;
+            *tsc = start + best / 2;
+            *ns = time;
+        }
+    }
+
+    return 0;
+}
+
+static int start_tsc_rate (uint64_t * tsc, uint64_t * ns)
+{
+    int ret = sample_tsc(&tsc_state.first_tsc, &tsc_state.first_ns);
+    if (ret < 0)
+        return ret;
+
+    do {
+        ret = sample_tsc(tsc, ns);
+        if (ret < 0)
+            return ret;
+
+        /* the host clock went backwards */
+        if (*ns < tsc_state.first_ns) {
+            tsc_state.first_tsc = *tsc;
+            tsc_state.first_ns = *ns;
+        }
+    } while (*ns - tsc_state.first_ns < TSC_CALIBRATION_MIN_NS);
+
+    return 0;
+}
+
+static uint64_t tsc_rate (uint64_t tsc_span, uint64_t ns_span)
+{
+    /* keep (ns_span << PAL_TSC_MULT_SHIFT) in 64 bits */
+    while ((tsc_span | ns_span) >> (64 - PAL_TSC_MULT_SHIFT)) {
+        tsc_span >>= 1;
+        ns_span >>= 1;
+    }
+
+    return (ns_span << PAL_TSC_MULT_SHIFT) / tsc_span;
+}
+
+int _DkSystemTimeCalibrate (PAL_TSC_CALIBRATION * calib)
+{
+    uint64_t tsc, ns, mult;
+    int ret;
+
+    _DkInternalLock(&tsc_lock);
+
+    if (!tsc_state.checked) {
+        tsc_state.usable = tsc_is_invariant();
+        tsc_state.checked = true;
+    }
+
+    if (!tsc_state.usable) {
+        ret = -PAL_ERROR_NOTSUPPORT;
+        goto out;
+    }
+
+    if (tsc_state.mult) {
+        ret = sample_tsc(&tsc, &ns);
+        if (ret < 0)
+            goto out;
+
+        mult = 0;
+        if (tsc > tsc_state.first_tsc && ns > tsc_state.first_ns)
+            mult = tsc_rate(tsc - tsc_state.first_tsc, ns - tsc_state.first_ns);
+
+        /* a rate off by more than 0.1% means that the host clock was set
+         * since the first calibration, so measure the rate again */
+        if (mult < tsc_state.mult - (tsc_state.mult >> 10) ||
+            mult > tsc_state.mult + (tsc_state.mult >> 10))
+            tsc_state.mult = 0;
+    }
+
+    if (!tsc_state.mult) {
+        ret = start_tsc_rate(&tsc, &ns);
+        if (ret < 0)
+            goto out;
+
+        mult = tsc_rate(tsc - tsc_state.first_tsc, ns - tsc_state.first_ns);
+    }
+
+    /* the host clock may have been set back: never start a mapping before
+     * the previous one, the caller slews its own time to the new one */
+    if (ns < tsc_state.last_ns)
+        ns = tsc_state.last_ns;
+
+    tsc_state.mult = mult;
+    tsc_state.last_ns = ns;
+    calib->tsc_base = tsc;
+    calib->ns_base = ns;
+    calib->mult = mult;
+    ret = 0;
+out:
+    _DkInternalUnlock(&tsc_lock);
+    return ret;
+}
+
 #if USE_ARCH_RDRAND == 1
 int _DkRandomBitsRead (void * buffer, int size)
 {
@@ -46,6 +46,10 @@ static int _DkObjectWaitOne(PAL_HANDLE handle, int64_t timeout_us) {
     /* only for all these handle which has a file descriptor, or
        a eventfd. events and semaphores will skip this part */
     if (HANDLE_HDR(handle)->flags & HAS_FDS) {
+        /* data in a ring does not make its fd readable */
+        if (IS_HANDLE_TYPE(handle, ring) && ring_ready(handle))
+            return 0;
+
         struct timespec timeout_ts;
 
         if (timeout_us >= 0) {
@@ -154,15 +158,11 @@ int _DkObjectsWaitAny(int count, PAL_HANDLE* handleArray, int64_t timeout_us,
         if (!(HANDLE_HDR(hdl)->flags & HAS_FDS))
             return -PAL_ERROR_NOTSUPPORT;
 
-        /* eliminate repeated entries */
-        for (j = 0 ; j < i ; j++)
-            if (hdl == handleArray[j])
-                break;
-        if (j == i) {
-            for (j = 0 ; j < MAX_FDS ; j++)
-                if (HANDLE_HDR(hdl)->flags & (RFD(j)|WFD(j)))
-                    maxfds++;
-        }
+        /* a repeated entry is polled twice, which is cheaper than
+           searching the array for it */
+        for (j = 0 ; j < MAX_FDS ; j++)
+            if (HANDLE_HDR(hdl)->flags & (RFD(j)|WFD(j)))
+                maxfds++;
     }
 
     struct pollfd * fds = __alloca(sizeof(struct pollfd) * maxfds);
@@ -174,11 +174,10 @@ int _DkObjectsWaitAny(int count, PAL_HANDLE* handleArray, int64_t timeout_us,
         if (!hdl)
             continue;
 
-        for (j = 0 ; j < i ; j++)
-            if (hdl == handleArray[j])
-                break;
-        if (j < i)
-            continue;
+        if (IS_HANDLE_TYPE(hdl, ring) && ring_ready(hdl)) {
+            *polled = hdl;
+            return 0;
+        }
 
         for (j = 0 ; j < MAX_FDS ; j++) {
             int events = 0;
@@ -263,6 +262,143 @@ int _DkObjectsWaitAny(int count, PAL_HANDLE* handleArray, int64_t timeout_us,
     return polled_hdl ? 0 : -PAL_ERROR_TRYAGAIN;
 }
 
+/* _DkStreamsWaitEvents for internal use. All the streams are polled with a
+   single ppoll(), and the events of every stream are returned. */
+int _DkStreamsWaitEvents(size_t count, PAL_HANDLE* handle_array, PAL_FLG* events,
+                         PAL_FLG* ret_events, int64_t timeout_us) {
+    size_t maxfds = 0, nfds = 0;
+    bool ready = false;
+    int ret;
+
+    for (size_t i = 0 ; i < count ; i++) {
+        PAL_HANDLE hdl = handle_array[i];
+
+        ret_events[i] = 0;
+        if (!hdl || !events[i])
+            continue;
+
+        for (int j = 0 ; j < MAX_FDS ; j++)
+            if (HANDLE_HDR(hdl)->flags & (RFD(j)|WFD(j)))
+                maxfds++;
+    }
+
+    if (!maxfds)
+        return -PAL_ERROR_TRYAGAIN;
+
+    /* the pollfds, followed by the handle and fd of each, as i * MAX_FDS + j */
+    struct pollfd* fds = malloc((sizeof(struct pollfd) + sizeof(size_t)) * maxfds);
+    if (!fds)
+        return -PAL_ERROR_NOMEM;
+    size_t* offs = (size_t*)&fds[maxfds];
+
+    for (size_t i = 0 ; i < count ; i++) {
+        PAL_HANDLE hdl = handle_array[i];
+
+        /* synchronous objects (without fds) are never ready */
+        if (!hdl || !events[i] || !(HANDLE_HDR(hdl)->flags & HAS_FDS))
+            continue;
+
+        /* data in a ring does not make its fd readable */
+        if (IS_HANDLE_TYPE(hdl, ring) && (events[i] & PAL_WAIT_READ) && ring_ready(hdl)) {
+            ret_events[i] |= PAL_WAIT_READ;
+            ready = true;
+        }
+
+        for (int j = 0 ; j < MAX_FDS ; j++) {
+            int fd_events = 0;
+
+            if (!(HANDLE_HDR(hdl)->flags & (RFD(j)|WFD(j))) ||
+                hdl->generic.fds[j] == PAL_IDX_POISON)
+                continue;
+
+            /* the error of an fd stays until the handle is closed, but
+             * data may still be left to read from it */
+            if (HANDLE_HDR(hdl)->flags & ERROR(j)) {
+                ret_events[i] |= PAL_WAIT_ERROR;
+                ready = true;
+            }
+
+            if ((HANDLE_HDR(hdl)->flags & RFD(j)) && (events[i] & PAL_WAIT_READ))
+                fd_events |= POLLIN;
+            if ((HANDLE_HDR(hdl)->flags & WFD(j)) && (events[i] & PAL_WAIT_WRITE) &&
+                !(HANDLE_HDR(hdl)->flags & ERROR(j)))
+                fd_events |= POLLOUT;
+
+            if (fd_events) {
+                fds[nfds].fd = hdl->generic.fds[j];
+                fds[nfds].events = fd_events|POLLHUP|POLLERR;
+                fds[nfds].revents = 0;
+                offs[nfds] = i * MAX_FDS + j;
+                nfds++;
+            }
+        }
+    }
+
+    ret = 0;
+    if (nfds) {
+        struct timespec timeout_ts = {0, 0};
+
+        if (!ready && timeout_us >= 0) {
+            int64_t sec = timeout_us / 1000000;
+            int64_t microsec = timeout_us - (sec * 1000000);
+            timeout_ts.tv_sec = sec;
+            timeout_ts.tv_nsec = microsec * 1000;
+        }
+
+        ret = INLINE_SYSCALL(ppoll, 5, fds, nfds,
+                             ready || timeout_us >= 0 ? &timeout_ts : NULL,
+                             NULL, 0);
+    }
+
+    if (IS_ERR(ret)) {
+        switch (ERRNO(ret)) {
+            case EINTR:
+            case ERESTART:
+                ret = -PAL_ERROR_INTERRUPTED;
+                break;
+            default:
+                ret = unix_to_pal_error(ERRNO(ret));
+                break;
+        }
+        goto out;
+    }
+
+    for (size_t k = 0 ; k < nfds ; k++) {
+        if (!fds[k].revents)
+            continue;
+
+        size_t i = offs[k] / MAX_FDS;
+        int j = offs[k] % MAX_FDS;
+        PAL_HANDLE hdl = handle_array[i];
+
+        if (fds[k].revents & POLLIN) {
+            /* a doorbell may be stale */
+            if (!IS_HANDLE_TYPE(hdl, ring) || ring_ready(hdl))
+                ret_events[i] |= PAL_WAIT_READ;
+        }
+        if (fds[k].revents & POLLOUT) {
+            HANDLE_HDR(hdl)->flags |= WRITABLE(j);
+            ret_events[i] |= PAL_WAIT_WRITE;
+        }
+        if (fds[k].revents & (POLLERR|POLLNVAL)) {
+            HANDLE_HDR(hdl)->flags |= ERROR(j);
+            ret_events[i] |= PAL_WAIT_ERROR;
+        }
+        /* a hang-up is not kept: the fd is polled again, for the data the
+         * peer left before closing its end */
+        if (fds[k].revents & POLLHUP)
+            ret_events[i] |= PAL_WAIT_ERROR;
+
+        if (ret_events[i])
+            ready = true;
+    }
+
+    ret = ready ? 0 : -PAL_ERROR_TRYAGAIN;
+out:
+    free(fds);
+    return ret;
+}
+
 #if TRACE_HEAP_LEAK == 1
 
 PAL_HANDLE heap_alloc_head;
@@ -436,6 +436,7 @@ no_data:
 
 noreturn void _DkProcessExit (int exitcode)
 {
+    file_flush_buffers();
     INLINE_SYSCALL(exit_group, 1, exitcode);
     while (true) {
         /* nothing */;
@@ -0,0 +1,705 @@
+/* Copyright (C) 2014 Stony Brook University
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * db_rings.c
+ *
+ * This file contains operands to handle streams with URIs that start with
+ * "ring:" or "ring.srv:". A ring stream connects two processes on the same
+ * host like a pipe, but the bytes go through two rings (one per direction) in
+ * memory shared by both ends, so reads and writes do not enter the host.
+ *
+ * The connection is made over an abstract UNIX socket, like a pipe. The
+ * client creates the shared memory (a memfd) and sends it with the first byte
+ * on the socket. After that, the socket only carries doorbells: a reader which
+ * finds its ring empty sets rx_waiting, and the next writer sends one byte to
+ * wake it up. So a ring handle can still be polled with the other handles, and
+ * the socket reports when the peer closes its end. A writer waiting for space
+ * in a full ring sleeps on a futex instead.
+ *
+ * A ring end must not be shared with another process, and is only used by
+ * one reader and one writer at a time (rx_lock and tx_lock). A write which
+ * fits into the ring is never interleaved with other writes.
+ */
+
+#include <linux/types.h>
+
+#include "api.h"
+#include "pal.h"
+#include "pal_debug.h"
+#include "pal_defs.h"
+#include "pal_error.h"
+#include "pal_internal.h"
+#include "pal_linux.h"
+#include "pal_linux_defs.h"
+#include "pal_security.h"
+typedef __kernel_pid_t pid_t;
+#include <asm/errno.h>
+#include <asm/fcntl.h>
+#include <asm/poll.h>
+#include <atomic.h>
+#include <linux/futex.h>
+#include <linux/time.h>
+#include <linux/un.h>
+#include <sys/socket.h>
+
+/* must be a power of two */
+#define RING_SIZE (64 * 1024)
+
+/* how long a writer sleeps on a full ring before checking for the peer */
+#define RING_WAIT_NSEC (10 * 1000 * 1000)
+
+struct ring {
+    /* written by the reader */
+    volatile uint32_t head __attribute__((aligned(64)));  /* bytes read so far */
+    volatile int64_t rx_waiting;  /* the reader waits for a doorbell */
+
+    /* written by the writer */
+    volatile uint32_t tail __attribute__((aligned(64)));  /* bytes written so far */
+    volatile int64_t tx_waiting;  /* the writer waits on head for space */
+
+    char data[RING_SIZE] __attribute__((aligned(64)));
+};
+
+/* ring[0] carries bytes from the client to the server, ring[1] back */
+struct ring_shm {
+    struct ring ring[2];
+};
+
+static inline struct ring* ring_rx(PAL_HANDLE handle) {
+    return &((struct ring_shm*)handle->ring.shm)->ring[1 - handle->ring.side];
+}
+
+static inline struct ring* ring_tx(PAL_HANDLE handle) {
+    return &((struct ring_shm*)handle->ring.shm)->ring[handle->ring.side];
+}
+
+static int ring_path(int pipeid, char* path, int len) {
+    /* use abstract UNIX sockets, apart from the ones of pipes */
+    memset(path, 0, len);
+
+    if (pal_sec.pipe_prefix_id)
+        return snprintf(path + 1, len - 1, GRAPHENE_UNIX_PREFIX_FMT "/ring%08x",
+                        pal_sec.pipe_prefix_id, pipeid);
+    else
+        return snprintf(path + 1, len - 1, "/graphene/ring%08x", pipeid);
+}
+
+static int ring_addr(int pipeid, struct sockaddr_un* addr) {
+    addr->sun_family = AF_UNIX;
+    return ring_path(pipeid, (char*)addr->sun_path, sizeof(addr->sun_path));
+}
+
+static PAL_HANDLE ring_new_handle(int fd, PAL_NUM pipeid, struct ring_shm* shm, int side,
+                                  int options) {
+    PAL_HANDLE hdl = malloc(HANDLE_SIZE(ring));
+    if (!hdl)
+        return NULL;
+
+    if (shm) {
+        SET_HANDLE_TYPE(hdl, ring);
+    } else {
+        SET_HANDLE_TYPE(hdl, ringsrv);
+    }
+    HANDLE_HDR(hdl)->flags |= RFD(0);
+    hdl->ring.fd          = fd;
+    hdl->ring.pipeid      = pipeid;
+    hdl->ring.nonblocking = options & PAL_OPTION_NONBLOCK ? PAL_TRUE : PAL_FALSE;
+    hdl->ring.shm         = shm;
+    hdl->ring.side        = side;
+    INIT_LOCK(&hdl->ring.rx_lock);
+    INIT_LOCK(&hdl->ring.tx_lock);
+    return hdl;
+}
+
+static int ring_map(int memfd, struct ring_shm** shm) {
+    void* addr = (void*)ARCH_MMAP(NULL, sizeof(struct ring_shm), PROT_READ | PROT_WRITE,
+                                  MAP_SHARED, memfd, 0);
+    if (IS_ERR_P(addr))
+        return -PAL_ERROR_NOMEM;
+
+    *shm = addr;
+    return 0;
+}
+
+/* the doorbell socket never blocks; blocking reads wait in ppoll() */
+static int ring_set_nonblock(int fd) {
+    int ret = INLINE_SYSCALL(fcntl, 3, fd, F_SETFL, O_NONBLOCK);
+    return IS_ERR(ret) ? unix_to_pal_error(ERRNO(ret)) : 0;
+}
+
+static int ring_listen(PAL_HANDLE* handle, PAL_NUM pipeid, int options) {
+    int ret, fd;
+
+    fd = INLINE_SYSCALL(socket, 3, AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | options, 0);
+    if (IS_ERR(fd))
+        return -PAL_ERROR_DENIED;
+
+    struct sockaddr_un addr;
+
+    if ((ret = ring_addr(pipeid, &addr)) < 0) {
+        INLINE_SYSCALL(close, 1, fd);
+        return ret;
+    }
+
+    ret = INLINE_SYSCALL(bind, 3, fd, &addr, sizeof(addr.sun_path) - 1);
+
+    if (IS_ERR(ret)) {
+        INLINE_SYSCALL(close, 1, fd);
+
+        switch (ERRNO(ret)) {
+            case EINVAL:
+                return -PAL_ERROR_INVAL;
+            case EADDRINUSE:
+                return -PAL_ERROR_STREAMEXIST;
+            default:
+                return -PAL_ERROR_DENIED;
+        }
+    }
+
+    ret = INLINE_SYSCALL(listen, 2, fd, 1);
+    if (IS_ERR(ret)) {
+        INLINE_SYSCALL(close, 1, fd);
+        return -PAL_ERROR_DENIED;
+    }
+
+    PAL_HANDLE hdl = ring_new_handle(fd, pipeid, NULL, 0, options);
+    if (!hdl) {
+        INLINE_SYSCALL(close, 1, fd);
+        return -PAL_ERROR_NOMEM;
+    }
+
+    *handle = hdl;
+    return 0;
+}
+
+static int ring_waitforclient(PAL_HANDLE handle, PAL_HANDLE* client) {
+    if (!IS_HANDLE_TYPE(handle, ringsrv))
+        return -PAL_ERROR_NOTSERVER;
+
+    if (handle->ring.fd == PAL_IDX_POISON)
+        return -PAL_ERROR_DENIED;
+
+    int newfd = INLINE_SYSCALL(accept4, 4, handle->ring.fd, NULL, NULL, O_CLOEXEC);
+
+    if (IS_ERR(newfd))
+        switch (ERRNO(newfd)) {
+            case EWOULDBLOCK:
+                return -PAL_ERROR_TRYAGAIN;
+            case ECONNABORTED:
+                return -PAL_ERROR_CONNFAILED;
+            default:
+                return -PAL_ERROR_DENIED;
+        }
+
+    /* the client sends the shared memory together with the first byte */
+    struct msghdr hdr;
+    struct iovec iov;
+    char cbuf[sizeof(struct cmsghdr) + sizeof(int)];
+    char b = 0;
+    int memfd;
+    int ret;
+
+    memset(&hdr, 0, sizeof(struct msghdr));
+    hdr.msg_iov        = &iov;
+    hdr.msg_iovlen     = 1;
+    hdr.msg_control    = cbuf;
+    hdr.msg_controllen = sizeof(cbuf);
+    iov.iov_base       = &b;
+    iov.iov_len        = 1;
+
+    ret = INLINE_SYSCALL(recvmsg, 3, newfd, &hdr, MSG_CMSG_CLOEXEC);
+
+    struct cmsghdr* chdr = CMSG_FIRSTHDR(&hdr);
+
+    if (IS_ERR(ret) || ret != 1 || !chdr || chdr->cmsg_level != SOL_SOCKET ||
+        chdr->cmsg_type != SCM_RIGHTS || chdr->cmsg_len != CMSG_LEN(sizeof(int))) {
+        INLINE_SYSCALL(close, 1, newfd);
+        return -PAL_ERROR_CONNFAILED;
+    }
+
+    memcpy(&memfd, CMSG_DATA(chdr), sizeof(int));
+
+    struct ring_shm* shm;
+    ret = ring_map(memfd, &shm);
+    INLINE_SYSCALL(close, 1, memfd);
+
+    if (ret < 0) {
+        INLINE_SYSCALL(close, 1, newfd);
+        return ret;
+    }
+
+    if ((ret = ring_set_nonblock(newfd)) < 0) {
+        INLINE_SYSCALL(munmap, 2, shm, sizeof(struct ring_shm));
+        INLINE_SYSCALL(close, 1, newfd);
+        return ret;
+    }
+
+    PAL_HANDLE clnt = ring_new_handle(newfd, handle->ring.pipeid, shm, /*side=*/1, 0);
+    if (!clnt) {
+        INLINE_SYSCALL(munmap, 2, shm, sizeof(struct ring_shm));
+        INLINE_SYSCALL(close, 1, newfd);
+        return -PAL_ERROR_NOMEM;
+    }
+
+    *client = clnt;
+    return 0;
+}
+
+static int ring_connect(PAL_HANDLE* handle, PAL_NUM pipeid, int options) {
+    int ret, fd, memfd;
+
+    fd = INLINE_SYSCALL(socket, 3, AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (IS_ERR(fd))
+        return -PAL_ERROR_DENIED;
+
+    struct sockaddr_un addr;
+
+    if ((ret = ring_addr(pipeid, &addr)) < 0)
+        goto out_fd;
+
+    ret = INLINE_SYSCALL(connect, 3, fd, &addr, sizeof(addr.sun_path) - 1);
+
+    if (IS_ERR(ret)) {
+        switch (ERRNO(ret)) {
+            case ECONNREFUSED:
+                ret = -PAL_ERROR_STREAMNOTEXIST;
+                break;
+            case EINTR:
+                ret = -PAL_ERROR_TRYAGAIN;
+                break;
+            default:
+                ret = -PAL_ERROR_DENIED;
+                break;
+        }
+        goto out_fd;
+    }
+
+    memfd = INLINE_SYSCALL(memfd_create, 2, "graphene-ring", MFD_CLOEXEC);
+    if (IS_ERR(memfd)) {
+        ret = unix_to_pal_error(ERRNO(memfd));
+        goto out_fd;
+    }
+
+    ret = INLINE_SYSCALL(ftruncate, 2, memfd, sizeof(struct ring_shm));
+    if (IS_ERR(ret)) {
+        ret = unix_to_pal_error(ERRNO(ret));
+        goto out_memfd;
+    }
+
+    struct ring_shm* shm;
+    if ((ret = ring_map(memfd, &shm)) < 0)
+        goto out_memfd;
+
+    /* both rings start empty, with their readers waiting for a doorbell */
+    shm->ring[0].rx_waiting = 1;
+    shm->ring[1].rx_waiting = 1;
+
+    struct msghdr hdr;
+    struct iovec iov;
+    char cbuf[sizeof(struct cmsghdr) + sizeof(int)];
+    char b = 0;
+
+    memset(&hdr, 0, sizeof(struct msghdr));
+    hdr.msg_iov        = &iov;
+    hdr.msg_iovlen     = 1;
+    hdr.msg_control    = cbuf;
+    hdr.msg_controllen = sizeof(cbuf);
+    iov.iov_base       = &b;
+    iov.iov_len        = 1;
+
+    struct cmsghdr* chdr = CMSG_FIRSTHDR(&hdr);
+    chdr->cmsg_level     = SOL_SOCKET;
+    chdr->cmsg_type      = SCM_RIGHTS;
+    chdr->cmsg_len       = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(chdr), &memfd, sizeof(int));
+
+    ret = INLINE_SYSCALL(sendmsg, 3, fd, &hdr, MSG_NOSIGNAL);
+    ret = IS_ERR(ret) ? -PAL_ERROR_DENIED : ring_set_nonblock(fd);
+
+    PAL_HANDLE hdl = NULL;
+    if (!ret) {
+        hdl = ring_new_handle(fd, pipeid, shm, /*side=*/0, options);
+        if (!hdl)
+            ret = -PAL_ERROR_NOMEM;
+    }
+
+    if (ret < 0) {
+        INLINE_SYSCALL(munmap, 2, shm, sizeof(struct ring_shm));
+        goto out_memfd;
+    }
+
+    INLINE_SYSCALL(close, 1, memfd);
+    *handle = hdl;
+    return 0;
+
+out_memfd:
+    INLINE_SYSCALL(close, 1, memfd);
+out_fd:
+    INLINE_SYSCALL(close, 1, fd);
+    return ret;
+}
+
+/* 'open' operation of ring stream. Like a pipe, a ring is identified by a
+   decimal number in URI: "ring.srv:<id>" listens and "ring:<id>" connects. */
+static int ring_open(PAL_HANDLE* handle, const char* type, const char* uri, int access, int share,
+                     int create, int options) {
+    if (!WITHIN_MASK(access, PAL_ACCESS_MASK) || !WITHIN_MASK(share, PAL_SHARE_MASK) ||
+        !WITHIN_MASK(create, PAL_CREATE_MASK) || !WITHIN_MASK(options, PAL_OPTION_MASK))
+        return -PAL_ERROR_INVAL;
+
+    char* endptr;
+    PAL_NUM pipeid = strtol(uri, &endptr, 10);
+
+    if (!*uri || *endptr)
+        return -PAL_ERROR_INVAL;
+
+    if (!strcmp_static(type, "ring.srv"))
+        return ring_listen(handle, pipeid, options);
+
+    if (!strcmp_static(type, "ring"))
+        return ring_connect(handle, pipeid, options);
+
+    return -PAL_ERROR_INVAL;
+}
+
+/* The ring this end reads looks empty: throw away the doorbells already
+   rung, and ask the writer to ring again. Returns -PAL_ERROR_ENDOFSTREAM if
+   the peer has closed its end. Must be called with rx_lock held: a reader
+   waiting in ppoll() would otherwise lose the doorbell meant for it. */
+static int ring_arm_doorbell(PAL_HANDLE handle, struct ring* r) {
+    char bytes[64];
+    int64_t ret;
+
+    do {
+        ret = INLINE_SYSCALL(recvfrom, 6, handle->ring.fd, bytes, sizeof(bytes), MSG_DONTWAIT,
+                             NULL, NULL);
+    } while (!IS_ERR(ret) && ret > 0);
+
+    r->rx_waiting = 1;
+    MB();
+
+    if (!IS_ERR(ret) && !ret) {
+        HANDLE_HDR(handle)->flags |= ERROR(0);
+        return -PAL_ERROR_ENDOFSTREAM;
+    }
+
+    return 0;
+}
+
+static void ring_doorbell(PAL_HANDLE handle, struct ring* r) {
+    MB();
+    if (r->rx_waiting && cmpxchg(&r->rx_waiting, 1, 0) == 1) {
+        char byte = 0;
+        INLINE_SYSCALL(sendto, 6, handle->ring.fd, &byte, 1, MSG_DONTWAIT | MSG_NOSIGNAL, NULL,
+                       0);
+    }
+}
+
+static bool ring_peer_closed(PAL_HANDLE handle) {
+    if (HANDLE_HDR(handle)->flags & ERROR(0))
+        return true;
+
+    struct pollfd pfd  = {.fd = handle->ring.fd, .events = POLLIN, .revents = 0};
+    struct timespec tp = {0, 0};
+    int ret            = INLINE_SYSCALL(ppoll, 5, &pfd, 1, &tp, NULL, 0);
+
+    if (ret == 1 && (pfd.revents & (POLLHUP | POLLERR))) {
+        HANDLE_HDR(handle)->flags |= ERROR(0);
+        return true;
+    }
+
+    return false;
+}
+
+/* Checks for the end of the stream without consuming any doorbell. */
+static bool ring_peer_eof(PAL_HANDLE handle) {
+    if (HANDLE_HDR(handle)->flags & ERROR(0))
+        return true;
+
+    char byte;
+    int64_t ret = INLINE_SYSCALL(recvfrom, 6, handle->ring.fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT,
+                                 NULL, NULL);
+    if (!IS_ERR(ret) && !ret) {
+        HANDLE_HDR(handle)->flags |= ERROR(0);
+        return true;
+    }
+
+    return false;
+}
+
+/* Only peeks at the ring: the doorbells are left to ring_read(), but the
+   writer is asked to ring, so that polling the fd wakes up on new data. */
+bool ring_ready(PAL_HANDLE handle) {
+    struct ring* r = ring_rx(handle);
+
+    if (r->tail != r->head)
+        return true;
+
+    r->rx_waiting = 1;
+    MB();
+
+    if (r->tail != r->head)
+        return true;
+
+    return ring_peer_eof(handle);
+}
+
+/* 'read' operation of ring stream. offset does not apply here. */
+static int64_t ring_read(PAL_HANDLE handle, uint64_t offset, uint64_t len, void* buffer) {
+    if (offset)
+        return -PAL_ERROR_INVAL;
+
+    if (!IS_HANDLE_TYPE(handle, ring))
+        return -PAL_ERROR_NOTCONNECTION;
+
+    if (!len)
+        return 0;
+
+    struct ring* r = ring_rx(handle);
+    int64_t ret;
+
+    _DkInternalLock(&handle->ring.rx_lock);
+
+    uint32_t head = r->head;
+    uint32_t avail;
+
+    while (!(avail = r->tail - head)) {
+        ret = ring_arm_doorbell(handle, r);
+
+        /* the writer may have written before it saw rx_waiting */
+        if ((avail = r->tail - head))
+            break;
+
+        if (ret < 0)
+            goto out;
+
+        if (handle->ring.nonblocking) {
+            ret = -PAL_ERROR_TRYAGAIN;
+            goto out;
+        }
+
+        struct pollfd pfd = {.fd = handle->ring.fd, .events = POLLIN, .revents = 0};
+        ret = INLINE_SYSCALL(ppoll, 5, &pfd, 1, NULL, NULL, 0);
+        if (IS_ERR(ret)) {
+            ret = unix_to_pal_error(ERRNO(ret));
+            goto out;
+        }
+    }
+
+    /* a corrupt tail from the peer must not move the copy out of the ring */
+    if (avail > RING_SIZE)
+        avail = RING_SIZE;
+    if (avail > len)
+        avail = len;
+
+    /* read the data only after the tail which covers it */
+    COMPILER_BARRIER();
+
+    uint32_t off   = head & (RING_SIZE - 1);
+    uint32_t first = avail < RING_SIZE - off ? avail : RING_SIZE - off;
+    memcpy(buffer, r->data + off, first);
+    memcpy((char*)buffer + first, r->data, avail - first);
+
+    COMPILER_BARRIER();
+    r->head = head + avail;
+
+    MB();
+    if (r->tx_waiting && cmpxchg(&r->tx_waiting, 1, 0) == 1)
+        INLINE_SYSCALL(futex, 6, &r->head, FUTEX_WAKE, 1, NULL, NULL, 0);
+
+    /* the ring is empty again but a doorbell was rung for the data: drain it
+     * now, or polling would report the fd readable for nothing */
+    if (r->tail == r->head && !r->rx_waiting)
+        ring_arm_doorbell(handle, r);
+
+    ret = avail;
+out:
+    _DkInternalUnlock(&handle->ring.rx_lock);
+    return ret;
+}
+
+/* 'write' operation of ring stream. offset does not apply here. */
+static int64_t ring_write(PAL_HANDLE handle, uint64_t offset, size_t len, const void* buffer) {
+    if (offset)
+        return -PAL_ERROR_INVAL;
+
+    if (!IS_HANDLE_TYPE(handle, ring))
+        return -PAL_ERROR_NOTCONNECTION;
+
+    if (HANDLE_HDR(handle)->flags & ERROR(0))
+        return unix_to_pal_error(EPIPE);
+
+    struct ring* r = ring_tx(handle);
+    size_t bytes   = 0;
+    int64_t ret    = 0;
+
+    _DkInternalLock(&handle->ring.tx_lock);
+
+    while (bytes < len) {
+        uint32_t tail  = r->tail;
+        uint32_t head  = r->head;
+        uint32_t space = RING_SIZE - (tail - head);
+
+        if (!space) {
+            if (handle->ring.nonblocking)
+                break;
+
+            r->tx_waiting = 1;
+            MB();
+            if (r->head == head) {
+                struct timespec ts = {0, RING_WAIT_NSEC};
+                INLINE_SYSCALL(futex, 6, &r->head, FUTEX_WAIT, head, &ts, NULL, 0);
+                if (r->head == head && ring_peer_closed(handle)) {
+                    ret = unix_to_pal_error(EPIPE);
+                    break;
+                }
+            }
+            continue;
+        }
+
+        uint32_t n = len - bytes < space ? len - bytes : space;
+
+        uint32_t off   = tail & (RING_SIZE - 1);
+        uint32_t first = n < RING_SIZE - off ? n : RING_SIZE - off;
+        memcpy(r->data + off, (const char*)buffer + bytes, first);
+        memcpy(r->data, (const char*)buffer + bytes + first, n - first);
+
+        /* publish the data before the tail which covers it */
+        COMPILER_BARRIER();
+        r->tail = tail + n;
+        bytes += n;
+
+        ring_doorbell(handle, r);
+    }
+
+    _DkInternalUnlock(&handle->ring.tx_lock);
+
+    if (bytes)
+        return bytes;
+    return ret ? ret : -PAL_ERROR_TRYAGAIN;
+}
+
+/* 'close' operation of ring stream. */
+static int ring_close(PAL_HANDLE handle) {
+    if (handle->ring.shm) {
+        INLINE_SYSCALL(munmap, 2, handle->ring.shm, sizeof(struct ring_shm));
+        handle->ring.shm = NULL;
+    }
+
+    if (handle->ring.fd != PAL_IDX_POISON) {
+        INLINE_SYSCALL(close, 1, handle->ring.fd);
+        handle->ring.fd = PAL_IDX_POISON;
+    }
+
+    return 0;
+}
+
+/* 'delete' operation of ring stream. The peer sees the shutdown of the
+   socket as the end of the stream. */
+static int ring_delete(PAL_HANDLE handle, int access) {
+    if (handle->ring.fd == PAL_IDX_POISON)
+        return 0;
+
+    int shutdown;
+    switch (access) {
+        case 0:
+            shutdown = SHUT_RDWR;
+            break;
+        case PAL_DELETE_RD:
+            shutdown = SHUT_RD;
+            break;
+        case PAL_DELETE_WR:
+            shutdown = SHUT_WR;
+            break;
+        default:
+            return -PAL_ERROR_INVAL;
+    }
+
+    INLINE_SYSCALL(shutdown, 2, handle->ring.fd, shutdown);
+    return 0;
+}
+
+static int ring_attrquerybyhdl(PAL_HANDLE handle, PAL_STREAM_ATTR* attr) {
+    if (handle->ring.fd == PAL_IDX_POISON)
+        return -PAL_ERROR_BADHANDLE;
+
+    attr->handle_type = PAL_GET_TYPE(handle);
+    attr->nonblocking = handle->ring.nonblocking;
+
+    if (IS_HANDLE_TYPE(handle, ringsrv)) {
+        struct pollfd pfd  = {.fd = handle->ring.fd, .events = POLLIN, .revents = 0};
+        struct timespec tp = {0, 0};
+        int ret            = INLINE_SYSCALL(ppoll, 5, &pfd, 1, &tp, NULL, 0);
+        attr->readable     = (ret == 1 && pfd.revents == POLLIN);
+        attr->pending_size = 0;
+        attr->writable     = PAL_FALSE;
+    } else {
+        struct ring* rx = ring_rx(handle);
+        struct ring* tx = ring_tx(handle);
+
+        if (rx->tail == rx->head)
+            ring_peer_eof(handle);
+
+        attr->pending_size = rx->tail - rx->head;
+        attr->readable     = attr->pending_size > 0;
+        attr->writable     = tx->tail - tx->head < RING_SIZE;
+    }
+
+    attr->disconnected = HANDLE_HDR(handle)->flags & ERROR(0);
+    return 0;
+}
+
+static int ring_attrsetbyhdl(PAL_HANDLE handle, PAL_STREAM_ATTR* attr) {
+    if (handle->ring.fd == PAL_IDX_POISON)
+        return -PAL_ERROR_BADHANDLE;
+
+    /* only the listening socket blocks; a connected ring waits in ppoll() */
+    if (IS_HANDLE_TYPE(handle, ringsrv) && attr->nonblocking != handle->ring.nonblocking) {
+        int ret = INLINE_SYSCALL(fcntl, 3, handle->ring.fd, F_SETFL,
+                                 attr->nonblocking ? O_NONBLOCK : 0);
+
+        if (IS_ERR(ret))
+            return unix_to_pal_error(ERRNO(ret));
+    }
+
+    handle->ring.nonblocking = attr->nonblocking;
+    return 0;
+}
+
+static int ring_getname(PAL_HANDLE handle, char* buffer, size_t count) {
+    /* like pipes, the server end of a connection is named after the server */
+    const char* prefix = IS_HANDLE_TYPE(handle, ringsrv) || handle->ring.side ? "ring.srv"
+                                                                              : "ring";
+
+    int ret = snprintf(buffer, count, "%s:%lu", prefix, handle->ring.pipeid);
+    if (ret < 0 || (size_t)ret >= count)
+        return -PAL_ERROR_OVERFLOW;
+
+    return ret;
+}
+
+struct handle_ops ring_ops = {
+    .getname        = &ring_getname,
+    .open           = &ring_open,
+    .waitforclient  = &ring_waitforclient,
+    .read           = &ring_read,
+    .write          = &ring_write,
+    .close          = &ring_close,
+    .delete         = &ring_delete,
+    .attrquerybyhdl = &ring_attrquerybyhdl,
+    .attrsetbyhdl   = &ring_attrsetbyhdl,
+};
@@ -0,0 +1,128 @@
+/* Copyright (C) 2014 Stony Brook University
+   This file is part of Graphene Library OS.
+
+   Graphene Library OS is free software: you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public License
+   as published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   Graphene Library OS is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/*
+ * db_shm.c
+ *
+ * This file contains operands to handle streams with URIs "shm:". Opening
+ * "shm:" creates a new object of anonymous memory (a memfd) of size zero,
+ * which DkStreamSetLength() resizes. Every mapping of the object, in this
+ * process or in any process the handle is sent to, shares the same memory.
+ */
+
+#include "api.h"
+#include "pal.h"
+#include "pal_debug.h"
+#include "pal_defs.h"
+#include "pal_error.h"
+#include "pal_internal.h"
+#include "pal_linux.h"
+#include "pal_linux_defs.h"
+#include <asm/fcntl.h>
+#include <asm/mman.h>
+#include <linux/stat.h>
+
+static int shm_open(PAL_HANDLE* handle, const char* type, const char* uri, int access, int share,
+                    int create, int options) {
+    __UNUSED(access);
+    __UNUSED(share);
+    __UNUSED(create);
+    __UNUSED(options);
+
+    if (strcmp_static(type, "shm") || *uri)
+        return -PAL_ERROR_INVAL;
+
+    int fd = INLINE_SYSCALL(memfd_create, 2, "graphene-shm", MFD_CLOEXEC);
+    if (IS_ERR(fd))
+        return unix_to_pal_error(ERRNO(fd));
+
+    PAL_HANDLE hdl = malloc(HANDLE_SIZE(shm));
+    if (!hdl) {
+        INLINE_SYSCALL(close, 1, fd);
+        return -PAL_ERROR_NOMEM;
+    }
+
+    SET_HANDLE_TYPE(hdl, shm);
+    HANDLE_HDR(hdl)->flags |= RFD(0) | WFD(0);
+    hdl->shm.fd = fd;
+    *handle     = hdl;
+    return 0;
+}
+
+static int shm_map(PAL_HANDLE handle, void** addr, int prot, uint64_t offset, uint64_t size) {
+    void* mem = *addr;
+    int flags = MAP_SHARED | (mem ? MAP_FIXED : 0);
+
+    mem = (void*)ARCH_MMAP(mem, size, HOST_PROT(prot), flags, handle->shm.fd, offset);
+
+    if (IS_ERR_P(mem))
+        return -PAL_ERROR_DENIED;
+
+    *addr = mem;
+    return 0;
+}
+
+static int64_t shm_setlength(PAL_HANDLE handle, uint64_t length) {
+    int ret = INLINE_SYSCALL(ftruncate, 2, handle->shm.fd, length);
+
+    if (IS_ERR(ret))
+        return (ERRNO(ret) == EINVAL || ERRNO(ret) == EBADF) ? -PAL_ERROR_BADHANDLE
+                                                             : -PAL_ERROR_DENIED;
+
+    return (int64_t)length;
+}
+
+static int shm_close(PAL_HANDLE handle) {
+    if (handle->shm.fd != PAL_IDX_POISON) {
+        INLINE_SYSCALL(close, 1, handle->shm.fd);
+        handle->shm.fd = PAL_IDX_POISON;
+    }
+    return 0;
+}
+
+static int shm_attrquerybyhdl(PAL_HANDLE handle, PAL_STREAM_ATTR* attr) {
+    struct stat stat_buf;
+
+    int ret = INLINE_SYSCALL(fstat, 2, handle->shm.fd, &stat_buf);
+    if (IS_ERR(ret))
+        return unix_to_pal_error(ERRNO(ret));
+
+    memset(attr, 0, sizeof(*attr));
+    attr->handle_type  = pal_type_shm;
+    attr->readable     = PAL_TRUE;
+    attr->writable     = PAL_TRUE;
+    attr->pending_size = stat_buf.st_size;
+    return 0;
+}
+
+static int shm_getname(PAL_HANDLE handle, char* buffer, size_t count) {
+    __UNUSED(handle);
+
+    if (count < static_strlen("shm:") + 1)
+        return -PAL_ERROR_OVERFLOW;
+
+    memcpy(buffer, "shm:", static_strlen("shm:") + 1);
+    return static_strlen("shm:");
+}
+
+struct handle_ops shm_ops = {
+    .getname        = &shm_getname,
+    .open           = &shm_open,
+    .map            = &shm_map,
+    .setlength      = &shm_setlength,
+    .close          = &shm_close,
+    .attrquerybyhdl = &shm_attrquerybyhdl,
+};
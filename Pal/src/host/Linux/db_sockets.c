@@ -58,6 +58,13 @@ typedef __kernel_pid_t pid_t;
 #define SOL_IPV6 41
 #endif
 
+#ifndef __USE_GNU
+struct mmsghdr {
+    struct msghdr msg_hdr;
+    unsigned int msg_len;
+};
+#endif
+
 /* 96 bytes is the minimal size of buffer to store a IPv4/IPv6
    address */
 #define PAL_SOCKADDR_SIZE 96
@@ -920,6 +927,134 @@ static int64_t udp_sendbyaddr(PAL_HANDLE handle, uint64_t offset, size_t len, co
     return bytes;
 }
 
+/* at most this many datagrams go to one sendmmsg() or recvmmsg() */
+#define DATAGRAM_BATCH 64
+
+union inet_addr {
+    struct sockaddr sa;
+    struct sockaddr_in in;
+    struct sockaddr_in6 in6;
+};
+
+static int inet_from_pal_addr(const PAL_SOCKADDR* paddr, union inet_addr* addr,
+                              socklen_t* addrlen) {
+    switch (paddr->family) {
+        case PAL_AF_INET:
+            memset(&addr->in, 0, sizeof(addr->in));
+            addr->in.sin_family = AF_INET;
+            addr->in.sin_port   = __htons(paddr->port);
+            memcpy(&addr->in.sin_addr, paddr->addr, sizeof(addr->in.sin_addr));
+            *addrlen = sizeof(addr->in);
+            return 0;
+        case PAL_AF_INET6:
+            memset(&addr->in6, 0, sizeof(addr->in6));
+            addr->in6.sin6_family = AF_INET6;
+            addr->in6.sin6_port   = __htons(paddr->port);
+            memcpy(&addr->in6.sin6_addr, paddr->addr, sizeof(addr->in6.sin6_addr));
+            *addrlen = sizeof(addr->in6);
+            return 0;
+        default:
+            return -PAL_ERROR_INVAL;
+    }
+}
+
+static void inet_to_pal_addr(const union inet_addr* addr, socklen_t addrlen,
+                             PAL_SOCKADDR* paddr) {
+    memset(paddr, 0, sizeof(*paddr));
+
+    if (addr->sa.sa_family == AF_INET && addrlen >= sizeof(addr->in)) {
+        paddr->family = PAL_AF_INET;
+        paddr->port   = __ntohs(addr->in.sin_port);
+        memcpy(paddr->addr, &addr->in.sin_addr, sizeof(addr->in.sin_addr));
+    } else if (addr->sa.sa_family == AF_INET6 && addrlen >= sizeof(addr->in6)) {
+        paddr->family = PAL_AF_INET6;
+        paddr->port   = __ntohs(addr->in6.sin6_port);
+        memcpy(paddr->addr, &addr->in6.sin6_addr, sizeof(addr->in6.sin6_addr));
+    }
+}
+
+static int64_t udp_sendbatch(PAL_HANDLE handle, PAL_DATAGRAM* msgs, uint64_t count) {
+    if (!IS_HANDLE_TYPE(handle, udpsrv))
+        return -PAL_ERROR_NOTCONNECTION;
+
+    if (handle->sock.fd == PAL_IDX_POISON)
+        return -PAL_ERROR_BADHANDLE;
+
+    if (count > DATAGRAM_BATCH)
+        count = DATAGRAM_BATCH;
+
+    struct mmsghdr hdrs[count];
+    struct iovec iovs[count];
+    union inet_addr addrs[count];
+
+    memset(hdrs, 0, sizeof(hdrs));
+    for (uint64_t i = 0; i < count; i++) {
+        int ret = inet_from_pal_addr(&msgs[i].addr, &addrs[i], &hdrs[i].msg_hdr.msg_namelen);
+        if (ret < 0)
+            return ret;
+
+        iovs[i].iov_base = msgs[i].buffer;
+        iovs[i].iov_len  = msgs[i].size;
+        hdrs[i].msg_hdr.msg_name   = &addrs[i];
+        hdrs[i].msg_hdr.msg_iov    = &iovs[i];
+        hdrs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int64_t sent = INLINE_SYSCALL(sendmmsg, 4, handle->sock.fd, hdrs, count, MSG_NOSIGNAL);
+
+    if (!IS_ERR(sent) && (uint64_t)sent == count)
+        HANDLE_HDR(handle)->flags |= WRITABLE(0);
+    else
+        HANDLE_HDR(handle)->flags &= ~WRITABLE(0);
+
+    if (IS_ERR(sent))
+        return unix_to_pal_error(ERRNO(sent));
+
+    for (int64_t i = 0; i < sent; i++)
+        msgs[i].bytes = hdrs[i].msg_len;
+
+    return sent;
+}
+
+static int64_t udp_recvbatch(PAL_HANDLE handle, PAL_DATAGRAM* msgs, uint64_t count) {
+    if (!IS_HANDLE_TYPE(handle, udpsrv))
+        return -PAL_ERROR_NOTCONNECTION;
+
+    if (handle->sock.fd == PAL_IDX_POISON)
+        return -PAL_ERROR_BADHANDLE;
+
+    if (count > DATAGRAM_BATCH)
+        count = DATAGRAM_BATCH;
+
+    struct mmsghdr hdrs[count];
+    struct iovec iovs[count];
+    union inet_addr addrs[count];
+
+    memset(hdrs, 0, sizeof(hdrs));
+    for (uint64_t i = 0; i < count; i++) {
+        iovs[i].iov_base = msgs[i].buffer;
+        iovs[i].iov_len  = msgs[i].size;
+        hdrs[i].msg_hdr.msg_name    = &addrs[i];
+        hdrs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+        hdrs[i].msg_hdr.msg_iov     = &iovs[i];
+        hdrs[i].msg_hdr.msg_iovlen  = 1;
+    }
+
+    /* block for the first datagram only, then take what is queued */
+    int64_t received = INLINE_SYSCALL(recvmmsg, 5, handle->sock.fd, hdrs, count,
+                                      MSG_WAITFORONE, NULL);
+
+    if (IS_ERR(received))
+        return unix_to_pal_error(ERRNO(received));
+
+    for (int64_t i = 0; i < received; i++) {
+        msgs[i].bytes = hdrs[i].msg_len;
+        inet_to_pal_addr(&addrs[i], hdrs[i].msg_hdr.msg_namelen, &msgs[i].addr);
+    }
+
+    return received;
+}
+
 static int socket_delete(PAL_HANDLE handle, int access) {
     if (handle->sock.fd == PAL_IDX_POISON)
         return 0;
@@ -1207,6 +1342,8 @@ struct handle_ops udpsrv_ops = {
     .open           = &udp_open,
     .readbyaddr     = &udp_receivebyaddr,
     .writebyaddr    = &udp_sendbyaddr,
+    .sendbatch      = &udp_sendbatch,
+    .recvbatch      = &udp_recvbatch,
     .delete         = &socket_delete,
     .close          = &socket_close,
     .attrquerybyhdl = &socket_attrquerybyhdl,
@@ -107,6 +107,7 @@ int handle_serialize(PAL_HANDLE handle, void** data) {
     const void* d1;
     const void* d2;
     int dsz1 = 0, dsz2 = 0;
+    int ret;
 
     // ~ Check cargo PAL_HANDLE - is allowed to be sent (White List checking
     // of cargo type)
@@ -114,6 +115,9 @@ int handle_serialize(PAL_HANDLE handle, void** data) {
     // Channel between parent and child
     switch (PAL_GET_TYPE(handle)) {
         case pal_type_file:
+            /* the receiver must see the buffered writes */
+            if ((ret = file_flush_buffer(handle)) < 0)
+                return ret;
             d1   = handle->file.realpath;
             dsz1 = strlen(handle->file.realpath) + 1;
             break;
@@ -121,6 +125,8 @@ int handle_serialize(PAL_HANDLE handle, void** data) {
         case pal_type_pipesrv:
         case pal_type_pipecli:
         case pal_type_pipeprv:
+        case pal_type_ringsrv:
+        case pal_type_shm:
             break;
         case pal_type_dev:
             if (handle->dev.realpath) {
@@ -189,12 +195,15 @@ int handle_deserialize(PAL_HANDLE* handle, const void* data, int size) {
             memcpy(hdl, hdl_data, hdlsz);
             memcpy((void*)hdl + hdlsz, data, l);
             hdl->file.realpath = (void*)hdl + hdlsz;
+            file_init_buffer(hdl);
             break;
         }
         case pal_type_pipe:
         case pal_type_pipesrv:
         case pal_type_pipecli:
         case pal_type_pipeprv:
+        case pal_type_ringsrv:
+        case pal_type_shm:
             hdl = malloc_copy(hdl_data, hdlsz);
             break;
         case pal_type_dev: {
@@ -28,6 +28,7 @@
 #endif
 
 #include <atomic.h>
+#include <list.h>
 
 /* Simpler mutex design: a single variable that tracks whether the
  * mutex is locked (just waste a 64 bit word for now).  State is 1 (locked) or
@@ -69,6 +70,7 @@ typedef struct {
 
 #define MAX_FDS 3
 
+DEFINE_LIST(pal_handle);
 typedef struct pal_handle
 {
     /* TSAI: Here we define the internal types of PAL_HANDLE
@@ -85,8 +87,10 @@ typedef struct pal_handle
 
         struct {
             PAL_IDX fd;
-            PAL_NUM offset;
             PAL_STR realpath;
+            PAL_PTR buffer;         /* struct file_buffer, NULL if unbuffered */
+            PAL_LOCK buffer_lock;
+            LIST_TYPE(pal_handle) buffered; /* on the list of buffered files */
             /*
              * map_start is to request this file should be mapped to this
              * address. When fork is emulated, the address is already
@@ -106,6 +110,20 @@ typedef struct pal_handle
             PAL_BOL nonblocking;
         } pipeprv;
 
+        struct {
+            PAL_IDX fd;
+            PAL_NUM pipeid;
+            PAL_BOL nonblocking;
+            PAL_PTR shm;    /* rings shared with the peer, NULL for ring.srv */
+            PAL_IDX side;   /* index of the ring this end writes */
+            PAL_LOCK rx_lock;
+            PAL_LOCK tx_lock;
+        } ring;
+
+        struct {
+            PAL_IDX fd;
+        } shm;
+
         struct {
             PAL_IDX fd_in, fd_out;
             PAL_IDX dev_type;
@@ -174,6 +192,7 @@ typedef struct pal_handle
         } event;
     };
 } * PAL_HANDLE;
+DEFINE_LISTP(pal_handle);
 
 #define RFD(n)          (1 << (MAX_FDS*0 + (n)))
 #define WFD(n)          (1 << (MAX_FDS*1 + (n)))
@@ -44,6 +44,10 @@
 #define ERRNO INTERNAL_SYSCALL_ERRNO
 #define ERRNO_P INTERNAL_SYSCALL_ERRNO_P
 
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
 #define GRAPHENE_UNIX_PREFIX_FMT       "/graphene/%016lx"
 #define GRAPHENE_MCAST_GROUP           "239.0.0.1"
 
@@ -150,6 +154,17 @@ int clone (int (*__fn) (void * __arg), void * __child_stack,
 /* set/unset CLOEXEC flags of all fds in a handle */
 int handle_set_cloexec (PAL_HANDLE handle, bool enable);
 
+/* check a "ring:" stream for data, and arm its doorbell if there is none */
+bool ring_ready (PAL_HANDLE handle);
+
+/* set up the buffering of a "file:" handle as configured in the manifest, and
+   write out its buffered writes (see file_buffer.h) */
+void file_init_buffer (PAL_HANDLE handle);
+int file_flush_buffer (PAL_HANDLE handle);
+
+/* write out the buffered writes of all file handles, at exit */
+void file_flush_buffers (void);
+
 /* serialize/deserialize a handle into/from a malloc'ed buffer */
 int handle_serialize (PAL_HANDLE handle, void ** data);
 int handle_deserialize (PAL_HANDLE * handle, const void * data, int size);
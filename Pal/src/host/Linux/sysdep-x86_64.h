@@ -44,6 +44,11 @@
 #define __NR_semtimedop 220
 #endif
 
+/* Same for memfd_create, used for memory shared between processes.  */
+#ifndef __NR_memfd_create
+#define __NR_memfd_create 319
+#endif
+
 #ifdef __ASSEMBLER__
 
 /* ELF uses byte-counts for .align, most others use log2 of count of bytes.  */
@@ -50,3 +50,5 @@ unsigned long _DkMemoryQuota(void) {
 unsigned long _DkMemoryAvailableQuota(void) {
     return 0;
 }
+
+struct handle_ops shm_ops;
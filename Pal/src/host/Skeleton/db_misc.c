@@ -41,6 +41,16 @@ unsigned long _DkSystemTimeQuery (void)
     return 0;
 }
 
+unsigned long _DkSystemTimeQueryNs (void)
+{
+    return 0;
+}
+
+int _DkSystemTimeCalibrate (PAL_TSC_CALIBRATION * calib)
+{
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
+
 size_t _DkRandomBitsRead (void * buffer, size_t size)
 {
     return -PAL_ERROR_NOTIMPLEMENTED;
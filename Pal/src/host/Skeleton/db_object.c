@@ -32,3 +32,8 @@
 int _DkObjectsWaitAny(int count, PAL_HANDLE* handleArray, int64_t timeout_us, PAL_HANDLE* polled) {
     return -PAL_ERROR_NOTIMPLEMENTED;
 }
+
+int _DkStreamsWaitEvents(size_t count, PAL_HANDLE* handle_array, PAL_FLG* events,
+                         PAL_FLG* ret_events, int64_t timeout_us) {
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
@@ -130,3 +130,5 @@ struct handle_ops pipeprv_ops = {
         .write              = &pipe_write,
         .close              = &pipe_close,
     };
+
+struct handle_ops ring_ops;
@@ -142,6 +142,9 @@ enum {
     pal_type_mutex,
     pal_type_event,
     pal_type_gipc,
+    pal_type_ring,
+    pal_type_ringsrv,
+    pal_type_shm,
     PAL_HANDLE_TYPE_BOUND,
 };
 
@@ -341,6 +344,35 @@ PAL_NUM
 DkStreamWrite (PAL_HANDLE handle, PAL_NUM offset, PAL_NUM count,
                PAL_PTR buffer, PAL_STR dest);
 
+/* Datagrams with binary socket addresses, for "udp:" streams that are not
+ * connected. These avoid formatting and parsing an "udp:addr:port" URI for
+ * every packet, and send or receive up to 'count' datagrams in one call, like
+ * sendmmsg() and recvmmsg(). */
+#define PAL_AF_INET     1
+#define PAL_AF_INET6    2
+
+typedef struct {
+    PAL_FLG family;     /* PAL_AF_INET or PAL_AF_INET6 */
+    uint16_t port;      /* host byte order */
+    uint8_t addr[16];   /* network byte order, IPv4 in the first 4 bytes */
+} PAL_SOCKADDR;
+
+typedef struct {
+    PAL_PTR buffer;
+    PAL_NUM size;       /* size of buffer */
+    PAL_NUM bytes;      /* set to the bytes sent or received */
+    PAL_SOCKADDR addr;  /* destination, or set to the source */
+} PAL_DATAGRAM;
+
+/* Returns the number of datagrams sent, or 0 for failure. */
+PAL_NUM
+DkDatagramSend (PAL_HANDLE handle, PAL_DATAGRAM * msgs, PAL_NUM count);
+
+/* Waits for at least one datagram, unless the stream is non-blocking, and
+ * returns the number of datagrams received, or 0 for failure. */
+PAL_NUM
+DkDatagramReceive (PAL_HANDLE handle, PAL_DATAGRAM * msgs, PAL_NUM count);
+
 #define PAL_DELETE_RD       01
 #define PAL_DELETE_WR       02
 
@@ -495,6 +527,18 @@ DkEventClear (PAL_HANDLE eventHandle);
 PAL_HANDLE
 DkObjectsWaitAny (PAL_NUM count, PAL_HANDLE * handleArray, PAL_NUM timeout_us);
 
+#define PAL_WAIT_READ   1
+#define PAL_WAIT_WRITE  2
+#define PAL_WAIT_ERROR  4   /* only in ret_events: the stream failed or was closed */
+
+/* Waits until any of the streams has one of its events[] (PAL_WAIT_READ and/or
+ * PAL_WAIT_WRITE), and sets ret_events[] of every stream from a single host
+ * poll. Handles which are NULL, have no events or are not streams are skipped.
+ * Returns: PAL_FALSE if the call times out or fails */
+PAL_BOL
+DkStreamsWaitEvents (PAL_NUM count, PAL_HANDLE * handle_array, PAL_FLG * events,
+                     PAL_FLG * ret_events, PAL_NUM timeout_us);
+
 /* Deprecate DkObjectReference */
 
 void DkObjectClose (PAL_HANDLE objectHandle);
@@ -510,6 +554,31 @@ void DkObjectClose (PAL_HANDLE objectHandle);
 PAL_NUM
 DkSystemTimeQuery (void);
 
+/* the time since the Epoch in nanoseconds, or 0 for failure */
+PAL_NUM
+DkSystemTimeQueryNs (void);
+
+/* A linear mapping from the time-stamp counter of the CPU to the time in
+ * nanoseconds, so that the time can be read without calling the PAL:
+ *     ns = ns_base + (((tsc - tsc_base) * mult) >> PAL_TSC_MULT_SHIFT) */
+#define PAL_TSC_MULT_SHIFT  32
+
+typedef struct {
+    PAL_NUM tsc_base;
+    PAL_NUM ns_base;
+    PAL_NUM mult;       /* nanoseconds per TSC tick, fixed point */
+} PAL_TSC_CALIBRATION;
+
+/* Fills in a mapping that starts at the current host time. Every call
+ * re-synchronizes the mapping with the host clock and refines the rate, so
+ * the caller should ask for a new mapping regularly (e.g. every second).
+ * A mapping never starts before the previous one did, but may start before
+ * the time the previous one extrapolates to; a caller that needs a monotonic
+ * clock slews to the new mapping.
+ * Fails if the TSC cannot be read or does not tick at a constant rate. */
+PAL_BOL
+DkSystemTimeCalibrate (PAL_TSC_CALIBRATION * calib);
+
 /*
  * Cryptographically secure random.
  * 0 on success, negative on failure.
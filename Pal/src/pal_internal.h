@@ -69,6 +69,11 @@ struct handle_ops {
     int64_t (*writebyaddr) (PAL_HANDLE handle, uint64_t offset, uint64_t count,
                             const void * buffer, const char * addr, size_t addrlen);
 
+    /* 'sendbatch' and 'recvbatch' are used by DkDatagramSend and
+       DkDatagramReceive, and return the number of datagrams */
+    int64_t (*sendbatch) (PAL_HANDLE handle, PAL_DATAGRAM * msgs, uint64_t count);
+    int64_t (*recvbatch) (PAL_HANDLE handle, PAL_DATAGRAM * msgs, uint64_t count);
+
     /* 'close' and 'delete' is used by DkObjectClose and DkStreamDelete,
        'close' will close the stream, while 'delete' actually destroy
        the stream, such as deleting a file or shutting down a socket */
@@ -215,6 +220,9 @@ extern struct pal_internal_state {
 
     PAL_HANDLE      console;
 
+    /* buffer sizes of file handles (loader.file_buffer.*), 0 if unbuffered */
+    unsigned long   file_read_ahead, file_write_behind;
+
     unsigned long   start_time;
 #if PROFILING == 1
     unsigned long   relocation_time;
@@ -278,6 +286,8 @@ int64_t _DkStreamRead (PAL_HANDLE handle, uint64_t offset, uint64_t count,
                        void * buf, char * addr, int addrlen);
 int64_t _DkStreamWrite (PAL_HANDLE handle, uint64_t offset, uint64_t count,
                         const void * buf, const char * addr, int addrlen);
+int64_t _DkDatagramSend (PAL_HANDLE handle, PAL_DATAGRAM * msgs, uint64_t count);
+int64_t _DkDatagramReceive (PAL_HANDLE handle, PAL_DATAGRAM * msgs, uint64_t count);
 int _DkStreamAttributesQuery (const char * uri, PAL_STREAM_ATTR * attr);
 int _DkStreamAttributesQueryByHandle (PAL_HANDLE hdl, PAL_STREAM_ATTR * attr);
 int _DkStreamMap (PAL_HANDLE handle, void ** addr, int prot, uint64_t offset,
@@ -326,6 +336,8 @@ int _DkVirtualMemoryProtect (void * addr, uint64_t size, int prot);
 int _DkObjectReference (PAL_HANDLE objectHandle);
 int _DkObjectClose (PAL_HANDLE objectHandle);
 int _DkObjectsWaitAny(int count, PAL_HANDLE* handleArray, int64_t timeout_us, PAL_HANDLE* polled);
+int _DkStreamsWaitEvents(size_t count, PAL_HANDLE* handle_array, PAL_FLG* events,
+                         PAL_FLG* ret_events, int64_t timeout_us);
 
 /* DkException calls & structures */
 PAL_EVENT_HANDLER _DkGetExceptionHandler (PAL_NUM event_num);
@@ -336,6 +348,8 @@ void _DkExceptionReturn (void * event);
 int _DkInternalLock (PAL_LOCK * mut);
 int _DkInternalUnlock (PAL_LOCK * mut);
 unsigned long _DkSystemTimeQuery (void);
+unsigned long _DkSystemTimeQueryNs (void);
+int _DkSystemTimeCalibrate (PAL_TSC_CALIBRATION * calib);
 size_t _DkFastRandomBitsRead (void * buffer, size_t size);
 
 /*
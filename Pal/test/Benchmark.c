@@ -0,0 +1,665 @@
+/* Microbenchmarks of the PAL calls, to track the PAL performance per host.
+ *
+ * USAGE:
+ *     ./pal_loader Benchmark [iterations] [benchmark prefix]
+ *
+ * Prints a header line with the host, the PAL version and the CPU, then one
+ * tab-separated line per benchmark: the name, the number of operations, the
+ * nanoseconds per operation and (for data transfers) the MB/s. Lines which
+ * do not start with a benchmark name start with '#'. */
+
+#include "api.h"
+#include "pal.h"
+#include "pal_debug.h"
+
+#ifndef PAL_HOST
+#define PAL_HOST "unknown"
+#endif
+#ifndef PAL_BENCH_VERSION
+#define PAL_BENCH_VERSION "unknown"
+#endif
+
+#define FILE_URI     "file:Benchmark.tmp"
+#define TCP_SRV_URI  "tcp.srv:127.0.0.1:8000"
+#define TCP_URI      "tcp:127.0.0.1:8000"
+#define UDP_SRV_URI  "udp.srv:127.0.0.1:8000"
+#define UDP_URI      "udp:127.0.0.1:8000"
+
+#define SMALL_SIZE   64
+#define BLOCK_SIZE   4096
+#define BLOCK_COUNT  1024
+#define LARGE_SIZE   (32 * 1024)
+#define UDP_SIZE     1024
+#define MAX_WAIT_HANDLES 256
+
+static char buffer[LARGE_SIZE];
+static char buffer2[LARGE_SIZE];
+
+static const char* prefix;
+
+/* Also true for a group of benchmarks ("tcp_") which the prefix selects a
+ * benchmark of */
+static bool bench_selected(const char* name) {
+    if (!prefix)
+        return true;
+    size_t name_len = strlen(name), prefix_len = strlen(prefix);
+    return !memcmp(name, prefix, name_len < prefix_len ? name_len : prefix_len);
+}
+
+static bool streq(const char* a, const char* b) {
+    size_t len = strlen(a);
+    return len == strlen(b) && !memcmp(a, b, len);
+}
+
+static void bench_report(const char* name, PAL_NUM ops, PAL_NUM ns, PAL_NUM bytes) {
+    if (!ops)
+        return;
+    if (!ns)
+        ns = 1;
+
+    if (bytes)
+        pal_printf("%s\t%lu\t%lu\t%lu\n", name, ops, ns / ops, bytes * 1000 / ns);
+    else
+        pal_printf("%s\t%lu\t%lu\t-\n", name, ops, ns / ops);
+}
+
+static int bench_fail(const char* name, const char* what) {
+    pal_printf("# %s: %s failed\n", name, what);
+    return -1;
+}
+
+static bool read_all(PAL_HANDLE hdl, void* buf, PAL_NUM size) {
+    for (PAL_NUM done = 0; done < size;) {
+        PAL_NUM bytes = DkStreamRead(hdl, 0, size - done, buf + done, NULL, 0);
+        if (!bytes)
+            return false;
+        done += bytes;
+    }
+    return true;
+}
+
+static bool write_all(PAL_HANDLE hdl, const void* buf, PAL_NUM size) {
+    for (PAL_NUM done = 0; done < size;) {
+        PAL_NUM bytes = DkStreamWrite(hdl, 0, size - done, (void*)buf + done, NULL);
+        if (!bytes)
+            return false;
+        done += bytes;
+    }
+    return true;
+}
+
+/* Writes and reads back size bytes, through the same stream (wr == rd) or
+ * from one end to the other, or through a child which echoes them */
+static int bench_stream(const char* name, PAL_HANDLE wr, PAL_HANDLE rd, PAL_NUM size,
+                        PAL_NUM iterations) {
+    if (!bench_selected(name))
+        return 0;
+
+    PAL_NUM start = DkSystemTimeQueryNs();
+    for (PAL_NUM i = 0; i < iterations; i++) {
+        if (!write_all(wr, buffer, size))
+            return bench_fail(name, "DkStreamWrite");
+        if (!read_all(rd, buffer2, size))
+            return bench_fail(name, "DkStreamRead");
+    }
+    bench_report(name, iterations, DkSystemTimeQueryNs() - start, size * iterations * 2);
+    return 0;
+}
+
+static int bench_file(PAL_NUM iterations) {
+    if (!bench_selected("file_"))
+        return 0;
+
+    PAL_HANDLE file = DkStreamOpen(FILE_URI, PAL_ACCESS_RDWR, PAL_SHARE_OWNER_W | PAL_SHARE_OWNER_R,
+                                   PAL_CREATE_TRY, 0);
+    if (!file)
+        return bench_fail("file", "DkStreamOpen");
+
+    int ret = 0;
+    PAL_NUM sizes[2] = {SMALL_SIZE, LARGE_SIZE};
+    const char* names[2] = {"file_write_read_64", "file_write_read_32k"};
+
+    for (int s = 0; s < 2 && !ret; s++) {
+        if (!bench_selected(names[s]))
+            continue;
+
+        PAL_NUM start = DkSystemTimeQueryNs();
+        for (PAL_NUM i = 0; i < iterations; i++) {
+            if (DkStreamWrite(file, 0, sizes[s], buffer, NULL) != sizes[s]) {
+                ret = bench_fail(names[s], "DkStreamWrite");
+                break;
+            }
+            if (DkStreamRead(file, 0, sizes[s], buffer2, NULL, 0) != sizes[s]) {
+                ret = bench_fail(names[s], "DkStreamRead");
+                break;
+            }
+        }
+        if (!ret)
+            bench_report(names[s], iterations, DkSystemTimeQueryNs() - start,
+                         sizes[s] * iterations * 2);
+    }
+
+    DkStreamDelete(file, 0);
+    DkObjectClose(file);
+    return ret;
+}
+
+/* Random 4 KB reads and writes within a 4 MB file, as a database does; the
+ * operations per second are 10^9 / ns_per_op */
+static int bench_file_random(PAL_NUM iterations) {
+    if (!bench_selected("file_random_"))
+        return 0;
+
+    PAL_HANDLE file = DkStreamOpen(FILE_URI, PAL_ACCESS_RDWR, PAL_SHARE_OWNER_W | PAL_SHARE_OWNER_R,
+                                   PAL_CREATE_TRY, 0);
+    if (!file)
+        return bench_fail("file_random", "DkStreamOpen");
+
+    int ret = 0;
+    for (PAL_NUM b = 0; b < BLOCK_COUNT && !ret; b++)
+        if (DkStreamWrite(file, b * BLOCK_SIZE, BLOCK_SIZE, buffer, NULL) != BLOCK_SIZE)
+            ret = bench_fail("file_random", "DkStreamWrite");
+
+    const char* names[2] = {"file_random_read_4k", "file_random_write_4k"};
+
+    for (int w = 0; w < 2 && !ret; w++) {
+        if (!bench_selected(names[w]))
+            continue;
+
+        uint32_t seed = 1;
+        PAL_NUM start = DkSystemTimeQueryNs();
+        for (PAL_NUM i = 0; i < iterations; i++) {
+            seed = seed * 1103515245 + 12345;
+            PAL_NUM offset = (seed >> 16) % BLOCK_COUNT * BLOCK_SIZE;
+            PAL_NUM bytes = w ? DkStreamWrite(file, offset, BLOCK_SIZE, buffer, NULL)
+                              : DkStreamRead(file, offset, BLOCK_SIZE, buffer2, NULL, 0);
+            if (bytes != BLOCK_SIZE) {
+                ret = bench_fail(names[w], w ? "DkStreamWrite" : "DkStreamRead");
+                break;
+            }
+        }
+        if (!ret)
+            bench_report(names[w], iterations, DkSystemTimeQueryNs() - start,
+                         BLOCK_SIZE * iterations);
+    }
+
+    DkStreamDelete(file, 0);
+    DkObjectClose(file);
+    return ret;
+}
+
+static int bench_pipe(PAL_NUM iterations) {
+    if (!bench_selected("pipe_"))
+        return 0;
+
+    PAL_HANDLE pipe = DkStreamOpen("pipe:", PAL_ACCESS_RDWR, 0, 0, 0);
+    if (!pipe)
+        return bench_fail("pipe", "DkStreamOpen");
+
+    int ret = bench_stream("pipe_write_read_64", pipe, pipe, SMALL_SIZE, iterations);
+    if (!ret)
+        ret = bench_stream("pipe_write_read_32k", pipe, pipe, LARGE_SIZE, iterations);
+
+    DkObjectClose(pipe);
+    return ret;
+}
+
+static int bench_tcp(PAL_NUM iterations) {
+    if (!bench_selected("tcp_"))
+        return 0;
+
+    PAL_HANDLE srv = DkStreamOpen(TCP_SRV_URI, 0, 0, 0, 0);
+    if (!srv)
+        return bench_fail("tcp", "DkStreamOpen(tcp.srv)");
+
+    int ret = -1;
+    PAL_HANDLE cli = DkStreamOpen(TCP_URI, 0, 0, 0, 0);
+    if (!cli) {
+        bench_fail("tcp", "DkStreamOpen(tcp)");
+        goto out_srv;
+    }
+
+    PAL_HANDLE conn = DkStreamWaitForClient(srv);
+    if (!conn) {
+        bench_fail("tcp", "DkStreamWaitForClient");
+        goto out_cli;
+    }
+
+    ret = bench_stream("tcp_write_read_64", cli, conn, SMALL_SIZE, iterations);
+    if (!ret)
+        ret = bench_stream("tcp_write_read_32k", cli, conn, LARGE_SIZE, iterations);
+
+    DkObjectClose(conn);
+out_cli:
+    DkObjectClose(cli);
+out_srv:
+    DkStreamDelete(srv, 0);
+    DkObjectClose(srv);
+    return ret;
+}
+
+static int bench_udp(PAL_NUM iterations) {
+    if (!bench_selected("udp_"))
+        return 0;
+
+    PAL_HANDLE srv = DkStreamOpen(UDP_SRV_URI, 0, 0, 0, 0);
+    if (!srv)
+        return bench_fail("udp", "DkStreamOpen(udp.srv)");
+
+    int ret = -1;
+    PAL_HANDLE cli = DkStreamOpen(UDP_URI, 0, 0, 0, 0);
+    if (!cli) {
+        bench_fail("udp", "DkStreamOpen(udp)");
+        goto out;
+    }
+
+    PAL_NUM sizes[2] = {SMALL_SIZE, UDP_SIZE};
+    const char* names[2] = {"udp_write_read_64", "udp_write_read_1k"};
+
+    for (int s = 0; s < 2; s++) {
+        if (!bench_selected(names[s]))
+            continue;
+
+        /* the server reads by address, a whole datagram at a time */
+        char addr[40];
+        PAL_NUM start = DkSystemTimeQueryNs();
+        for (PAL_NUM i = 0; i < iterations; i++) {
+            if (DkStreamWrite(cli, 0, sizes[s], buffer, NULL) != sizes[s]) {
+                bench_fail(names[s], "DkStreamWrite");
+                goto out_cli;
+            }
+            if (DkStreamRead(srv, 0, sizes[s], buffer2, addr, sizeof(addr)) != sizes[s]) {
+                bench_fail(names[s], "DkStreamRead");
+                goto out_cli;
+            }
+        }
+        bench_report(names[s], iterations, DkSystemTimeQueryNs() - start,
+                     sizes[s] * iterations * 2);
+    }
+    ret = 0;
+
+out_cli:
+    DkObjectClose(cli);
+out:
+    DkStreamDelete(srv, 0);
+    DkObjectClose(srv);
+    return ret;
+}
+
+/* The child echoes everything back to the parent, until the parent closes the
+ * stream */
+static int child_echo(void) {
+    PAL_HANDLE parent = pal_control.parent_process;
+
+    while (true) {
+        PAL_NUM bytes = DkStreamRead(parent, 0, sizeof(buffer), buffer, NULL, 0);
+        if (!bytes || !write_all(parent, buffer, bytes))
+            break;
+    }
+    return 0;
+}
+
+static int bench_process_stream(PAL_NUM iterations) {
+    if (!bench_selected("process_write_read_"))
+        return 0;
+
+    const char* args[] = {"Benchmark", "child", "echo", NULL};
+    PAL_HANDLE proc = DkProcessCreate("file:Benchmark", args);
+    if (!proc)
+        return bench_fail("process_write_read", "DkProcessCreate");
+
+    int ret = bench_stream("process_write_read_64", proc, proc, SMALL_SIZE, iterations);
+    if (!ret)
+        ret = bench_stream("process_write_read_32k", proc, proc, LARGE_SIZE, iterations);
+
+    DkObjectClose(proc);
+    return ret;
+}
+
+/* DkObjectsWaitAny and DkStreamsWaitEvents over n pipes, of which only the
+ * last one is readable */
+static int bench_wait(PAL_NUM iterations) {
+    if (!bench_selected("wait_"))
+        return 0;
+
+    static PAL_HANDLE pipes[MAX_WAIT_HANDLES];
+    static PAL_FLG events[MAX_WAIT_HANDLES], ret_events[MAX_WAIT_HANDLES];
+    int ret = 0, npipes = 0;
+
+    for (; npipes < MAX_WAIT_HANDLES; npipes++) {
+        pipes[npipes] = DkStreamOpen("pipe:", PAL_ACCESS_RDWR, 0, 0, 0);
+        if (!pipes[npipes]) {
+            ret = bench_fail("wait", "DkStreamOpen");
+            goto out;
+        }
+        events[npipes] = PAL_WAIT_READ;
+    }
+
+    for (int n = 1; n <= MAX_WAIT_HANDLES; n *= 4) {
+        char name[48];
+        PAL_HANDLE ready = pipes[n - 1];
+
+        if (!write_all(ready, buffer, 1)) {
+            ret = bench_fail("wait", "DkStreamWrite");
+            goto out;
+        }
+
+        snprintf(name, sizeof(name), "wait_any_%d", n);
+        if (bench_selected(name)) {
+            PAL_NUM start = DkSystemTimeQueryNs();
+            for (PAL_NUM i = 0; i < iterations; i++)
+                if (DkObjectsWaitAny(n, pipes, NO_TIMEOUT) != ready) {
+                    ret = bench_fail(name, "DkObjectsWaitAny");
+                    goto out;
+                }
+            bench_report(name, iterations, DkSystemTimeQueryNs() - start, 0);
+        }
+
+        snprintf(name, sizeof(name), "wait_events_%d", n);
+        if (bench_selected(name)) {
+            PAL_NUM start = DkSystemTimeQueryNs();
+            for (PAL_NUM i = 0; i < iterations; i++)
+                if (!DkStreamsWaitEvents(n, pipes, events, ret_events, NO_TIMEOUT) ||
+                    !(ret_events[n - 1] & PAL_WAIT_READ)) {
+                    /* not implemented on every host */
+                    bench_fail(name, "DkStreamsWaitEvents");
+                    break;
+                }
+            bench_report(name, iterations, DkSystemTimeQueryNs() - start, 0);
+        }
+
+        if (!read_all(ready, buffer2, 1)) {
+            ret = bench_fail("wait", "DkStreamRead");
+            goto out;
+        }
+    }
+
+out:
+    for (int i = 0; i < npipes; i++)
+        DkObjectClose(pipes[i]);
+    return ret;
+}
+
+static int bench_memory(PAL_NUM iterations) {
+    PAL_NUM sizes[2] = {pal_control.alloc_align, pal_control.alloc_align * 256};
+    const char* names[2] = {"vm_alloc_free_page", "vm_alloc_touch_free_256_pages"};
+
+    for (int s = 0; s < 2; s++) {
+        if (!bench_selected(names[s]))
+            continue;
+
+        PAL_NUM start = DkSystemTimeQueryNs();
+        for (PAL_NUM i = 0; i < iterations; i++) {
+            char* mem = DkVirtualMemoryAlloc(NULL, sizes[s], 0, PAL_PROT_READ | PAL_PROT_WRITE);
+            if (!mem)
+                return bench_fail(names[s], "DkVirtualMemoryAlloc");
+            if (s)
+                for (PAL_NUM off = 0; off < sizes[s]; off += pal_control.alloc_align)
+                    mem[off] = 1;
+            DkVirtualMemoryFree(mem, sizes[s]);
+        }
+        bench_report(names[s], iterations, DkSystemTimeQueryNs() - start, 0);
+    }
+    return 0;
+}
+
+static PAL_HANDLE thread_done;
+
+static int thread_exit(void* arg) {
+    __UNUSED(arg);
+    DkEventSet(thread_done);
+    DkThreadExit();
+    return 0;
+}
+
+static int bench_thread(PAL_NUM iterations) {
+    if (!bench_selected("thread_create"))
+        return 0;
+
+    thread_done = DkSynchronizationEventCreate(PAL_FALSE);
+    if (!thread_done)
+        return bench_fail("thread_create", "DkSynchronizationEventCreate");
+
+    int ret = 0;
+    PAL_NUM start = DkSystemTimeQueryNs();
+    for (PAL_NUM i = 0; i < iterations; i++) {
+        PAL_HANDLE thread = DkThreadCreate(&thread_exit, NULL);
+        if (!thread) {
+            ret = bench_fail("thread_create", "DkThreadCreate");
+            break;
+        }
+        DkObjectsWaitAny(1, &thread_done, NO_TIMEOUT);
+        DkObjectClose(thread);
+    }
+    if (!ret)
+        bench_report("thread_create", iterations, DkSystemTimeQueryNs() - start, 0);
+
+    DkObjectClose(thread_done);
+    return ret;
+}
+
+static PAL_HANDLE ping, pong;
+static PAL_NUM pingpong_iterations;
+
+static int thread_pong(void* arg) {
+    __UNUSED(arg);
+    for (PAL_NUM i = 0; i < pingpong_iterations; i++) {
+        DkObjectsWaitAny(1, &ping, NO_TIMEOUT);
+        DkEventSet(pong);
+    }
+    DkThreadExit();
+    return 0;
+}
+
+static int bench_event(PAL_NUM iterations) {
+    int ret = 0;
+
+    if (bench_selected("event_set_wait")) {
+        PAL_HANDLE event = DkSynchronizationEventCreate(PAL_FALSE);
+        if (!event)
+            return bench_fail("event_set_wait", "DkSynchronizationEventCreate");
+
+        PAL_NUM start = DkSystemTimeQueryNs();
+        for (PAL_NUM i = 0; i < iterations; i++) {
+            DkEventSet(event);
+            if (DkObjectsWaitAny(1, &event, NO_TIMEOUT) != event) {
+                ret = bench_fail("event_set_wait", "DkObjectsWaitAny");
+                break;
+            }
+        }
+        if (!ret)
+            bench_report("event_set_wait", iterations, DkSystemTimeQueryNs() - start, 0);
+        DkObjectClose(event);
+    }
+
+    if (!ret && bench_selected("event_pingpong")) {
+        ping = DkSynchronizationEventCreate(PAL_FALSE);
+        pong = DkSynchronizationEventCreate(PAL_FALSE);
+        if (!ping || !pong)
+            return bench_fail("event_pingpong", "DkSynchronizationEventCreate");
+
+        pingpong_iterations = iterations;
+        PAL_HANDLE thread = DkThreadCreate(&thread_pong, NULL);
+        if (!thread)
+            return bench_fail("event_pingpong", "DkThreadCreate");
+
+        PAL_NUM start = DkSystemTimeQueryNs();
+        for (PAL_NUM i = 0; i < iterations; i++) {
+            DkEventSet(ping);
+            DkObjectsWaitAny(1, &pong, NO_TIMEOUT);
+        }
+        bench_report("event_pingpong", iterations, DkSystemTimeQueryNs() - start, 0);
+
+        DkObjectClose(thread);
+        DkObjectClose(ping);
+        DkObjectClose(pong);
+    }
+
+    return ret;
+}
+
+static int bench_mutex(PAL_NUM iterations) {
+    if (!bench_selected("mutex_acquire_release"))
+        return 0;
+
+    PAL_HANDLE mutex = DkMutexCreate(0);
+    if (!mutex)
+        return bench_fail("mutex_acquire_release", "DkMutexCreate");
+
+    int ret = 0;
+    PAL_NUM start = DkSystemTimeQueryNs();
+    for (PAL_NUM i = 0; i < iterations; i++) {
+        if (DkObjectsWaitAny(1, &mutex, NO_TIMEOUT) != mutex) {
+            ret = bench_fail("mutex_acquire_release", "DkObjectsWaitAny");
+            break;
+        }
+        DkMutexRelease(mutex);
+    }
+    if (!ret)
+        bench_report("mutex_acquire_release", iterations, DkSystemTimeQueryNs() - start, 0);
+
+    DkObjectClose(mutex);
+    return ret;
+}
+
+static int bench_time(PAL_NUM iterations) {
+    if (bench_selected("time_query_us")) {
+        PAL_NUM start = DkSystemTimeQueryNs();
+        for (PAL_NUM i = 0; i < iterations; i++)
+            DkSystemTimeQuery();
+        bench_report("time_query_us", iterations, DkSystemTimeQueryNs() - start, 0);
+    }
+
+    if (bench_selected("time_query_ns")) {
+        PAL_NUM start = DkSystemTimeQueryNs();
+        for (PAL_NUM i = 0; i < iterations; i++)
+            DkSystemTimeQueryNs();
+        bench_report("time_query_ns", iterations, DkSystemTimeQueryNs() - start, 0);
+    }
+    return 0;
+}
+
+/* The child exits as soon as it has written to the parent, which is how the
+ * parent knows it is up */
+static int child_exit(void) {
+    int retval = 0;
+    DkStreamWrite(pal_control.parent_process, 0, sizeof(retval), &retval, NULL);
+    return 0;
+}
+
+static int bench_process_create(PAL_NUM iterations) {
+    if (!bench_selected("process_create"))
+        return 0;
+
+    const char* args[] = {"Benchmark", "child", "exit", NULL};
+
+    PAL_NUM start = DkSystemTimeQueryNs();
+    for (PAL_NUM i = 0; i < iterations; i++) {
+        PAL_HANDLE proc = DkProcessCreate("file:Benchmark", args);
+        if (!proc)
+            return bench_fail("process_create", "DkProcessCreate");
+
+        int retval;
+        if (!read_all(proc, &retval, sizeof(retval)))
+            return bench_fail("process_create", "DkStreamRead");
+        DkObjectClose(proc);
+    }
+    bench_report("process_create", iterations, DkSystemTimeQueryNs() - start, 0);
+    return 0;
+}
+
+/* The child receives and closes handles, and acknowledges every one */
+static int child_recv(void) {
+    PAL_HANDLE parent = pal_control.parent_process;
+
+    while (true) {
+        PAL_HANDLE hdl = DkReceiveHandle(parent);
+        if (!hdl)
+            break;
+        DkObjectClose(hdl);
+        if (!write_all(parent, buffer, 1))
+            break;
+    }
+    return 0;
+}
+
+static int bench_send_handle(PAL_NUM iterations) {
+    if (!bench_selected("send_handle"))
+        return 0;
+
+    const char* args[] = {"Benchmark", "child", "recv", NULL};
+    PAL_HANDLE proc = DkProcessCreate("file:Benchmark", args);
+    if (!proc)
+        return bench_fail("send_handle", "DkProcessCreate");
+
+    int ret = -1;
+    PAL_HANDLE pipe = DkStreamOpen("pipe:", PAL_ACCESS_RDWR, 0, 0, 0);
+    if (!pipe) {
+        bench_fail("send_handle", "DkStreamOpen");
+        goto out;
+    }
+
+    PAL_NUM start = DkSystemTimeQueryNs();
+    for (PAL_NUM i = 0; i < iterations; i++) {
+        if (!DkSendHandle(proc, pipe)) {
+            bench_fail("send_handle", "DkSendHandle");
+            goto out_pipe;
+        }
+        if (!read_all(proc, buffer2, 1)) {
+            bench_fail("send_handle", "DkStreamRead");
+            goto out_pipe;
+        }
+    }
+    bench_report("send_handle", iterations, DkSystemTimeQueryNs() - start, 0);
+    ret = 0;
+
+out_pipe:
+    DkObjectClose(pipe);
+out:
+    DkObjectClose(proc);
+    return ret;
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 3 && streq(argv[1], "child")) {
+        if (streq(argv[2], "echo"))
+            return child_echo();
+        if (streq(argv[2], "exit"))
+            return child_exit();
+        if (streq(argv[2], "recv"))
+            return child_recv();
+        return -1;
+    }
+
+    PAL_NUM iterations = argc >= 2 ? atol(argv[1]) : 10000;
+    prefix = argc >= 3 ? argv[2] : NULL;
+    if (!iterations)
+        return -1;
+
+    /* the slow calls run fewer times */
+    PAL_NUM few = iterations / 100 ? : 1;
+
+    memset(buffer, 'x', sizeof(buffer));
+
+    pal_printf("# host=%s version=%s cpu=%s iterations=%lu\n", PAL_HOST, PAL_BENCH_VERSION,
+               pal_control.cpu_info.cpu_brand, iterations);
+    pal_printf("# benchmark\toperations\tns_per_op\tmb_per_s\n");
+
+    int ret = 0;
+    ret |= bench_time(iterations * 10);
+    ret |= bench_mutex(iterations);
+    ret |= bench_event(iterations);
+    ret |= bench_memory(iterations);
+    ret |= bench_thread(few);
+    ret |= bench_file(iterations);
+    ret |= bench_file_random(iterations);
+    ret |= bench_pipe(iterations);
+    ret |= bench_tcp(iterations);
+    ret |= bench_udp(iterations);
+    ret |= bench_process_stream(iterations);
+    ret |= bench_wait(iterations);
+    ret |= bench_process_create(few);
+    ret |= bench_send_handle(few);
+
+    return ret ? -1 : 0;
+}